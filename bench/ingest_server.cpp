@@ -0,0 +1,269 @@
+#include "ingest_server.h"
+#include "config.h"
+#include "esp_timer.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+static IngestConfig config;
+static IngestFrame* frames = nullptr;
+static size_t frameCapacity = 0;
+static std::atomic<uint32_t> framesReceived(0);
+static std::atomic<uint32_t> requests(0);
+static std::atomic<bool> running(false);
+static std::thread serverThread;
+static int listenFd = -1;
+
+// Разбор текущего запроса
+struct RequestState {
+  char header[1024];
+  size_t headerLen;
+  bool inBody;
+  long bodyLeft;
+  long frame;               // X-Frame (-1 - нет: статус в потоке, досылка)
+  long version;             // X-Settings-Version (-1 - нет)
+  uint32_t bytes;
+};
+
+static void resetRequest(RequestState& request) {
+  request.headerLen = 0;
+  request.inBody = false;
+  request.bodyLeft = 0;
+  request.frame = -1;
+  request.version = -1;
+  request.bytes = 0;
+}
+
+static void parseHeaders(RequestState& request) {
+  request.header[request.headerLen] = 0;
+  char* line = request.header;
+  while (line && *line) {
+    char* next = strstr(line, "\r\n");
+    if (next) {
+      *next = 0;
+      next += 2;
+    }
+    if (strncasecmp(line, "Content-Length:", 15) == 0) {
+      request.bodyLeft = strtol(line + 15, nullptr, 10);
+    } else if (strncasecmp(line, "X-Frame:", 8) == 0) {
+      request.frame = strtol(line + 8, nullptr, 10);
+    } else if (strncasecmp(line, "X-Settings-Version:", 19) == 0) {
+      request.version = strtol(line + 19, nullptr, 10);
+    }
+    line = next;
+  }
+}
+
+static bool sendAll(int fd, const char* data, size_t len) {
+  while (len > 0) {
+    ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+static bool finishRequest(int fd, const RequestState& request) {
+  if (request.frame >= 0 && (size_t)request.frame < frameCapacity) {
+    IngestFrame& frame = frames[request.frame];
+    if (frame.receivedUs == 0) {
+      frame.receivedUs = esp_timer_get_time();
+      frame.bytes = request.bytes;
+      framesReceived.fetch_add(1, std::memory_order_release);
+    }
+  }
+  requests.fetch_add(1, std::memory_order_relaxed);
+
+  char response[128];
+  int len;
+  if (config.mode == INGEST_CONTROL && request.version >= 0) {
+    len = snprintf(response, sizeof(response),
+                   "HTTP/1.1 200 OK\r\nX-Settings-Version: %ld\r\nContent-Length: 0\r\n\r\n", request.version);
+  } else {
+    len = snprintf(response, sizeof(response), "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n");
+  }
+  return sendAll(fd, response, len);
+}
+
+// Разобрать принятые байты; false - ошибка протокола или отправки ответа
+static bool consume(int fd, RequestState& request, const uint8_t* data, size_t len) {
+  while (len > 0) {
+    if (!request.inBody) {
+      if (request.headerLen + 1 >= sizeof(request.header)) {
+        return false;
+      }
+      request.header[request.headerLen++] = (char)*data++;
+      len--;
+      if (request.headerLen >= 4 && memcmp(request.header + request.headerLen - 4, "\r\n\r\n", 4) == 0) {
+        parseHeaders(request);
+        request.inBody = true;
+        if (request.bodyLeft == 0) {
+          if (!finishRequest(fd, request)) {
+            return false;
+          }
+          resetRequest(request);
+        }
+      }
+      continue;
+    }
+    size_t take = (size_t)request.bodyLeft < len ? (size_t)request.bodyLeft : len;
+    request.bodyLeft -= take;
+    request.bytes += take;
+    data += take;
+    len -= take;
+    if (request.bodyLeft == 0) {
+      if (!finishRequest(fd, request)) {
+        return false;
+      }
+      resetRequest(request);
+    }
+  }
+  return true;
+}
+
+static void serveConnection(int fd) {
+  static uint8_t buffer[65536];
+  RequestState request;
+  resetRequest(request);
+
+  // Ограничение скорости: ведро на 20 мс трафика (не меньше одного сегмента)
+  double tokens = 0;
+  double burst = config.rateBytesPerSec / 50.0;
+  if (burst < 1460) {
+    burst = 1460;
+  }
+  int64_t lastRefill = esp_timer_get_time();
+
+  while (running.load(std::memory_order_relaxed)) {
+    size_t want = sizeof(buffer);
+    if (config.rateBytesPerSec > 0) {
+      int64_t now = esp_timer_get_time();
+      tokens += (now - lastRefill) * (double)config.rateBytesPerSec / 1000000.0;
+      lastRefill = now;
+      if (tokens > burst) {
+        tokens = burst;
+      }
+      if (tokens < 1460) {
+        int64_t waitUs = (int64_t)((1460 - tokens) * 1000000.0 / config.rateBytesPerSec);
+        std::this_thread::sleep_for(std::chrono::microseconds(waitUs));
+        continue;
+      }
+      want = (size_t)tokens < want ? (size_t)tokens : want;
+    }
+
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 20) <= 0) {
+      continue;
+    }
+    ssize_t n = recv(fd, buffer, want, 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;  // Камера закрыла соединение (stopStreaming, переподключение)
+    }
+    tokens -= n;
+    if (!consume(fd, request, buffer, n)) {
+      fprintf(stderr, "ingest: malformed request, closing connection\n");
+      break;
+    }
+  }
+  close(fd);
+}
+
+static void serverLoop() {
+  while (running.load(std::memory_order_relaxed)) {
+    struct pollfd pfd = {listenFd, POLLIN, 0};
+    if (poll(&pfd, 1, 20) <= 0) {
+      continue;
+    }
+    int fd = accept(listenFd, nullptr, nullptr);
+    if (fd >= 0) {
+      serveConnection(fd);
+    }
+  }
+}
+
+bool ingestStart(const IngestConfig& ingestConfig, size_t maxFrames) {
+  if (running.load()) {
+    return false;
+  }
+  config = ingestConfig;
+  free(frames);
+  frames = (IngestFrame*)calloc(maxFrames, sizeof(IngestFrame));
+  if (!frames) {
+    return false;
+  }
+  frameCapacity = maxFrames;
+  framesReceived.store(0);
+  requests.store(0);
+
+  listenFd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    return false;
+  }
+  int enable = 1;
+  setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  // До listen(): размер окна согласуется при установке соединения
+  if (config.receiveBuffer > 0) {
+    setsockopt(listenFd, SOL_SOCKET, SO_RCVBUF, &config.receiveBuffer, sizeof(config.receiveBuffer));
+  }
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(SERVER_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 1) < 0) {
+    fprintf(stderr, "ingest: port %d unavailable: %s\n", SERVER_PORT, strerror(errno));
+    close(listenFd);
+    listenFd = -1;
+    return false;
+  }
+  running.store(true);
+  serverThread = std::thread(serverLoop);
+  return true;
+}
+
+bool ingestWaitFrames(uint32_t count, uint32_t timeoutMs) {
+  int64_t deadline = esp_timer_get_time() + (int64_t)timeoutMs * 1000;
+  while (framesReceived.load(std::memory_order_acquire) < count) {
+    if (esp_timer_get_time() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+void ingestStop() {
+  if (!running.load()) {
+    return;
+  }
+  running.store(false);
+  serverThread.join();
+  close(listenFd);
+  listenFd = -1;
+}
+
+const IngestFrame* ingestFrames() {
+  return frames;
+}
+
+uint32_t ingestRequests() {
+  return requests.load();
+}
@@ -0,0 +1,59 @@
+#ifndef INGEST_SERVER_H
+#define INGEST_SERVER_H
+
+/*
+ * Ingest Server Module
+ *
+ * Приёмник потока для бенчмарка: POST STREAM_PATH на 127.0.0.1:SERVER_PORT в отдельном потоке,
+ * время получения каждого кадра (последнего байта тела) по X-Frame.
+ *
+ * Особенности:
+ * - Одно соединение за раз, как у камеры; keep-alive и конвейер запросов
+ * - INGEST_PLAIN - ответ без тела (старый сервер), INGEST_CONTROL - с X-Settings-Version
+ *   кадра (stream_control считает канал активным, настроек в ответе нет)
+ * - Ограничение скорости чтения и маленький SO_RCVBUF - канал, близкий к WiFi
+ * - Время - esp_timer_get_time(), те же часы, что у fb->timestamp камеры
+ *
+ * Использование:
+ *   IngestConfig config = {INGEST_CONTROL, 0, 0};
+ *   ingestStart(config, 4096);
+ *   ... стриминг ...
+ *   ingestWaitFrames(sent, 2000);
+ *   ingestStop();
+ *   const IngestFrame* frames = ingestFrames();  // frames[i].receivedUs, 0 - не получен
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum IngestMode : uint8_t {
+  INGEST_PLAIN,     // 200, Content-Length: 0
+  INGEST_CONTROL    // 200, X-Settings-Version: <версия кадра>, Content-Length: 0
+};
+
+struct IngestConfig {
+  IngestMode mode;
+  uint32_t rateBytesPerSec;   // Скорость чтения (0 - без ограничения)
+  int receiveBuffer;          // SO_RCVBUF, байт (0 - по умолчанию ОС)
+};
+
+struct IngestFrame {
+  int64_t receivedUs;         // Тело получено полностью (0 - кадра не было)
+  uint32_t bytes;             // Размер тела
+};
+
+// Запустить приёмник; maxFrames - ёмкость таблицы кадров (X-Frame дальше не учитываются)
+bool ingestStart(const IngestConfig& config, size_t maxFrames);
+
+// Дождаться получения кадров 0..count-1; false - таймаут
+bool ingestWaitFrames(uint32_t count, uint32_t timeoutMs);
+
+// Остановить поток приёмника и закрыть сокеты (таблица кадров остаётся до следующего запуска)
+void ingestStop();
+
+const IngestFrame* ingestFrames();
+
+// Запросов с телом, принятых с запуска (кадры и статус в потоке)
+uint32_t ingestRequests();
+
+#endif // INGEST_SERVER_H
@@ -0,0 +1,537 @@
+/*
+ * Stream Benchmark
+ *
+ * Сквозной бенчмарк пути отправки кадров: настоящие stream_client, stream_control и camera
+ * (env:bench, сборка native) отправляют кадры в ingest_server через loopback.
+ * Матрица: разрешение x транспорт x режим сервера, для каждой комбинации - устойчивый FPS,
+ * скорость, задержка кадра от захвата до получения сервером (p50/p90/p99/max),
+ * время CPU и выделения памяти loop на кадр.
+ *
+ * Транспорты:
+ *   loopback  - буферы сокетов ОС, приёмник без ограничений (потолок самого кода)
+ *   lwip      - SO_SNDBUF 5744 (TCP_SND_BUF lwIP): write() блокируется, как на ESP32
+ *   wifi      - lwip + приёмник читает со скоростью --wifi-rate с маленьким окном
+ *
+ * Сборка:
+ *   pio run -e bench
+ *
+ * Использование:
+ *   .pio/build/bench/program [--duration SEC] [--warmup-ms MS] [--fps N] [--frames DIR]
+ *                            [--only SUBSTR] [--wifi-rate KB] [--label TEXT] [--json FILE]
+ *                            [--baseline FILE] [--tolerance PCT]
+ *
+ *   --frames DIR   подкаталоги DIR (vga/, hd/, ...) - последовательности JPEG, имя подкаталога -
+ *                  имя разрешения; без параметра - синтетические кадры VGA, SVGA, HD, UXGA
+ *   --json FILE    результаты (одна комбинация на строку) для сравнения между коммитами
+ *   --baseline FILE сравнить с прошлыми результатами: FPS ниже, задержка p50/p99 или CPU выше
+ *                  больше чем на --tolerance процентов (15) и на 500/50 мкс, выделений больше
+ *                  на 0.5/кадр - регрессия
+ *
+ * Возвращает: 0 - ok, 1 - регрессия относительно --baseline, 2 - ошибка запуска
+ */
+
+#include <Arduino.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/utsname.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "config.h"
+#include "camera.h"
+#include "wifi_client.h"
+#include "wifi_settings.h"
+#include "stream_client.h"
+#include "stream_control.h"
+#include "heap_counters.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
+#include "native_hal.h"
+#include "ingest_server.h"
+
+// Прошивка (main.cpp) в env:bench не собирается - setup()/loop() здесь не нужны
+
+struct Resolution {
+  std::string name;
+  framesize_t frameSize;      // Синтетические кадры (FRAMESIZE_INVALID - JPEG из каталога)
+  std::string directory;
+};
+
+struct Transport {
+  const char* name;
+  int sendBuffer;             // SO_SNDBUF камеры (0 - ОС)
+  bool shaped;                // Приёмник ограничен --wifi-rate
+};
+
+static const Transport TRANSPORTS[] = {
+  {"loopback", 0, false},
+  {"lwip", 5744, false},
+  {"wifi", 5744, true},
+};
+
+static const struct {
+  const char* name;
+  IngestMode mode;
+} SERVER_MODES[] = {
+  {"plain", INGEST_PLAIN},
+  {"control", INGEST_CONTROL},
+};
+
+struct Percentiles {
+  uint32_t p50;
+  uint32_t p90;
+  uint32_t p99;
+  uint32_t max;
+};
+
+struct BenchResult {
+  std::string name;
+  std::string resolution;
+  size_t width;
+  size_t height;
+  const char* transport;
+  const char* server;
+  uint32_t frames;
+  uint32_t failed;
+  double frameKB;
+  double fps;
+  double throughputKBs;
+  Percentiles latency;        // Захват -> тело получено сервером
+  LatencySummary socketWrite; // LATENCY_SOCKET_WRITE прошивки
+  double cpuUsPerFrame;
+  double allocsPerFrame;
+};
+
+struct BenchOptions {
+  uint32_t durationMs = 3000;
+  uint32_t warmupMs = 500;
+  int fps = STREAM_FPS;
+  uint32_t wifiRateKB = 1500;   // ~12 Mbit/s - типичная отправка TCP ESP32-CAM
+  const char* frames = nullptr;
+  const char* only = nullptr;
+  const char* label = "";
+  const char* json = nullptr;
+  const char* baseline = nullptr;
+  double tolerance = 15;
+};
+
+static int64_t threadCpuUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static Percentiles percentiles(std::vector<uint32_t>& values) {
+  Percentiles p = {0, 0, 0, 0};
+  if (values.empty()) {
+    return p;
+  }
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  p.p50 = values[(n - 1) * 50 / 100];
+  p.p90 = values[(n - 1) * 90 / 100];
+  p.p99 = values[(n - 1) * 99 / 100];
+  p.max = values[n - 1];
+  return p;
+}
+
+// ==================== Окружение прошивки ====================
+
+// Камера, WiFi (шим подключается сразу) и адрес сервера - как после настройки по Bluetooth
+static bool setupFirmware() {
+  char dataDir[] = "/tmp/stream_bench.XXXXXX";
+  if (!mkdtemp(dataDir)) {
+    return false;
+  }
+  nativeSetDataDir(dataDir);
+  nativeSdSetPresent(false);
+  nativeCameraSetFrameRate(0);  // Темп задаёт stream_client (frameInterval)
+
+  initHeapCounters();
+  initEventTrace();
+  if (!initCamera()) {
+    return false;
+  }
+  initWiFiSettings();
+  saveWiFiCredentials("bench", "");
+  saveServerHost("127.0.0.1");
+  startWiFi();
+  unsigned long start = millis();
+  while (!isWiFiConnected() && millis() - start < 5000) {
+    WiFiLinkEvent event;
+    while (pollWiFiEvent(event)) {
+    }
+    delay(1);
+  }
+  if (!isWiFiConnected()) {
+    return false;
+  }
+  initStreaming();
+  return true;
+}
+
+static bool selectFrames(const Resolution& resolution) {
+  if (resolution.frameSize == FRAMESIZE_INVALID) {
+    return nativeCameraLoadFrames(resolution.directory.c_str());
+  }
+  nativeCameraLoadFrames("");
+  sensor_t* s = esp_camera_sensor_get();
+  return s && s->set_framesize(s, resolution.frameSize) == 0;
+}
+
+// ==================== Прогон ====================
+
+static bool runBench(const BenchOptions& options, const Resolution& resolution, const Transport& transport,
+                     IngestMode mode, BenchResult& result) {
+  if (!selectFrames(resolution)) {
+    fprintf(stderr, "%s: no frames\n", resolution.name.c_str());
+    return false;
+  }
+  nativeNetSetSendBuffer(transport.sendBuffer);
+  setStreamFPS(options.fps);
+
+  IngestConfig ingest = {mode, transport.shaped ? options.wifiRateKB * 1024 : 0, transport.shaped ? 8192 : 0};
+  size_t maxFrames = (size_t)(options.durationMs + options.warmupMs) * options.fps / 1000 + 64;
+  if (!ingestStart(ingest, maxFrames)) {
+    return false;
+  }
+  // Таблицы - до прогона: в измеряемом окне loop выделяет память только сама прошивка
+  std::vector<int64_t> captureUs(maxFrames, 0);
+  std::vector<uint32_t> latencies;
+  latencies.reserve(maxFrames);
+
+  resetServerConnectionErrors();
+  markStreamLinkLost();  // Подключение без паузы RECONNECT_INTERVAL после прошлого прогона
+  if (!startStreaming()) {
+    ingestStop();
+    return false;
+  }
+
+  unsigned long runStart = millis();
+  bool measuring = false;
+  unsigned long windowStart = 0;
+  uint32_t windowFirstFrame = 0;
+  uint32_t windowFailed = 0;
+  uint32_t windowAllocations = 0;
+  int64_t cpuUs = 0;
+  unsigned long sent = 0;
+
+  while (true) {
+    unsigned long now = millis();
+    if (!measuring && now - runStart >= options.warmupMs) {
+      measuring = true;
+      windowStart = now;
+      windowFirstFrame = getFramesSent();
+      windowFailed = getFailedFrames();
+      windowAllocations = getLoopAllocations();
+      latencyTake(LATENCY_SOCKET_WRITE);
+      cpuUs = 0;
+    }
+    if (measuring && now - windowStart >= options.durationMs) {
+      break;
+    }
+
+    int64_t cpuStart = threadCpuUs();
+    updateStreaming();
+    handleStreamControl();
+    unsigned long framesNow = getFramesSent();
+    if (framesNow != sent) {
+      // Время CPU - только итерации с кадром: ожидание интервала кадра в прошивке - занятый цикл
+      cpuUs += threadCpuUs() - cpuStart;
+      if (sent < maxFrames) {
+        captureUs[sent] = nativeCameraLastCaptureTime();
+      }
+      sent = framesNow;
+    }
+    delayMicroseconds(100);
+  }
+  unsigned long windowMs = millis() - windowStart;
+  uint32_t windowFrames = sent - windowFirstFrame;
+  result.failed = getFailedFrames() - windowFailed;
+  result.allocsPerFrame = windowFrames ? (double)(getLoopAllocations() - windowAllocations) / windowFrames : 0;
+  result.cpuUsPerFrame = windowFrames ? (double)cpuUs / windowFrames : 0;
+  result.socketWrite = latencyTake(LATENCY_SOCKET_WRITE);
+
+  // Кадры в пути (буферы сокетов, медленный приёмник) - дождаться до остановки
+  if (!ingestWaitFrames(sent, 5000)) {
+    fprintf(stderr, "%s: %lu frames sent, not all received\n", result.name.c_str(), sent);
+  }
+  stopStreaming();
+  ingestStop();
+
+  const IngestFrame* frames = ingestFrames();
+  uint64_t bytes = 0;
+  uint32_t received = 0;
+  for (uint32_t i = windowFirstFrame; i < sent && i < maxFrames; i++) {
+    if (frames[i].receivedUs == 0) {
+      continue;
+    }
+    received++;
+    bytes += frames[i].bytes;
+    latencies.push_back((uint32_t)(frames[i].receivedUs - captureUs[i]));
+  }
+  result.frames = received;
+  result.fps = windowMs ? received * 1000.0 / windowMs : 0;
+  result.throughputKBs = windowMs ? bytes / 1024.0 * 1000.0 / windowMs : 0;
+  result.frameKB = received ? bytes / 1024.0 / received : 0;
+  result.latency = percentiles(latencies);
+
+  camera_fb_t* fb = captureFrame();
+  result.width = fb ? fb->width : 0;
+  result.height = fb ? fb->height : 0;
+  releaseFrame(fb);
+  return true;
+}
+
+// ==================== Результаты ====================
+
+static void printHeader() {
+  printf("%-24s %9s %7s %9s %9s %9s %9s %9s %9s %8s %7s\n", "config", "frame_kb", "fps", "KB/s",
+         "lat_p50", "lat_p90", "lat_p99", "lat_max", "write_p99", "cpu_us", "allocs");
+}
+
+static void printResult(const BenchResult& r) {
+  printf("%-24s %9.1f %7.1f %9.0f %9u %9u %9u %9u %9u %8.0f %7.2f\n", r.name.c_str(), r.frameKB, r.fps,
+         r.throughputKBs, r.latency.p50, r.latency.p90, r.latency.p99, r.latency.max, r.socketWrite.p99,
+         r.cpuUsPerFrame, r.allocsPerFrame);
+  if (r.failed) {
+    printf("%-24s %u frames failed\n", "", r.failed);
+  }
+}
+
+static bool writeJson(const char* path, const BenchOptions& options, const std::vector<BenchResult>& results) {
+  FILE* f = fopen(path, "w");
+  if (!f) {
+    return false;
+  }
+  struct utsname host;
+  uname(&host);
+  char date[32];
+  time_t now = time(nullptr);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  // Одна комбинация на строку - читается --baseline без парсера JSON и удобна для diff
+  fprintf(f, "{\n  \"label\": \"%s\",\n  \"date\": \"%s\",\n  \"host\": \"%s %s\",\n", options.label, date,
+          host.sysname, host.machine);
+  fprintf(f, "  \"duration_ms\": %u,\n  \"warmup_ms\": %u,\n  \"stream_fps\": %d,\n  \"wifi_rate_kb\": %u,\n",
+          options.durationMs, options.warmupMs, options.fps, options.wifiRateKB);
+  fprintf(f, "  \"results\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    fprintf(f,
+            "    {\"name\": \"%s\", \"resolution\": \"%s\", \"width\": %zu, \"height\": %zu, "
+            "\"transport\": \"%s\", \"server\": \"%s\", \"frames\": %u, \"failed\": %u, \"frame_kb\": %.1f, "
+            "\"fps\": %.2f, \"throughput_kbs\": %.0f, "
+            "\"latency_us\": {\"p50\": %u, \"p90\": %u, \"p99\": %u, \"max\": %u}, "
+            "\"socket_write_us\": {\"p50\": %u, \"p90\": %u, \"p99\": %u, \"max\": %u}, "
+            "\"cpu_us_per_frame\": %.1f, \"allocs_per_frame\": %.2f}%s\n",
+            r.name.c_str(), r.resolution.c_str(), r.width, r.height, r.transport, r.server, r.frames, r.failed,
+            r.frameKB, r.fps, r.throughputKBs, r.latency.p50, r.latency.p90, r.latency.p99, r.latency.max,
+            r.socketWrite.p50, r.socketWrite.p90, r.socketWrite.p99, r.socketWrite.max, r.cpuUsPerFrame,
+            r.allocsPerFrame, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  return fclose(f) == 0;
+}
+
+// Число после "key": (начиная с from); false - ключа нет
+static bool jsonNumber(const char* line, const char* key, double& value, const char* from = nullptr) {
+  char pattern[48];
+  snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+  const char* found = strstr(from ? from : line, pattern);
+  if (!found) {
+    return false;
+  }
+  value = strtod(found + strlen(pattern), nullptr);
+  return true;
+}
+
+// Порог регрессии помимо процентов: задержки loopback - сотни мкс и дрожат от планировщика
+static const double LATENCY_NOISE_US = 500;
+static const double CPU_NOISE_US = 50;
+static const double ALLOCS_NOISE = 0.5;
+
+// Сравнение с прошлым прогоном; возвращает число регрессий
+static int compareBaseline(const char* path, double tolerance, const std::vector<BenchResult>& results) {
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "Cannot read baseline %s\n", path);
+    return -1;
+  }
+  int regressions = 0;
+  int compared = 0;
+  char line[1024];
+  printf("\nBaseline %s (tolerance %.0f%%):\n", path, tolerance);
+  while (fgets(line, sizeof(line), f)) {
+    const char* nameStart = strstr(line, "\"name\": \"");
+    if (!nameStart) {
+      continue;
+    }
+    nameStart += 9;
+    const char* nameEnd = strchr(nameStart, '"');
+    std::string name(nameStart, nameEnd ? nameEnd - nameStart : 0);
+    const BenchResult* current = nullptr;
+    for (const BenchResult& r : results) {
+      if (r.name == name) {
+        current = &r;
+      }
+    }
+    const char* latency = strstr(line, "\"latency_us\"");
+    double fps, p50, p99, cpu, allocs;
+    if (!current || !latency || !jsonNumber(line, "fps", fps) || !jsonNumber(line, "p50", p50, latency) ||
+        !jsonNumber(line, "p99", p99, latency) || !jsonNumber(line, "cpu_us_per_frame", cpu) ||
+        !jsonNumber(line, "allocs_per_frame", allocs)) {
+      continue;
+    }
+    compared++;
+    double limit = 1 + tolerance / 100;
+    bool worse = false;
+    auto report = [&](const char* metric, double before, double after) {
+      printf("  REGRESSION %-24s %-16s %.1f -> %.1f\n", name.c_str(), metric, before, after);
+      worse = true;
+    };
+    if (current->fps * limit < fps) {
+      report("fps", fps, current->fps);
+    }
+    if (current->latency.p50 > p50 * limit && current->latency.p50 > p50 + LATENCY_NOISE_US) {
+      report("latency_p50_us", p50, current->latency.p50);
+    }
+    if (current->latency.p99 > p99 * limit && current->latency.p99 > p99 + LATENCY_NOISE_US) {
+      report("latency_p99_us", p99, current->latency.p99);
+    }
+    if (current->cpuUsPerFrame > cpu * limit && current->cpuUsPerFrame > cpu + CPU_NOISE_US) {
+      report("cpu_us_per_frame", cpu, current->cpuUsPerFrame);
+    }
+    if (current->allocsPerFrame > allocs + ALLOCS_NOISE) {
+      report("allocs_per_frame", allocs, current->allocsPerFrame);
+    }
+    regressions += worse ? 1 : 0;
+  }
+  fclose(f);
+  printf("  %d configs compared, %d regressed\n", compared, regressions);
+  return regressions;
+}
+
+// ==================== Параметры ====================
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [--duration SEC] [--warmup-ms MS] [--fps N] [--frames DIR] [--only SUBSTR]\n"
+          "          [--wifi-rate KB] [--label TEXT] [--json FILE] [--baseline FILE] [--tolerance PCT]\n",
+          program);
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--duration") == 0) {
+      options.durationMs = atoi(value) * 1000;
+    } else if (strcmp(arg, "--warmup-ms") == 0) {
+      options.warmupMs = atoi(value);
+    } else if (strcmp(arg, "--fps") == 0) {
+      options.fps = constrain(atoi(value), 1, 60);
+    } else if (strcmp(arg, "--frames") == 0) {
+      options.frames = value;
+    } else if (strcmp(arg, "--only") == 0) {
+      options.only = value;
+    } else if (strcmp(arg, "--wifi-rate") == 0) {
+      options.wifiRateKB = atoi(value);
+    } else if (strcmp(arg, "--label") == 0) {
+      options.label = value;
+    } else if (strcmp(arg, "--json") == 0) {
+      options.json = value;
+    } else if (strcmp(arg, "--baseline") == 0) {
+      options.baseline = value;
+    } else if (strcmp(arg, "--tolerance") == 0) {
+      options.tolerance = atof(value);
+    } else {
+      return false;
+    }
+  }
+  return options.durationMs > 0 && options.wifiRateKB > 0;
+}
+
+static std::vector<Resolution> listResolutions(const char* framesDir) {
+  std::vector<Resolution> resolutions;
+  if (!framesDir) {
+    resolutions.push_back({"vga", FRAMESIZE_VGA, ""});
+    resolutions.push_back({"svga", FRAMESIZE_SVGA, ""});
+    resolutions.push_back({"hd", FRAMESIZE_HD, ""});
+    resolutions.push_back({"uxga", FRAMESIZE_UXGA, ""});
+    return resolutions;
+  }
+  DIR* dir = opendir(framesDir);
+  if (!dir) {
+    return resolutions;
+  }
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (entry->d_name[0] != '.' && entry->d_type == DT_DIR) {
+      resolutions.push_back({entry->d_name, FRAMESIZE_INVALID, std::string(framesDir) + "/" + entry->d_name});
+    }
+  }
+  closedir(dir);
+  std::sort(resolutions.begin(), resolutions.end(),
+            [](const Resolution& a, const Resolution& b) { return a.name < b.name; });
+  return resolutions;
+}
+
+int main(int argc, char** argv) {
+  BenchOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    usage(argv[0]);
+    return 2;
+  }
+  std::vector<Resolution> resolutions = listResolutions(options.frames);
+  if (resolutions.empty()) {
+    fprintf(stderr, "No frame directories in %s\n", options.frames);
+    return 2;
+  }
+
+  // Вывод прошивки ("Streaming started" на каждый прогон) не смешивается с таблицей
+  nativeSerialSetEnabled(false);
+  if (!setupFirmware()) {
+    fprintf(stderr, "Firmware setup failed\n");
+    return 2;
+  }
+
+  std::vector<BenchResult> results;
+  printHeader();
+  for (const Resolution& resolution : resolutions) {
+    for (const Transport& transport : TRANSPORTS) {
+      for (const auto& server : SERVER_MODES) {
+        BenchResult result = {};
+        result.name = resolution.name + "/" + transport.name + "/" + server.name;
+        if (options.only && result.name.find(options.only) == std::string::npos) {
+          continue;
+        }
+        result.resolution = resolution.name;
+        result.transport = transport.name;
+        result.server = server.name;
+        if (!runBench(options, resolution, transport, server.mode, result)) {
+          fprintf(stderr, "%s: run failed\n", result.name.c_str());
+          return 2;
+        }
+        printResult(result);
+        fflush(stdout);
+        results.push_back(result);
+      }
+    }
+  }
+
+  if (options.json && !writeJson(options.json, options, results)) {
+    fprintf(stderr, "Cannot write %s\n", options.json);
+    return 2;
+  }
+  if (options.baseline) {
+    int regressions = compareBaseline(options.baseline, options.tolerance, results);
+    if (regressions != 0) {
+      return regressions < 0 ? 2 : 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef ASYNC_HTTP_H
+#define ASYNC_HTTP_H
+
+#include <Arduino.h>
+
+/*
+ * Async HTTP Module
+ *
+ * Очередь коротких HTTP запросов управления (настройки, статус), которые выполняются
+ * фоновой задачей - loop() и видеопоток не ждут connect/ответа сервера.
+ *
+ * Особенности:
+ * - Запросы выполняет задача "http_async" (ядро 0) через HTTPClient, по одному
+ * - Очередь на ASYNC_HTTP_QUEUE запросов; не начатый запрос с тем же tag заменяется новым
+ *   (например, свежий статус вместо устаревшего)
+ * - Результат (код, тело, до ASYNC_HTTP_HEADERS заголовков ответа) передаётся в callback из handleAsyncHttp(),
+ *   значение заголовка длиннее ASYNC_HTTP_HEADER_VALUE_MAX - пустое, а не обрезанное,
+ *   то есть в контексте loop - callback может менять состояние других модулей
+ * - В loop работа за вызов ограничена: копирование запроса в очередь и вызов готовых callback
+ * - Без выделения памяти в loop: тела запроса и ответа - в буфере слота (PSRAM, выделяется
+ *   в initAsyncHttp()), заголовки - массивы фиксированного размера
+ *
+ * Использование:
+ *   initAsyncHttp();                        // В setup()
+ *   handleAsyncHttp();                      // В loop - вызывает callback завершённых запросов
+ *
+ *   AsyncHttpRequest request;
+ *   request.tag = 1;
+ *   request.url = settingsURL;              // Строка должна жить до завершения запроса
+ *   snprintf(request.headers, sizeof(request.headers), "X-Device-ID: %s\n", getDeviceId());
+ *   request.collectHeaders[0] = "ETag";
+ *   request.callback = onSettings;          // void onSettings(const AsyncHttpResponse& response)
+ *   asyncHttpSubmit(request);
+ */
+
+#define ASYNC_HTTP_QUEUE 4
+#define ASYNC_HTTP_HEADERS 2
+#define ASYNC_HTTP_BODY_MAX 4096             // Тело запроса и ответа, байт
+#define ASYNC_HTTP_REQUEST_HEADERS_MAX 224
+#define ASYNC_HTTP_HEADER_VALUE_MAX 96      // ETag W/"<SHA-256 hex>" - 69 символов; длиннее - значение отбрасывается
+
+// Ответ длиннее ASYNC_HTTP_BODY_MAX (ошибки HTTPClient - от -1 до -11)
+#define ASYNC_HTTP_ERROR_TOO_LARGE -100
+
+struct AsyncHttpResponse {
+  int status;                                // HTTP код или отрицательная ошибка (нет соединения, таймаут)
+  const char* body;                          // Тело ответа, нуль-терминировано
+  size_t length;
+  const char* headers[ASYNC_HTTP_HEADERS];   // Значения collectHeaders[i] ("" - нет в ответе)
+};
+
+typedef void (*AsyncHttpCallback)(const AsyncHttpResponse& response);
+
+struct AsyncHttpRequest {
+  uint8_t tag = 0;                       // Вид запроса (для замены в очереди и asyncHttpPending)
+  bool post = false;                     // POST body, иначе GET
+  const char* url = nullptr;             // Не копируется - строка должна жить до завершения запроса
+  char headers[ASYNC_HTTP_REQUEST_HEADERS_MAX] = "";  // Строки "Name: value\n"
+  const char* body = nullptr;            // Копируется в буфер слота при постановке в очередь
+  size_t bodyLength = 0;
+  const char* collectHeaders[ASYNC_HTTP_HEADERS] = {};  // Заголовки ответа для callback
+  uint16_t timeoutMs = 3000;             // Таймаут connect и чтения ответа
+  AsyncHttpCallback callback = nullptr;  // nullptr - результат не нужен
+};
+
+// Создать задачу и буферы очереди
+void initAsyncHttp();
+
+// Поставить запрос в очередь. false - очередь заполнена или тело больше ASYNC_HTTP_BODY_MAX
+bool asyncHttpSubmit(const AsyncHttpRequest& request);
+
+// Запрос с этим tag в очереди или выполняется
+bool asyncHttpPending(uint8_t tag);
+
+// Вызвать callback завершённых запросов (вызывать в loop)
+void handleAsyncHttp();
+
+#endif // ASYNC_HTTP_H
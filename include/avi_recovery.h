@@ -0,0 +1,31 @@
+#ifndef AVI_RECOVERY_H
+#define AVI_RECOVERY_H
+
+#include <Arduino.h>
+
+/*
+ * AVI Recovery Module
+ *
+ * Восстановление прерванных записей (*.avi.tmp после сбоя питания или извлечения карты).
+ *
+ * Алгоритм:
+ * - Поиск LIST movi и обход кадров 00dc по заголовкам (данные кадров не читаются)
+ * - Обрезка по последнему полностью записанному кадру
+ * - Запись индекса idx1 сразу за последним кадром
+ * - Исправление размеров RIFF, movi и количества кадров в avih/strh
+ * - Переименование .tmp -> .avi
+ *
+ * Хост-версия для карт из эксплуатации: tools/avi_recover.cpp
+ */
+
+struct AVIRecoveryResult {
+  uint32_t frames;        // Восстановлено кадров
+  uint32_t originalSize;  // Размер .tmp файла до восстановления
+  uint32_t recoveredSize; // Размер данных AVI после восстановления (RIFF + 8)
+};
+
+// Восстановить tempPath и переименовать в finalPath.
+// false - восстановить нечего (нет заголовка или ни одного полного кадра) или ошибка переименования
+bool recoverAVIFile(const String& tempPath, const String& finalPath, AVIRecoveryResult& result);
+
+#endif // AVI_RECOVERY_H
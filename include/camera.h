@@ -14,4 +14,8 @@ camera_fb_t* captureFrame();
 // Вернуть буфер кадра
 void releaseFrame(camera_fb_t* fb);
 
+// Получить кадр с другим разрешением (timelapse). Разрешение сенсора восстанавливается сразу,
+// кадр освобождается как обычно через releaseFrame()
+camera_fb_t* captureFrameAtSize(framesize_t frameSize);
+
 #endif // CAMERA_H
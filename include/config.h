@@ -4,6 +4,24 @@
 // ==================== Настройки Wi-Fi ====================
 #define WIFI_SSID ""          // Имя вашей WiFi сети
 #define WIFI_PASSWORD ""       // Пароль WiFi
+#define WIFI_CONNECT_TIMEOUT_MS 10000    // Попытка подключения без IP дольше - неудача (WIFI_LINK_DISCONNECTED)
+#define WIFI_RETRY_DELAY_MS 5000         // Пауза перед повторной попыткой
+#define WIFI_FAST_RECONNECT true         // Подключаться к BSSID/каналу из кэша NVS без сканирования
+#define WIFI_DIRECTED_TIMEOUT_MS 3000    // Нет ассоциации с точкой из кэша дольше - сканирование
+#define WIFI_REUSE_LEASE true            // С точкой из кэша - прошлый IP без DHCP (false, если аренды короткие)
+#define WIFI_LEASE_REUSE_S 3600          // Прошлый IP - не дольше N секунд после DHCP (не больше половины срока аренды сервера)
+#define WIFI_MAX_PROFILES 4              // Профилей сетей: основной (ssid/password) и список "wifi.networks"
+#define WIFI_PROFILE_PRIORITY_DB 3       // Выбор сети: каждая позиция в списке профилей "стоит" столько dB RSSI
+
+// Роуминг: слабая точка доступа или поток не успевает - сканирование и переход на лучшую
+#define WIFI_ROAM_ENABLED true
+#define WIFI_ROAM_RSSI -75               // Сигнал слабее (dBm) - проверка не пройдена
+#define WIFI_ROAM_CHECK_MS 2000          // Период проверки RSSI и отправки кадров
+#define WIFI_ROAM_SAMPLES 5              // Непройденных проверок подряд до сканирования
+#define WIFI_ROAM_HYSTERESIS_DB 8        // Новая точка должна быть лучше текущей на столько dB
+#define WIFI_ROAM_COOLDOWN_MS 60000      // Минимум между сканированиями для роуминга
+#define WIFI_ROAM_PENALTY_DB 15          // Штраф точке, где поток не успевал или подключение не удалось...
+#define WIFI_ROAM_PENALTY_MS 300000      // ...на это время
 
 // ==================== Настройки сервера ====================
 #define SERVER_HOST ""      // IP вашего веб-сервера
@@ -11,6 +29,19 @@
 #define STREAM_PATH "/stream"            // Путь для отправки видео потока
 #define SETTINGS_PATH "/api/camera"      // Путь для получения настроек
 #define STATUS_PATH "/api/status"        // Путь для отправки статуса
+#define SETTINGS_WATCH_ENABLED true      // Long-poll канал настроек (иначе только опрос SETTINGS_PATH)
+#define SETTINGS_WATCH_PATH "/api/camera/watch"  // Путь long-poll запроса настроек
+#define SETTINGS_WATCH_TIMEOUT_S 25      // Сколько сервер держит запрос без изменений, сек
+
+// ==================== Хранение настроек (NVS) ====================
+#define SETTINGS_STORE_DEBOUNCE_MS 2000  // Запись группы настроек после паузы в изменениях
+#define SETTINGS_STORE_MAX_DELAY_MS 10000  // ...но не позже этого срока после первого изменения
+
+// ==================== Буферы JSON управления ====================
+#define SETTINGS_JSON_MAX 2048           // Максимальный JSON настроек (больше - ответ отбрасывается)
+#define STATUS_JSON_MAX 4096             // Буфер сериализации статуса
+#define JSON_ARENA_SIZE 8192             // Арена ArduinoJson для разбора настроек и сборки статуса
+#define JSON_FILTER_ARENA_SIZE 3072      // Арена фильтра полей настроек (строится один раз)
 
 // ==================== Пины камеры для AI-Thinker ESP32-CAM ====================
 #define PWDN_GPIO_NUM     32
@@ -34,8 +65,63 @@
 #define STREAM_FPS 60                    // Target FPS
 #define STREAM_QUALITY 15                // JPEG quality (10-63, lower=better, 15 good for HD@60fps)
 
+// Буфер кадров на время обрыва связи (store-and-forward)
+#define STREAM_SPOOL_ENABLED true        // Копить кадры в PSRAM, пока сервер недоступен
+#define STREAM_SPOOL_MAX_BYTES (1024 * 1024)  // Размер буфера (при переполнении вытесняются старые кадры)
+#define STREAM_SPOOL_INTERVAL_MS 1000    // Интервал между сохраняемыми кадрами (0 = каждый кадр потока)
+#define STREAM_BACKFILL_RATE_KB 64       // Скорость досылки после восстановления связи, KB/s
+
+// Управление в соединении видеопотока (настройки в ответах на кадры, статус между кадрами)
+#define STREAM_CONTROL_ENABLED true      // Разбирать ответы сервера на кадры
+#define STREAM_CONTROL_HOLD_MS 5000      // Нет ответов с X-Settings-Version дольше - отдельные запросы настроек/статуса
+
 // ==================== Настройки записи на SD карту ====================
 #define SD_RECORDING_ENABLED false       // Включена ли запись по умолчанию
 #define SD_RECORDING_INTERVAL 10         // Интервал записи в секундах (по умолчанию 10)
+#define SD_CLUSTER_SIZE 32768            // Размер кластера FAT32 для учёта места (32KB - стандарт для SDHC 8-32GB)
+#define SD_SYNC_INTERVAL_MS 3000         // Синхронизация .tmp файла (для восстановления после сбоя питания)
+#define SD_ROLLOVER_PREPARE_MS 3000      // За сколько до конца сегмента открывать следующий файл
+#define SD_BUS_WIDTH 1                   // Шина SD_MMC: 1 (GPIO4/12/13 свободны) или 4 (быстрее, см. docs/sd-recording.md)
+#define SD_BUS_FREQ_KHZ 20000            // Частота шины: 20000 (default speed) или 40000 (high speed)
+#define SD_MAX_OPEN_FILES 8              // Текущий, следующий и завершаемый сегменты, каталог, чтение сегментов
+#define SD_BENCH_MB 4                    // Объём записи на каждый размер блока в тесте карты (команда "sdbench")
+#define SD_CONTAINER 0                   // Контейнер сегментов: 0 = AVI, 1 = Matroska (MKV)
+#define SD_MKV_CLUSTER_MS 5000           // Длительность кластера MKV (не больше 32767)
+
+// Профиль записи (независимо от стриминга)
+#define SD_RECORDING_FPS 0               // Частота кадров записи (0 = как у стриминга)
+#define SD_RECORDING_EVERY_N 1           // Записывать каждый N-й кадр (1 = все)
+#define SD_SEGMENT_MAX_MB 0              // Максимальный размер сегмента в MB (0 = только по времени)
+
+// Timelapse (SD_RECORDING_MODE 2)
+#define SD_TIMELAPSE_INTERVAL 60         // Секунд между кадрами
+#define SD_TIMELAPSE_FPS 24              // Частота воспроизведения
+#define SD_TIMELAPSE_SEGMENT_HOURS 12    // Длительность сегмента (реального времени)
+#define SD_TIMELAPSE_FRAMESIZE -1        // Разрешение кадров timelapse (framesize_t, -1 = как у стриминга)
+
+// Запись по событию (пред-событийный буфер в PSRAM + post-roll)
+#define SD_RECORDING_MODE 0              // 0 = непрерывная запись, 1 = по событию
+#define SD_PREEVENT_SECONDS 5            // Сколько секунд до события сохранять
+#define SD_POSTROLL_SECONDS 10           // Сколько секунд писать после последнего события
+#define SD_PREEVENT_MAX_BYTES (2 * 1024 * 1024)  // Максимальный размер буфера в PSRAM
+#define SD_TRIGGER_GPIO -1               // GPIO триггера (активный LOW, -1 = выкл). На ESP32-CAM свободны 12, 13 (только при SD_BUS_WIDTH 1)
+#define SD_MOTION_THRESHOLD 0            // Детектор движения: % изменения размера JPEG (0 = выкл)
+
+// ==================== Выгрузка записей на сервер ====================
+#define SD_UPLOAD_ENABLED false          // Выгружать завершённые сегменты на сервер
+#define SD_UPLOAD_PATH "/api/records/upload"  // Путь для приёма сегментов
+#define SD_UPLOAD_RATE_KB 256            // Ограничение скорости выгрузки, KB/s (0 = без ограничения)
+#define SD_UPLOAD_CHUNK_KB 32            // Размер одного запроса (части сегмента), KB
+#define SD_UPLOAD_SAVE_KB 256            // Как часто сохранять позицию выгрузки в NVS, KB
+
+// ==================== Просмотр записей с устройства ====================
+#define PLAYBACK_SERVER_ENABLED true     // HTTP сервер списка и воспроизведения записей
+#define PLAYBACK_PORT 80                 // Порт сервера записей
+#define PLAYBACK_BLOCK_SIZE 16384        // Блок чтения с карты (кратен сектору 512)
+
+// ==================== Трасса событий ====================
+#define TRACE_ENABLED true               // Кольцевой буфер событий в PSRAM (GET /trace, команда "trace")
+#define TRACE_EVENTS 2048                // Событий в буфере (степень двойки, 12 байт на событие)
+#define TRACE_DUMP_PATH "/trace.bin"     // Файл дампа на SD (команда "trace")
 
 #endif // CONFIG_H
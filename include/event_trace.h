@@ -0,0 +1,88 @@
+#ifndef EVENT_TRACE_H
+#define EVENT_TRACE_H
+
+#include <Arduino.h>
+
+/*
+ * Event Trace Module
+ *
+ * Бинарная трасса событий (кадры, запись на SD, переподключения, настройки) в кольцевом
+ * буфере PSRAM - разбор сбоев по времени без Serial.printf.
+ *
+ * Особенности:
+ * - traceEvent(): атомарный инкремент индекса, время esp_timer_get_time() и запись 12 байт -
+ *   без блокировок, с обоих ядер, из любой задачи (не из ISR)
+ * - TRACE_EVENTS последних событий (степень двойки), старые перезаписываются
+ * - Выгрузка: на время чтения трасса замораживается (новые события считаются в lost), дамп -
+ *   TraceDumpHeader + события от старых к новым
+ *   - GET /trace на сервере записей (playback_server), сервер забирает сам
+ *   - команда "trace" в настройках - файл TRACE_DUMP_PATH на SD (фоновая задача sd_recorder)
+ * - tools/trace_to_chrome.cpp переводит дамп в формат Chrome Trace (chrome://tracing, Perfetto)
+ * - Событие, записанное ядром во время заморозки, может испортить самую старую запись дампа
+ *
+ * Использование:
+ *   initEventTrace();                               // В setup()
+ *   traceEvent(TRACE_FRAME_CAPTURED, fb->len);
+ *
+ *   traceFreeze();
+ *   for (uint32_t offset = 0; offset < traceDumpSize(); offset += n) n = traceRead(offset, buf, sizeof(buf));
+ *   traceUnfreeze();
+ */
+
+// Типы событий (номера - часть формата дампа, только добавлять)
+enum TraceEventType : uint8_t {
+  TRACE_FRAME_CAPTURED = 1,    // arg - размер JPEG
+  TRACE_FRAME_SENT = 2,        // arg - номер кадра
+  TRACE_FRAME_DROPPED = 3,     // arg - TraceDropReason
+  TRACE_SD_WRITE_BEGIN = 4,    // arg - размер кадра
+  TRACE_SD_WRITE_END = 5,      // arg - 1 записан, 0 ошибка
+  TRACE_RECONNECT_BEGIN = 6,
+  TRACE_RECONNECT_END = 7,     // arg - 1 подключено, 0 ошибка
+  TRACE_SETTINGS_APPLIED = 8,  // arg - длина JSON настроек
+  TRACE_SEND_BEGIN = 9,        // arg - размер кадра
+  TRACE_SEND_END = 10          // arg - 1 отправлен, 0 ошибка
+};
+
+// Причина потери кадра потока
+enum TraceDropReason : uint8_t {
+  TRACE_DROP_NO_CONNECTION = 1,  // Нет соединения с сервером
+  TRACE_DROP_CAPTURE = 2,        // Камера не отдала кадр
+  TRACE_DROP_SEND = 3            // Ошибка отправки
+};
+
+struct TraceEvent {
+  uint32_t timeUs;     // Младшие 32 бита esp_timer_get_time()
+  uint8_t type;        // TraceEventType
+  uint8_t core;
+  uint16_t reserved;
+  uint32_t arg;
+};
+
+// Заголовок дампа (little-endian)
+struct TraceDumpHeader {
+  char magic[4];       // "ECTR"
+  uint16_t version;    // 1
+  uint16_t eventSize;  // sizeof(TraceEvent)
+  uint32_t count;      // Событий в дампе
+  uint32_t total;      // Событий с загрузки (total - count перезаписаны)
+  uint32_t lost;       // Не записаны во время выгрузки
+  uint32_t dumpUs;     // Время дампа (младшие 32 бита esp_timer_get_time())
+};
+
+// Выделить буфер (PSRAM). Без буфера traceEvent() ничего не делает
+bool initEventTrace();
+
+// Записать событие
+void traceEvent(TraceEventType type, uint32_t arg = 0);
+
+// Заморозить трассу для выгрузки (вложенные вызовы допустимы)
+void traceFreeze();
+void traceUnfreeze();
+
+// Размер дампа замороженной трассы, байт
+uint32_t traceDumpSize();
+
+// Прочитать часть дампа (байты offset...), возвращает прочитано байт
+size_t traceRead(uint32_t offset, uint8_t* buffer, size_t len);
+
+#endif // EVENT_TRACE_H
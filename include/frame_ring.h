@@ -0,0 +1,57 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <Arduino.h>
+
+/*
+ * Frame Ring Module
+ *
+ * Кольцевой буфер JPEG кадров в PSRAM с ограничением по размеру.
+ *
+ * Особенности:
+ * - Каждый кадр хранится непрерывно (можно писать в файл/сокет без копирования)
+ * - При нехватке места вытесняются самые старые кадры
+ * - У каждого кадра сохраняется время захвата (millis())
+ * - Нет выделений памяти после frameRingInit()
+ *
+ * Использование:
+ *   FrameRing ring;
+ *   frameRingInit(ring, 2 * 1024 * 1024);       // 2MB в PSRAM
+ *   frameRingPush(ring, fb->buf, fb->len, millis());
+ *   while (frameRingPeek(ring, data, len, ts)) {
+ *     // ... использовать кадр
+ *     frameRingPop(ring);
+ *   }
+ */
+
+struct FrameRing {
+  uint8_t* buffer;
+  size_t capacity;
+  size_t head;       // Позиция самого старого кадра
+  size_t tail;       // Позиция для следующего кадра
+  size_t bytes;      // Байт JPEG данных в буфере (без заголовков)
+  uint32_t frames;   // Количество кадров в буфере
+};
+
+// Выделить буфер (PSRAM). false - нет памяти
+bool frameRingInit(FrameRing& ring, size_t capacity);
+
+// Освободить буфер
+void frameRingFree(FrameRing& ring);
+
+// Удалить все кадры
+void frameRingClear(FrameRing& ring);
+
+// Добавить кадр (вытесняя старые). false - кадр больше буфера
+bool frameRingPush(FrameRing& ring, const uint8_t* data, size_t len, uint32_t timestamp);
+
+// Самый старый кадр без удаления. false - буфер пуст
+bool frameRingPeek(const FrameRing& ring, const uint8_t*& data, size_t& len, uint32_t& timestamp);
+
+// Удалить самый старый кадр
+void frameRingPop(FrameRing& ring);
+
+// Удалить кадры, захваченные раньше timestamp
+void frameRingDropOlderThan(FrameRing& ring, uint32_t timestamp);
+
+#endif // FRAME_RING_H
@@ -0,0 +1,37 @@
+#ifndef HEAP_COUNTERS_H
+#define HEAP_COUNTERS_H
+
+#include <Arduino.h>
+
+/*
+ * Heap Counters Module
+ *
+ * Счётчики выделений памяти (malloc/calloc/realloc, в том числе из new и String) -
+ * проверка, что путь управления (настройки, статус) в установившемся режиме не трогает кучу.
+ *
+ * Особенности:
+ * - Работает при сборке с -DHEAP_COUNTERS и -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+ *   (platformio.ini); без флага счётчики всегда 0, heapCountersEnabled() - false
+ * - Отдельно считаются выделения из задачи loop (задача запоминается в initHeapCounters())
+ * - Счётчик общего числа выделений между ядрами не синхронизирован - приблизительный
+ *
+ * Использование:
+ *   initHeapCounters();                     // В setup(), из задачи loop
+ *   uint32_t before = getLoopAllocations();
+ *   buildStatus();
+ *   uint32_t allocs = getLoopAllocations() - before;
+ */
+
+// Запомнить текущую задачу как задачу loop
+void initHeapCounters();
+
+// Собрано с обёртками malloc
+bool heapCountersEnabled();
+
+// Выделений из задачи loop
+uint32_t getLoopAllocations();
+
+// Выделений всеми задачами
+uint32_t getTotalAllocations();
+
+#endif // HEAP_COUNTERS_H
@@ -0,0 +1,51 @@
+#ifndef JSON_ARENA_H
+#define JSON_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/*
+ * JSON Arena Module
+ *
+ * Аллокатор ArduinoJson поверх буфера фиксированного размера: разбор настроек и
+ * сборка статуса не обращаются к куче.
+ *
+ * Особенности:
+ * - Выделение - сдвиг указателя (выравнивание 8 байт от начала буфера; невыровненное
+ *   начало пропускается), освобождение последнего блока возвращает место, остальные
+ *   блоки освобождаются вместе с последним живым - документ на арене должен быть один
+ *   (второй одновременно живой документ, например фильтр, - в своей арене)
+ * - reallocate() последнего блока - на месте (ArduinoJson так растит строки и пулы)
+ * - Не хватило места - nullptr, ArduinoJson возвращает NoMemory / overflowed()
+ *
+ * Использование:
+ *   alignas(8) static uint8_t buffer[JSON_ARENA_SIZE];
+ *   static JsonArena arena(buffer, sizeof(buffer));
+ *   JsonDocument doc(&arena);
+ *   deserializeJson(doc, json, length, DeserializationOption::Filter(filter));
+ */
+
+class JsonArena : public ArduinoJson::Allocator {
+public:
+  JsonArena(uint8_t* buffer, size_t capacity);
+
+  void* allocate(size_t size) override;
+  void deallocate(void* ptr) override;
+  void* reallocate(void* ptr, size_t newSize) override;
+
+  size_t used() const { return top; }
+  size_t peak() const { return peakUsed; }
+  size_t capacity() const { return size; }
+  uint32_t failures() const { return failedAllocations; }
+
+private:
+  uint8_t* buffer;
+  size_t size;
+  size_t top = 0;             // Занято с начала буфера
+  size_t lastBlock = 0;       // Смещение заголовка последнего блока
+  size_t live = 0;            // Неосвобождённых блоков
+  size_t peakUsed = 0;
+  uint32_t failedAllocations = 0;
+};
+
+#endif // JSON_ARENA_H
@@ -0,0 +1,69 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <Arduino.h>
+
+/*
+ * Latency Histogram Module
+ *
+ * Гистограммы длительностей (мкс) фиксированного размера: лог-линейные корзины -
+ * 8 корзин на каждую степень двойки, погрешность перцентиля не больше 1/16 значения.
+ *
+ * Особенности:
+ * - Без блокировок: запись - атомарный инкремент корзины, можно писать с обоих ядер
+ * - Окна со сбросом при чтении: latencyTake() атомарно забирает и обнуляет каждую корзину -
+ *   каждое значение попадает ровно в одно окно
+ * - До 2^26 мкс (~67 с), большие значения - в последней корзине (max точный)
+ * - Этапы потока (LatencyStage) - готовые гистограммы для статуса
+ *
+ * Использование:
+ *   unsigned long start = micros();
+ *   ...
+ *   latencyRecord(LATENCY_CAPTURE, micros() - start);
+ *
+ *   LatencySummary s = latencyTake(LATENCY_CAPTURE);   // p50/p90/p99/max за окно
+ */
+
+#define LATENCY_SUB_BITS 3                                  // 2^3 корзин на октаву
+#define LATENCY_MAX_BITS 26                                 // Верхняя граница 2^26 мкс
+#define LATENCY_BUCKETS ((LATENCY_MAX_BITS - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS)
+
+struct LatencyHistogram {
+  uint32_t buckets[LATENCY_BUCKETS];
+  uint32_t max;
+};
+
+// Итог окна, мкс
+struct LatencySummary {
+  uint32_t count;
+  uint32_t p50;
+  uint32_t p90;
+  uint32_t p99;
+  uint32_t max;
+};
+
+// Этапы обработки кадра
+enum LatencyStage {
+  LATENCY_CAPTURE,       // esp_camera_fb_get()
+  LATENCY_SD_WRITE,      // Запись кадра в файл на SD
+  LATENCY_HEADER,        // Сборка HTTP заголовка кадра
+  LATENCY_SOCKET_WRITE,  // Отправка кадра в сокет
+  LATENCY_RECONNECT,     // Подключение к серверу потока
+  LATENCY_LOOP,          // Итерация loop()
+  LATENCY_STAGES
+};
+
+// Добавить значение
+void latencyRecord(LatencyHistogram& histogram, uint32_t us);
+
+// Перцентили и максимум с прошлого вызова, гистограмма обнуляется
+LatencySummary latencyTake(LatencyHistogram& histogram);
+
+// То же для этапов
+void latencyRecord(LatencyStage stage, uint32_t us);
+LatencySummary latencyTake(LatencyStage stage);
+
+// Имя этапа для статуса ("capture", "sd_write", ...)
+const char* latencyStageName(LatencyStage stage);
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,67 @@
+#ifndef MKV_WRITER_H
+#define MKV_WRITER_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+/*
+ * MKV Writer Module
+ *
+ * Запись сегментов в контейнер Matroska (MJPEG, кодек V_MJPEG) - альтернатива AVI.
+ *
+ * Особенности:
+ * - Segment и последний Cluster имеют неизвестный размер: оборванный файл остаётся воспроизводимым
+ * - Кадры - ключевые SimpleBlock, новый Cluster каждые SD_MKV_CLUSTER_MS
+ * - Размер кластера записывается при открытии следующего, Cues и Duration - при финализации
+ * - Точка Cues на каждый кластер; при переполнении таблицы остаётся каждая вторая
+ * - Нет 32-битного ограничения RIFF и заголовков, которые нужно исправлять после каждого кадра
+ *
+ * Использование:
+ *   MKVWriter writer;
+ *   mkvWriteHeader(file, writer, 1280, 720);
+ *   mkvWriteFrame(file, writer, fb->buf, fb->len, timeMs);   // мс от начала сегмента
+ *   mkvFinalize(file, writer, durationMs);
+ *
+ * Проверка файлов на компьютере: tools/mkv_inspect.cpp
+ */
+
+#define MKV_MAX_CUES 128
+
+struct MKVWriter {
+  uint32_t segmentData;      // Начало данных Segment (от него считаются позиции SeekHead и Cues)
+  uint32_t seekVoidPos;      // Резерв в SeekHead под ссылку на Cues
+  uint32_t durationVoidPos;  // Резерв в Info под Duration
+  uint32_t end;              // Конец записанных данных (позиция следующей записи)
+  uint32_t clusterPos;       // Текущий Cluster (0 - ещё нет)
+  uint32_t clusterTime;      // Время текущего кластера, мс от начала сегмента
+  uint32_t clusterCount;
+  uint32_t frames;
+  uint16_t cueCount;
+  uint16_t cueStep;          // Точка Cues на каждый cueStep-й кластер
+  uint32_t cueTimes[MKV_MAX_CUES];
+  uint32_t cuePositions[MKV_MAX_CUES];
+};
+
+struct MKVRecoveryResult {
+  uint32_t frames;         // Восстановлено кадров
+  uint32_t originalSize;   // Размер .tmp файла до восстановления
+  uint32_t recoveredSize;  // Конец данных Segment после восстановления
+};
+
+// Записать EBML заголовок, начало Segment, SeekHead, Info и Tracks
+bool mkvWriteHeader(File& file, MKVWriter& writer, uint16_t width, uint16_t height);
+
+// Дописать кадр (файл должен быть позиционирован на writer.end)
+bool mkvWriteFrame(File& file, MKVWriter& writer, const uint8_t* data, size_t len, uint32_t timeMs);
+
+// Закрыть последний кластер, записать Cues, Duration и размер Segment
+bool mkvFinalize(File& file, MKVWriter& writer, uint32_t durationMs);
+
+// Прочитать длительность и количество кадров (обход кластеров - только при старте)
+bool mkvReadInfo(File& file, uint32_t& durationMs, uint32_t& frames);
+
+// Восстановить прерванную запись: обрезка по последнему полному кадру, Duration, rename.
+// false - нет ни одного полного кадра или ошибка переименования
+bool recoverMKVFile(const String& tempPath, const String& finalPath, MKVRecoveryResult& result);
+
+#endif // MKV_WRITER_H
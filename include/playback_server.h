@@ -0,0 +1,34 @@
+#ifndef PLAYBACK_SERVER_H
+#define PLAYBACK_SERVER_H
+
+#include <Arduino.h>
+
+/*
+ * Playback Server Module
+ *
+ * HTTP сервер на устройстве (PLAYBACK_PORT) для просмотра записей без извлечения карты.
+ *
+ * Особенности:
+ * - GET /records - список сегментов из каталога с временем начала и конца (JSON)
+ * - GET /records/001.mkv - файл сегмента, поддержка Range (206 Partial Content) для перемотки
+ * - GET /trace - дамп трассы событий (event_trace), трасса заморожена на время отправки
+ * - Чтение с карты блоками PLAYBACK_BLOCK_SIZE, выровненными по смещению в файле, прямо в сокет
+ * - Чтение уступает записи (readSegmentData): пока рекордеру нужна карта, блок не читается
+ * - Неблокирующий: за вызов читается не больше одного блока и отправляется не больше 4KB
+ * - Одно соединение за раз, без авторизации (только для локальной сети)
+ *
+ * Использование:
+ *   handlePlaybackServer();    // В loop, при подключенном WiFi (сервер стартует при первом вызове)
+ *
+ *   curl http://<ip>/records?from=1700000000&to=1700003600
+ *   ffplay http://<ip>/records/012.mkv
+ *   curl -o trace.bin http://<ip>/trace
+ */
+
+// Обработка соединений (вызывать в loop)
+void handlePlaybackServer();
+
+// Отправлено данных записей с загрузки, KB
+uint32_t getPlaybackSentKB();
+
+#endif // PLAYBACK_SERVER_H
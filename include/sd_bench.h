@@ -0,0 +1,35 @@
+#ifndef SD_BENCH_H
+#define SD_BENCH_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+/*
+ * SD Bench Module
+ *
+ * Измерение скорости записи на карту - для выбора режима шины SD_MMC (1-bit / 4-bit) на плате.
+ *
+ * Особенности:
+ * - Последовательная запись файла блоками 4, 8, 16 и 32KB (как пишет рекордер: кадр = несколько блоков)
+ * - Скорость включает flush и close (обновление FAT)
+ * - Время каждого write() - 99-й перцентиль и максимум (паузы карты на стирание блоков)
+ * - Буфер в DMA памяти только на время теста, файл удаляется
+ *
+ * Использование (из фоновой задачи - тест занимает карту на несколько секунд):
+ *   SDBenchResult results[SD_BENCH_BLOCK_SIZES];
+ *   int count = runSDBenchmark(SD_MMC, "/sdbench.tmp", 4 * 1024 * 1024, results);
+ */
+
+#define SD_BENCH_BLOCK_SIZES 4
+
+struct SDBenchResult {
+  uint32_t blockSize;   // Размер блока write(), байт
+  uint32_t kbPerSec;    // Последовательная запись, KB/s
+  uint32_t p99Us;       // 99-й перцентиль времени write() одного блока, мкс
+  uint32_t maxUs;       // Максимальное время write(), мкс
+};
+
+// Записать totalBytes блоками каждого размера. Возвращает количество результатов (0 - ошибка)
+int runSDBenchmark(fs::FS& fs, const char* path, uint32_t totalBytes, SDBenchResult* results);
+
+#endif // SD_BENCH_H
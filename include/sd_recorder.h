@@ -2,6 +2,8 @@
 #define SD_RECORDER_H
 
 #include <Arduino.h>
+#include "segment_catalog.h"
+#include "sd_bench.h"
 
 /*
  * SD Card Recorder Module
@@ -14,6 +16,12 @@
  * - Безопасное извлечение - файлы закрываются после каждого интервала
  * - Неполные записи автоматически удаляются
  * - Файлы нумеруются последовательно (001.mjpeg, 002.mjpeg, ...)
+ * - Режим записи по событию с пред-событийным буфером в PSRAM
+ * - Собственный профиль записи (FPS, прореживание) - пишет и без стриминга/сервера
+ * - Timelapse: кадр раз в N секунд, файл открывается только на время записи кадра
+ * - Контейнер AVI или Matroska (MKV с Cues, воспроизводится и оборванным)
+ * - Ротация сначала удаляет сегменты, уже выгруженные на сервер (segment_uploader)
+ * - Шина SD_MMC 1-bit или 4-bit (настройка на плату), встроенный тест скорости карты
  * 
  * Использование:
  *   initSDRecorder();          // Инициализация
@@ -55,6 +63,9 @@ bool isRecording();
 // Получить статус записи
 String getRecordingStatus();
 
+// Статус записи в buf (без выделения памяти), возвращает длину
+size_t formatRecordingStatus(char* buf, size_t size);
+
 // Получить информацию о SD карте (структура с данными)
 SDCardInfo getSDCardInfo();
 
@@ -65,11 +76,114 @@ String getSDCardInfoString();
 void setRecordingEnabled(bool enabled);
 bool isRecordingEnabled();
 
-// Установить интервал записи (секунды)
+// Установить интервал записи (секунды, 5-3600)
 void setRecordingInterval(int seconds);
 int getRecordingInterval();
 
+// Профиль записи, независимый от стриминга:
+// частота кадров записи (0 = как у стриминга) и прореживание (каждый N-й кадр)
+void setRecordingFPS(int fps);
+int getRecordingFPS();
+void setRecordingDecimation(int everyN);
+int getRecordingDecimation();
+
+// Максимальный размер сегмента (MB, 0 = только по интервалу)
+void setSegmentMaxSize(int megabytes);
+int getSegmentMaxSize();
+
+// Контейнер новых сегментов (текущий сегмент дописывается в прежнем)
+enum RecordingContainer {
+  RECORDING_AVI = 0,
+  RECORDING_MKV = 1
+};
+
+void setRecordingContainer(RecordingContainer container);
+RecordingContainer getRecordingContainer();
+
+// Интервал захвата кадров для записи (мс, 0 = как у стриминга)
+unsigned long getRecordingCaptureInterval();
+
+// Разрешение кадров для записи (framesize_t, -1 = как у стриминга)
+int getRecordingFrameSize();
+
+// Выгрузка записей на сервер (segment_uploader).
+// Самый старый невыгруженный сегмент (false - нет или карта занята)
+bool getNextSegmentToUpload(SegmentInfo& info);
+
+// Имя файла сегмента ("001.avi")
+String getSegmentFileName(const SegmentInfo& info);
+
+// Прочитать часть сегмента: прочитано байт, 0 - карта занята (повторить позже), -1 - сегмента больше нет.
+// Чтение уступает записи: пока фоновая задача или сброс буфера события ждут карту, возвращает 0.
+// Файл остаётся открытым между вызовами - последовательное чтение без seek
+int readSegmentData(const SegmentInfo& info, uint32_t offset, uint8_t* buffer, size_t len);
+
+// Отметить сегмент выгруженным (ротация удаляет такие сегменты первыми)
+void markSegmentUploaded(const SegmentInfo& info);
+
+// Просмотр записей (playback_server).
+// Сегменты начиная с position (0 - самый старый): количество, -1 - каталог занят
+int readSegmentList(int position, SegmentInfo* list, int maxCount);
+
+// Найти сегмент по имени файла ("001.mkv"): 1 - найден, 0 - каталог занят, -1 - нет
+int findSegmentByName(const String& name, SegmentInfo& info);
+
+// Тест скорости карты
+enum SDBenchState {
+  SD_BENCH_IDLE = 0,
+  SD_BENCH_RUNNING = 1,
+  SD_BENCH_DONE = 2,
+  SD_BENCH_FAILED = 3    // Нет места или ошибка записи
+};
+
+// Режим шины SD_MMC: 1 или 4 бита. Сохраняется в NVS, действует со следующего монтирования
+// (перезагрузка или повторная вставка карты). Если 4-bit не монтируется - 1-bit
+void setSDBusWidth(int width);
+int getSDBusWidth();
+
+// Фактический режим шины (0 - карта не смонтирована)
+int getMountedSDBusWidth();
+
+// Запустить тест скорости записи в фоновой задаче (запись на время теста приостанавливается)
+bool startSDBenchmark();
+SDBenchState getSDBenchmarkState();
+
+// Результаты последнего теста (SD_BENCH_BLOCK_SIZES записей) и режим шины, на котором он выполнен
+int getSDBenchmarkResults(SDBenchResult* results, int& busWidth);
+
+// Записать дамп трассы событий в TRACE_DUMP_PATH (в фоновой задаче). false - карты нет
+bool requestTraceDump();
+
 // Очистить все записи
 bool clearAllRecordings();
 
+// Режим записи
+enum RecordingMode {
+  RECORDING_CONTINUOUS = 0,  // Непрерывная запись сегментами
+  RECORDING_EVENT = 1,       // Запись по событию (пред-событийный буфер + post-roll)
+  RECORDING_TIMELAPSE = 2    // Один кадр раз в N секунд в многочасовые сегменты
+};
+
+void setRecordingMode(RecordingMode mode);
+RecordingMode getRecordingMode();
+
+// Окно записи по событию: секунды до события (буфер в PSRAM) и после последнего события (0 - не менять)
+void setEventWindow(int preSeconds, int postSeconds);
+
+// Порог детектора движения (% изменения размера JPEG, 0 = выкл)
+void setMotionThreshold(int percent);
+
+// Событие (команда сервера, датчик движения, GPIO): буфер сбрасывается в новый сегмент,
+// запись продолжается post-roll секунд после последнего события
+void triggerRecordingEvent(const char* source);
+
+// Количество событий с момента загрузки
+unsigned long getRecordingEventCount();
+
+// Timelapse: секунд между кадрами, частота воспроизведения, длительность сегмента в часах (0 - не менять)
+void setTimelapseSettings(int intervalSeconds, int playbackFps, int segmentHours);
+
+// Разрешение кадров timelapse (framesize_t, -1 = как у стриминга)
+void setTimelapseFrameSize(int frameSize);
+
 #endif // SD_RECORDER_H
@@ -0,0 +1,100 @@
+#ifndef SEGMENT_CATALOG_H
+#define SEGMENT_CATALOG_H
+
+#include <Arduino.h>
+
+/*
+ * Segment Catalog Module
+ *
+ * Append-only каталог записанных сегментов на SD карте (/records/segments.cat).
+ *
+ * Особенности:
+ * - Записи фиксированного размера (24 байта) с CRC32
+ * - Старт и ротация без обхода папки /records и без перебора имён через exists()
+ * - Оборванная последняя запись (сбой питания) игнорируется и отрезается перезаписью каталога
+ * - Повреждённый или отсутствующий каталог восстанавливается сканированием
+ * - Периодическое сжатие (перезапись только живых сегментов)
+ *
+ * Использование:
+ *   initSegmentCatalog(1000);          // Выделить память под таблицу
+ *   loadSegmentCatalog();              // Прочитать каталог с карты
+ *   catalogSegmentOpened(index);       // Начата запись сегмента
+ *   catalogSegmentClosed(info);        // Сегмент завершён и переименован
+ *   catalogSegmentDeleted(index);      // Сегмент удалён при ротации
+ *   catalogSegmentUploaded(index);     // Сегмент выгружен на сервер
+ */
+
+// Информация о записанном сегменте
+struct SegmentInfo {
+  uint16_t index;        // Номер файла (001.avi, 001.mkv -> 1)
+  uint8_t flags;         // SEGMENT_FLAG_*
+  uint32_t startTime;    // Время начала (unix time или секунды с загрузки)
+  uint32_t durationMs;   // Длительность сегмента
+  uint32_t bytes;        // Размер файла в байтах
+  uint32_t frames;       // Количество кадров
+};
+
+// startTime взят из синхронизированных часов (иначе - секунды с загрузки)
+#define SEGMENT_FLAG_WALLCLOCK 0x01
+// Сегмент записан в Matroska (NNN.mkv), иначе AVI
+#define SEGMENT_FLAG_MKV 0x02
+// Сегмент полностью выгружен на сервер (segment_uploader)
+#define SEGMENT_FLAG_UPLOADED 0x04
+
+// Инициализация (выделяет таблицу на maxSegments записей, PSRAM если есть)
+bool initSegmentCatalog(int maxSegments);
+
+// Прочитать каталог с карты. false - каталог отсутствует или повреждён
+bool loadSegmentCatalog();
+
+// Очистить таблицу в памяти (перед восстановлением сканированием)
+void clearSegmentCatalog();
+
+// Добавить сегмент в таблицу без записи на карту (восстановление сканированием)
+bool catalogRestoreSegment(const SegmentInfo& info);
+
+// Отсортировать таблицу по времени начала (после восстановления сканированием)
+void sortSegmentCatalog();
+
+// Перезаписать файл каталога текущим содержимым таблицы
+bool writeSegmentCatalog();
+
+// Отметить начало записи сегмента (для поиска незавершённого .tmp при старте)
+bool catalogSegmentOpened(uint16_t index);
+
+// Добавить завершённый сегмент
+bool catalogSegmentClosed(const SegmentInfo& info);
+
+// Отметить удаление сегмента
+bool catalogSegmentDeleted(uint16_t index);
+
+// Отметить выгрузку сегмента на сервер (SEGMENT_FLAG_UPLOADED)
+bool catalogSegmentUploaded(uint16_t index);
+
+// Количество сегментов в каталоге
+int catalogSegmentCount();
+
+// Получить сегмент по позиции (0 - самый старый)
+bool catalogGetSegment(int position, SegmentInfo& info);
+
+// Самый старый / самый новый сегмент
+bool catalogOldestSegment(SegmentInfo& info);
+bool catalogNewestSegment(SegmentInfo& info);
+
+// Самый старый сегмент с установленным (set = true) или снятым флагом
+bool catalogOldestWithFlag(uint8_t flag, bool set, SegmentInfo& info);
+
+// Есть ли сегмент с таким номером
+bool catalogHasSegment(uint16_t index);
+
+// Найти сегмент по номеру
+bool catalogFindSegment(uint16_t index, SegmentInfo& info);
+
+// Сегменты, запись которых была начата, но не завершена (в порядке открытия).
+// Возвращает количество (не больше 4: завершаемый, текущий и заранее открытый следующий)
+int catalogPendingSegments(uint16_t* indexes, int maxCount);
+
+// Суммарный размер сегментов в каталоге (байты)
+uint64_t catalogTotalBytes();
+
+#endif // SEGMENT_CATALOG_H
@@ -0,0 +1,69 @@
+#ifndef SEGMENT_UPLOADER_H
+#define SEGMENT_UPLOADER_H
+
+#include <Arduino.h>
+
+/*
+ * Segment Uploader Module
+ *
+ * Фоновая выгрузка завершённых сегментов из /records на сервер (POST SD_UPLOAD_PATH).
+ *
+ * Особенности:
+ * - Сегмент передаётся частями по SD_UPLOAD_CHUNK_KB, каждая со смещением (X-Upload-Offset)
+ * - Сервер отвечает принятым смещением; при расхождении (409) выгрузка продолжается с него
+ * - Позиция сохраняется в NVS - после перезагрузки выгрузка продолжается, а не начинается заново
+ * - Ограничение скорости (token bucket) и пауза, пока видеопоток занимает канал
+ * - Неблокирующая: за вызов отправляется не больше 4KB, ответ читается по мере прихода
+ * - Выгруженные сегменты отмечаются в каталоге - ротация удаляет их первыми
+ *
+ * Протокол:
+ *   POST /api/records/upload
+ *   X-Device-ID: 24:0A:C4:00:00:01
+ *   X-Segment: 001.mkv
+ *   X-Segment-Start: 1700000000        // startTime сегмента (вместе с именем - ключ на сервере)
+ *   X-Segment-Duration: 10000
+ *   X-Upload-Offset: 65536             // Смещение этой части в файле
+ *   X-Upload-Total: 1048576            // Полный размер файла
+ *   Content-Length: 32768
+ *
+ *   200 + X-Upload-Offset: 98304       // Сколько байт сегмента сервер уже сохранил
+ *   409 + X-Upload-Offset: 0           // Смещение не совпало - продолжить с указанного
+ *
+ * Использование:
+ *   initSegmentUploader();             // После initSDRecorder()
+ *   handleSegmentUploader();           // В loop, при подключенном WiFi
+ *
+ * Тестовый сервер для проверки на компьютере: tools/upload_server.cpp
+ */
+
+struct UploadStatus {
+  bool enabled;
+  bool active;           // Идёт выгрузка сегмента
+  bool paused;           // Ожидание свободного канала (видеопоток)
+  uint16_t segment;      // Номер выгружаемого сегмента
+  uint32_t offset;       // Подтверждённое сервером смещение
+  uint32_t total;        // Размер сегмента
+  uint32_t uploaded;     // Выгружено сегментов с загрузки
+  uint32_t sentKB;       // Отправлено данных с загрузки, KB
+  uint32_t pauses;       // Сколько раз выгрузка уступала канал видеопотоку
+  uint32_t failures;     // Неудачные запросы
+};
+
+// Инициализация (загружает настройки и позицию выгрузки из NVS)
+void initSegmentUploader();
+
+// Обработка выгрузки (вызывать в loop, неблокирующая)
+void handleSegmentUploader();
+
+// Включить/выключить выгрузку
+void setUploadEnabled(bool enabled);
+bool isUploadEnabled();
+
+// Ограничение скорости, KB/s (0 = без ограничения)
+void setUploadRate(int rateKB);
+int getUploadRate();
+
+// Состояние выгрузки
+UploadStatus getUploadStatus();
+
+#endif // SEGMENT_UPLOADER_H
@@ -51,22 +51,27 @@ void loadCameraSettings();
 // Save camera settings to NVS
 void saveCameraSettings();
 
-// Проверка и обработка настроек с сервера (вызывать в loop)
+// Проверка и обработка настроек с сервера (вызывать в loop; пока работает settings_channel - не опрашивает)
 void handleServerSettings();
 
+// Применить JSON настроек (ответ SETTINGS_PATH, settings_channel или stream_control).
+// Разбор в арене с фильтром по известным полям - без выделения памяти в куче.
+// false - JSON не разобран: версию таких настроек не подтверждаем, сервер пришлёт их снова
+bool processSettings(const char* json, size_t length);
+
 // Применить настройки камеры
 void applyCameraSettings(const CameraSettings& settings);
 
 // Получить текущие настройки
 CameraSettings getCurrentSettings();
 
-// Отправить статус на сервер
+// Отправить статус на сервер (в очередь async_http)
 void sendStatusToServer();
 
 // Установить интервал опроса сервера (мс)
 void setSettingsPollInterval(unsigned long interval);
 
-// Загрузить настройки с сервера (синхронно, при первом подключении)
+// Загрузить настройки с сервера при первом подключении (запрос в фоне; true - ответ получен и применён)
 bool fetchInitialSettingsFromServer();
 
 // Проверить, были ли загружены начальные настройки
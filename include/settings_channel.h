@@ -0,0 +1,52 @@
+#ifndef SETTINGS_CHANNEL_H
+#define SETTINGS_CHANNEL_H
+
+#include <Arduino.h>
+
+/*
+ * Settings Channel Module
+ *
+ * Доставка настроек с сервера без опроса: long-poll запрос в keep-alive соединении.
+ *
+ * Особенности:
+ * - Сервер держит запрос, пока версия настроек не изменится (до SETTINGS_WATCH_TIMEOUT_S),
+ *   и отвечает сразу после изменения - настройки применяются без ожидания интервала опроса
+ * - Следующий запрос несёт применённую версию - это подтверждение для сервера
+ * - Настройки, которые не удалось разобрать, не подтверждаются: сервер пришлёт их снова
+ * - Одно TCP соединение на все запросы (без handshake на каждый)
+ * - Неблокирующий: connect() проверяется в loop без ожидания, ответ читается по мере прихода -
+ *   недоступный сервер не задерживает захват и видеопоток
+ * - Имя сервера разрешается один раз (повторно - после сбоев connect(), не чаще раза в минуту):
+ *   повторы после ошибок не ждут DNS
+ * - Пока канал не работает (старый сервер без SETTINGS_WATCH_PATH, ошибки), настройки
+ *   получает обычный опрос handleServerSettings()
+ *
+ * Протокол:
+ *   GET /api/camera/watch?version=7&timeout=25
+ *   X-Device-ID: 24:0A:C4:00:00:01
+ *   X-Settings-Version: 7              // Применённая версия (подтверждение)
+ *
+ *   200 + X-Settings-Version: 8 + JSON // Новые настройки (формат GET SETTINGS_PATH)
+ *   204 + X-Settings-Version: 7        // Изменений нет за timeout секунд
+ *   404                                // Сервер не поддерживает канал - только опрос
+ *
+ * Использование:
+ *   handleSettingsChannel();           // В loop, после загрузки начальных настроек
+ *   if (!isSettingsChannelActive()) { ... опрос ... }
+ *
+ * Тестовый сервер для проверки на компьютере: tools/settings_server.cpp
+ */
+
+// Обработка канала (вызывать в loop, неблокирующая)
+void handleSettingsChannel();
+
+// Канал получает ответы сервера - опрос настроек не нужен
+bool isSettingsChannelActive();
+
+// Применённая версия настроек (0 - сервер версий не сообщал)
+uint32_t getSettingsVersion();
+
+// Версия из ответа на обычный запрос настроек (начальная загрузка, опрос)
+void setSettingsVersion(uint32_t version);
+
+#endif // SETTINGS_CHANNEL_H
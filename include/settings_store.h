@@ -0,0 +1,59 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <Arduino.h>
+
+/*
+ * Settings Store Module
+ *
+ * Хранение групп настроек в NVS: каждая группа (camera, sdrec, upload) - один блоб
+ * с версией и CRC32 вместо отдельного ключа на каждый параметр.
+ *
+ * Особенности:
+ * - settingsStoreSave() только копирует данные: запись в flash откладывается на
+ *   SETTINGS_STORE_DEBOUNCE_MS после последнего изменения (серия изменений - одна запись),
+ *   но не дольше SETTINGS_STORE_MAX_DELAY_MS
+ * - Данные совпадают с записанными (по CRC) - запись не выполняется
+ * - handleSettingsStore() пишет не больше одной группы за вызов
+ * - Миграция: поля структуры только добавляются в конец с увеличением версии -
+ *   блоб старой версии заполняет начало структуры, новые поля остаются как были
+ *   (значения по умолчанию). Нет блоба - модуль читает старые ключи и сохраняет блоб
+ * - Изменения за последние SETTINGS_STORE_DEBOUNCE_MS теряются при пропадании питания;
+ *   перед ESP.restart() нужно вызвать settingsStoreFlush()
+ *
+ * Использование:
+ *   RecordingBlob blob = packRecordingSettings();     // Текущие значения (по умолчанию)
+ *   if (settingsStoreLoad("sdrec", 2, &blob, sizeof(blob))) unpack(blob);
+ *   settingsStoreSave("sdrec", 2, &blob, sizeof(blob)); // При изменении
+ *   handleSettingsStore();                             // В loop
+ */
+
+#define SETTINGS_STORE_GROUPS 4        // Групп настроек (namespace NVS)
+#define SETTINGS_STORE_MAX_BLOB 128    // Байт данных в группе
+
+// Статистика записей в NVS
+struct SettingsStoreStats {
+  uint32_t writes;          // Записей блобов в flash
+  uint32_t skipped;         // Сохранений без изменений (запись не понадобилась)
+  uint32_t coalesced;       // Сохранений, объединённых с ожидающей записью
+  uint32_t failures;        // Ошибок записи
+  int pending;              // Групп ждут записи
+  unsigned long lastWriteUs;  // Длительность последней записи
+  unsigned long maxWriteUs;   // Максимальная длительность записи
+};
+
+// Прочитать блоб группы. false - блоба нет или он повреждён (data не меняется)
+bool settingsStoreLoad(const char* ns, uint16_t version, void* data, size_t size);
+
+// Сохранить группу (отложенная запись; без изменений - ничего не делает)
+void settingsStoreSave(const char* ns, uint16_t version, const void* data, size_t size);
+
+// Записать все ожидающие группы сейчас (перед перезагрузкой)
+void settingsStoreFlush();
+
+// Отложенные записи (вызывать в loop)
+void handleSettingsStore();
+
+SettingsStoreStats getSettingsStoreStats();
+
+#endif // SETTINGS_STORE_H
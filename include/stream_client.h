@@ -12,7 +12,7 @@ bool startStreaming();
 // Остановить стриминг
 void stopStreaming();
 
-// Отправить кадр (вызывать в loop)
+// Захватить кадр и отправить на сервер и/или записать на SD по своим интервалам (вызывать в loop)
 void sendFrame();
 
 // Обновление стриминга (вызывать в loop)
@@ -21,6 +21,29 @@ void updateStreaming();
 // Проверка статуса стриминга
 bool isStreaming();
 
+// Канал занят видеопотоком: отправка кадра не укладывается в интервал или недавно оборвалась
+// (фоновые передачи, например segment_uploader, должны ждать)
+bool isStreamCongested();
+
+// Скорость записи кадров в сокет, KB/s (скользящее среднее; 0 - кадров ещё не было)
+unsigned long getStreamThroughputKB();
+
+// Буфер кадров на время обрыва связи с сервером
+struct SpoolStatus {
+  bool enabled;               // Буфер выделен (STREAM_SPOOL_ENABLED и есть PSRAM)
+  bool active;                // Сервер недоступен, кадры копятся
+  uint32_t frames;            // Кадров ждёт досылки
+  uint32_t bytes;             // Их объём
+  unsigned long spooled;      // Сохранено за всё время (часть могла быть вытеснена)
+  unsigned long backfilled;   // Дослано за всё время
+};
+
+SpoolStatus getSpoolStatus();
+
+// Отправить статус (JSON) в соединении потока. false - канал управления в потоке не работает,
+// статус надо отправить отдельным запросом
+bool sendStatusInBand(const char* json, size_t length);
+
 // Установить целевой FPS
 void setStreamFPS(int fps);
 
@@ -33,6 +56,15 @@ unsigned long getFramesSent();
 // Получить количество неудачных кадров
 unsigned long getFailedFrames();
 
+// WiFi потерян (из main): начать отсчёт времени до первого кадра после потери связи
+void markStreamLinkLost();
+
+// Время от загрузки до первого отправленного кадра, мс (0 - ещё не было)
+unsigned long getBootTimeToFirstFrame();
+
+// Время от последней потери WiFi до первого отправленного кадра, мс (0 - ещё не было)
+unsigned long getLinkLossTimeToFirstFrame();
+
 // Получить статус стриминга
 String getStreamingStatus();
 
@@ -46,6 +78,6 @@ void resetServerConnectionErrors();
 void setServerHost(const String& host);
 
 // Get current server host
-String getServerHost();
+const String& getServerHost();
 
 #endif // STREAM_CLIENT_H
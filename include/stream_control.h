@@ -0,0 +1,52 @@
+#ifndef STREAM_CONTROL_H
+#define STREAM_CONTROL_H
+
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+/*
+ * Stream Control Module
+ *
+ * Управление камерой через соединение видеопотока: сервер кладёт настройки и команды
+ * в ответы на кадры (POST STREAM_PATH), камера отправляет статус в том же соединении.
+ * Задержка доставки настроек - один интервал кадра, без отдельных TCP соединений.
+ *
+ * Особенности:
+ * - Ответы на кадры разбираются по мере прихода (раньше просто отбрасывались)
+ * - Сервер, присылающий X-Settings-Version в ответах, считается поддерживающим канал:
+ *   пока ответы приходят, опрос SETTINGS_PATH и settings_channel не работают,
+ *   статус уходит в поток (sendStatusInBand)
+ * - Нет ответов STREAM_CONTROL_HOLD_MS (стриминг остановлен, старый сервер) -
+ *   снова работают settings_channel, опрос SETTINGS_PATH и отдельный STATUS_PATH
+ * - Настройки применяются в handleStreamControl() (в loop), не во время отправки кадра
+ *
+ * Протокол:
+ *   POST /stream                        // Кадр, X-Settings-Version: 7 - применённая версия
+ *
+ *   200 + X-Settings-Version: 7         // Версия не изменилась, тела нет
+ *   200 + X-Settings-Version: 8 + JSON  // Новые настройки/команда (формат GET SETTINGS_PATH,
+ *                                       // можно только изменённые поля относительно версии кадра)
+ *
+ *   Из-за конвейера кадров одну версию могут принести несколько ответов подряд -
+ *   применяется первый, следующий кадр подтверждает версию.
+ *
+ * Использование:
+ *   streamControlReset();               // Новое соединение потока
+ *   streamControlRead(client);          // После отправки кадра - разобрать ответы
+ *   handleStreamControl();              // В loop - применить полученные настройки
+ *   if (isStreamControlActive()) { ... статус через sendStatusInBand() ... }
+ */
+
+// Новое соединение: сбросить разбор ответов
+void streamControlReset();
+
+// Прочитать и разобрать ответы сервера из соединения потока (неблокирующая)
+void streamControlRead(WiFiClient& client);
+
+// Применить настройки, пришедшие в ответах (вызывать в loop)
+void handleStreamControl();
+
+// Сервер присылает управление в ответах потока - отдельные запросы не нужны
+bool isStreamControlActive();
+
+#endif // STREAM_CONTROL_H
@@ -4,18 +4,109 @@
 #include <Arduino.h>
 #include <WiFi.h>
 
-// Инициализация WiFi подключения
-bool initWiFi();
+/*
+ * WiFi Client Module
+ *
+ * Неблокирующее управление подключением к WiFi: попытка только запускается,
+ * результат приходит событием - loop() (запись на SD, сервер записей) не ждёт ассоциации.
+ *
+ * Особенности:
+ * - События драйвера (WiFi.onEvent, задача событий ядра) складываются в очередь,
+ *   main забирает их в loop через pollWiFiEvent()
+ * - Попытка без IP за WIFI_CONNECT_TIMEOUT_MS прерывается событием WIFI_LINK_DISCONNECTED
+ *   (причина WIFI_DISCONNECT_TIMEOUT)
+ * - После WIFI_LINK_GOT_IP - отключение power save и максимальная мощность передатчика
+ * - Автопереподключение драйвера выключено: когда повторять попытку, решает машина состояний main
+ * - Быстрое переподключение: BSSID, канал и аренда последнего подключения хранятся в NVS;
+ *   попытка идёт сразу к этой точке доступа (без сканирования, с прошлым IP без DHCP
+ *   в течение WIFI_LEASE_REUSE_S после получения аренды), при неудаче за
+ *   WIFI_DIRECTED_TIMEOUT_MS - обычная попытка со сканированием
+ * - Статический IP из настроек сервера ("wifi.ip") важнее аренды из кэша
+ * - Несколько профилей сетей (wifi_settings): без кэша - асинхронное сканирование и выбор точки
+ *   доступа по RSSI с поправкой на позицию профиля и штрафом точкам, где поток не успевал
+ * - Роуминг (handleWiFiRoaming): RSSI ниже WIFI_ROAM_RSSI или отправка кадров не успевает
+ *   WIFI_ROAM_SAMPLES проверок подряд - сканирование; переход, если кандидат лучше
+ *   на WIFI_ROAM_HYSTERESIS_DB. Решения - в журнале getWiFiRoamLog() (статус)
+ *
+ * Использование:
+ *   startWiFi();                          // Начать подключение (сразу возвращается)
+ *   WiFiLinkEvent event;                  // В loop:
+ *   while (pollWiFiEvent(event)) { ... }  // WIFI_LINK_GOT_IP - сеть готова
+ *   if (handleWiFiRoaming()) { ... }      // При подключении: true - начат переход, ждать WIFI_LINK_GOT_IP
+ */
 
-// Проверка подключения WiFi
+enum WiFiLinkEvent : uint8_t {
+  WIFI_LINK_CONNECTED = 1,     // Ассоциация с точкой доступа (IP ещё нет)
+  WIFI_LINK_GOT_IP,            // Получен IP - можно работать с сервером
+  WIFI_LINK_DISCONNECTED       // Соединение потеряно или попытка не удалась (причина - getWiFiDisconnectReason())
+};
+
+// Причины WIFI_LINK_DISCONNECTED помимо wifi_err_reason_t драйвера (1-255)
+#define WIFI_DISCONNECT_TIMEOUT 1000     // Нет IP за WIFI_CONNECT_TIMEOUT_MS
+#define WIFI_DISCONNECT_LOST_IP 1001     // DHCP потерял адрес при живой ассоциации
+
+#define WIFI_ROAM_LOG 4                  // Решений о роуминге в статусе
+
+enum WiFiRoamReason : uint8_t {
+  WIFI_ROAM_REASON_RSSI,       // Слабый сигнал
+  WIFI_ROAM_REASON_SEND        // Отправка кадров не успевает или обрывается
+};
+
+// Решение о роуминге (после сканирования)
+struct WiFiRoamDecision {
+  uint32_t uptime;             // Секунды с загрузки
+  WiFiRoamReason reason;
+  bool roamed;                 // false - лучшей точки доступа не нашлось
+  int8_t rssi;                 // Текущая точка
+  int8_t targetRssi;           // Лучший кандидат (0 - нет)
+  int8_t targetProfile;        // Профиль кандидата (-1 - нет)
+  uint16_t throughputKB;       // Скорость отправки кадров на текущей точке, KB/s
+  char from[18];               // BSSID текущей точки
+  char to[18];                 // BSSID кандидата ("" - нет)
+};
+
+// Начать подключение с сохранёнными профилями (без ожидания)
+void startWiFi();
+
+// Следующее событие подключения (вызывать в loop); false - событий нет.
+// Здесь же проверяется таймаут текущей попытки
+bool pollWiFiEvent(WiFiLinkEvent& event);
+
+// Роуминг (вызывать в loop при подключении). true - начат переход на другую точку доступа:
+// связь прервана, результат - WIFI_LINK_GOT_IP или WIFI_LINK_DISCONNECTED
+bool handleWiFiRoaming();
+
+// Журнал решений о роуминге, новые первыми. Возвращает количество
+size_t getWiFiRoamLog(WiFiRoamDecision* decisions, size_t maxDecisions);
+
+// Переходов с загрузки
+uint32_t getWiFiRoamCount();
+
+// SSID и BSSID текущего подключения ("" без подключения)
+const char* getWiFiSSID();
+void formatWiFiBSSID(char* buf, size_t size);
+
+// Проверка подключения WiFi (IP получен)
 bool isWiFiConnected();
 
-// Проверка и переподключение WiFi
-void checkWiFiConnection();
+// Причина последнего WIFI_LINK_DISCONNECTED
+uint16_t getWiFiDisconnectReason();
+
+// Длительность последнего подключения: startWiFi() -> IP, мс
+unsigned long getWiFiConnectTime();
+
+// Последнее подключение - к точке доступа из кэша (без сканирования)
+bool wasWiFiConnectDirected();
 
 // Получить локальный IP адрес
 String getLocalIP();
 
+// Записать локальный IP в buf (без выделения памяти; "Not connected" без подключения)
+void formatLocalIP(char* buf, size_t size);
+
+// MAC адрес устройства "AA:BB:CC:DD:EE:FF" - идентификатор в запросах к серверу (кэшируется)
+const char* getDeviceId();
+
 // Отключение WiFi
 void disconnectWiFi();
 
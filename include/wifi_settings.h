@@ -4,6 +4,24 @@
 #include <Arduino.h>
 #include <Preferences.h>
 
+// Последнее удачное подключение - быстрое переподключение без сканирования и DHCP
+struct WiFiLinkCache {
+  char ssid[33];        // Кэш действителен только для этой сети
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint32_t ip;          // Аренда DHCP, 0 - нет
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+  uint32_t leaseTime;   // time() получения аренды по DHCP, 0 - адрес не от DHCP
+};
+
+// Профиль сети: SSID и пароль
+struct WiFiProfile {
+  char ssid[33];
+  char password[65];
+};
+
 // Initialize WiFi settings storage
 void initWiFiSettings();
 
@@ -13,9 +31,28 @@ void saveWiFiCredentials(const String& ssid, const String& password);
 // Load WiFi credentials from NVS
 bool loadWiFiCredentials(String& ssid, String& password);
 
+// Load network profiles in priority order: 0 - ssid/password (Bluetooth, "wifi.ssid"),
+// дальше - список "wifi.networks" с сервера. Возвращает количество
+size_t loadWiFiProfiles(WiFiProfile* profiles, size_t maxProfiles);
+
+// Save network profiles (0 - основной, ssid/password); flash пишется только при изменении
+void saveWiFiProfiles(const WiFiProfile* profiles, size_t count);
+
 // Get current WiFi SSID
 String getCurrentSSID();
 
+// Load cached BSSID/channel/lease (false - нет кэша или другой формат)
+bool loadWiFiLinkCache(WiFiLinkCache& cache);
+
+// Save cached BSSID/channel/lease (flash пишется только при изменении)
+void saveWiFiLinkCache(const WiFiLinkCache& cache);
+
+// Save static IP config ("" в ip - DHCP)
+void saveWiFiStaticIP(const char* ip, const char* gateway, const char* subnet, const char* dns);
+
+// Load static IP config (false - DHCP)
+bool loadWiFiStaticIP(IPAddress& ip, IPAddress& gateway, IPAddress& subnet, IPAddress& dns);
+
 // Save server host to NVS
 void saveServerHost(const String& host);
 
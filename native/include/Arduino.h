@@ -0,0 +1,100 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/*
+ * Native Arduino Core
+ *
+ * Подмножество ядра Arduino-ESP32 для сборки модулей src/ на Linux (env:native).
+ *
+ * Особенности:
+ * - millis()/micros() - монотонные часы процесса (64 бита, без переполнения через 49/71 суток)
+ * - Serial - stdout; ввода нет (available() == 0)
+ * - PSRAM "есть" (psramFound() == true), ps_malloc - обычный malloc
+ * - ESP.restart() завершает процесс (код 3), запускающий скрипт может перезапустить
+ * - GPIO - входы читаются как HIGH (триггер SD_TRIGGER_GPIO не срабатывает)
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include <algorithm>
+
+#include "WString.h"
+#include "Stream.h"
+#include "IPAddress.h"
+
+using std::min;
+using std::max;
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x01
+#define OUTPUT       0x03
+#define INPUT_PULLUP 0x05
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+bool setCpuFrequencyMhz(uint32_t mhz);
+uint32_t getCpuFrequencyMhz();
+
+bool psramFound();
+void* ps_malloc(size_t size);
+void* ps_calloc(size_t count, size_t size);
+void* ps_realloc(void* ptr, size_t size);
+
+// strlcpy есть в newlib ESP-IDF и в glibc начиная с 2.38
+#if defined(__GLIBC__) && (__GLIBC__ < 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38))
+#define NATIVE_NEED_STRLCPY
+size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long baud);
+  void end();
+  int available() override;
+  int read() override;
+  int peek() override;
+  void flush();
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+ public:
+  uint32_t getHeapSize();
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  uint32_t getPsramSize();
+  uint32_t getFreePsram();
+  uint32_t getCpuFreqMHz();
+  uint32_t getCycleCount();
+  [[noreturn]] void restart();
+};
+
+extern EspClass ESP;
+
+#endif // NATIVE_ARDUINO_H
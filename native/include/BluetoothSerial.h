@@ -0,0 +1,25 @@
+#ifndef NATIVE_BLUETOOTHSERIAL_H
+#define NATIVE_BLUETOOTHSERIAL_H
+
+/*
+ * BluetoothSerial для сборки native: без радио. Строки для устройства можно подать
+ * через nativeBluetoothInject() (например, JSON с учётными данными WiFi), ответы идут в stdout.
+ */
+
+#include "Arduino.h"
+
+class BluetoothSerial : public Stream {
+ public:
+  bool begin(String localName = String(), bool isMaster = false);
+  void end();
+  bool hasClient();
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buffer, size_t size) override;
+  using Print::write;
+  void flush() {}
+};
+
+#endif // NATIVE_BLUETOOTHSERIAL_H
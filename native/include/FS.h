@@ -0,0 +1,92 @@
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+/*
+ * FS (Arduino-ESP32 VFS) для сборки native: пути файловой системы - внутри каталога хоста.
+ * Как в ядре, File разделяет открытый файл между копиями и закрывается последней копией.
+ */
+
+#include <memory>
+#include "Arduino.h"
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileImpl;
+
+class File : public Stream {
+ public:
+  File() {}
+  explicit File(std::shared_ptr<FileImpl> impl) : impl(impl) {}
+
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t read(uint8_t* buf, size_t size);
+  size_t readBytes(char* buffer, size_t length) { return read((uint8_t*)buffer, length); }
+  void flush();
+  bool seek(uint32_t pos, SeekMode mode);
+  bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+  size_t position() const;
+  size_t size() const;
+  bool setBufferSize(size_t size);
+  void close();
+  operator bool() const;
+  time_t getLastWrite();
+  const char* path() const;
+  const char* name() const;
+
+  bool isDirectory();
+  File openNextFile(const char* mode = FILE_READ);
+  void rewindDirectory();
+
+ private:
+  std::shared_ptr<FileImpl> impl;
+};
+
+class FS {
+ public:
+  explicit FS(const char* root = "") { setRoot(root); }
+
+  File open(const char* path, const char* mode = FILE_READ, const bool create = false);
+  File open(const String& path, const char* mode = FILE_READ, const bool create = false) {
+    return open(path.c_str(), mode, create);
+  }
+  bool exists(const char* path);
+  bool exists(const String& path) { return exists(path.c_str()); }
+  bool remove(const char* path);
+  bool remove(const String& path) { return remove(path.c_str()); }
+  bool rename(const char* pathFrom, const char* pathTo);
+  bool rename(const String& pathFrom, const String& pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+  bool mkdir(const char* path);
+  bool mkdir(const String& path) { return mkdir(path.c_str()); }
+  bool rmdir(const char* path);
+  bool rmdir(const String& path) { return rmdir(path.c_str()); }
+
+ protected:
+  char root[160] = "";      // Каталог хоста, соответствующий "/"
+  bool mounted = false;
+
+  void setRoot(const char* path);
+  // Путь хоста для пути FS (false - не смонтировано или путь не абсолютный)
+  bool hostPath(const char* path, char* out, size_t size) const;
+};
+
+}  // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif // NATIVE_FS_H
@@ -0,0 +1,111 @@
+#ifndef NATIVE_HTTPCLIENT_H
+#define NATIVE_HTTPCLIENT_H
+
+/*
+ * HTTPClient (Arduino-ESP32) для сборки native: HTTP/1.1 поверх WiFiClient.
+ *
+ * Только http://; тело ответа - Content-Length, chunked или до закрытия соединения.
+ * Коды ошибок - как у Arduino-ESP32 (HTTPC_ERROR_*).
+ */
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED  (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED  (-2)
+#define HTTPC_ERROR_SEND_PAYLOAD_FAILED (-3)
+#define HTTPC_ERROR_NOT_CONNECTED       (-4)
+#define HTTPC_ERROR_CONNECTION_LOST     (-5)
+#define HTTPC_ERROR_NO_STREAM           (-6)
+#define HTTPC_ERROR_NO_HTTP_SERVER      (-7)
+#define HTTPC_ERROR_TOO_LESS_RAM        (-8)
+#define HTTPC_ERROR_ENCODING            (-9)
+#define HTTPC_ERROR_STREAM_WRITE        (-10)
+#define HTTPC_ERROR_READ_TIMEOUT        (-11)
+
+#define HTTPCLIENT_DEFAULT_TCP_TIMEOUT 5000
+
+typedef enum {
+  HTTP_CODE_CONTINUE = 100,
+  HTTP_CODE_OK = 200,
+  HTTP_CODE_CREATED = 201,
+  HTTP_CODE_NO_CONTENT = 204,
+  HTTP_CODE_PARTIAL_CONTENT = 206,
+  HTTP_CODE_MOVED_PERMANENTLY = 301,
+  HTTP_CODE_FOUND = 302,
+  HTTP_CODE_NOT_MODIFIED = 304,
+  HTTP_CODE_BAD_REQUEST = 400,
+  HTTP_CODE_UNAUTHORIZED = 401,
+  HTTP_CODE_FORBIDDEN = 403,
+  HTTP_CODE_NOT_FOUND = 404,
+  HTTP_CODE_REQUEST_TIMEOUT = 408,
+  HTTP_CODE_CONFLICT = 409,
+  HTTP_CODE_PAYLOAD_TOO_LARGE = 413,
+  HTTP_CODE_RANGE_NOT_SATISFIABLE = 416,
+  HTTP_CODE_INTERNAL_SERVER_ERROR = 500,
+  HTTP_CODE_SERVICE_UNAVAILABLE = 503
+} t_http_codes;
+
+class HTTPClient {
+ public:
+  HTTPClient();
+  ~HTTPClient();
+
+  bool begin(String url);
+  bool begin(const String& host, uint16_t port, const String& uri = "/");
+  void end();
+  bool connected();
+
+  void setReuse(bool reuse) { reuseConnection = reuse; }
+  void setConnectTimeout(int32_t timeoutMs) { connectTimeout = timeoutMs; }
+  void setTimeout(uint16_t timeoutMs) { tcpTimeout = timeoutMs; }
+  void setUserAgent(const String& userAgent) { this->userAgent = userAgent; }
+
+  void addHeader(const String& name, const String& value);
+  void collectHeaders(const char* headerKeys[], const size_t headerKeysCount);
+  String header(const char* name);
+  bool hasHeader(const char* name);
+  int headers() { return (int)collectCount; }
+
+  int GET();
+  int POST(uint8_t* payload, size_t size);
+  int POST(const String& payload);
+  int PUT(uint8_t* payload, size_t size);
+  int sendRequest(const char* type, uint8_t* payload = nullptr, size_t size = 0);
+
+  // -1 - длина тела неизвестна (chunked или до закрытия)
+  int getSize() { return bodySize; }
+  String getString();
+  int writeToStream(Stream* stream);
+  WiFiClient& getStream() { return client; }
+  WiFiClient* getStreamPtr() { return &client; }
+
+  static String errorToString(int error);
+
+ private:
+  static const size_t MAX_COLLECT = 8;
+
+  WiFiClient client;
+  String host;
+  uint16_t port = 80;
+  String uri;
+  String requestHeaders;
+  String userAgent = "ESP32HTTPClient";
+  bool reuseConnection = true;
+  bool canReuse = false;
+  bool chunked = false;
+  int32_t connectTimeout = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
+  uint16_t tcpTimeout = HTTPCLIENT_DEFAULT_TCP_TIMEOUT;
+  int returnCode = 0;
+  int bodySize = -1;
+  String collectKeys[MAX_COLLECT];
+  String collectValues[MAX_COLLECT];
+  size_t collectCount = 0;
+
+  bool connect();
+  int handleHeaderResponse();
+  bool readLine(String& line);
+  void disconnect(bool preserveClient = false);
+};
+
+#endif // NATIVE_HTTPCLIENT_H
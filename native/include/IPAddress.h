@@ -0,0 +1,28 @@
+#ifndef NATIVE_IPADDRESS_H
+#define NATIVE_IPADDRESS_H
+
+#include <stdint.h>
+#include "WString.h"
+
+// IPv4 адрес; uint32_t - в порядке байт сети (первый октет - младший байт), как в lwIP
+class IPAddress {
+ public:
+  IPAddress() : address(0) {}
+  IPAddress(uint8_t o1, uint8_t o2, uint8_t o3, uint8_t o4)
+    : address((uint32_t)o1 | ((uint32_t)o2 << 8) | ((uint32_t)o3 << 16) | ((uint32_t)o4 << 24)) {}
+  IPAddress(uint32_t value) : address(value) {}
+
+  operator uint32_t() const { return address; }
+  bool operator==(const IPAddress& rhs) const { return address == rhs.address; }
+  bool operator!=(const IPAddress& rhs) const { return address != rhs.address; }
+  uint8_t operator[](int index) const { return (address >> (index * 8)) & 0xFF; }
+
+  bool fromString(const char* str);
+  bool fromString(const String& str) { return fromString(str.c_str()); }
+  String toString() const;
+
+ private:
+  uint32_t address;
+};
+
+#endif // NATIVE_IPADDRESS_H
@@ -0,0 +1,41 @@
+#ifndef NATIVE_SD_MMC_H
+#define NATIVE_SD_MMC_H
+
+/*
+ * SD_MMC для сборки native: карта - каталог <data>/sdcard, ёмкость - nativeSdSetCapacity()
+ * (по умолчанию 8 GB). Без карты (nativeSdSetPresent(false)) begin() не проходит.
+ */
+
+#include "FS.h"
+
+typedef enum { CARD_NONE, CARD_MMC, CARD_SD, CARD_SDHC, CARD_UNKNOWN } sdcard_type_t;
+
+#define SDMMC_FREQ_DEFAULT   20000
+#define SDMMC_FREQ_HIGHSPEED 40000
+#define SDMMC_FREQ_PROBING   400
+#define SDMMC_FREQ_52M       52000
+#define SDMMC_FREQ_26M       26000
+#define BOARD_MAX_SDMMC_FREQ SDMMC_FREQ_HIGHSPEED
+
+namespace fs {
+
+class SDMMCFS : public FS {
+ public:
+  SDMMCFS() : FS("") {}
+
+  bool setPins(int clk, int cmd, int d0);
+  bool setPins(int clk, int cmd, int d0, int d1, int d2, int d3);
+  bool begin(const char* mountpoint = "/sdcard", bool mode1bit = false, bool formatIfMountFailed = false,
+             int sdmmcFrequency = BOARD_MAX_SDMMC_FREQ, uint8_t maxOpenFiles = 5);
+  void end();
+  sdcard_type_t cardType();
+  uint64_t cardSize();
+  uint64_t totalBytes();
+  uint64_t usedBytes();
+};
+
+}  // namespace fs
+
+extern fs::SDMMCFS SD_MMC;
+
+#endif // NATIVE_SD_MMC_H
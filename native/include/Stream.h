@@ -0,0 +1,65 @@
+#ifndef NATIVE_STREAM_H
+#define NATIVE_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+
+// Print/Stream ядра Arduino: форматированный вывод и чтение с таймаутом
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+  size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+  size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+  size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+  size_t print(const String& s);
+  size_t print(const char* s);
+  size_t print(char c);
+  size_t print(int value, int base = 10);
+  size_t print(unsigned int value, int base = 10);
+  size_t print(long value, int base = 10);
+  size_t print(unsigned long value, int base = 10);
+  size_t print(long long value, int base = 10);
+  size_t print(unsigned long long value, int base = 10);
+  size_t print(double value, int digits = 2);
+
+  size_t println();
+  template <typename T>
+  size_t println(const T& value) {
+    size_t n = print(value);
+    return n + println();
+  }
+  template <typename T>
+  size_t println(const T& value, int format) {
+    size_t n = print(value, format);
+    return n + println();
+  }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+
+  void setTimeout(unsigned long timeoutMs) { timeout = timeoutMs; }
+  unsigned long getTimeout() const { return timeout; }
+
+  size_t readBytes(char* buffer, size_t length);
+  size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+  size_t readBytesUntil(char terminator, char* buffer, size_t length);
+  String readString();
+  String readStringUntil(char terminator);
+
+ protected:
+  unsigned long timeout = 1000;
+  int timedRead();
+};
+
+#endif // NATIVE_STREAM_H
@@ -0,0 +1,130 @@
+#ifndef NATIVE_WSTRING_H
+#define NATIVE_WSTRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * String (Arduino WString) для сборки native.
+ *
+ * Буфер в куче через malloc/realloc, как в ядре ESP32 - выделения видны счётчикам
+ * heap_counters (сборка с HEAP_COUNTERS). Нехватка памяти делает строку недействительной
+ * (c_str() == nullptr не бывает: пустая строка "").
+ */
+
+class String {
+ public:
+  String(const char* cstr = "");
+  String(const char* cstr, unsigned int length);
+  String(const String& str);
+  String(String&& str);
+  explicit String(char c);
+  explicit String(unsigned char value, unsigned char base = 10);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  explicit String(float value, unsigned int decimalPlaces = 2);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+  ~String();
+
+  String& operator=(const String& rhs);
+  String& operator=(String&& rhs);
+  String& operator=(const char* cstr);
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return len; }
+  bool isEmpty() const { return len == 0; }
+  const char* c_str() const { return buffer ? buffer : ""; }
+  char* begin() { return buffer; }
+  char* end() { return buffer ? buffer + len : nullptr; }
+
+  bool concat(const String& str);
+  bool concat(const char* cstr);
+  bool concat(const char* cstr, unsigned int length);
+  bool concat(char c);
+  bool concat(int value);
+  bool concat(unsigned int value);
+  bool concat(long value);
+  bool concat(unsigned long value);
+  bool concat(long long value);
+  bool concat(unsigned long long value);
+  bool concat(float value);
+  bool concat(double value);
+
+  template <typename T>
+  String& operator+=(const T& rhs) {
+    concat(rhs);
+    return *this;
+  }
+
+  int compareTo(const String& s) const;
+  bool equals(const String& s) const;
+  bool equals(const char* cstr) const;
+  bool equalsIgnoreCase(const String& s) const;
+  bool operator==(const String& rhs) const { return equals(rhs); }
+  bool operator==(const char* cstr) const { return equals(cstr); }
+  bool operator!=(const String& rhs) const { return !equals(rhs); }
+  bool operator!=(const char* cstr) const { return !equals(cstr); }
+  bool operator<(const String& rhs) const { return compareTo(rhs) < 0; }
+  bool operator>(const String& rhs) const { return compareTo(rhs) > 0; }
+  bool startsWith(const String& prefix) const;
+  bool startsWith(const String& prefix, unsigned int offset) const;
+  bool endsWith(const String& suffix) const;
+
+  char charAt(unsigned int index) const;
+  void setCharAt(unsigned int index, char c);
+  char operator[](unsigned int index) const { return charAt(index); }
+  char& operator[](unsigned int index);
+  void getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index = 0) const;
+  void toCharArray(char* buf, unsigned int bufsize, unsigned int index = 0) const {
+    getBytes((unsigned char*)buf, bufsize, index);
+  }
+
+  int indexOf(char ch, unsigned int fromIndex = 0) const;
+  int indexOf(const char* str, unsigned int fromIndex = 0) const;
+  int indexOf(const String& str, unsigned int fromIndex = 0) const;
+  int lastIndexOf(char ch) const;
+  int lastIndexOf(char ch, unsigned int fromIndex) const;
+  int lastIndexOf(const String& str) const;
+  String substring(unsigned int beginIndex) const { return substring(beginIndex, len); }
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+  void replace(char find, char replace);
+  void replace(const String& find, const String& replace);
+  void remove(unsigned int index);
+  void remove(unsigned int index, unsigned int count);
+  void toLowerCase();
+  void toUpperCase();
+  void trim();
+
+  long toInt() const;
+  float toFloat() const;
+  double toDouble() const;
+
+ private:
+  char* buffer = nullptr;
+  unsigned int capacity = 0;
+  unsigned int len = 0;
+
+  void invalidate();
+  bool grow(unsigned int size);
+  String& copy(const char* cstr, unsigned int length);
+  void move(String& rhs);
+};
+
+// Тип промежуточного результата operator+ (как в ядре; ArduinoJson его различает)
+class StringSumHelper : public String {
+ public:
+  using String::String;
+  StringSumHelper(const String& s) : String(s) {}
+};
+
+StringSumHelper operator+(const String& lhs, const String& rhs);
+StringSumHelper operator+(const String& lhs, const char* rhs);
+StringSumHelper operator+(const char* lhs, const String& rhs);
+StringSumHelper operator+(const String& lhs, char rhs);
+
+#endif // NATIVE_WSTRING_H
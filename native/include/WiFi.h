@@ -0,0 +1,155 @@
+#ifndef NATIVE_WIFI_H
+#define NATIVE_WIFI_H
+
+/*
+ * WiFi (Arduino-ESP32) для сборки native: сеть хоста вместо радио.
+ *
+ * Особенности:
+ * - begin() всегда "ассоциируется": STA_CONNECTED и STA_GOT_IP приходят из отдельного потока
+ *   событий (как из задачи событий ядра), через nativeWiFiSetJoinDelay() мс
+ * - Адрес - статический из config(), иначе 127.0.0.1; BSSID/канал - из begin() или точки по умолчанию
+ * - Эфир для scanNetworks() задаётся nativeWiFiSetNetworks() (по умолчанию пусто - подключение
+ *   "вслепую" к основному профилю)
+ * - Обрыв связи - nativeWiFiDropLink(reason): STA_DISCONNECTED с этой причиной
+ */
+
+#include "Arduino.h"
+#include "esp_wifi.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+typedef enum {
+  WL_NO_SHIELD = 255,
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL,
+  WL_SCAN_COMPLETED,
+  WL_CONNECTED,
+  WL_CONNECT_FAILED,
+  WL_CONNECTION_LOST,
+  WL_DISCONNECTED
+} wl_status_t;
+
+typedef enum { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA } wifi_mode_t;
+
+typedef enum {
+  WIFI_POWER_19_5dBm = 78,
+  WIFI_POWER_19dBm = 76,
+  WIFI_POWER_17dBm = 68,
+  WIFI_POWER_15dBm = 60,
+  WIFI_POWER_13dBm = 52,
+  WIFI_POWER_11dBm = 44,
+  WIFI_POWER_8_5dBm = 34,
+  WIFI_POWER_7dBm = 28,
+  WIFI_POWER_5dBm = 20,
+  WIFI_POWER_2dBm = 8,
+  WIFI_POWER_MINUS_1dBm = -4
+} wifi_power_t;
+
+// Порядок как в Arduino-ESP32 2.x
+typedef enum {
+  ARDUINO_EVENT_WIFI_READY = 0,
+  ARDUINO_EVENT_WIFI_SCAN_DONE,
+  ARDUINO_EVENT_WIFI_STA_START,
+  ARDUINO_EVENT_WIFI_STA_STOP,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED,
+  ARDUINO_EVENT_WIFI_STA_AUTHMODE_CHANGE,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP6,
+  ARDUINO_EVENT_WIFI_STA_LOST_IP,
+  ARDUINO_EVENT_MAX
+} arduino_event_id_t;
+
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t channel;
+  uint8_t authmode;
+  uint16_t aid;
+} wifi_event_sta_connected_t;
+
+typedef struct {
+  uint8_t ssid[32];
+  uint8_t ssid_len;
+  uint8_t bssid[6];
+  uint8_t reason;
+  int8_t rssi;
+} wifi_event_sta_disconnected_t;
+
+typedef struct {
+  uint32_t ip;
+  uint32_t netmask;
+  uint32_t gw;
+} native_ip_info_t;
+
+typedef struct {
+  int if_index;
+  native_ip_info_t ip_info;
+  bool ip_changed;
+} ip_event_got_ip_t;
+
+typedef union {
+  wifi_event_sta_connected_t wifi_sta_connected;
+  wifi_event_sta_disconnected_t wifi_sta_disconnected;
+  ip_event_got_ip_t got_ip;
+} arduino_event_info_t;
+
+typedef arduino_event_id_t WiFiEvent_t;
+typedef arduino_event_info_t WiFiEventInfo_t;
+typedef void (*WiFiEventFuncCb)(arduino_event_id_t event, arduino_event_info_t info);
+typedef void (*WiFiEventCb)(arduino_event_id_t event);
+typedef int wifi_event_id_t;
+
+#define WIFI_SCAN_RUNNING (-1)
+#define WIFI_SCAN_FAILED  (-2)
+
+class WiFiClass {
+ public:
+  bool mode(wifi_mode_t mode);
+  wifi_mode_t getMode();
+  bool setSleep(bool enabled);
+  bool setAutoReconnect(bool autoReconnect);
+  bool setTxPower(wifi_power_t power);
+
+  wl_status_t begin(const char* ssid, const char* passphrase = nullptr, int32_t channel = 0,
+                    const uint8_t* bssid = nullptr, bool connect = true);
+  bool config(IPAddress localIP, IPAddress gateway, IPAddress subnet, IPAddress dns1 = (uint32_t)0,
+              IPAddress dns2 = (uint32_t)0);
+  bool disconnect(bool wifiOff = false, bool eraseAp = false);
+  bool reconnect();
+  wl_status_t status();
+  bool isConnected() { return status() == WL_CONNECTED; }
+
+  IPAddress localIP();
+  IPAddress gatewayIP();
+  IPAddress subnetMask();
+  IPAddress dnsIP(uint8_t index = 0);
+  uint8_t* macAddress(uint8_t* mac);
+  String macAddress();
+  String SSID();
+  uint8_t* BSSID();
+  String BSSIDstr();
+  int32_t channel();
+  int8_t RSSI();
+
+  // Сканирование (async - результат через scanComplete())
+  int16_t scanNetworks(bool async = false, bool showHidden = false, bool passive = false,
+                       uint32_t maxMsPerChannel = 300, uint8_t channel = 0);
+  int16_t scanComplete();
+  void scanDelete();
+  String SSID(uint8_t index);
+  uint8_t* BSSID(uint8_t index);
+  String BSSIDstr(uint8_t index);
+  int32_t channel(uint8_t index);
+  int32_t RSSI(uint8_t index);
+
+  int hostByName(const char* host, IPAddress& result);
+
+  wifi_event_id_t onEvent(WiFiEventFuncCb callback, arduino_event_id_t event = ARDUINO_EVENT_MAX);
+  void removeEvent(wifi_event_id_t id);
+};
+
+extern WiFiClass WiFi;
+
+#endif // NATIVE_WIFI_H
@@ -0,0 +1,58 @@
+#ifndef NATIVE_WIFICLIENT_H
+#define NATIVE_WIFICLIENT_H
+
+#include <memory>
+#include "Arduino.h"
+
+/*
+ * WiFiClient поверх сокетов POSIX.
+ *
+ * Как в Arduino-ESP32: копии разделяют один сокет, он закрывается stop() или последней копией.
+ * write() блокируется, пока ядро не примет данные (не дольше таймаута); SO_SNDBUF можно
+ * уменьшить до окна TCP lwIP (nativeNetSetSendBuffer), чтобы write() ждал подтверждений как на ESP32.
+ */
+
+struct NativeSocket;
+
+class WiFiClient : public Stream {
+ public:
+  WiFiClient();
+  explicit WiFiClient(int fd);
+  ~WiFiClient() override;
+
+  int connect(IPAddress ip, uint16_t port);
+  int connect(IPAddress ip, uint16_t port, int32_t timeoutMs);
+  int connect(const char* host, uint16_t port);
+  int connect(const char* host, uint16_t port, int32_t timeoutMs);
+
+  size_t write(uint8_t data) override;
+  size_t write(const uint8_t* buf, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int read(uint8_t* buf, size_t size);
+  int peek() override;
+  void flush();
+  void stop();
+  uint8_t connected();
+  operator bool() { return connected(); }
+  bool operator==(const WiFiClient& rhs) const { return socket == rhs.socket; }
+
+  int fd() const;
+  int setNoDelay(bool nodelay);
+  bool getNoDelay();
+  int setSocketOption(int option, char* value, size_t len);
+  int setOption(int option, int* value);
+  // Таймаут чтения/записи, мс (Stream::setTimeout)
+  void setTimeout(uint32_t timeoutMs);
+
+  IPAddress remoteIP() const;
+  uint16_t remotePort() const;
+  IPAddress localIP() const;
+  uint16_t localPort() const;
+
+ private:
+  std::shared_ptr<NativeSocket> socket;
+};
+
+#endif // NATIVE_WIFICLIENT_H
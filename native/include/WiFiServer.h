@@ -0,0 +1,31 @@
+#ifndef NATIVE_WIFISERVER_H
+#define NATIVE_WIFISERVER_H
+
+#include "WiFiClient.h"
+
+// Прослушивающий сокет; порт сдвигается на nativeNetPortOffset() (порт 80 на Linux - только root)
+class WiFiServer {
+ public:
+  WiFiServer(uint16_t port = 80, uint8_t maxClients = 4);
+  ~WiFiServer();
+
+  void begin(uint16_t port = 0);
+  void end();
+  void close() { end(); }
+  void stop() { end(); }
+  bool hasClient();
+  WiFiClient accept();
+  WiFiClient available() { return accept(); }
+  void setNoDelay(bool nodelay);
+  bool getNoDelay() const { return noDelay; }
+  operator bool() const { return listenFd >= 0; }
+
+ private:
+  int listenFd = -1;
+  int pendingFd = -1;       // Принят в hasClient(), отдаётся accept()
+  uint16_t port;
+  uint8_t maxClients;
+  bool noDelay = false;
+};
+
+#endif // NATIVE_WIFISERVER_H
@@ -0,0 +1,126 @@
+#ifndef NATIVE_ESP_CAMERA_H
+#define NATIVE_ESP_CAMERA_H
+
+/*
+ * esp32-camera для сборки native: кадры - JPEG из каталога (nativeCameraLoadFrames, по кругу)
+ * или синтетические (маркеры SOI/EOI, размер по разрешению и качеству).
+ * fb_count буферов, как у драйвера: пока все выданы, esp_camera_fb_get() возвращает nullptr.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include "esp_err.h"
+
+// Порядок как в sensor.h esp32-camera (значения приходят числами в настройках сервера)
+typedef enum {
+  FRAMESIZE_96X96,
+  FRAMESIZE_QQVGA,
+  FRAMESIZE_QCIF,
+  FRAMESIZE_HQVGA,
+  FRAMESIZE_240X240,
+  FRAMESIZE_QVGA,
+  FRAMESIZE_CIF,
+  FRAMESIZE_HVGA,
+  FRAMESIZE_VGA,
+  FRAMESIZE_SVGA,
+  FRAMESIZE_XGA,
+  FRAMESIZE_HD,
+  FRAMESIZE_SXGA,
+  FRAMESIZE_UXGA,
+  FRAMESIZE_FHD,
+  FRAMESIZE_P_HD,
+  FRAMESIZE_P_3MP,
+  FRAMESIZE_QXGA,
+  FRAMESIZE_QHD,
+  FRAMESIZE_WQXGA,
+  FRAMESIZE_P_FHD,
+  FRAMESIZE_QSXGA,
+  FRAMESIZE_INVALID
+} framesize_t;
+
+typedef enum {
+  PIXFORMAT_RGB565,
+  PIXFORMAT_YUV422,
+  PIXFORMAT_YUV420,
+  PIXFORMAT_GRAYSCALE,
+  PIXFORMAT_JPEG,
+  PIXFORMAT_RGB888,
+  PIXFORMAT_RAW,
+  PIXFORMAT_RGB444,
+  PIXFORMAT_RGB555
+} pixformat_t;
+
+typedef enum { CAMERA_FB_IN_PSRAM, CAMERA_FB_IN_DRAM } camera_fb_location_t;
+typedef enum { CAMERA_GRAB_WHEN_EMPTY, CAMERA_GRAB_LATEST } camera_grab_mode_t;
+typedef enum { LEDC_CHANNEL_0, LEDC_CHANNEL_1 } ledc_channel_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1 } ledc_timer_t;
+
+typedef struct {
+  int pin_pwdn;
+  int pin_reset;
+  int pin_xclk;
+  int pin_sccb_sda;
+  int pin_sccb_scl;
+  int pin_d7;
+  int pin_d6;
+  int pin_d5;
+  int pin_d4;
+  int pin_d3;
+  int pin_d2;
+  int pin_d1;
+  int pin_d0;
+  int pin_vsync;
+  int pin_href;
+  int pin_pclk;
+  int xclk_freq_hz;
+  ledc_timer_t ledc_timer;
+  ledc_channel_t ledc_channel;
+  pixformat_t pixel_format;
+  framesize_t frame_size;
+  int jpeg_quality;
+  size_t fb_count;
+  camera_fb_location_t fb_location;
+  camera_grab_mode_t grab_mode;
+} camera_config_t;
+
+typedef struct {
+  uint8_t* buf;
+  size_t len;
+  size_t width;
+  size_t height;
+  pixformat_t format;
+  struct timeval timestamp;
+} camera_fb_t;
+
+typedef struct {
+  framesize_t framesize;
+  uint8_t quality;
+  int8_t brightness;
+  int8_t contrast;
+  int8_t saturation;
+  uint8_t hmirror;
+  uint8_t vflip;
+} camera_status_t;
+
+typedef struct _sensor sensor_t;
+struct _sensor {
+  camera_status_t status;
+  pixformat_t pixformat;
+  int (*set_pixformat)(sensor_t* sensor, pixformat_t pixformat);
+  int (*set_framesize)(sensor_t* sensor, framesize_t framesize);
+  int (*set_quality)(sensor_t* sensor, int quality);
+  int (*set_brightness)(sensor_t* sensor, int level);
+  int (*set_contrast)(sensor_t* sensor, int level);
+  int (*set_saturation)(sensor_t* sensor, int level);
+  int (*set_hmirror)(sensor_t* sensor, int enable);
+  int (*set_vflip)(sensor_t* sensor, int enable);
+};
+
+esp_err_t esp_camera_init(const camera_config_t* config);
+esp_err_t esp_camera_deinit();
+camera_fb_t* esp_camera_fb_get();
+void esp_camera_fb_return(camera_fb_t* fb);
+sensor_t* esp_camera_sensor_get();
+
+#endif // NATIVE_ESP_CAMERA_H
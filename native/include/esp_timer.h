@@ -0,0 +1,9 @@
+#ifndef NATIVE_ESP_TIMER_H
+#define NATIVE_ESP_TIMER_H
+
+#include <stdint.h>
+
+// Микросекунды с запуска процесса (те же часы, что у micros())
+int64_t esp_timer_get_time();
+
+#endif // NATIVE_ESP_TIMER_H
@@ -0,0 +1,27 @@
+#ifndef NATIVE_ESP_WIFI_H
+#define NATIVE_ESP_WIFI_H
+
+#include "esp_err.h"
+
+typedef enum { WIFI_PS_NONE, WIFI_PS_MIN_MODEM, WIFI_PS_MAX_MODEM } wifi_ps_type_t;
+
+// Причины отключения (поле reason события STA_DISCONNECTED), значения ESP-IDF
+typedef enum {
+  WIFI_REASON_UNSPECIFIED = 1,
+  WIFI_REASON_AUTH_EXPIRE = 2,
+  WIFI_REASON_AUTH_LEAVE = 3,
+  WIFI_REASON_ASSOC_EXPIRE = 4,
+  WIFI_REASON_ASSOC_LEAVE = 8,
+  WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT = 15,
+  WIFI_REASON_BEACON_TIMEOUT = 200,
+  WIFI_REASON_NO_AP_FOUND = 201,
+  WIFI_REASON_AUTH_FAIL = 202,
+  WIFI_REASON_ASSOC_FAIL = 203,
+  WIFI_REASON_HANDSHAKE_TIMEOUT = 204,
+  WIFI_REASON_CONNECTION_FAIL = 205
+} wifi_err_reason_t;
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t* type);
+
+#endif // NATIVE_ESP_WIFI_H
@@ -0,0 +1,43 @@
+#ifndef NATIVE_FREERTOS_H
+#define NATIVE_FREERTOS_H
+
+/*
+ * FreeRTOS для сборки native: задачи - потоки POSIX, тик - 1 мс (как configTICK_RATE_HZ 1000
+ * в Arduino-ESP32). Ядра и приоритеты не моделируются - планирует ОС.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE  ((BaseType_t)1)
+#define pdFALSE ((BaseType_t)0)
+#define pdPASS  pdTRUE
+#define pdFAIL  pdFALSE
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+// Критическая секция: спинлок (на ESP32 ещё и запрет прерываний ядра)
+typedef struct {
+  volatile int locked;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+
+void vPortEnterCritical(portMUX_TYPE* mux);
+void vPortExitCritical(portMUX_TYPE* mux);
+
+#define portENTER_CRITICAL(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux) vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux) vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux) vPortExitCritical(mux)
+
+#endif // NATIVE_FREERTOS_H
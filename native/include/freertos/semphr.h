@@ -0,0 +1,15 @@
+#ifndef NATIVE_FREERTOS_SEMPHR_H
+#define NATIVE_FREERTOS_SEMPHR_H
+
+#include "FreeRTOS.h"
+
+struct NativeSemaphore;
+typedef NativeSemaphore* SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif // NATIVE_FREERTOS_SEMPHR_H
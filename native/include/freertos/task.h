@@ -0,0 +1,30 @@
+#ifndef NATIVE_FREERTOS_TASK_H
+#define NATIVE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+struct NativeTask;
+typedef NativeTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* parameters);
+
+// Задача - отсоединённый поток; stackDepth, priority и coreId не используются
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t coreId);
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* handle);
+
+// nullptr - текущая задача (поток завершается)
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+BaseType_t xPortGetCoreID();
+
+#define taskYIELD() vTaskDelay(0)
+
+// Уведомления задачи (счётчик)
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+
+#endif // NATIVE_FREERTOS_TASK_H
@@ -0,0 +1,14 @@
+#ifndef NATIVE_LWIP_SOCKETS_H
+#define NATIVE_LWIP_SOCKETS_H
+
+// BSD сокеты lwIP (socket/connect/select/fcntl/close) - на хосте это сокеты POSIX
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#endif // NATIVE_LWIP_SOCKETS_H
@@ -0,0 +1,90 @@
+#ifndef NATIVE_HAL_H
+#define NATIVE_HAL_H
+
+/*
+ * Native HAL Module
+ *
+ * Управление окружением сборки native (env:native) со стороны хоста: где лежат NVS и карта,
+ * откуда камера берёт кадры, что "видно в эфире" и как ведёт себя сеть. Прошивка эти функции
+ * не вызывает - только native_main, бенчмарки и тесты (test/).
+ *
+ * Особенности:
+ * - Каталог данных: <dir>/nvs (Preferences), <dir>/sdcard (SD_MMC); по умолчанию ".native"
+ * - Настройки действуют с момента вызова (до setup() - для загрузки)
+ *
+ * Использование:
+ *   nativeSetDataDir("/tmp/cam1");
+ *   nativeCameraLoadFrames("frames/hd");     // JPEG по кругу вместо синтетических кадров
+ *   nativeNetSetSendBuffer(5744);           // SO_SNDBUF как TCP_SND_BUF lwIP
+ *   nativeWiFiDropLink(WIFI_REASON_BEACON_TIMEOUT);
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+// ==================== Данные ====================
+
+void nativeSetDataDir(const char* path);
+const char* nativeDataDir();
+// Каталог внутри данных (создаётся): nativeDataPath("nvs") -> "<dir>/nvs"
+const char* nativeDataPath(const char* name, char* buf, size_t size);
+
+// Вывод Serial в stdout (по умолчанию включён; бенчмарки отключают журнал прошивки)
+void nativeSerialSetEnabled(bool enabled);
+
+// ==================== Время ====================
+
+// Сдвинуть millis()/micros()/esp_timer_get_time() вперёд без ожидания (тесты задержек)
+void nativeClockAdvance(uint32_t ms);
+
+// ==================== Камера ====================
+
+// Кадры - файлы *.jpg/*.jpeg каталога (по имени, по кругу); false - ни одного файла.
+// Пустой путь - синтетические кадры
+bool nativeCameraLoadFrames(const char* directory);
+size_t nativeCameraFrameCount();
+// Частота кадров сенсора: esp_camera_fb_get() ждёт следующий кадр (по умолчанию 25, 0 - без ограничения)
+void nativeCameraSetFrameRate(uint32_t fps);
+// Кадров выдано с esp_camera_init()
+uint32_t nativeCameraFramesCaptured();
+// Время захвата последнего выданного кадра (esp_timer_get_time(), как fb->timestamp)
+int64_t nativeCameraLastCaptureTime();
+
+// ==================== WiFi ====================
+
+struct NativeAccessPoint {
+  const char* ssid;
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t rssi;
+};
+
+// Точки доступа, которые находит scanNetworks() (копируются)
+void nativeWiFiSetNetworks(const NativeAccessPoint* networks, size_t count);
+// RSSI текущего подключения (по умолчанию -50)
+void nativeWiFiSetRSSI(int8_t rssi);
+// Задержка STA_CONNECTED/STA_GOT_IP после begin(), мс (по умолчанию 20)
+void nativeWiFiSetJoinDelay(uint32_t ms);
+// Обрыв связи: STA_DISCONNECTED с этой причиной (wifi_err_reason_t)
+void nativeWiFiDropLink(uint8_t reason);
+
+// ==================== Сеть ====================
+
+// SO_SNDBUF сокетов WiFiClient, байт (0 - по умолчанию ОС). На ESP32 write() ждёт, пока
+// данные не уместятся в TCP_SND_BUF lwIP - маленький буфер воспроизводит эту блокировку
+void nativeNetSetSendBuffer(int bytes);
+// Сдвиг портов WiFiServer (PLAYBACK_PORT 80 без root недоступен)
+void nativeNetSetPortOffset(int offset);
+int nativeNetPortOffset();
+
+// ==================== SD карта ====================
+
+void nativeSdSetPresent(bool present);
+void nativeSdSetCapacity(uint64_t bytes);
+
+// ==================== Bluetooth ====================
+
+// Строка, "принятая" по Bluetooth SPP (перевод строки добавляется)
+void nativeBluetoothInject(const char* line);
+
+#endif // NATIVE_HAL_H
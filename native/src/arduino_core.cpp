@@ -0,0 +1,426 @@
+#include "Arduino.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "native_hal.h"
+#include <stdarg.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+// ==================== Время ====================
+
+static const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+static std::atomic<uint64_t> clockOffset(0);  // nativeClockAdvance(), мкс
+
+static uint64_t elapsedMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - processStart).count() +
+         clockOffset.load(std::memory_order_relaxed);
+}
+
+void nativeClockAdvance(uint32_t ms) {
+  clockOffset.fetch_add((uint64_t)ms * 1000, std::memory_order_relaxed);
+}
+
+unsigned long millis() {
+  return elapsedMicros() / 1000;
+}
+
+unsigned long micros() {
+  return elapsedMicros();
+}
+
+int64_t esp_timer_get_time() {
+  return elapsedMicros();
+}
+
+void delay(unsigned long ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() {
+  std::this_thread::yield();
+}
+
+// ==================== GPIO и частота ====================
+
+void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+}
+
+int digitalRead(uint8_t pin) {
+  return HIGH;  // Подтяжка к питанию: активный LOW не срабатывает
+}
+
+static uint32_t cpuFrequencyMhz = 240;
+
+bool setCpuFrequencyMhz(uint32_t mhz) {
+  cpuFrequencyMhz = mhz;
+  return true;
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return cpuFrequencyMhz;
+}
+
+// ==================== Память ====================
+
+bool psramFound() {
+  return true;
+}
+
+void* ps_malloc(size_t size) {
+  return malloc(size);
+}
+
+void* ps_calloc(size_t count, size_t size) {
+  return calloc(count, size);
+}
+
+void* ps_realloc(void* ptr, size_t size) {
+  return realloc(ptr, size);
+}
+
+void* heap_caps_malloc(size_t size, uint32_t caps) {
+  return malloc(size);
+}
+
+void* heap_caps_calloc(size_t count, size_t size, uint32_t caps) {
+  return calloc(count, size);
+}
+
+void* heap_caps_realloc(void* ptr, size_t size, uint32_t caps) {
+  return realloc(ptr, size);
+}
+
+void heap_caps_free(void* ptr) {
+  free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? ESP.getFreePsram() : ESP.getFreeHeap();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? ESP.getFreePsram() : ESP.getMaxAllocHeap();
+}
+
+#ifdef NATIVE_NEED_STRLCPY
+size_t strlcpy(char* dst, const char* src, size_t size) {
+  size_t length = strlen(src);
+  if (size > 0) {
+    size_t n = length < size - 1 ? length : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return length;
+}
+#endif
+
+// new/delete через malloc/free этой единицы трансляции: со сборкой HEAP_COUNTERS
+// (-Wl,--wrap=malloc) их тоже считает heap_counters - как на ESP32, где libstdc++ линкуется статически
+void* operator new(size_t size) {
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr) {
+    abort();  // Исключения не используются
+  }
+  return ptr;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return malloc(size ? size : 1);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+// ==================== ESP ====================
+
+// Куча хоста не похожа на кучу ESP32: значения - как у AI-Thinker с 4 MB PSRAM после загрузки
+static const uint32_t NATIVE_HEAP_SIZE = 327680;
+static const uint32_t NATIVE_FREE_HEAP = 180000;
+static const uint32_t NATIVE_PSRAM_SIZE = 4194252;
+
+EspClass ESP;
+
+uint32_t EspClass::getHeapSize() {
+  return NATIVE_HEAP_SIZE;
+}
+
+uint32_t EspClass::getFreeHeap() {
+  return NATIVE_FREE_HEAP;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return NATIVE_FREE_HEAP;
+}
+
+uint32_t EspClass::getMaxAllocHeap() {
+  return 110580;
+}
+
+uint32_t EspClass::getPsramSize() {
+  return NATIVE_PSRAM_SIZE;
+}
+
+uint32_t EspClass::getFreePsram() {
+  return NATIVE_PSRAM_SIZE;
+}
+
+uint32_t EspClass::getCpuFreqMHz() {
+  return cpuFrequencyMhz;
+}
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(elapsedMicros() * cpuFrequencyMhz);
+}
+
+void EspClass::restart() {
+  Serial.println("[native] ESP.restart() - exiting with code 3");
+  fflush(stdout);
+  exit(3);
+}
+
+// ==================== Print / Stream ====================
+
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    if (!write(*buffer++)) {
+      break;
+    }
+    n++;
+  }
+  return n;
+}
+
+size_t Print::printf(const char* format, ...) {
+  char stackBuffer[64];
+  char* buffer = stackBuffer;
+  va_list args;
+  va_start(args, format);
+  va_list copy;
+  va_copy(copy, args);
+  int len = vsnprintf(stackBuffer, sizeof(stackBuffer), format, copy);
+  va_end(copy);
+  if (len < 0) {
+    va_end(args);
+    return 0;
+  }
+  if ((size_t)len >= sizeof(stackBuffer)) {
+    buffer = (char*)malloc(len + 1);
+    if (!buffer) {
+      va_end(args);
+      return 0;
+    }
+    vsnprintf(buffer, len + 1, format, args);
+  }
+  va_end(args);
+  len = write((const uint8_t*)buffer, len);
+  if (buffer != stackBuffer) {
+    free(buffer);
+  }
+  return len;
+}
+
+size_t Print::print(const String& s) {
+  return write((const uint8_t*)s.c_str(), s.length());
+}
+
+size_t Print::print(const char* s) {
+  return write(s);
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t)c);
+}
+
+size_t Print::print(int value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(long value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(long long value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(unsigned long long value, int base) {
+  return print(String(value, (unsigned char)base));
+}
+
+size_t Print::print(double value, int digits) {
+  return print(String(value, (unsigned int)digits));
+}
+
+size_t Print::println() {
+  return write((const uint8_t*)"\r\n", 2);
+}
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) {
+      return c;
+    }
+    delayMicroseconds(100);
+  } while (millis() - start < timeout);
+  return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) {
+      break;
+    }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0 || c == terminator) {
+      break;
+    }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+String Stream::readString() {
+  String result;
+  int c;
+  while ((c = timedRead()) >= 0) {
+    result += (char)c;
+  }
+  return result;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String result;
+  int c;
+  while ((c = timedRead()) >= 0 && c != terminator) {
+    result += (char)c;
+  }
+  return result;
+}
+
+// ==================== Serial ====================
+
+HardwareSerial Serial;
+static bool serialEnabled = true;
+
+void nativeSerialSetEnabled(bool enabled) {
+  serialEnabled = enabled;
+}
+
+void HardwareSerial::begin(unsigned long baud) {
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+}
+
+void HardwareSerial::end() {
+  fflush(stdout);
+}
+
+int HardwareSerial::available() {
+  return 0;
+}
+
+int HardwareSerial::read() {
+  return -1;
+}
+
+int HardwareSerial::peek() {
+  return -1;
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (!serialEnabled) {
+    return size;
+  }
+  // "\r\n" ядра - в "\n" терминала
+  size_t start = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (buffer[i] == '\r') {
+      fwrite(buffer + start, 1, i - start, stdout);
+      start = i + 1;
+    }
+  }
+  fwrite(buffer + start, 1, size - start, stdout);
+  return size;
+}
+
+// ==================== IPAddress ====================
+
+bool IPAddress::fromString(const char* str) {
+  unsigned int octets[4];
+  char tail;
+  if (!str || sscanf(str, "%u.%u.%u.%u%c", &octets[0], &octets[1], &octets[2], &octets[3], &tail) != 4) {
+    return false;
+  }
+  for (int i = 0; i < 4; i++) {
+    if (octets[i] > 255) {
+      return false;
+    }
+  }
+  *this = IPAddress(octets[0], octets[1], octets[2], octets[3]);
+  return true;
+}
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(buf);
+}
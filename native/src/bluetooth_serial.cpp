@@ -0,0 +1,71 @@
+#include "BluetoothSerial.h"
+#include "native_hal.h"
+#include <deque>
+#include <mutex>
+
+static std::mutex inputLock;
+static std::deque<uint8_t> input;
+static bool started = false;
+
+void nativeBluetoothInject(const char* line) {
+  std::lock_guard<std::mutex> guard(inputLock);
+  for (const char* c = line; *c; c++) {
+    input.push_back((uint8_t)*c);
+  }
+  input.push_back('\n');
+}
+
+bool BluetoothSerial::begin(String localName, bool isMaster) {
+  started = true;
+  Serial.printf("[native] Bluetooth SPP '%s' (input via nativeBluetoothInject)\n", localName.c_str());
+  return true;
+}
+
+void BluetoothSerial::end() {
+  started = false;
+}
+
+bool BluetoothSerial::hasClient() {
+  std::lock_guard<std::mutex> guard(inputLock);
+  return started && !input.empty();
+}
+
+int BluetoothSerial::available() {
+  std::lock_guard<std::mutex> guard(inputLock);
+  return started ? (int)input.size() : 0;
+}
+
+int BluetoothSerial::read() {
+  std::lock_guard<std::mutex> guard(inputLock);
+  if (!started || input.empty()) {
+    return -1;
+  }
+  int c = input.front();
+  input.pop_front();
+  return c;
+}
+
+int BluetoothSerial::peek() {
+  std::lock_guard<std::mutex> guard(inputLock);
+  return started && !input.empty() ? input.front() : -1;
+}
+
+size_t BluetoothSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t BluetoothSerial::write(const uint8_t* buffer, size_t size) {
+  // Ответы - в stdout с пометкой, чтобы отличать от Serial
+  static bool lineStart = true;
+  for (size_t i = 0; i < size; i++) {
+    if (buffer[i] == '\r') {
+      continue;
+    }
+    if (lineStart) {
+      fputs("[bt] ", stdout);
+    }
+    fputc(buffer[i], stdout);
+    lineStart = buffer[i] == '\n';
+  }
+  return size;
+}
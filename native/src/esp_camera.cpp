@@ -0,0 +1,357 @@
+#include "esp_camera.h"
+#include "esp_timer.h"
+#include "native_hal.h"
+#include "Arduino.h"
+#include <dirent.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FrameSizeInfo {
+  uint16_t width;
+  uint16_t height;
+};
+
+// Индекс - framesize_t
+static const FrameSizeInfo FRAME_SIZES[FRAMESIZE_INVALID] = {
+  {96, 96}, {160, 120}, {176, 144}, {240, 176}, {240, 240}, {320, 240}, {400, 296},
+  {480, 320}, {640, 480}, {800, 600}, {1024, 768}, {1280, 720}, {1280, 1024}, {1600, 1200},
+  {1920, 1080}, {720, 1280}, {864, 1536}, {2048, 1536}, {2560, 1440}, {2560, 1600},
+  {1080, 1920}, {2560, 1920}
+};
+
+static const size_t MAX_FB_COUNT = 4;
+
+struct NativeFrameBuffer {
+  camera_fb_t fb;
+  size_t capacity;
+  bool out;                 // Выдан прошивке
+};
+
+static std::mutex cameraLock;
+static bool initialized = false;
+static NativeFrameBuffer buffers[MAX_FB_COUNT];
+static size_t bufferCount = 0;
+static sensor_t sensor;
+
+static std::vector<std::vector<uint8_t>> loadedFrames;
+static size_t nextLoadedFrame = 0;
+static uint32_t frameRate = 25;
+static int64_t nextFrameDue = 0;
+static uint32_t framesCaptured = 0;
+static int64_t lastCaptureTime = 0;
+
+// ==================== Источник кадров ====================
+
+static bool hasJpegExtension(const char* name) {
+  const char* dot = strrchr(name, '.');
+  return dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0);
+}
+
+bool nativeCameraLoadFrames(const char* directory) {
+  std::lock_guard<std::mutex> guard(cameraLock);
+  loadedFrames.clear();
+  nextLoadedFrame = 0;
+  if (!directory || !directory[0]) {
+    return true;
+  }
+  DIR* dir = opendir(directory);
+  if (!dir) {
+    return false;
+  }
+  std::vector<std::string> names;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != nullptr) {
+    if (hasJpegExtension(entry->d_name)) {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  std::sort(names.begin(), names.end());
+
+  for (const std::string& name : names) {
+    std::string path = std::string(directory) + "/" + name;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) {
+      continue;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+      data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(f);
+    if (data.size() >= 4 && data[0] == 0xFF && data[1] == 0xD8) {
+      loadedFrames.push_back(std::move(data));
+    }
+  }
+  return !loadedFrames.empty();
+}
+
+size_t nativeCameraFrameCount() {
+  std::lock_guard<std::mutex> guard(cameraLock);
+  return loadedFrames.size();
+}
+
+void nativeCameraSetFrameRate(uint32_t fps) {
+  std::lock_guard<std::mutex> guard(cameraLock);
+  frameRate = fps;
+  nextFrameDue = 0;
+}
+
+uint32_t nativeCameraFramesCaptured() {
+  return framesCaptured;
+}
+
+int64_t nativeCameraLastCaptureTime() {
+  std::lock_guard<std::mutex> guard(cameraLock);
+  return lastCaptureTime;
+}
+
+// Размер кадра из маркера SOF0/SOF2 (false - маркер не найден)
+static bool jpegDimensions(const std::vector<uint8_t>& data, size_t& width, size_t& height) {
+  size_t pos = 2;
+  while (pos + 9 < data.size()) {
+    if (data[pos] != 0xFF) {
+      return false;
+    }
+    uint8_t marker = data[pos + 1];
+    size_t length = (data[pos + 2] << 8) | data[pos + 3];
+    if (marker == 0xC0 || marker == 0xC2) {
+      height = (data[pos + 5] << 8) | data[pos + 6];
+      width = (data[pos + 7] << 8) | data[pos + 8];
+      return true;
+    }
+    pos += 2 + length;
+  }
+  return false;
+}
+
+// Размер синтетического кадра: OV2640 даёт ~w*h*3/(quality+20) байт, разброс кадров +-10%
+static size_t syntheticSize(framesize_t frameSize, int quality, uint32_t index) {
+  const FrameSizeInfo& info = FRAME_SIZES[frameSize];
+  size_t base = (size_t)info.width * info.height * 3 / (quality + 20);
+  uint32_t hash = index * 2654435761u;
+  int variation = (int)(hash >> 24) % 21 - 10;
+  return base + (long)base * variation / 100;
+}
+
+// SOI, SOF0 с размером, тело без 0xFF, EOI - валидная для парсеров маркеров структура
+static void fillSynthetic(uint8_t* buf, size_t len, size_t width, size_t height, uint32_t index) {
+  static const uint8_t header[] = {
+    0xFF, 0xD8,
+    0xFF, 0xC0, 0x00, 0x11, 0x08, 0x00, 0x00, 0x00, 0x00, 0x03,
+    0x01, 0x21, 0x00, 0x02, 0x11, 0x01, 0x03, 0x11, 0x01
+  };
+  memcpy(buf, header, sizeof(header));
+  buf[7] = height >> 8;
+  buf[8] = height & 0xFF;
+  buf[9] = width >> 8;
+  buf[10] = width & 0xFF;
+  uint32_t state = 0x9E3779B9u ^ index;
+  for (size_t i = sizeof(header); i < len - 2; i++) {
+    state = state * 1664525u + 1013904223u;
+    buf[i] = (state >> 24) % 0xFF;
+  }
+  buf[len - 2] = 0xFF;
+  buf[len - 1] = 0xD9;
+}
+
+static bool reserveBuffer(NativeFrameBuffer& buffer, size_t size) {
+  if (buffer.capacity >= size) {
+    return true;
+  }
+  uint8_t* grown = (uint8_t*)realloc(buffer.fb.buf, size);
+  if (!grown) {
+    return false;
+  }
+  buffer.fb.buf = grown;
+  buffer.capacity = size;
+  return true;
+}
+
+// ==================== Сенсор ====================
+
+static int setPixformat(sensor_t* s, pixformat_t pixformat) {
+  s->pixformat = pixformat;
+  return 0;
+}
+
+static int setFramesize(sensor_t* s, framesize_t framesize) {
+  if (framesize >= FRAMESIZE_INVALID) {
+    return -1;
+  }
+  s->status.framesize = framesize;
+  return 0;
+}
+
+static int setQuality(sensor_t* s, int quality) {
+  s->status.quality = constrain(quality, 0, 63);
+  return 0;
+}
+
+static int setBrightness(sensor_t* s, int level) {
+  s->status.brightness = constrain(level, -2, 2);
+  return 0;
+}
+
+static int setContrast(sensor_t* s, int level) {
+  s->status.contrast = constrain(level, -2, 2);
+  return 0;
+}
+
+static int setSaturation(sensor_t* s, int level) {
+  s->status.saturation = constrain(level, -2, 2);
+  return 0;
+}
+
+static int setHmirror(sensor_t* s, int enable) {
+  s->status.hmirror = enable ? 1 : 0;
+  return 0;
+}
+
+static int setVflip(sensor_t* s, int enable) {
+  s->status.vflip = enable ? 1 : 0;
+  return 0;
+}
+
+// ==================== Драйвер ====================
+
+esp_err_t esp_camera_init(const camera_config_t* config) {
+  std::lock_guard<std::mutex> guard(cameraLock);
+  if (initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  if (!config || config->frame_size >= FRAMESIZE_INVALID || config->fb_count == 0) {
+    return ESP_ERR_INVALID_ARG;
+  }
+
+  memset(&sensor, 0, sizeof(sensor));
+  sensor.pixformat = config->pixel_format;
+  sensor.status.framesize = config->frame_size;
+  sensor.status.quality = config->jpeg_quality;
+  sensor.set_pixformat = setPixformat;
+  sensor.set_framesize = setFramesize;
+  sensor.set_quality = setQuality;
+  sensor.set_brightness = setBrightness;
+  sensor.set_contrast = setContrast;
+  sensor.set_saturation = setSaturation;
+  sensor.set_hmirror = setHmirror;
+  sensor.set_vflip = setVflip;
+
+  // Буферы выделяются при инициализации, как в драйвере: позже кадр только копируется
+  size_t initialCapacity = syntheticSize(FRAMESIZE_UXGA, 4, 0) * 11 / 10;
+  for (const std::vector<uint8_t>& frame : loadedFrames) {
+    initialCapacity = std::max(initialCapacity, frame.size());
+  }
+  bufferCount = std::min(config->fb_count, MAX_FB_COUNT);
+  for (size_t i = 0; i < bufferCount; i++) {
+    memset(&buffers[i], 0, sizeof(buffers[i]));
+    if (!reserveBuffer(buffers[i], initialCapacity)) {
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  nextFrameDue = 0;
+  framesCaptured = 0;
+  initialized = true;
+  return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit() {
+  std::lock_guard<std::mutex> guard(cameraLock);
+  if (!initialized) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  for (size_t i = 0; i < bufferCount; i++) {
+    free(buffers[i].fb.buf);
+    memset(&buffers[i], 0, sizeof(buffers[i]));
+  }
+  bufferCount = 0;
+  initialized = false;
+  return ESP_OK;
+}
+
+camera_fb_t* esp_camera_fb_get() {
+  int64_t waitUntil = 0;
+  {
+    std::lock_guard<std::mutex> guard(cameraLock);
+    if (!initialized) {
+      return nullptr;
+    }
+    // Частота сенсора: следующий кадр не раньше периода после предыдущего
+    int64_t now = esp_timer_get_time();
+    if (frameRate > 0) {
+      if (nextFrameDue > now) {
+        waitUntil = nextFrameDue;
+      }
+      int64_t base = nextFrameDue > now ? nextFrameDue : now;
+      nextFrameDue = base + 1000000 / frameRate;
+    }
+  }
+  if (waitUntil > 0) {
+    std::this_thread::sleep_for(std::chrono::microseconds(waitUntil - esp_timer_get_time()));
+  }
+
+  std::lock_guard<std::mutex> guard(cameraLock);
+  NativeFrameBuffer* buffer = nullptr;
+  for (size_t i = 0; i < bufferCount; i++) {
+    if (!buffers[i].out) {
+      buffer = &buffers[i];
+      break;
+    }
+  }
+  if (!buffer) {
+    return nullptr;  // Все буферы у прошивки - драйвер ждал бы и выдал "Failed to get the frame"
+  }
+
+  camera_fb_t& fb = buffer->fb;
+  framesize_t frameSize = sensor.status.framesize;
+  if (!loadedFrames.empty()) {
+    const std::vector<uint8_t>& frame = loadedFrames[nextLoadedFrame];
+    nextLoadedFrame = (nextLoadedFrame + 1) % loadedFrames.size();
+    if (!reserveBuffer(*buffer, frame.size())) {
+      return nullptr;
+    }
+    memcpy(fb.buf, frame.data(), frame.size());
+    fb.len = frame.size();
+    if (!jpegDimensions(frame, fb.width, fb.height)) {
+      fb.width = FRAME_SIZES[frameSize].width;
+      fb.height = FRAME_SIZES[frameSize].height;
+    }
+  } else {
+    size_t len = syntheticSize(frameSize, sensor.status.quality, framesCaptured);
+    if (!reserveBuffer(*buffer, len)) {
+      return nullptr;
+    }
+    fb.width = FRAME_SIZES[frameSize].width;
+    fb.height = FRAME_SIZES[frameSize].height;
+    fillSynthetic(fb.buf, len, fb.width, fb.height, framesCaptured);
+    fb.len = len;
+  }
+  fb.format = PIXFORMAT_JPEG;
+  int64_t now = esp_timer_get_time();
+  fb.timestamp.tv_sec = now / 1000000;
+  fb.timestamp.tv_usec = now % 1000000;
+  lastCaptureTime = now;
+  buffer->out = true;
+  framesCaptured++;
+  return &fb;
+}
+
+void esp_camera_fb_return(camera_fb_t* fb) {
+  std::lock_guard<std::mutex> guard(cameraLock);
+  for (size_t i = 0; i < bufferCount; i++) {
+    if (&buffers[i].fb == fb) {
+      buffers[i].out = false;
+      return;
+    }
+  }
+}
+
+sensor_t* esp_camera_sensor_get() {
+  return initialized ? &sensor : nullptr;
+}
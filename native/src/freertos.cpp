@@ -0,0 +1,212 @@
+#include "Arduino.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include <pthread.h>
+#include <sched.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
+// Задача: поток и счётчик уведомлений. Потоки без задачи (main, потоки событий HAL)
+// получают её при первом обращении - xTaskGetCurrentTaskHandle() различает loop и фон
+struct NativeTask {
+  TaskFunction_t function;
+  void* parameters;
+  char name[16];
+  std::mutex lock;
+  std::condition_variable notified;
+  uint32_t notifyCount = 0;
+};
+
+struct NativeSemaphore {
+  std::timed_mutex mutex;           // Мьютекс (xSemaphoreCreateMutex)
+  bool binary = false;
+  std::mutex lock;                  // Двоичный семафор (xSemaphoreCreateBinary)
+  std::condition_variable given;
+  bool available = false;
+};
+
+static thread_local NativeTask* currentTask = nullptr;
+
+// Задачи потоков хоста - без malloc: xTaskGetCurrentTaskHandle() вызывается из обёртки
+// malloc в heap_counters, выделение памяти здесь ушло бы в рекурсию
+static const int MAX_ADOPTED_THREADS = 32;
+alignas(NativeTask) static unsigned char adoptedTasks[MAX_ADOPTED_THREADS][sizeof(NativeTask)];
+static int adoptedCount = 0;
+
+static NativeTask* selfTask() {
+  if (!currentTask) {
+    int slot = __atomic_fetch_add(&adoptedCount, 1, __ATOMIC_RELAXED);
+    if (slot >= MAX_ADOPTED_THREADS) {
+      abort();
+    }
+    currentTask = new (adoptedTasks[slot]) NativeTask();
+    currentTask->function = nullptr;
+    currentTask->parameters = nullptr;
+    strlcpy(currentTask->name, "native", sizeof(currentTask->name));
+  }
+  return currentTask;
+}
+
+static void* taskEntry(void* arg) {
+  NativeTask* task = (NativeTask*)arg;
+  currentTask = task;
+  pthread_setname_np(pthread_self(), task->name);
+  task->function(task->parameters);
+  // Задача FreeRTOS не может вернуться из функции - завершение без vTaskDelete
+  return nullptr;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                                   void* parameters, UBaseType_t priority, TaskHandle_t* handle,
+                                   BaseType_t coreId) {
+  NativeTask* task = new NativeTask();
+  task->function = function;
+  task->parameters = parameters;
+  strlcpy(task->name, name ? name : "task", sizeof(task->name));
+  pthread_t thread;
+  if (pthread_create(&thread, nullptr, taskEntry, task) != 0) {
+    delete task;
+    return pdFAIL;
+  }
+  pthread_detach(thread);
+  if (handle) {
+    *handle = task;
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stackDepth,
+                       void* parameters, UBaseType_t priority, TaskHandle_t* handle) {
+  return xTaskCreatePinnedToCore(function, name, stackDepth, parameters, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  // Удалить можно только себя: чужой поток POSIX безопасно не остановить
+  if (task == nullptr || task == currentTask) {
+    pthread_exit(nullptr);
+  }
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (ticks == 0) {
+    sched_yield();
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)millis();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return selfTask();
+}
+
+BaseType_t xPortGetCoreID() {
+  return 1;  // loop() на ESP32 - ядро 1
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  if (!task) {
+    return pdFAIL;
+  }
+  {
+    std::lock_guard<std::mutex> guard(task->lock);
+    task->notifyCount++;
+  }
+  task->notified.notify_one();
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  NativeTask* task = selfTask();
+  std::unique_lock<std::mutex> guard(task->lock);
+  auto ready = [task] { return task->notifyCount > 0; };
+  if (ticksToWait == portMAX_DELAY) {
+    task->notified.wait(guard, ready);
+  } else {
+    task->notified.wait_for(guard, std::chrono::milliseconds(ticksToWait), ready);
+  }
+  uint32_t count = task->notifyCount;
+  if (count > 0) {
+    task->notifyCount = clearCountOnExit ? 0 : count - 1;
+  }
+  return count;
+}
+
+void vPortEnterCritical(portMUX_TYPE* mux) {
+  while (__atomic_exchange_n(&mux->locked, 1, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+}
+
+void vPortExitCritical(portMUX_TYPE* mux) {
+  __atomic_store_n(&mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex() {
+  return new NativeSemaphore();
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() {
+  NativeSemaphore* semaphore = new NativeSemaphore();
+  semaphore->binary = true;
+  return semaphore;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+  if (!semaphore) {
+    return pdFALSE;
+  }
+  if (semaphore->binary) {
+    std::unique_lock<std::mutex> guard(semaphore->lock);
+    auto ready = [semaphore] { return semaphore->available; };
+    bool taken;
+    if (ticksToWait == portMAX_DELAY) {
+      semaphore->given.wait(guard, ready);
+      taken = true;
+    } else {
+      taken = semaphore->given.wait_for(guard, std::chrono::milliseconds(ticksToWait), ready);
+    }
+    if (taken) {
+      semaphore->available = false;
+    }
+    return taken ? pdTRUE : pdFALSE;
+  }
+  if (ticksToWait == portMAX_DELAY) {
+    semaphore->mutex.lock();
+    return pdTRUE;
+  }
+  if (ticksToWait == 0) {
+    return semaphore->mutex.try_lock() ? pdTRUE : pdFALSE;
+  }
+  return semaphore->mutex.try_lock_for(std::chrono::milliseconds(ticksToWait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  if (!semaphore) {
+    return pdFALSE;
+  }
+  if (semaphore->binary) {
+    {
+      std::lock_guard<std::mutex> guard(semaphore->lock);
+      if (semaphore->available) {
+        return pdFALSE;
+      }
+      semaphore->available = true;
+    }
+    semaphore->given.notify_one();
+    return pdTRUE;
+  }
+  semaphore->mutex.unlock();
+  return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+  delete semaphore;
+}
@@ -0,0 +1,359 @@
+#include "FS.h"
+#include "SD_MMC.h"
+#include "native_hal.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs {
+
+// Открытый файл или каталог; пути - как их видит прошивка ("/records/seg_0001.mjpg")
+struct FileImpl {
+  FILE* file = nullptr;
+  DIR* dir = nullptr;
+  char path[128] = "";      // Путь FS
+  char hostPath[288] = "";  // Путь хоста
+  char* buffer = nullptr;   // Буфер stdio (setBufferSize)
+
+  ~FileImpl() {
+    close();
+  }
+  void close() {
+    if (file) {
+      fclose(file);
+      file = nullptr;
+    }
+    if (dir) {
+      closedir(dir);
+      dir = nullptr;
+    }
+    free(buffer);
+    buffer = nullptr;
+  }
+};
+
+// ==================== File ====================
+
+size_t File::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t File::write(const uint8_t* buf, size_t size) {
+  if (!impl || !impl->file) {
+    return 0;
+  }
+  return fwrite(buf, 1, size, impl->file);
+}
+
+int File::available() {
+  if (!impl || !impl->file) {
+    return 0;
+  }
+  return size() - position();
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  if (!impl || !impl->file) {
+    return -1;
+  }
+  int c = fgetc(impl->file);
+  if (c != EOF) {
+    ungetc(c, impl->file);
+  }
+  return c == EOF ? -1 : c;
+}
+
+size_t File::read(uint8_t* buf, size_t size) {
+  if (!impl || !impl->file) {
+    return 0;
+  }
+  return fread(buf, 1, size, impl->file);
+}
+
+void File::flush() {
+  if (impl && impl->file) {
+    fflush(impl->file);
+  }
+}
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!impl || !impl->file) {
+    return false;
+  }
+  int whence = mode == SeekCur ? SEEK_CUR : (mode == SeekEnd ? SEEK_END : SEEK_SET);
+  return fseek(impl->file, mode == SeekEnd ? -(long)pos : (long)pos, whence) == 0;
+}
+
+size_t File::position() const {
+  if (!impl || !impl->file) {
+    return 0;
+  }
+  long pos = ftell(impl->file);
+  return pos < 0 ? 0 : pos;
+}
+
+size_t File::size() const {
+  if (!impl || !impl->file) {
+    return 0;
+  }
+  // Учитывает ещё не сброшенные данные буфера stdio
+  long current = ftell(impl->file);
+  fseek(impl->file, 0, SEEK_END);
+  long end = ftell(impl->file);
+  fseek(impl->file, current, SEEK_SET);
+  return end < 0 ? 0 : end;
+}
+
+bool File::setBufferSize(size_t size) {
+  if (!impl || !impl->file || impl->buffer) {
+    return false;
+  }
+  impl->buffer = (char*)malloc(size);
+  return impl->buffer && setvbuf(impl->file, impl->buffer, _IOFBF, size) == 0;
+}
+
+void File::close() {
+  if (impl) {
+    impl->close();
+    impl.reset();
+  }
+}
+
+File::operator bool() const {
+  return impl && (impl->file || impl->dir);
+}
+
+time_t File::getLastWrite() {
+  struct stat st;
+  if (!impl || stat(impl->hostPath, &st) != 0) {
+    return 0;
+  }
+  return st.st_mtime;
+}
+
+const char* File::path() const {
+  return impl ? impl->path : nullptr;
+}
+
+const char* File::name() const {
+  if (!impl) {
+    return nullptr;
+  }
+  // Ядро 2.x: имя без каталога
+  const char* slash = strrchr(impl->path, '/');
+  return slash ? slash + 1 : impl->path;
+}
+
+bool File::isDirectory() {
+  return impl && impl->dir;
+}
+
+File File::openNextFile(const char* mode) {
+  if (!impl || !impl->dir) {
+    return File();
+  }
+  struct dirent* entry;
+  while ((entry = readdir(impl->dir)) != nullptr) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    auto next = std::make_shared<FileImpl>();
+    int len = snprintf(next->path, sizeof(next->path), "%s%s%s", impl->path,
+                       impl->path[strlen(impl->path) - 1] == '/' ? "" : "/", entry->d_name);
+    int hostLen = snprintf(next->hostPath, sizeof(next->hostPath), "%s/%s", impl->hostPath, entry->d_name);
+    // Имя не помещается в путь карты - такой файл прошивка всё равно не открыла бы
+    if (len >= (int)sizeof(next->path) || hostLen >= (int)sizeof(next->hostPath)) {
+      continue;
+    }
+    struct stat st;
+    if (stat(next->hostPath, &st) != 0) {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      next->dir = opendir(next->hostPath);
+    } else {
+      next->file = fopen(next->hostPath, strcmp(mode, FILE_READ) == 0 ? "rb" : "r+b");
+    }
+    if (next->file || next->dir) {
+      return File(next);
+    }
+  }
+  return File();
+}
+
+void File::rewindDirectory() {
+  if (impl && impl->dir) {
+    rewinddir(impl->dir);
+  }
+}
+
+// ==================== FS ====================
+
+void FS::setRoot(const char* path) {
+  strlcpy(root, path ? path : "", sizeof(root));
+  mounted = root[0] != 0;
+}
+
+bool FS::hostPath(const char* path, char* out, size_t size) const {
+  if (!mounted || !path || path[0] != '/') {
+    return false;
+  }
+  // Выход за корень карты ("..") не допускается
+  if (strstr(path, "/..")) {
+    return false;
+  }
+  snprintf(out, size, "%s%s", root, strcmp(path, "/") == 0 ? "" : path);
+  return true;
+}
+
+File FS::open(const char* path, const char* mode, const bool create) {
+  auto impl = std::make_shared<FileImpl>();
+  if (!hostPath(path, impl->hostPath, sizeof(impl->hostPath))) {
+    return File();
+  }
+  strlcpy(impl->path, path, sizeof(impl->path));
+
+  struct stat st;
+  bool exists = stat(impl->hostPath, &st) == 0;
+  if (exists && S_ISDIR(st.st_mode)) {
+    impl->dir = opendir(impl->hostPath);
+    return impl->dir ? File(impl) : File();
+  }
+  if (!exists && strcmp(mode, FILE_READ) == 0) {
+    return File();  // Ядро печатает "does not exist" и возвращает пустой File
+  }
+  const char* hostMode = "rb";
+  if (strcmp(mode, FILE_WRITE) == 0) {
+    hostMode = "wb";
+  } else if (strcmp(mode, FILE_APPEND) == 0) {
+    hostMode = "ab";
+  } else if (strcmp(mode, "r+") == 0) {
+    hostMode = exists ? "r+b" : "w+b";
+  } else if (strcmp(mode, "w+") == 0) {
+    hostMode = "w+b";
+  } else if (strcmp(mode, "a+") == 0) {
+    hostMode = "a+b";
+  }
+  impl->file = fopen(impl->hostPath, hostMode);
+  return impl->file ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) {
+  char host[288];
+  struct stat st;
+  return hostPath(path, host, sizeof(host)) && stat(host, &st) == 0;
+}
+
+bool FS::remove(const char* path) {
+  char host[288];
+  return hostPath(path, host, sizeof(host)) && unlink(host) == 0;
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo) {
+  char from[288];
+  char to[288];
+  struct stat st;
+  // FAT не заменяет существующий файл при переименовании
+  if (!hostPath(pathFrom, from, sizeof(from)) || !hostPath(pathTo, to, sizeof(to)) || stat(to, &st) == 0) {
+    return false;
+  }
+  return ::rename(from, to) == 0;
+}
+
+bool FS::mkdir(const char* path) {
+  char host[288];
+  return hostPath(path, host, sizeof(host)) && (::mkdir(host, 0755) == 0 || errno == EEXIST);
+}
+
+bool FS::rmdir(const char* path) {
+  char host[288];
+  return hostPath(path, host, sizeof(host)) && ::rmdir(host) == 0;
+}
+
+// ==================== SD_MMC ====================
+
+static bool sdPresent = true;
+static uint64_t sdCapacity = 8ULL * 1024 * 1024 * 1024;
+
+bool SDMMCFS::setPins(int clk, int cmd, int d0) {
+  return true;
+}
+
+bool SDMMCFS::setPins(int clk, int cmd, int d0, int d1, int d2, int d3) {
+  return true;
+}
+
+bool SDMMCFS::begin(const char* mountpoint, bool mode1bit, bool formatIfMountFailed, int sdmmcFrequency,
+                    uint8_t maxOpenFiles) {
+  if (!sdPresent) {
+    return false;
+  }
+  char path[128];
+  setRoot(nativeDataPath("sdcard", path, sizeof(path)));
+  return true;
+}
+
+void SDMMCFS::end() {
+  setRoot("");
+}
+
+sdcard_type_t SDMMCFS::cardType() {
+  return mounted ? CARD_SDHC : CARD_NONE;
+}
+
+uint64_t SDMMCFS::cardSize() {
+  return mounted ? sdCapacity : 0;
+}
+
+uint64_t SDMMCFS::totalBytes() {
+  return mounted ? sdCapacity : 0;
+}
+
+static uint64_t directoryBytes(const char* hostPath) {
+  DIR* dir = opendir(hostPath);
+  if (!dir) {
+    return 0;
+  }
+  uint64_t total = 0;
+  struct dirent* entry;
+  char child[512];
+  while ((entry = readdir(dir)) != nullptr) {
+    if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+      continue;
+    }
+    snprintf(child, sizeof(child), "%s/%s", hostPath, entry->d_name);
+    struct stat st;
+    if (stat(child, &st) != 0) {
+      continue;
+    }
+    total += S_ISDIR(st.st_mode) ? directoryBytes(child) : (uint64_t)st.st_size;
+  }
+  closedir(dir);
+  return total;
+}
+
+uint64_t SDMMCFS::usedBytes() {
+  if (!mounted) {
+    return 0;
+  }
+  uint64_t used = directoryBytes(root);
+  return used < sdCapacity ? used : sdCapacity;
+}
+
+}  // namespace fs
+
+fs::SDMMCFS SD_MMC;
+
+void nativeSdSetPresent(bool present) {
+  fs::sdPresent = present;
+}
+
+void nativeSdSetCapacity(uint64_t bytes) {
+  fs::sdCapacity = bytes;
+}
@@ -0,0 +1,370 @@
+#include "HTTPClient.h"
+#include "WiFi.h"
+
+HTTPClient::HTTPClient() {
+}
+
+HTTPClient::~HTTPClient() {
+  client.stop();
+}
+
+bool HTTPClient::begin(String url) {
+  // Новый адрес - старое соединение к другому серверу не переиспользуется
+  String previousHost = host;
+  uint16_t previousPort = port;
+  requestHeaders = "";
+  returnCode = 0;
+  bodySize = -1;
+
+  if (!url.startsWith("http://")) {
+    return false;  // https:// не поддерживается сборкой native
+  }
+  url = url.substring(7);
+  int slash = url.indexOf('/');
+  String hostPort = slash >= 0 ? url.substring(0, slash) : url;
+  uri = slash >= 0 ? url.substring(slash) : String("/");
+  int colon = hostPort.indexOf(':');
+  if (colon >= 0) {
+    host = hostPort.substring(0, colon);
+    port = hostPort.substring(colon + 1).toInt();
+  } else {
+    host = hostPort;
+    port = 80;
+  }
+  if (host != previousHost || port != previousPort) {
+    client.stop();
+  }
+  return host.length() > 0 && port > 0;
+}
+
+bool HTTPClient::begin(const String& host, uint16_t port, const String& uri) {
+  return begin("http://" + host + ":" + String(port) + uri);
+}
+
+void HTTPClient::end() {
+  disconnect(false);
+}
+
+void HTTPClient::disconnect(bool preserveClient) {
+  // Тело ответа должно быть дочитано, иначе соединение нельзя переиспользовать
+  if (client.connected() && reuseConnection && canReuse && preserveClient) {
+    return;
+  }
+  client.stop();
+}
+
+bool HTTPClient::connected() {
+  return client.connected();
+}
+
+void HTTPClient::addHeader(const String& name, const String& value) {
+  // Заголовки, которые добавляет sendRequest()
+  if (name.equalsIgnoreCase("Connection") || name.equalsIgnoreCase("User-Agent") ||
+      name.equalsIgnoreCase("Host") || name.equalsIgnoreCase("Content-Length")) {
+    return;
+  }
+  requestHeaders += name;
+  requestHeaders += ": ";
+  requestHeaders += value;
+  requestHeaders += "\r\n";
+}
+
+void HTTPClient::collectHeaders(const char* headerKeys[], const size_t headerKeysCount) {
+  collectCount = headerKeysCount < MAX_COLLECT ? headerKeysCount : MAX_COLLECT;
+  for (size_t i = 0; i < collectCount; i++) {
+    collectKeys[i] = headerKeys[i];
+    collectValues[i] = "";
+  }
+}
+
+String HTTPClient::header(const char* name) {
+  for (size_t i = 0; i < collectCount; i++) {
+    if (collectKeys[i].equalsIgnoreCase(name)) {
+      return collectValues[i];
+    }
+  }
+  return String();
+}
+
+bool HTTPClient::hasHeader(const char* name) {
+  for (size_t i = 0; i < collectCount; i++) {
+    if (collectKeys[i].equalsIgnoreCase(name) && collectValues[i].length() > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int HTTPClient::GET() {
+  return sendRequest("GET");
+}
+
+int HTTPClient::POST(uint8_t* payload, size_t size) {
+  return sendRequest("POST", payload, size);
+}
+
+int HTTPClient::POST(const String& payload) {
+  return sendRequest("POST", (uint8_t*)payload.c_str(), payload.length());
+}
+
+int HTTPClient::PUT(uint8_t* payload, size_t size) {
+  return sendRequest("PUT", payload, size);
+}
+
+bool HTTPClient::connect() {
+  if (client.connected()) {
+    // Остаток прошлого ответа (keep-alive) - отбросить
+    while (client.available() > 0) {
+      client.read();
+    }
+    return true;
+  }
+  client.setTimeout(tcpTimeout);
+  if (!client.connect(host.c_str(), port, connectTimeout)) {
+    return false;
+  }
+  client.setNoDelay(true);
+  return true;
+}
+
+int HTTPClient::sendRequest(const char* type, uint8_t* payload, size_t size) {
+  for (size_t i = 0; i < collectCount; i++) {
+    collectValues[i] = "";
+  }
+  bodySize = -1;
+  chunked = false;
+  canReuse = false;
+
+  if (!connect()) {
+    return returnCode = HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+
+  String header = String(type) + " " + uri + " HTTP/1.1\r\nHost: " + host;
+  if (port != 80) {
+    header += ":";
+    header += String(port);
+  }
+  header += "\r\nUser-Agent: ";
+  header += userAgent;
+  header += "\r\nConnection: ";
+  header += reuseConnection ? "keep-alive" : "close";
+  header += "\r\n";
+  if (payload && size > 0) {
+    header += "Content-Length: ";
+    header += String((unsigned int)size);
+    header += "\r\n";
+  } else if (strcmp(type, "POST") == 0 || strcmp(type, "PUT") == 0) {
+    header += "Content-Length: 0\r\n";
+  }
+  header += requestHeaders;
+  header += "\r\n";
+
+  if (client.write((const uint8_t*)header.c_str(), header.length()) != header.length()) {
+    client.stop();
+    return returnCode = HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  if (payload && size > 0 && client.write(payload, size) != size) {
+    client.stop();
+    return returnCode = HTTPC_ERROR_SEND_PAYLOAD_FAILED;
+  }
+  return returnCode = handleHeaderResponse();
+}
+
+bool HTTPClient::readLine(String& line) {
+  line = "";
+  unsigned long start = millis();
+  while (millis() - start < tcpTimeout) {
+    int c = client.read();
+    if (c < 0) {
+      if (!client.connected()) {
+        return false;
+      }
+      delayMicroseconds(200);
+      continue;
+    }
+    if (c == '\n') {
+      if (line.endsWith("\r")) {
+        line.remove(line.length() - 1);
+      }
+      return true;
+    }
+    line += (char)c;
+  }
+  return false;
+}
+
+int HTTPClient::handleHeaderResponse() {
+  String line;
+  int code = 0;
+  bool keepAlive = reuseConnection;
+  while (true) {
+    if (!readLine(line)) {
+      client.stop();
+      return code ? HTTPC_ERROR_CONNECTION_LOST : HTTPC_ERROR_READ_TIMEOUT;
+    }
+    if (code == 0) {
+      // Строка статуса; 100 Continue пропускается
+      if (!line.startsWith("HTTP/1.")) {
+        client.stop();
+        return HTTPC_ERROR_NO_HTTP_SERVER;
+      }
+      code = line.substring(9, 12).toInt();
+      continue;
+    }
+    if (line.length() == 0) {
+      if (code == HTTP_CODE_CONTINUE) {
+        code = 0;
+        continue;
+      }
+      break;
+    }
+    int colon = line.indexOf(':');
+    if (colon <= 0) {
+      continue;
+    }
+    String name = line.substring(0, colon);
+    String value = line.substring(colon + 1);
+    value.trim();
+    if (name.equalsIgnoreCase("Content-Length")) {
+      bodySize = value.toInt();
+    } else if (name.equalsIgnoreCase("Transfer-Encoding")) {
+      chunked = value.equalsIgnoreCase("chunked");
+    } else if (name.equalsIgnoreCase("Connection")) {
+      keepAlive = keepAlive && !value.equalsIgnoreCase("close");
+    }
+    for (size_t i = 0; i < collectCount; i++) {
+      if (collectKeys[i].equalsIgnoreCase(name.c_str())) {
+        collectValues[i] = value;
+      }
+    }
+  }
+  if (code == HTTP_CODE_NO_CONTENT || code == HTTP_CODE_NOT_MODIFIED) {
+    bodySize = 0;
+  }
+  canReuse = keepAlive && (bodySize >= 0 || chunked);
+  return code;
+}
+
+int HTTPClient::writeToStream(Stream* stream) {
+  if (!stream) {
+    return HTTPC_ERROR_NO_STREAM;
+  }
+  if (!client.connected() && client.available() == 0) {
+    return HTTPC_ERROR_NOT_CONNECTED;
+  }
+
+  uint8_t buffer[1460];
+  int total = 0;
+  long remaining = bodySize;       // -1 - до закрытия соединения
+  String line;
+  while (true) {
+    if (chunked) {
+      if (remaining <= 0) {
+        if (remaining == 0 && total > 0 && !readLine(line)) {
+          break;  // CRLF после блока
+        }
+        if (!readLine(line)) {
+          return HTTPC_ERROR_READ_TIMEOUT;
+        }
+        remaining = strtol(line.c_str(), nullptr, 16);
+        if (remaining == 0) {
+          readLine(line);  // Завершающая пустая строка
+          break;
+        }
+      }
+    } else if (remaining == 0) {
+      break;
+    }
+
+    size_t want = sizeof(buffer);
+    if (remaining > 0 && (size_t)remaining < want) {
+      want = remaining;
+    }
+    int len = client.read(buffer, want);
+    if (len < 0) {
+      if (bodySize < 0 && !chunked) {
+        break;  // Тело до закрытия соединения
+      }
+      client.stop();
+      return HTTPC_ERROR_CONNECTION_LOST;
+    }
+    if (len == 0) {
+      unsigned long start = millis();
+      while (client.available() == 0 && client.connected() && millis() - start < tcpTimeout) {
+        delayMicroseconds(200);
+      }
+      if (client.available() == 0 && client.connected()) {
+        client.stop();
+        return HTTPC_ERROR_READ_TIMEOUT;
+      }
+      continue;
+    }
+    if (stream->write(buffer, len) != (size_t)len) {
+      client.stop();
+      return HTTPC_ERROR_STREAM_WRITE;
+    }
+    total += len;
+    if (remaining > 0) {
+      remaining -= len;
+    }
+  }
+  disconnect(true);
+  return total;
+}
+
+// Приёмник тела для getString()
+class StringStream : public Stream {
+ public:
+  String& target;
+  explicit StringStream(String& target) : target(target) {}
+  size_t write(uint8_t c) override {
+    return target.concat((char)c) ? 1 : 0;
+  }
+  size_t write(const uint8_t* data, size_t size) override {
+    return target.concat((const char*)data, size) ? size : 0;
+  }
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+};
+
+String HTTPClient::getString() {
+  String body;
+  if (bodySize > 0) {
+    body.reserve(bodySize);
+  }
+  if (bodySize != 0) {
+    StringStream stream(body);
+    writeToStream(&stream);
+  }
+  return body;
+}
+
+String HTTPClient::errorToString(int error) {
+  switch (error) {
+    case HTTPC_ERROR_CONNECTION_REFUSED:
+      return "connection refused";
+    case HTTPC_ERROR_SEND_HEADER_FAILED:
+      return "send header failed";
+    case HTTPC_ERROR_SEND_PAYLOAD_FAILED:
+      return "send payload failed";
+    case HTTPC_ERROR_NOT_CONNECTED:
+      return "not connected";
+    case HTTPC_ERROR_CONNECTION_LOST:
+      return "connection lost";
+    case HTTPC_ERROR_NO_STREAM:
+      return "no stream";
+    case HTTPC_ERROR_NO_HTTP_SERVER:
+      return "no HTTP server";
+    case HTTPC_ERROR_TOO_LESS_RAM:
+      return "too less ram";
+    case HTTPC_ERROR_ENCODING:
+      return "Transfer-Encoding not supported";
+    case HTTPC_ERROR_STREAM_WRITE:
+      return "Stream write error";
+    case HTTPC_ERROR_READ_TIMEOUT:
+      return "read Timeout";
+    default:
+      return String();
+  }
+}
@@ -0,0 +1,23 @@
+#include "native_hal.h"
+#include "Arduino.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+static char dataDir[128] = ".native";
+
+void nativeSetDataDir(const char* path) {
+  strlcpy(dataDir, path && *path ? path : ".native", sizeof(dataDir));
+}
+
+const char* nativeDataDir() {
+  mkdir(dataDir, 0755);
+  return dataDir;
+}
+
+const char* nativeDataPath(const char* name, char* buf, size_t size) {
+  snprintf(buf, size, "%s/%s", nativeDataDir(), name);
+  if (mkdir(buf, 0755) != 0 && errno != EEXIST) {
+    Serial.printf("[native] Cannot create %s: %s\n", buf, strerror(errno));
+  }
+  return buf;
+}
@@ -0,0 +1,109 @@
+/*
+ * Точка входа сборки native: разбор параметров хоста, затем setup() и loop() прошивки.
+ *
+ * Использование:
+ *   .pio/build/native/program --data /tmp/cam1 --ssid lab --server 127.0.0.1 --frames frames/hd
+ *
+ * Параметры:
+ *   --data DIR         каталог NVS и SD карты (по умолчанию .native)
+ *   --ssid NAME        сохранить сеть в NVS (как по Bluetooth), --password PASS - её пароль
+ *   --server HOST      сохранить адрес сервера в NVS
+ *   --frames DIR       JPEG кадры камеры (по умолчанию синтетические)
+ *   --fps N            частота кадров сенсора (0 - без ограничения)
+ *   --sndbuf BYTES     SO_SNDBUF сокетов (5744 - как TCP_SND_BUF lwIP)
+ *   --port-offset N    сдвиг портов WiFiServer (по умолчанию 8000: PLAYBACK_PORT 80 -> 8080)
+ *   --no-sd            без SD карты
+ *   --bt LINE          строка, "принятая" по Bluetooth (можно повторять)
+ *   --duration SEC     завершить работу через SEC секунд (код 0)
+ *
+ * Возвращает: 0 - истекло --duration, 2 - ошибка параметров, 3 - ESP.restart()
+ *
+ * В тестах (pio test -e native) main() - у каждого теста в test/, этот файл пропускается.
+ */
+
+#ifndef PIO_UNIT_TESTING
+
+#include <Arduino.h>
+#include <string.h>
+#include "native_hal.h"
+#include "wifi_settings.h"
+
+void setup();
+void loop();
+
+static void usage(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [--data DIR] [--ssid NAME [--password PASS]] [--server HOST] [--frames DIR]\n"
+          "          [--fps N] [--sndbuf BYTES] [--port-offset N] [--no-sd] [--bt LINE]... [--duration SEC]\n",
+          program);
+}
+
+int main(int argc, char** argv) {
+  const char* ssid = nullptr;
+  const char* password = "";
+  const char* server = nullptr;
+  const char* frames = nullptr;
+  unsigned long durationMs = 0;
+  nativeNetSetPortOffset(8000);
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (strcmp(arg, "--no-sd") == 0) {
+      nativeSdSetPresent(false);
+    } else if (!hasValue) {
+      usage(argv[0]);
+      return 2;
+    } else if (strcmp(arg, "--data") == 0) {
+      nativeSetDataDir(argv[++i]);
+    } else if (strcmp(arg, "--ssid") == 0) {
+      ssid = argv[++i];
+    } else if (strcmp(arg, "--password") == 0) {
+      password = argv[++i];
+    } else if (strcmp(arg, "--server") == 0) {
+      server = argv[++i];
+    } else if (strcmp(arg, "--frames") == 0) {
+      frames = argv[++i];
+    } else if (strcmp(arg, "--fps") == 0) {
+      nativeCameraSetFrameRate(atoi(argv[++i]));
+    } else if (strcmp(arg, "--sndbuf") == 0) {
+      nativeNetSetSendBuffer(atoi(argv[++i]));
+    } else if (strcmp(arg, "--port-offset") == 0) {
+      nativeNetSetPortOffset(atoi(argv[++i]));
+    } else if (strcmp(arg, "--bt") == 0) {
+      nativeBluetoothInject(argv[++i]);
+    } else if (strcmp(arg, "--duration") == 0) {
+      durationMs = strtoul(argv[++i], nullptr, 10) * 1000;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (frames && !nativeCameraLoadFrames(frames)) {
+    fprintf(stderr, "No JPEG frames in %s\n", frames);
+    return 2;
+  }
+
+  // Учётные данные - через модуль прошивки, как их сохраняет Bluetooth
+  if (ssid || server) {
+    initWiFiSettings();
+    if (ssid) {
+      saveWiFiCredentials(ssid, password);
+    }
+    if (server) {
+      saveServerHost(server);
+    }
+  }
+
+  setup();
+  while (durationMs == 0 || millis() < durationMs) {
+    loop();
+    // loopTask на ESP32 отдаёт процессор сторожевому таймеру между итерациями
+    yield();
+  }
+  fflush(stdout);
+  return 0;
+}
+
+#endif // PIO_UNIT_TESTING
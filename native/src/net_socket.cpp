@@ -0,0 +1,363 @@
+#include "WiFi.h"
+#include "native_hal.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define WIFI_CLIENT_DEF_CONN_TIMEOUT_MS 3000
+
+static int sendBufferBytes = 0;
+static int portOffset = 0;
+
+void nativeNetSetSendBuffer(int bytes) {
+  sendBufferBytes = bytes;
+}
+
+void nativeNetSetPortOffset(int offset) {
+  portOffset = offset;
+}
+
+int nativeNetPortOffset() {
+  return portOffset;
+}
+
+// Сокет всегда неблокирующий: таймауты - через poll()
+struct NativeSocket {
+  int fd;
+  int peeked = -1;          // Байт, прочитанный peek()
+
+  explicit NativeSocket(int fd) : fd(fd) {}
+  ~NativeSocket() {
+    close();
+  }
+  void close() {
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+};
+
+static void setNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Ждать готовности сокета; false - таймаут или ошибка
+static bool waitSocket(int fd, short events, int timeoutMs) {
+  struct pollfd pfd = {fd, events, 0};
+  int res;
+  do {
+    res = poll(&pfd, 1, timeoutMs);
+  } while (res < 0 && errno == EINTR);
+  return res > 0;
+}
+
+WiFiClient::WiFiClient() {
+  timeout = WIFI_CLIENT_DEF_CONN_TIMEOUT_MS;
+}
+
+WiFiClient::WiFiClient(int fd) : WiFiClient() {
+  setNonBlocking(fd);
+  socket = std::make_shared<NativeSocket>(fd);
+}
+
+WiFiClient::~WiFiClient() {
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip, port, timeout);
+}
+
+int WiFiClient::connect(IPAddress ip, uint16_t port, int32_t timeoutMs) {
+  stop();
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return 0;
+  }
+  if (sendBufferBytes > 0) {
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sendBufferBytes, sizeof(sendBufferBytes));
+  }
+  setNonBlocking(fd);
+
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  int res = ::connect(fd, (struct sockaddr*)&addr, sizeof(addr));
+  if (res < 0 && errno != EINPROGRESS) {
+    ::close(fd);
+    return 0;
+  }
+  if (res < 0) {
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (!waitSocket(fd, POLLOUT, timeoutMs) || getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error) {
+      ::close(fd);
+      return 0;
+    }
+  }
+  socket = std::make_shared<NativeSocket>(fd);
+  return 1;
+}
+
+int WiFiClient::connect(const char* host, uint16_t port) {
+  return connect(host, port, timeout);
+}
+
+int WiFiClient::connect(const char* host, uint16_t port, int32_t timeoutMs) {
+  IPAddress ip;
+  if (!WiFi.hostByName(host, ip)) {
+    return 0;
+  }
+  return connect(ip, port, timeoutMs);
+}
+
+size_t WiFiClient::write(uint8_t data) {
+  return write(&data, 1);
+}
+
+size_t WiFiClient::write(const uint8_t* buf, size_t size) {
+  if (!socket || socket->fd < 0) {
+    return 0;
+  }
+  size_t sent = 0;
+  while (sent < size) {
+    ssize_t res = send(socket->fd, buf + sent, size - sent, MSG_NOSIGNAL);
+    if (res > 0) {
+      sent += res;
+      continue;
+    }
+    if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+      // Буфер отправки полон: ждём подтверждений, как lwIP
+      if (waitSocket(socket->fd, POLLOUT, timeout)) {
+        continue;
+      }
+    }
+    stop();
+    break;
+  }
+  return sent;
+}
+
+int WiFiClient::available() {
+  if (!socket || socket->fd < 0) {
+    return 0;
+  }
+  int count = 0;
+  if (ioctl(socket->fd, FIONREAD, &count) < 0) {
+    count = 0;
+  }
+  return count + (socket->peeked >= 0 ? 1 : 0);
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t* buf, size_t size) {
+  if (!socket || socket->fd < 0) {
+    return -1;
+  }
+  if (size == 0) {
+    return 0;
+  }
+  size_t count = 0;
+  if (socket->peeked >= 0) {
+    buf[count++] = (uint8_t)socket->peeked;
+    socket->peeked = -1;
+    if (count == size) {
+      return count;
+    }
+  }
+  ssize_t res = recv(socket->fd, buf + count, size - count, MSG_DONTWAIT);
+  if (res > 0) {
+    return count + res;
+  }
+  if (res == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+    // Соединение закрыто: данные до закрытия уже прочитаны
+    return count > 0 ? (int)count : -1;
+  }
+  return count;
+}
+
+int WiFiClient::peek() {
+  if (!socket || socket->fd < 0) {
+    return -1;
+  }
+  if (socket->peeked < 0) {
+    uint8_t c;
+    if (recv(socket->fd, &c, 1, MSG_DONTWAIT) == 1) {
+      socket->peeked = c;
+    }
+  }
+  return socket->peeked;
+}
+
+void WiFiClient::flush() {
+}
+
+void WiFiClient::stop() {
+  if (socket) {
+    socket->close();
+    socket.reset();
+  }
+}
+
+uint8_t WiFiClient::connected() {
+  if (!socket || socket->fd < 0) {
+    return 0;
+  }
+  if (socket->peeked >= 0) {
+    return 1;
+  }
+  uint8_t c;
+  ssize_t res = recv(socket->fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (res > 0) {
+    return 1;
+  }
+  if (res == 0) {
+    return 0;  // Сервер закрыл соединение
+  }
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+int WiFiClient::fd() const {
+  return socket ? socket->fd : -1;
+}
+
+int WiFiClient::setNoDelay(bool nodelay) {
+  int flag = nodelay;
+  return setOption(TCP_NODELAY, &flag);
+}
+
+bool WiFiClient::getNoDelay() {
+  int flag = 0;
+  socklen_t len = sizeof(flag);
+  if (fd() < 0 || getsockopt(fd(), IPPROTO_TCP, TCP_NODELAY, &flag, &len) < 0) {
+    return false;
+  }
+  return flag;
+}
+
+int WiFiClient::setSocketOption(int option, char* value, size_t len) {
+  return fd() < 0 ? -1 : setsockopt(fd(), SOL_SOCKET, option, value, len);
+}
+
+int WiFiClient::setOption(int option, int* value) {
+  return fd() < 0 ? -1 : setsockopt(fd(), IPPROTO_TCP, option, value, sizeof(int));
+}
+
+void WiFiClient::setTimeout(uint32_t timeoutMs) {
+  Stream::setTimeout(timeoutMs);
+}
+
+static bool socketAddress(int fd, bool peer, struct sockaddr_in& addr) {
+  socklen_t len = sizeof(addr);
+  if (fd < 0) {
+    return false;
+  }
+  int res = peer ? getpeername(fd, (struct sockaddr*)&addr, &len) : getsockname(fd, (struct sockaddr*)&addr, &len);
+  return res == 0 && addr.sin_family == AF_INET;
+}
+
+IPAddress WiFiClient::remoteIP() const {
+  struct sockaddr_in addr;
+  return socketAddress(fd(), true, addr) ? IPAddress((uint32_t)addr.sin_addr.s_addr) : IPAddress();
+}
+
+uint16_t WiFiClient::remotePort() const {
+  struct sockaddr_in addr;
+  return socketAddress(fd(), true, addr) ? ntohs(addr.sin_port) : 0;
+}
+
+IPAddress WiFiClient::localIP() const {
+  struct sockaddr_in addr;
+  return socketAddress(fd(), false, addr) ? IPAddress((uint32_t)addr.sin_addr.s_addr) : IPAddress();
+}
+
+uint16_t WiFiClient::localPort() const {
+  struct sockaddr_in addr;
+  return socketAddress(fd(), false, addr) ? ntohs(addr.sin_port) : 0;
+}
+
+// ==================== WiFiServer ====================
+
+WiFiServer::WiFiServer(uint16_t port, uint8_t maxClients) : port(port), maxClients(maxClients) {
+}
+
+WiFiServer::~WiFiServer() {
+  end();
+}
+
+void WiFiServer::begin(uint16_t port) {
+  if (listenFd >= 0) {
+    return;
+  }
+  if (port) {
+    this->port = port;
+  }
+  int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return;
+  }
+  int enable = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(this->port + portOffset);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, maxClients) < 0) {
+    Serial.printf("[native] WiFiServer: port %d unavailable: %s\n", this->port + portOffset, strerror(errno));
+    ::close(fd);
+    return;
+  }
+  setNonBlocking(fd);
+  listenFd = fd;
+}
+
+void WiFiServer::end() {
+  if (pendingFd >= 0) {
+    ::close(pendingFd);
+    pendingFd = -1;
+  }
+  if (listenFd >= 0) {
+    ::close(listenFd);
+    listenFd = -1;
+  }
+}
+
+bool WiFiServer::hasClient() {
+  if (pendingFd >= 0) {
+    return true;
+  }
+  if (listenFd < 0) {
+    return false;
+  }
+  pendingFd = ::accept(listenFd, nullptr, nullptr);
+  return pendingFd >= 0;
+}
+
+WiFiClient WiFiServer::accept() {
+  if (!hasClient()) {
+    return WiFiClient();
+  }
+  WiFiClient client(pendingFd);
+  pendingFd = -1;
+  if (noDelay) {
+    client.setNoDelay(true);
+  }
+  return client;
+}
+
+void WiFiServer::setNoDelay(bool nodelay) {
+  noDelay = nodelay;
+}
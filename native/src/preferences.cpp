@@ -0,0 +1,298 @@
+#include "Preferences.h"
+#include "native_hal.h"
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Типы значений (первый байт файла ключа)
+enum : uint8_t {
+  PT_I8 = 1, PT_U8, PT_I16, PT_U16, PT_I32, PT_U32, PT_I64, PT_U64, PT_FLOAT, PT_BOOL, PT_STR, PT_BLOB
+};
+
+// Ограничение NVS: имена до 15 символов
+static const size_t NVS_KEY_NAME_MAX = 15;
+
+static bool validName(const char* name) {
+  return name && name[0] && strlen(name) <= NVS_KEY_NAME_MAX;
+}
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partitionLabel) {
+  if (path[0] || !validName(name)) {
+    return false;
+  }
+  char nvs[128];
+  if (!nativeDataPath("nvs", nvs, sizeof(nvs))) {
+    return false;
+  }
+  snprintf(path, sizeof(path), "%s/%s", nvs, name);
+  if (::mkdir(path, 0755) < 0 && errno != EEXIST) {
+    path[0] = 0;
+    return false;
+  }
+  this->readOnly = readOnly;
+  return true;
+}
+
+void Preferences::end() {
+  path[0] = 0;
+}
+
+static bool keyPath(const char* dir, const char* key, char* out, size_t size) {
+  if (!dir[0] || !validName(key)) {
+    return false;
+  }
+  snprintf(out, size, "%s/%s", dir, key);
+  return true;
+}
+
+bool Preferences::clear() {
+  if (!path[0] || readOnly) {
+    return false;
+  }
+  DIR* dir = opendir(path);
+  if (!dir) {
+    return false;
+  }
+  struct dirent* entry;
+  char file[192];
+  while ((entry = readdir(dir)) != nullptr) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+    // Файлы ключей - не длиннее NVS ключа; чужой длинный файл пропускаем
+    if (snprintf(file, sizeof(file), "%s/%s", path, entry->d_name) < (int)sizeof(file)) {
+      unlink(file);
+    }
+  }
+  closedir(dir);
+  return true;
+}
+
+bool Preferences::remove(const char* key) {
+  char file[192];
+  if (readOnly || !keyPath(path, key, file, sizeof(file))) {
+    return false;
+  }
+  return unlink(file) == 0;
+}
+
+bool Preferences::isKey(const char* key) {
+  char file[192];
+  struct stat st;
+  return keyPath(path, key, file, sizeof(file)) && stat(file, &st) == 0;
+}
+
+size_t Preferences::putValue(const char* key, uint8_t type, const void* value, size_t len) {
+  char file[192];
+  if (readOnly || !keyPath(path, key, file, sizeof(file))) {
+    return 0;
+  }
+  // Запись через временный файл: обрыв процесса не оставляет полузаписанный ключ
+  char temp[200];
+  snprintf(temp, sizeof(temp), "%s.tmp", file);
+  FILE* f = fopen(temp, "wb");
+  if (!f) {
+    return 0;
+  }
+  bool ok = fwrite(&type, 1, 1, f) == 1 && (len == 0 || fwrite(value, 1, len, f) == len);
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || ::rename(temp, file) != 0) {
+    unlink(temp);
+    return 0;
+  }
+  return len;
+}
+
+long Preferences::valueSize(const char* key, uint8_t type) {
+  char file[192];
+  if (!keyPath(path, key, file, sizeof(file))) {
+    return -1;
+  }
+  FILE* f = fopen(file, "rb");
+  if (!f) {
+    return -1;
+  }
+  uint8_t stored = 0;
+  long size = -1;
+  if (fread(&stored, 1, 1, f) == 1 && stored == type && fseek(f, 0, SEEK_END) == 0) {
+    size = ftell(f) - 1;
+  }
+  fclose(f);
+  return size;
+}
+
+bool Preferences::getValue(const char* key, uint8_t type, void* value, size_t len) {
+  if (valueSize(key, type) != (long)len) {
+    return false;
+  }
+  char file[192];
+  keyPath(path, key, file, sizeof(file));
+  FILE* f = fopen(file, "rb");
+  if (!f) {
+    return false;
+  }
+  bool ok = fseek(f, 1, SEEK_SET) == 0 && (len == 0 || fread(value, 1, len, f) == len);
+  fclose(f);
+  return ok;
+}
+
+size_t Preferences::putChar(const char* key, int8_t value) {
+  return putValue(key, PT_I8, &value, sizeof(value));
+}
+
+size_t Preferences::putUChar(const char* key, uint8_t value) {
+  return putValue(key, PT_U8, &value, sizeof(value));
+}
+
+size_t Preferences::putShort(const char* key, int16_t value) {
+  return putValue(key, PT_I16, &value, sizeof(value));
+}
+
+size_t Preferences::putUShort(const char* key, uint16_t value) {
+  return putValue(key, PT_U16, &value, sizeof(value));
+}
+
+size_t Preferences::putInt(const char* key, int32_t value) {
+  return putValue(key, PT_I32, &value, sizeof(value));
+}
+
+size_t Preferences::putUInt(const char* key, uint32_t value) {
+  return putValue(key, PT_U32, &value, sizeof(value));
+}
+
+size_t Preferences::putLong(const char* key, int32_t value) {
+  return putInt(key, value);
+}
+
+size_t Preferences::putULong(const char* key, uint32_t value) {
+  return putUInt(key, value);
+}
+
+size_t Preferences::putLong64(const char* key, int64_t value) {
+  return putValue(key, PT_I64, &value, sizeof(value));
+}
+
+size_t Preferences::putULong64(const char* key, uint64_t value) {
+  return putValue(key, PT_U64, &value, sizeof(value));
+}
+
+size_t Preferences::putFloat(const char* key, float value) {
+  return putValue(key, PT_FLOAT, &value, sizeof(value));
+}
+
+size_t Preferences::putBool(const char* key, bool value) {
+  uint8_t stored = value ? 1 : 0;
+  return putValue(key, PT_BOOL, &stored, sizeof(stored));
+}
+
+size_t Preferences::putString(const char* key, const char* value) {
+  if (!value) {
+    return 0;
+  }
+  // Как в ядре: возвращается длина строки без нуля
+  return putValue(key, PT_STR, value, strlen(value));
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+  if (!value && len > 0) {
+    return 0;
+  }
+  return putValue(key, PT_BLOB, value, len);
+}
+
+#define NATIVE_PREF_GET(type, tag)                        \
+  type value;                                             \
+  return getValue(key, tag, &value, sizeof(value)) ? value : defaultValue
+
+int8_t Preferences::getChar(const char* key, int8_t defaultValue) {
+  NATIVE_PREF_GET(int8_t, PT_I8);
+}
+
+uint8_t Preferences::getUChar(const char* key, uint8_t defaultValue) {
+  NATIVE_PREF_GET(uint8_t, PT_U8);
+}
+
+int16_t Preferences::getShort(const char* key, int16_t defaultValue) {
+  NATIVE_PREF_GET(int16_t, PT_I16);
+}
+
+uint16_t Preferences::getUShort(const char* key, uint16_t defaultValue) {
+  NATIVE_PREF_GET(uint16_t, PT_U16);
+}
+
+int32_t Preferences::getInt(const char* key, int32_t defaultValue) {
+  NATIVE_PREF_GET(int32_t, PT_I32);
+}
+
+uint32_t Preferences::getUInt(const char* key, uint32_t defaultValue) {
+  NATIVE_PREF_GET(uint32_t, PT_U32);
+}
+
+int32_t Preferences::getLong(const char* key, int32_t defaultValue) {
+  return getInt(key, defaultValue);
+}
+
+uint32_t Preferences::getULong(const char* key, uint32_t defaultValue) {
+  return getUInt(key, defaultValue);
+}
+
+int64_t Preferences::getLong64(const char* key, int64_t defaultValue) {
+  NATIVE_PREF_GET(int64_t, PT_I64);
+}
+
+uint64_t Preferences::getULong64(const char* key, uint64_t defaultValue) {
+  NATIVE_PREF_GET(uint64_t, PT_U64);
+}
+
+float Preferences::getFloat(const char* key, float defaultValue) {
+  NATIVE_PREF_GET(float, PT_FLOAT);
+}
+
+bool Preferences::getBool(const char* key, bool defaultValue) {
+  uint8_t value;
+  return getValue(key, PT_BOOL, &value, sizeof(value)) ? value != 0 : defaultValue;
+}
+
+size_t Preferences::getString(const char* key, char* value, size_t maxLen) {
+  long len = valueSize(key, PT_STR);
+  if (len < 0 || !value || (size_t)len + 1 > maxLen) {
+    return 0;
+  }
+  if (!getValue(key, PT_STR, value, len)) {
+    return 0;
+  }
+  value[len] = 0;
+  return len + 1;
+}
+
+String Preferences::getString(const char* key, String defaultValue) {
+  long len = valueSize(key, PT_STR);
+  if (len < 0) {
+    return defaultValue;
+  }
+  char* buffer = (char*)malloc(len + 1);
+  if (!buffer) {
+    return defaultValue;
+  }
+  String result = defaultValue;
+  if (getValue(key, PT_STR, buffer, len)) {
+    buffer[len] = 0;
+    result = buffer;
+  }
+  free(buffer);
+  return result;
+}
+
+size_t Preferences::getBytesLength(const char* key) {
+  long len = valueSize(key, PT_BLOB);
+  return len < 0 ? 0 : len;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+  long len = valueSize(key, PT_BLOB);
+  if (len <= 0 || !buf || (size_t)len > maxLen) {
+    return 0;
+  }
+  return getValue(key, PT_BLOB, buf, len) ? len : 0;
+}
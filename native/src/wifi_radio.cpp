@@ -0,0 +1,456 @@
+#include "WiFi.h"
+#include "native_hal.h"
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+WiFiClass WiFi;
+
+// Точка доступа по умолчанию: подключение "вслепую" и begin() без BSSID
+static const uint8_t DEFAULT_BSSID[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static const uint8_t DEFAULT_CHANNEL = 1;
+static const uint8_t DEVICE_MAC[6] = {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01};
+static const unsigned long SCAN_DURATION_MS = 120;
+static const unsigned long GOT_IP_DELAY_MS = 5;
+
+struct AccessPoint {
+  std::string ssid;
+  uint8_t bssid[6];
+  uint8_t channel;
+  int8_t rssi;
+};
+
+struct EventCallback {
+  wifi_event_id_t id;
+  WiFiEventFuncCb callback;
+  arduino_event_id_t filter;
+};
+
+struct PendingEvent {
+  unsigned long due;
+  uint32_t generation;      // Событие попытки, отменённой новым begin()/disconnect(), не доставляется...
+  bool always;              // ...кроме отключения уже идущей попытки/связи
+  arduino_event_id_t id;
+  arduino_event_info_t info;
+};
+
+// Всё состояние радио - под одним мьютексом (вызовы из loop и поток событий).
+// Объекты не разрушаются при выходе: поток событий ждёт на radioWake до конца процесса
+static std::mutex& radioLock = *new std::mutex();
+static std::condition_variable& radioWake = *new std::condition_variable();
+static bool eventThreadStarted = false;
+static std::vector<EventCallback>& callbacks = *new std::vector<EventCallback>();
+static std::vector<PendingEvent>& pending = *new std::vector<PendingEvent>();
+static wifi_event_id_t nextCallbackId = 1;
+
+static wifi_mode_t wifiMode = WIFI_OFF;
+static uint32_t attemptGeneration = 0;
+static bool associated = false;
+static bool gotIp = false;
+static std::string currentSsid;
+static uint8_t currentBssid[6];
+static uint8_t currentChannel = 0;
+static int8_t currentRssi = -50;
+static uint32_t joinDelayMs = 20;
+static IPAddress staticIp, staticGateway, staticSubnet, staticDns;
+
+static std::vector<AccessPoint> networks;
+static std::vector<AccessPoint> scanResults;
+static bool scanRunning = false;
+static bool scanDone = false;
+static unsigned long scanEnd = 0;
+
+static void eventLoop() {
+  std::unique_lock<std::mutex> guard(radioLock);
+  while (true) {
+    if (pending.empty()) {
+      radioWake.wait(guard);
+      continue;
+    }
+    auto next = std::min_element(pending.begin(), pending.end(),
+                                 [](const PendingEvent& a, const PendingEvent& b) { return a.due < b.due; });
+    unsigned long now = millis();
+    if ((long)(next->due - now) > 0) {
+      radioWake.wait_for(guard, std::chrono::milliseconds(next->due - now));
+      continue;
+    }
+    PendingEvent event = *next;
+    pending.erase(next);
+    if (event.generation != attemptGeneration && !event.always) {
+      continue;
+    }
+    // Состояние меняется в момент доставки - как у драйвера перед вызовом обработчиков
+    if (event.id == ARDUINO_EVENT_WIFI_STA_CONNECTED) {
+      associated = true;
+    } else if (event.id == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+      if (!associated) {
+        continue;
+      }
+      gotIp = true;
+    }
+    std::vector<EventCallback> targets = callbacks;
+    guard.unlock();
+    for (const EventCallback& target : targets) {
+      if (target.filter == ARDUINO_EVENT_MAX || target.filter == event.id) {
+        target.callback(event.id, event.info);
+      }
+    }
+    guard.lock();
+  }
+}
+
+// Вызывать под radioLock
+static void postEvent(arduino_event_id_t id, const arduino_event_info_t& info, unsigned long delayMs,
+                      bool always = false) {
+  if (!eventThreadStarted) {
+    std::thread(eventLoop).detach();
+    eventThreadStarted = true;
+  }
+  pending.push_back({millis() + delayMs, attemptGeneration, always, id, info});
+  radioWake.notify_all();
+}
+
+static void postDisconnected(uint8_t reason) {
+  arduino_event_info_t info = {};
+  size_t len = currentSsid.size() < 32 ? currentSsid.size() : 32;
+  memcpy(info.wifi_sta_disconnected.ssid, currentSsid.data(), len);
+  info.wifi_sta_disconnected.ssid_len = len;
+  memcpy(info.wifi_sta_disconnected.bssid, currentBssid, 6);
+  info.wifi_sta_disconnected.reason = reason;
+  info.wifi_sta_disconnected.rssi = currentRssi;
+  postEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, info, 0, true);
+}
+
+// Вызывать под radioLock: прервать попытку/подключение (события старой попытки отменяются)
+static void dropAssociation(uint8_t reason) {
+  bool wasActive = associated || !currentSsid.empty();
+  attemptGeneration++;
+  associated = false;
+  gotIp = false;
+  if (wasActive) {
+    postDisconnected(reason);
+  }
+  currentSsid.clear();
+}
+
+void nativeWiFiSetNetworks(const NativeAccessPoint* list, size_t count) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  networks.clear();
+  for (size_t i = 0; i < count; i++) {
+    AccessPoint ap;
+    ap.ssid = list[i].ssid ? list[i].ssid : "";
+    memcpy(ap.bssid, list[i].bssid, 6);
+    ap.channel = list[i].channel;
+    ap.rssi = list[i].rssi;
+    networks.push_back(ap);
+  }
+}
+
+void nativeWiFiSetRSSI(int8_t rssi) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  currentRssi = rssi;
+}
+
+void nativeWiFiSetJoinDelay(uint32_t ms) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  joinDelayMs = ms;
+}
+
+void nativeWiFiDropLink(uint8_t reason) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  if (associated) {
+    dropAssociation(reason);
+  }
+}
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  if (mode == WIFI_OFF) {
+    dropAssociation(WIFI_REASON_ASSOC_LEAVE);
+    scanRunning = false;
+    scanDone = false;
+  }
+  wifiMode = mode;
+  return true;
+}
+
+wifi_mode_t WiFiClass::getMode() {
+  return wifiMode;
+}
+
+bool WiFiClass::setSleep(bool enabled) {
+  return true;
+}
+
+bool WiFiClass::setAutoReconnect(bool autoReconnect) {
+  return true;  // Драйвер сам не переподключается (как при false)
+}
+
+bool WiFiClass::setTxPower(wifi_power_t power) {
+  return true;
+}
+
+wl_status_t WiFiClass::begin(const char* ssid, const char* passphrase, int32_t channel, const uint8_t* bssid,
+                             bool connect) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  if (wifiMode == WIFI_OFF) {
+    wifiMode = WIFI_STA;
+  }
+  if (associated) {
+    dropAssociation(WIFI_REASON_ASSOC_LEAVE);
+  }
+  attemptGeneration++;
+  gotIp = false;
+  currentSsid = ssid ? ssid : "";
+  if (!connect) {
+    return WL_DISCONNECTED;
+  }
+
+  // Точка доступа: заданная, иначе лучшая с этим SSID в эфире, иначе точка по умолчанию.
+  // Эфир задан, а точки нет - NO_AP_FOUND, как у драйвера
+  const AccessPoint* target = nullptr;
+  for (const AccessPoint& ap : networks) {
+    if (ap.ssid != currentSsid || (bssid && memcmp(ap.bssid, bssid, 6) != 0)) {
+      continue;
+    }
+    if (!target || ap.rssi > target->rssi) {
+      target = &ap;
+    }
+  }
+  if (target) {
+    memcpy(currentBssid, target->bssid, 6);
+    currentChannel = target->channel;
+    currentRssi = target->rssi;
+  } else if (!networks.empty()) {
+    memcpy(currentBssid, bssid ? bssid : DEFAULT_BSSID, 6);
+    arduino_event_info_t info = {};
+    info.wifi_sta_disconnected.reason = WIFI_REASON_NO_AP_FOUND;
+    memcpy(info.wifi_sta_disconnected.bssid, currentBssid, 6);
+    postEvent(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, info, joinDelayMs);
+    return WL_DISCONNECTED;
+  } else {
+    memcpy(currentBssid, bssid ? bssid : DEFAULT_BSSID, 6);
+    currentChannel = channel > 0 ? channel : DEFAULT_CHANNEL;
+  }
+
+  arduino_event_info_t info = {};
+  size_t len = currentSsid.size() < 32 ? currentSsid.size() : 32;
+  memcpy(info.wifi_sta_connected.ssid, currentSsid.data(), len);
+  info.wifi_sta_connected.ssid_len = len;
+  memcpy(info.wifi_sta_connected.bssid, currentBssid, 6);
+  info.wifi_sta_connected.channel = currentChannel;
+  postEvent(ARDUINO_EVENT_WIFI_STA_CONNECTED, info, joinDelayMs);
+
+  arduino_event_info_t ipInfo = {};
+  ipInfo.got_ip.ip_info.ip = localIP();
+  postEvent(ARDUINO_EVENT_WIFI_STA_GOT_IP, ipInfo, joinDelayMs + GOT_IP_DELAY_MS);
+  return WL_DISCONNECTED;
+}
+
+bool WiFiClass::config(IPAddress localIP, IPAddress gateway, IPAddress subnet, IPAddress dns1, IPAddress dns2) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  staticIp = localIP;
+  staticGateway = gateway;
+  staticSubnet = subnet;
+  staticDns = dns1;
+  return true;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  dropAssociation(WIFI_REASON_ASSOC_LEAVE);
+  if (wifiOff) {
+    wifiMode = WIFI_OFF;
+  }
+  return true;
+}
+
+bool WiFiClass::reconnect() {
+  std::string ssid;
+  {
+    std::lock_guard<std::mutex> guard(radioLock);
+    ssid = currentSsid;
+  }
+  if (ssid.empty()) {
+    return false;
+  }
+  begin(ssid.c_str());
+  return true;
+}
+
+wl_status_t WiFiClass::status() {
+  std::lock_guard<std::mutex> guard(radioLock);
+  if (gotIp) {
+    return WL_CONNECTED;
+  }
+  return wifiMode == WIFI_OFF ? WL_NO_SHIELD : WL_DISCONNECTED;
+}
+
+// Адреса - статические из config(), иначе loopback хоста (DHCP "выдаёт" 127.0.0.1)
+IPAddress WiFiClass::localIP() {
+  return (uint32_t)staticIp != 0 ? staticIp : IPAddress(127, 0, 0, 1);
+}
+
+IPAddress WiFiClass::gatewayIP() {
+  return (uint32_t)staticIp != 0 ? staticGateway : IPAddress(127, 0, 0, 1);
+}
+
+IPAddress WiFiClass::subnetMask() {
+  return (uint32_t)staticIp != 0 ? staticSubnet : IPAddress(255, 0, 0, 0);
+}
+
+IPAddress WiFiClass::dnsIP(uint8_t index) {
+  return (uint32_t)staticIp != 0 ? staticDns : IPAddress(127, 0, 0, 1);
+}
+
+uint8_t* WiFiClass::macAddress(uint8_t* mac) {
+  memcpy(mac, DEVICE_MAC, 6);
+  return mac;
+}
+
+String WiFiClass::macAddress() {
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", DEVICE_MAC[0], DEVICE_MAC[1], DEVICE_MAC[2],
+           DEVICE_MAC[3], DEVICE_MAC[4], DEVICE_MAC[5]);
+  return String(buf);
+}
+
+String WiFiClass::SSID() {
+  std::lock_guard<std::mutex> guard(radioLock);
+  return associated ? String(currentSsid.c_str()) : String();
+}
+
+uint8_t* WiFiClass::BSSID() {
+  return associated ? currentBssid : nullptr;
+}
+
+String WiFiClass::BSSIDstr() {
+  uint8_t* bssid = BSSID();
+  if (!bssid) {
+    return String();
+  }
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", bssid[0], bssid[1], bssid[2], bssid[3], bssid[4],
+           bssid[5]);
+  return String(buf);
+}
+
+int32_t WiFiClass::channel() {
+  return associated ? currentChannel : 0;
+}
+
+int8_t WiFiClass::RSSI() {
+  return associated ? currentRssi : 0;
+}
+
+int16_t WiFiClass::scanNetworks(bool async, bool showHidden, bool passive, uint32_t maxMsPerChannel,
+                                uint8_t channel) {
+  {
+    std::lock_guard<std::mutex> guard(radioLock);
+    if (scanRunning) {
+      return WIFI_SCAN_RUNNING;
+    }
+    scanRunning = true;
+    scanDone = false;
+    scanEnd = millis() + SCAN_DURATION_MS;
+  }
+  if (async) {
+    return WIFI_SCAN_RUNNING;
+  }
+  delay(SCAN_DURATION_MS);
+  return scanComplete();
+}
+
+int16_t WiFiClass::scanComplete() {
+  std::lock_guard<std::mutex> guard(radioLock);
+  if (scanRunning && (long)(millis() - scanEnd) >= 0) {
+    scanRunning = false;
+    scanDone = true;
+    scanResults = networks;
+  }
+  if (scanRunning) {
+    return WIFI_SCAN_RUNNING;
+  }
+  return scanDone ? (int16_t)scanResults.size() : WIFI_SCAN_FAILED;
+}
+
+void WiFiClass::scanDelete() {
+  std::lock_guard<std::mutex> guard(radioLock);
+  scanRunning = false;
+  scanDone = false;
+  scanResults.clear();
+}
+
+String WiFiClass::SSID(uint8_t index) {
+  return index < scanResults.size() ? String(scanResults[index].ssid.c_str()) : String();
+}
+
+uint8_t* WiFiClass::BSSID(uint8_t index) {
+  return index < scanResults.size() ? scanResults[index].bssid : nullptr;
+}
+
+String WiFiClass::BSSIDstr(uint8_t index) {
+  uint8_t* bssid = BSSID(index);
+  if (!bssid) {
+    return String();
+  }
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", bssid[0], bssid[1], bssid[2], bssid[3], bssid[4],
+           bssid[5]);
+  return String(buf);
+}
+
+int32_t WiFiClass::channel(uint8_t index) {
+  return index < scanResults.size() ? scanResults[index].channel : 0;
+}
+
+int32_t WiFiClass::RSSI(uint8_t index) {
+  return index < scanResults.size() ? scanResults[index].rssi : 0;
+}
+
+int WiFiClass::hostByName(const char* host, IPAddress& result) {
+  if (result.fromString(host)) {
+    return 1;
+  }
+  struct addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  struct addrinfo* info = nullptr;
+  if (getaddrinfo(host, nullptr, &hints, &info) != 0 || !info) {
+    return 0;
+  }
+  result = IPAddress((uint32_t)((struct sockaddr_in*)info->ai_addr)->sin_addr.s_addr);
+  freeaddrinfo(info);
+  return 1;
+}
+
+wifi_event_id_t WiFiClass::onEvent(WiFiEventFuncCb callback, arduino_event_id_t event) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  wifi_event_id_t id = nextCallbackId++;
+  callbacks.push_back({id, callback, event});
+  return id;
+}
+
+void WiFiClass::removeEvent(wifi_event_id_t id) {
+  std::lock_guard<std::mutex> guard(radioLock);
+  for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+    if (it->id == id) {
+      callbacks.erase(it);
+      return;
+    }
+  }
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type) {
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t* type) {
+  *type = WIFI_PS_NONE;
+  return ESP_OK;
+}
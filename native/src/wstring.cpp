@@ -0,0 +1,502 @@
+#include "WString.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Числа - через snprintf; основание 10/16/8/2, как utoa/ltoa ядра
+static void formatUnsigned(char* buf, size_t size, unsigned long long value, unsigned char base) {
+  if (base == 10) {
+    snprintf(buf, size, "%llu", value);
+    return;
+  }
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+  char tmp[72];
+  size_t n = 0;
+  do {
+    unsigned digit = value % base;
+    tmp[n++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value && n < sizeof(tmp));
+  size_t i = 0;
+  while (n > 0 && i + 1 < size) {
+    buf[i++] = tmp[--n];
+  }
+  buf[i] = 0;
+}
+
+static void formatSigned(char* buf, size_t size, long long value, unsigned char base) {
+  if (base == 10) {
+    snprintf(buf, size, "%lld", value);
+    return;
+  }
+  // Как ltoa ядра: в других основаниях - дополнительный код
+  formatUnsigned(buf, size, (unsigned long long)value, base);
+}
+
+String::String(const char* cstr) {
+  if (cstr) {
+    copy(cstr, strlen(cstr));
+  }
+}
+
+String::String(const char* cstr, unsigned int length) {
+  if (cstr) {
+    copy(cstr, length);
+  }
+}
+
+String::String(const String& str) {
+  *this = str;
+}
+
+String::String(String&& str) {
+  move(str);
+}
+
+String::String(char c) {
+  char buf[2] = {c, 0};
+  copy(buf, 1);
+}
+
+String::String(unsigned char value, unsigned char base) {
+  char buf[72];
+  formatUnsigned(buf, sizeof(buf), value, base);
+  copy(buf, strlen(buf));
+}
+
+String::String(int value, unsigned char base) {
+  char buf[72];
+  formatSigned(buf, sizeof(buf), value, base);
+  copy(buf, strlen(buf));
+}
+
+String::String(unsigned int value, unsigned char base) {
+  char buf[72];
+  formatUnsigned(buf, sizeof(buf), value, base);
+  copy(buf, strlen(buf));
+}
+
+String::String(long value, unsigned char base) {
+  char buf[72];
+  formatSigned(buf, sizeof(buf), value, base);
+  copy(buf, strlen(buf));
+}
+
+String::String(unsigned long value, unsigned char base) {
+  char buf[72];
+  formatUnsigned(buf, sizeof(buf), value, base);
+  copy(buf, strlen(buf));
+}
+
+String::String(long long value, unsigned char base) {
+  char buf[72];
+  formatSigned(buf, sizeof(buf), value, base);
+  copy(buf, strlen(buf));
+}
+
+String::String(unsigned long long value, unsigned char base) {
+  char buf[72];
+  formatUnsigned(buf, sizeof(buf), value, base);
+  copy(buf, strlen(buf));
+}
+
+String::String(float value, unsigned int decimalPlaces) : String((double)value, decimalPlaces) {}
+
+String::String(double value, unsigned int decimalPlaces) {
+  char buf[352];
+  snprintf(buf, sizeof(buf), "%.*f", decimalPlaces, value);
+  copy(buf, strlen(buf));
+}
+
+String::~String() {
+  free(buffer);
+}
+
+void String::invalidate() {
+  free(buffer);
+  buffer = nullptr;
+  capacity = 0;
+  len = 0;
+}
+
+bool String::reserve(unsigned int size) {
+  if (buffer && capacity >= size) {
+    return true;
+  }
+  if (grow(size)) {
+    if (len == 0) {
+      buffer[0] = 0;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool String::grow(unsigned int size) {
+  char* grown = (char*)realloc(buffer, size + 1);
+  if (!grown) {
+    return false;
+  }
+  buffer = grown;
+  capacity = size;
+  return true;
+}
+
+String& String::copy(const char* cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return *this;
+  }
+  len = length;
+  memmove(buffer, cstr, length);
+  buffer[len] = 0;
+  return *this;
+}
+
+void String::move(String& rhs) {
+  if (this == &rhs) {
+    return;
+  }
+  free(buffer);
+  buffer = rhs.buffer;
+  capacity = rhs.capacity;
+  len = rhs.len;
+  rhs.buffer = nullptr;
+  rhs.capacity = 0;
+  rhs.len = 0;
+}
+
+String& String::operator=(const String& rhs) {
+  if (this == &rhs) {
+    return *this;
+  }
+  if (rhs.buffer) {
+    copy(rhs.buffer, rhs.len);
+  } else {
+    invalidate();
+  }
+  return *this;
+}
+
+String& String::operator=(String&& rhs) {
+  move(rhs);
+  return *this;
+}
+
+String& String::operator=(const char* cstr) {
+  // nullptr - недействительная строка (ArduinoJson так очищает строку перед записью)
+  if (cstr) {
+    copy(cstr, strlen(cstr));
+  } else {
+    invalidate();
+  }
+  return *this;
+}
+
+bool String::concat(const char* cstr, unsigned int length) {
+  if (!cstr) {
+    return false;
+  }
+  if (length == 0) {
+    return true;
+  }
+  unsigned int newLen = len + length;
+  if (!reserve(newLen)) {
+    return false;
+  }
+  // cstr может указывать внутрь собственного буфера (s += s)
+  memmove(buffer + len, cstr, length);
+  len = newLen;
+  buffer[len] = 0;
+  return true;
+}
+
+bool String::concat(const String& str) {
+  if (&str == this) {
+    unsigned int length = len;
+    return reserve(len * 2) && concat(buffer, length);
+  }
+  return concat(str.c_str(), str.len);
+}
+
+bool String::concat(const char* cstr) {
+  return cstr && concat(cstr, strlen(cstr));
+}
+
+bool String::concat(char c) {
+  return concat(&c, 1);
+}
+
+bool String::concat(int value) {
+  return concat(String(value));
+}
+
+bool String::concat(unsigned int value) {
+  return concat(String(value));
+}
+
+bool String::concat(long value) {
+  return concat(String(value));
+}
+
+bool String::concat(unsigned long value) {
+  return concat(String(value));
+}
+
+bool String::concat(long long value) {
+  return concat(String(value));
+}
+
+bool String::concat(unsigned long long value) {
+  return concat(String(value));
+}
+
+bool String::concat(float value) {
+  return concat(String(value));
+}
+
+bool String::concat(double value) {
+  return concat(String(value));
+}
+
+int String::compareTo(const String& s) const {
+  return strcmp(c_str(), s.c_str());
+}
+
+bool String::equals(const String& s) const {
+  return len == s.len && compareTo(s) == 0;
+}
+
+bool String::equals(const char* cstr) const {
+  return strcmp(c_str(), cstr ? cstr : "") == 0;
+}
+
+bool String::equalsIgnoreCase(const String& s) const {
+  return len == s.len && strcasecmp(c_str(), s.c_str()) == 0;
+}
+
+bool String::startsWith(const String& prefix) const {
+  return startsWith(prefix, 0);
+}
+
+bool String::startsWith(const String& prefix, unsigned int offset) const {
+  if (offset > len || prefix.len > len - offset) {
+    return false;
+  }
+  return strncmp(c_str() + offset, prefix.c_str(), prefix.len) == 0;
+}
+
+bool String::endsWith(const String& suffix) const {
+  if (suffix.len > len) {
+    return false;
+  }
+  return strcmp(c_str() + len - suffix.len, suffix.c_str()) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+  return index < len ? buffer[index] : 0;
+}
+
+void String::setCharAt(unsigned int index, char c) {
+  if (index < len) {
+    buffer[index] = c;
+  }
+}
+
+char& String::operator[](unsigned int index) {
+  static char dummy;
+  if (index >= len) {
+    dummy = 0;
+    return dummy;
+  }
+  return buffer[index];
+}
+
+void String::getBytes(unsigned char* buf, unsigned int bufsize, unsigned int index) const {
+  if (!bufsize || !buf) {
+    return;
+  }
+  if (index >= len) {
+    buf[0] = 0;
+    return;
+  }
+  unsigned int n = bufsize - 1;
+  if (n > len - index) {
+    n = len - index;
+  }
+  memcpy(buf, buffer + index, n);
+  buf[n] = 0;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len) {
+    return -1;
+  }
+  const char* found = (const char*)memchr(buffer + fromIndex, ch, len - fromIndex);
+  return found ? found - buffer : -1;
+}
+
+int String::indexOf(const char* str, unsigned int fromIndex) const {
+  if (!str || fromIndex >= len) {
+    return -1;
+  }
+  const char* found = strstr(buffer + fromIndex, str);
+  return found ? found - buffer : -1;
+}
+
+int String::indexOf(const String& str, unsigned int fromIndex) const {
+  return indexOf(str.c_str(), fromIndex);
+}
+
+int String::lastIndexOf(char ch) const {
+  return len ? lastIndexOf(ch, len - 1) : -1;
+}
+
+int String::lastIndexOf(char ch, unsigned int fromIndex) const {
+  if (fromIndex >= len) {
+    return -1;
+  }
+  for (int i = fromIndex; i >= 0; i--) {
+    if (buffer[i] == ch) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int String::lastIndexOf(const String& str) const {
+  if (str.len == 0 || str.len > len) {
+    return -1;
+  }
+  for (int i = len - str.len; i >= 0; i--) {
+    if (strncmp(buffer + i, str.c_str(), str.len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    unsigned int tmp = beginIndex;
+    beginIndex = endIndex;
+    endIndex = tmp;
+  }
+  if (beginIndex >= len) {
+    return String();
+  }
+  if (endIndex > len) {
+    endIndex = len;
+  }
+  return String(buffer + beginIndex, endIndex - beginIndex);
+}
+
+void String::replace(char find, char replace) {
+  for (unsigned int i = 0; i < len; i++) {
+    if (buffer[i] == find) {
+      buffer[i] = replace;
+    }
+  }
+}
+
+void String::replace(const String& find, const String& replace) {
+  if (len == 0 || find.len == 0) {
+    return;
+  }
+  String result;
+  result.reserve(len);
+  unsigned int pos = 0;
+  int found;
+  while ((found = indexOf(find, pos)) >= 0) {
+    result.concat(buffer + pos, found - pos);
+    result.concat(replace);
+    pos = found + find.len;
+  }
+  result.concat(buffer + pos, len - pos);
+  move(result);
+}
+
+void String::remove(unsigned int index) {
+  remove(index, (unsigned int)-1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index >= len || count == 0) {
+    return;
+  }
+  if (count > len - index) {
+    count = len - index;
+  }
+  memmove(buffer + index, buffer + index + count, len - index - count + 1);
+  len -= count;
+}
+
+void String::toLowerCase() {
+  for (unsigned int i = 0; i < len; i++) {
+    buffer[i] = tolower((unsigned char)buffer[i]);
+  }
+}
+
+void String::toUpperCase() {
+  for (unsigned int i = 0; i < len; i++) {
+    buffer[i] = toupper((unsigned char)buffer[i]);
+  }
+}
+
+void String::trim() {
+  if (len == 0) {
+    return;
+  }
+  unsigned int begin = 0;
+  while (begin < len && isspace((unsigned char)buffer[begin])) {
+    begin++;
+  }
+  unsigned int end = len;
+  while (end > begin && isspace((unsigned char)buffer[end - 1])) {
+    end--;
+  }
+  len = end - begin;
+  if (begin > 0) {
+    memmove(buffer, buffer + begin, len);
+  }
+  buffer[len] = 0;
+}
+
+long String::toInt() const {
+  return buffer ? atol(buffer) : 0;
+}
+
+float String::toFloat() const {
+  return (float)toDouble();
+}
+
+double String::toDouble() const {
+  return buffer ? atof(buffer) : 0;
+}
+
+StringSumHelper operator+(const String& lhs, const String& rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+StringSumHelper operator+(const String& lhs, const char* rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+StringSumHelper operator+(const char* lhs, const String& rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
+
+StringSumHelper operator+(const String& lhs, char rhs) {
+  StringSumHelper result(lhs);
+  result.concat(rhs);
+  return result;
+}
@@ -0,0 +1,266 @@
+#include "async_http.h"
+#include <HTTPClient.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+// Слот очереди: владелец меняется по состоянию (loop заполняет и забирает результат, задача выполняет)
+enum HttpSlotState {
+  SLOT_FREE,
+  SLOT_FILLING,     // loop копирует запрос
+  SLOT_QUEUED,      // Ждёт задачу
+  SLOT_ACTIVE,      // Выполняется задачей
+  SLOT_DONE         // Результат ждёт handleAsyncHttp()
+};
+
+struct HttpSlot {
+  volatile HttpSlotState state;
+  uint32_t seq;           // Порядок постановки в очередь
+  AsyncHttpRequest request;
+  char* buffer;           // Тело запроса, затем тело ответа (ASYNC_HTTP_BODY_MAX + 1)
+  size_t length;
+  int status;
+  char headerValues[ASYNC_HTTP_HEADERS][ASYNC_HTTP_HEADER_VALUE_MAX];
+};
+
+static HttpSlot slots[ASYNC_HTTP_QUEUE];
+static portMUX_TYPE slotLock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t nextSeq = 0;
+static TaskHandle_t httpTaskHandle = nullptr;
+
+// Приёмник тела ответа для writeToStream() - пишет в буфер слота
+class SlotBodyStream : public Stream {
+public:
+  SlotBodyStream(char* buffer, size_t capacity) : buffer(buffer), capacity(capacity), length(0), overflow(false) {}
+
+  size_t write(uint8_t c) override {
+    return write(&c, 1);
+  }
+
+  size_t write(const uint8_t* data, size_t size) override {
+    if (length + size > capacity) {
+      overflow = true;
+      return 0;   // writeToStream() прерывает чтение
+    }
+    memcpy(buffer + length, data, size);
+    length += size;
+    return size;
+  }
+
+  int available() override { return 0; }
+  int read() override { return -1; }
+  int peek() override { return -1; }
+
+  char* buffer;
+  size_t capacity;
+  size_t length;
+  bool overflow;
+};
+
+// Добавить заголовки запроса из строк "Name: value\n"
+static void addRequestHeaders(HTTPClient& http, const char* headers) {
+  char name[40];
+  char value[ASYNC_HTTP_HEADER_VALUE_MAX + 32];
+  const char* line = headers;
+  while (*line) {
+    const char* end = strchr(line, '\n');
+    if (!end) {
+      end = line + strlen(line);
+    }
+    const char* colon = (const char*)memchr(line, ':', end - line);
+    if (colon && colon > line && (size_t)(colon - line) < sizeof(name)) {
+      memcpy(name, line, colon - line);
+      name[colon - line] = 0;
+      const char* valueStart = colon + 1;
+      while (valueStart < end && *valueStart == ' ') {
+        valueStart++;
+      }
+      const char* valueEnd = end;
+      while (valueEnd > valueStart && (valueEnd[-1] == ' ' || valueEnd[-1] == '\r')) {
+        valueEnd--;
+      }
+      size_t valueLen = min((size_t)(valueEnd - valueStart), sizeof(value) - 1);
+      memcpy(value, valueStart, valueLen);
+      value[valueLen] = 0;
+      http.addHeader(name, value);
+    }
+    line = *end ? end + 1 : end;
+  }
+}
+
+static void performRequest(HttpSlot& slot) {
+  const AsyncHttpRequest& request = slot.request;
+  HTTPClient http;
+  http.setConnectTimeout(request.timeoutMs);
+  http.setTimeout(request.timeoutMs);
+  http.setReuse(false);
+
+  slot.status = -1;
+  size_t bodyLength = slot.length;
+  slot.length = 0;
+  if (!http.begin(request.url)) {
+    slot.buffer[0] = 0;
+    return;
+  }
+  addRequestHeaders(http, request.headers);
+  // collectHeaders() принимает неконстантный массив
+  const char* collect[ASYNC_HTTP_HEADERS];
+  size_t collectCount = 0;
+  while (collectCount < ASYNC_HTTP_HEADERS && request.collectHeaders[collectCount]) {
+    collect[collectCount] = request.collectHeaders[collectCount];
+    collectCount++;
+  }
+  if (collectCount > 0) {
+    http.collectHeaders(collect, collectCount);
+  }
+
+  if (request.post) {
+    slot.status = http.POST((uint8_t*)slot.buffer, bodyLength);
+  } else {
+    slot.status = http.GET();
+  }
+  if (slot.status > 0) {
+    for (size_t i = 0; i < collectCount; i++) {
+      // Обрезанное значение хуже отсутствующего (ETag в If-None-Match никогда не совпадёт)
+      String value = http.header(request.collectHeaders[i]);
+      if (value.length() < ASYNC_HTTP_HEADER_VALUE_MAX) {
+        memcpy(slot.headerValues[i], value.c_str(), value.length() + 1);
+      } else {
+        slot.headerValues[i][0] = 0;
+        Serial.printf("Async HTTP: %s too long (%u bytes), ignored\n", request.collectHeaders[i], value.length());
+      }
+    }
+    // Тело читается в тот же буфер - тело запроса уже отправлено
+    SlotBodyStream body(slot.buffer, ASYNC_HTTP_BODY_MAX);
+    if (http.getSize() > ASYNC_HTTP_BODY_MAX) {
+      slot.status = ASYNC_HTTP_ERROR_TOO_LARGE;
+    } else if (http.getSize() != 0) {
+      http.writeToStream(&body);
+      if (body.overflow) {
+        slot.status = ASYNC_HTTP_ERROR_TOO_LARGE;
+        body.length = 0;
+      }
+    }
+    slot.length = body.length;
+  }
+  slot.buffer[slot.length] = 0;
+  http.end();
+}
+
+// Самый старый запрос в очереди (переводится в SLOT_ACTIVE)
+static HttpSlot* takeQueued() {
+  HttpSlot* oldest = nullptr;
+  portENTER_CRITICAL(&slotLock);
+  for (int i = 0; i < ASYNC_HTTP_QUEUE; i++) {
+    if (slots[i].state == SLOT_QUEUED && (!oldest || (int32_t)(slots[i].seq - oldest->seq) < 0)) {
+      oldest = &slots[i];
+    }
+  }
+  if (oldest) {
+    oldest->state = SLOT_ACTIVE;
+  }
+  portEXIT_CRITICAL(&slotLock);
+  return oldest;
+}
+
+static void asyncHttpTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+    HttpSlot* slot;
+    while ((slot = takeQueued()) != nullptr) {
+      performRequest(*slot);
+      slot->state = SLOT_DONE;
+    }
+  }
+}
+
+void initAsyncHttp() {
+  if (httpTaskHandle) {
+    return;
+  }
+  for (int i = 0; i < ASYNC_HTTP_QUEUE; i++) {
+    slots[i].state = SLOT_FREE;
+    // Буферы выделяются один раз на всё время работы
+    slots[i].buffer = (char*)ps_malloc(ASYNC_HTTP_BODY_MAX + 1);
+    if (!slots[i].buffer) {
+      slots[i].buffer = (char*)malloc(ASYNC_HTTP_BODY_MAX + 1);
+    }
+    if (!slots[i].buffer) {
+      Serial.println("Async HTTP: buffer allocation failed");
+      return;
+    }
+  }
+  // Ядро 0 (там же WiFi стек), приоритет как у sd_maint - loop на ядре 1 не вытесняется
+  xTaskCreatePinnedToCore(asyncHttpTask, "http_async", 8192, nullptr, 1, &httpTaskHandle, 0);
+}
+
+bool asyncHttpSubmit(const AsyncHttpRequest& request) {
+  if (!httpTaskHandle || request.bodyLength > ASYNC_HTTP_BODY_MAX) {
+    return false;
+  }
+
+  // Не начатый запрос того же вида заменяется, иначе - свободный слот
+  HttpSlot* slot = nullptr;
+  portENTER_CRITICAL(&slotLock);
+  for (int i = 0; i < ASYNC_HTTP_QUEUE && !slot; i++) {
+    if (slots[i].state == SLOT_QUEUED && slots[i].request.tag == request.tag) {
+      slot = &slots[i];
+    }
+  }
+  for (int i = 0; i < ASYNC_HTTP_QUEUE && !slot; i++) {
+    if (slots[i].state == SLOT_FREE) {
+      slot = &slots[i];
+    }
+  }
+  if (slot) {
+    slot->state = SLOT_FILLING;
+  }
+  portEXIT_CRITICAL(&slotLock);
+  if (!slot) {
+    return false;
+  }
+
+  slot->request = request;
+  slot->request.body = nullptr;   // Указатель вызывающего после возврата недействителен
+  if (request.bodyLength > 0) {
+    memcpy(slot->buffer, request.body, request.bodyLength);
+  }
+  slot->length = request.bodyLength;
+  slot->status = 0;
+  for (int i = 0; i < ASYNC_HTTP_HEADERS; i++) {
+    slot->headerValues[i][0] = 0;
+  }
+  slot->seq = nextSeq++;
+  slot->state = SLOT_QUEUED;
+  xTaskNotifyGive(httpTaskHandle);
+  return true;
+}
+
+bool asyncHttpPending(uint8_t tag) {
+  // SLOT_DONE тоже: callback ещё не вызван
+  for (int i = 0; i < ASYNC_HTTP_QUEUE; i++) {
+    if (slots[i].state != SLOT_FREE && slots[i].request.tag == tag) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void handleAsyncHttp() {
+  for (int i = 0; i < ASYNC_HTTP_QUEUE; i++) {
+    HttpSlot& slot = slots[i];
+    if (slot.state != SLOT_DONE) {
+      continue;
+    }
+    if (slot.request.callback) {
+      AsyncHttpResponse response;
+      response.status = slot.status;
+      response.body = slot.buffer;
+      response.length = slot.length;
+      for (int h = 0; h < ASYNC_HTTP_HEADERS; h++) {
+        response.headers[h] = slot.headerValues[h];
+      }
+      slot.request.callback(response);
+    }
+    slot.state = SLOT_FREE;
+  }
+}
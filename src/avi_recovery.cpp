@@ -0,0 +1,178 @@
+#include "avi_recovery.h"
+#include <SD_MMC.h>
+#include <FS.h>
+#include <stdlib.h>
+
+static const uint32_t AVIIF_KEYFRAME = 0x10;
+static const int INDEX_ENTRIES_PER_WRITE = 32;  // idx1 пишем блоками по 512 байт
+
+// ==================== Вспомогательные функции ====================
+
+static uint32_t read32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+static void write32At(File& file, uint32_t pos, uint32_t value) {
+  uint8_t bytes[4];
+  put32(bytes, value);
+  file.seek(pos);
+  file.write(bytes, sizeof(bytes));
+}
+
+// Найти данные avih и strh внутри LIST hdrl (strh - внутри LIST strl)
+static void findHeaderChunks(File& file, uint32_t pos, uint32_t end, uint32_t& avihData, uint32_t& strhData) {
+  while (pos + 8 <= end) {
+    uint8_t chunk[12];
+    file.seek(pos);
+    if (file.read(chunk, sizeof(chunk)) < 8) {
+      return;
+    }
+    uint32_t size = read32(chunk + 4);
+
+    if (memcmp(chunk, "avih", 4) == 0) {
+      avihData = pos + 8;
+    } else if (memcmp(chunk, "strh", 4) == 0 && strhData == 0) {
+      strhData = pos + 8;
+    } else if (memcmp(chunk, "LIST", 4) == 0 && memcmp(chunk + 8, "strl", 4) == 0) {
+      findHeaderChunks(file, pos + 12, pos + 8 + size, avihData, strhData);
+    }
+    pos += 8 + size + (size & 1);
+  }
+}
+
+// ==================== Публичные функции ====================
+
+bool recoverAVIFile(const String& tempPath, const String& finalPath, AVIRecoveryResult& result) {
+  File file = SD_MMC.open(tempPath, "r+");
+  if (!file) {
+    return false;
+  }
+
+  uint32_t fileSize = file.size();
+  result.frames = 0;
+  result.originalSize = fileSize;
+  result.recoveredSize = 0;
+
+  uint8_t riff[12];
+  if (fileSize < 12 || file.read(riff, sizeof(riff)) != sizeof(riff) ||
+      memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "AVI ", 4) != 0) {
+    file.close();
+    return false;
+  }
+
+  // Обход верхнего уровня: LIST hdrl (заголовки) и LIST movi (кадры)
+  uint32_t avihData = 0;
+  uint32_t strhData = 0;
+  uint32_t moviStart = 0;
+  uint32_t pos = 12;
+  while (pos + 12 <= fileSize) {
+    uint8_t chunk[12];
+    file.seek(pos);
+    if (file.read(chunk, sizeof(chunk)) != sizeof(chunk)) {
+      break;
+    }
+    uint32_t size = read32(chunk + 4);
+    if (memcmp(chunk, "LIST", 4) == 0 && memcmp(chunk + 8, "movi", 4) == 0) {
+      moviStart = pos;  // Размер movi не используем - в .tmp он не финализирован
+      break;
+    }
+    if (memcmp(chunk, "LIST", 4) == 0 && memcmp(chunk + 8, "hdrl", 4) == 0) {
+      findHeaderChunks(file, pos + 12, pos + 8 + size, avihData, strhData);
+    }
+    pos += 8 + size + (size & 1);
+  }
+
+  if (moviStart == 0) {
+    file.close();
+    return false;
+  }
+
+  // Обход кадров по заголовкам chunk'ов до последнего полностью записанного 00dc
+  uint32_t moviData = moviStart + 8;  // Смещения в idx1 - от fourcc "movi"
+  uint32_t cut = moviStart + 12;
+  uint32_t* index = nullptr;  // Пары (смещение, размер)
+  size_t indexCapacity = 0;
+
+  while (cut + 8 <= fileSize) {
+    uint8_t chunk[8];
+    file.seek(cut);
+    if (file.read(chunk, sizeof(chunk)) != sizeof(chunk) || memcmp(chunk + 2, "dc", 2) != 0) {
+      break;
+    }
+    uint32_t size = read32(chunk + 4);
+    uint64_t next = (uint64_t)cut + 8 + size + (size & 1);
+    if (next > fileSize) {
+      break;  // Кадр оборван
+    }
+
+    if (result.frames * 2 >= indexCapacity) {
+      size_t newCapacity = indexCapacity ? indexCapacity * 2 : 1024;
+      uint32_t* grown = (uint32_t*)(psramFound() ? ps_realloc(index, newCapacity * sizeof(uint32_t))
+                                                 : realloc(index, newCapacity * sizeof(uint32_t)));
+      if (!grown) {
+        break;  // Нет памяти под индекс - восстанавливаем то, что успели пройти
+      }
+      index = grown;
+      indexCapacity = newCapacity;
+    }
+    index[result.frames * 2] = cut - moviData;
+    index[result.frames * 2 + 1] = size;
+    result.frames++;
+    cut = next;
+  }
+
+  if (result.frames == 0) {
+    free(index);
+    file.close();
+    return false;
+  }
+
+  // Индекс idx1 сразу за последним полным кадром (хвост оборванного кадра остаётся за концом RIFF)
+  uint8_t block[16 * INDEX_ENTRIES_PER_WRITE];
+  file.seek(cut);
+  memcpy(block, "idx1", 4);
+  put32(block + 4, result.frames * 16);
+  file.write(block, 8);
+
+  size_t used = 0;
+  for (uint32_t i = 0; i < result.frames; i++) {
+    uint8_t* entry = block + used;
+    memcpy(entry, "00dc", 4);
+    put32(entry + 4, AVIIF_KEYFRAME);
+    put32(entry + 8, index[i * 2]);
+    put32(entry + 12, index[i * 2 + 1]);
+    used += 16;
+    if (used == sizeof(block) || i == result.frames - 1) {
+      file.write(block, used);
+      used = 0;
+    }
+  }
+  free(index);
+
+  // Исправляем размеры и количество кадров
+  uint32_t end = cut + 8 + result.frames * 16;
+  write32At(file, 4, end - 8);                       // RIFF
+  write32At(file, moviStart + 4, cut - moviData);    // LIST movi
+  if (avihData) {
+    write32At(file, avihData + 16, result.frames);   // avih.dwTotalFrames
+  }
+  if (strhData) {
+    write32At(file, strhData + 32, result.frames);   // strh.dwLength
+  }
+  file.close();
+
+  result.recoveredSize = end;
+  if (!SD_MMC.rename(tempPath, finalPath)) {
+    return false;
+  }
+
+  Serial.printf("Recovered %s: %u frames\n", finalPath.c_str(), result.frames);
+  return true;
+}
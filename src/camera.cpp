@@ -1,4 +1,6 @@
 #include "camera.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
 
 bool initCamera() {
   camera_config_t config;
@@ -39,7 +41,13 @@ bool initCamera() {
 }
 
 camera_fb_t* captureFrame() {
-  return esp_camera_fb_get();
+  unsigned long start = micros();
+  camera_fb_t* fb = esp_camera_fb_get();
+  latencyRecord(LATENCY_CAPTURE, micros() - start);
+  if (fb) {
+    traceEvent(TRACE_FRAME_CAPTURED, fb->len);
+  }
+  return fb;
 }
 
 void releaseFrame(camera_fb_t* fb) {
@@ -47,3 +55,22 @@ void releaseFrame(camera_fb_t* fb) {
     esp_camera_fb_return(fb);
   }
 }
+
+camera_fb_t* captureFrameAtSize(framesize_t frameSize) {
+  sensor_t* s = esp_camera_sensor_get();
+  if (!s || s->status.framesize == frameSize) {
+    return captureFrame();
+  }
+  
+  framesize_t previous = s->status.framesize;
+  s->set_framesize(s, frameSize);
+  
+  // Буферы уже могут содержать кадры старого разрешения (fb_count = 2)
+  for (int i = 0; i < 2; i++) {
+    releaseFrame(captureFrame());
+  }
+  camera_fb_t* fb = captureFrame();
+  
+  s->set_framesize(s, previous);
+  return fb;
+}
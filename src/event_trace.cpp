@@ -0,0 +1,101 @@
+#include "event_trace.h"
+#include "config.h"
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static TraceEvent* events = nullptr;
+static volatile uint32_t head = 0;          // Событий записано с загрузки (следующий индекс)
+static volatile uint32_t frozen = 0;        // Вложенность traceFreeze()
+static volatile uint32_t lostEvents = 0;
+static portMUX_TYPE freezeLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Снимок при заморозке
+static TraceDumpHeader dumpHeader;
+static uint32_t dumpFirst = 0;              // Индекс самого старого события дампа
+
+static const uint32_t EVENT_MASK = TRACE_EVENTS - 1;
+static_assert((TRACE_EVENTS & (TRACE_EVENTS - 1)) == 0, "TRACE_EVENTS must be a power of two");
+
+bool initEventTrace() {
+#if TRACE_ENABLED
+  if (!events) {
+    events = (TraceEvent*)ps_calloc(TRACE_EVENTS, sizeof(TraceEvent));
+    if (!events) {
+      Serial.println("Event trace disabled: no PSRAM");
+    }
+  }
+#endif
+  return events != nullptr;
+}
+
+void traceEvent(TraceEventType type, uint32_t arg) {
+  if (!events) {
+    return;
+  }
+  if (frozen) {
+    lostEvents++;   // Приблизительно - счётчик без атомарности, только для дампа
+    return;
+  }
+  uint32_t index = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+  TraceEvent& event = events[index & EVENT_MASK];
+  event.timeUs = (uint32_t)esp_timer_get_time();
+  event.type = type;
+  event.core = xPortGetCoreID();
+  event.arg = arg;
+}
+
+void traceFreeze() {
+  portENTER_CRITICAL(&freezeLock);
+  if (frozen++ == 0) {
+    uint32_t total = head;
+    uint32_t count = total < TRACE_EVENTS ? total : TRACE_EVENTS;
+    memcpy(dumpHeader.magic, "ECTR", 4);
+    dumpHeader.version = 1;
+    dumpHeader.eventSize = sizeof(TraceEvent);
+    dumpHeader.count = count;
+    dumpHeader.total = total;
+    dumpHeader.lost = lostEvents;
+    dumpHeader.dumpUs = (uint32_t)esp_timer_get_time();
+    dumpFirst = total - count;
+  }
+  portEXIT_CRITICAL(&freezeLock);
+}
+
+void traceUnfreeze() {
+  portENTER_CRITICAL(&freezeLock);
+  if (frozen > 0) {
+    frozen--;
+  }
+  portEXIT_CRITICAL(&freezeLock);
+}
+
+uint32_t traceDumpSize() {
+  return sizeof(TraceDumpHeader) + dumpHeader.count * sizeof(TraceEvent);
+}
+
+size_t traceRead(uint32_t offset, uint8_t* buffer, size_t len) {
+  // Без буфера дамп - только заголовок (count 0)
+  if (!frozen) {
+    return 0;
+  }
+  uint32_t size = traceDumpSize();
+  size_t done = 0;
+  while (done < len && offset < size) {
+    size_t n;
+    if (offset < sizeof(TraceDumpHeader)) {
+      n = min(len - done, (size_t)(sizeof(TraceDumpHeader) - offset));
+      memcpy(buffer + done, (const uint8_t*)&dumpHeader + offset, n);
+    } else {
+      // Кольцо может переходить через конец буфера - копируем до конца события
+      uint32_t eventOffset = offset - sizeof(TraceDumpHeader);
+      uint32_t index = (dumpFirst + eventOffset / sizeof(TraceEvent)) & EVENT_MASK;
+      uint32_t within = eventOffset % sizeof(TraceEvent);
+      n = min(len - done, (size_t)(sizeof(TraceEvent) - within));
+      memcpy(buffer + done, (const uint8_t*)&events[index] + within, n);
+    }
+    done += n;
+    offset += n;
+  }
+  return done;
+}
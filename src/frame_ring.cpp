@@ -0,0 +1,120 @@
+#include "frame_ring.h"
+#include <stdlib.h>
+
+// Заголовок кадра в буфере: длина + время захвата
+static const size_t ENTRY_HEADER_SIZE = 8;
+static const uint32_t WRAP_MARKER = 0xFFFFFFFF;  // Остаток буфера пуст, следующий кадр с начала
+
+static size_t alignedSize(size_t len) {
+  return ENTRY_HEADER_SIZE + ((len + 3) & ~(size_t)3);
+}
+
+// Позиция кадра с учётом перехода в начало буфера
+static size_t normalize(const FrameRing& ring, size_t pos) {
+  if (ring.capacity - pos < ENTRY_HEADER_SIZE) {
+    return 0;
+  }
+  uint32_t len;
+  memcpy(&len, ring.buffer + pos, sizeof(len));
+  return (len == WRAP_MARKER) ? 0 : pos;
+}
+
+bool frameRingInit(FrameRing& ring, size_t capacity) {
+  ring.buffer = (uint8_t*)(psramFound() ? ps_malloc(capacity) : nullptr);
+  ring.capacity = ring.buffer ? capacity : 0;
+  frameRingClear(ring);
+  return ring.buffer != nullptr;
+}
+
+void frameRingFree(FrameRing& ring) {
+  free(ring.buffer);
+  ring.buffer = nullptr;
+  ring.capacity = 0;
+  frameRingClear(ring);
+}
+
+void frameRingClear(FrameRing& ring) {
+  ring.head = 0;
+  ring.tail = 0;
+  ring.bytes = 0;
+  ring.frames = 0;
+}
+
+bool frameRingPush(FrameRing& ring, const uint8_t* data, size_t len, uint32_t timestamp) {
+  size_t need = alignedSize(len);
+  if (!ring.buffer || need > ring.capacity) {
+    return false;
+  }
+
+  // Освобождаем непрерывный участок под кадр, вытесняя старые кадры
+  for (;;) {
+    if (ring.frames == 0) {
+      ring.head = 0;
+      ring.tail = 0;
+      break;
+    }
+    if (ring.tail > ring.head) {
+      if (ring.capacity - ring.tail >= need) {
+        break;
+      }
+      if (ring.head >= need) {
+        // Переходим в начало буфера
+        if (ring.capacity - ring.tail >= ENTRY_HEADER_SIZE) {
+          memcpy(ring.buffer + ring.tail, &WRAP_MARKER, sizeof(WRAP_MARKER));
+        }
+        ring.tail = 0;
+        break;
+      }
+    } else if (ring.head - ring.tail >= need && ring.tail != ring.head) {
+      break;
+    }
+    frameRingPop(ring);
+  }
+
+  uint32_t len32 = len;
+  memcpy(ring.buffer + ring.tail, &len32, sizeof(len32));
+  memcpy(ring.buffer + ring.tail + 4, &timestamp, sizeof(timestamp));
+  memcpy(ring.buffer + ring.tail + ENTRY_HEADER_SIZE, data, len);
+  ring.tail += need;
+  ring.bytes += len;
+  ring.frames++;
+  return true;
+}
+
+bool frameRingPeek(const FrameRing& ring, const uint8_t*& data, size_t& len, uint32_t& timestamp) {
+  if (ring.frames == 0) {
+    return false;
+  }
+  size_t pos = normalize(ring, ring.head);
+  uint32_t len32;
+  memcpy(&len32, ring.buffer + pos, sizeof(len32));
+  memcpy(&timestamp, ring.buffer + pos + 4, sizeof(timestamp));
+  len = len32;
+  data = ring.buffer + pos + ENTRY_HEADER_SIZE;
+  return true;
+}
+
+void frameRingPop(FrameRing& ring) {
+  if (ring.frames == 0) {
+    return;
+  }
+  size_t pos = normalize(ring, ring.head);
+  uint32_t len32;
+  memcpy(&len32, ring.buffer + pos, sizeof(len32));
+  ring.head = pos + alignedSize(len32);
+  ring.bytes -= len32;
+  ring.frames--;
+  if (ring.frames == 0) {
+    ring.head = 0;
+    ring.tail = 0;
+  }
+}
+
+void frameRingDropOlderThan(FrameRing& ring, uint32_t timestamp) {
+  const uint8_t* data;
+  size_t len;
+  uint32_t frameTime;
+  while (frameRingPeek(ring, data, len, frameTime) && (int32_t)(frameTime - timestamp) < 0) {
+    frameRingPop(ring);
+  }
+}
@@ -0,0 +1,60 @@
+#include "heap_counters.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static TaskHandle_t loopTask = nullptr;
+static volatile uint32_t loopAllocations = 0;
+static volatile uint32_t totalAllocations = 0;
+
+#ifdef HEAP_COUNTERS
+
+extern "C" {
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+static inline void countAllocation() {
+  totalAllocations++;
+  // До запуска планировщика задачи ещё нет
+  if (loopTask && xTaskGetCurrentTaskHandle() == loopTask) {
+    loopAllocations++;
+  }
+}
+
+void* __wrap_malloc(size_t size) {
+  countAllocation();
+  return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+  countAllocation();
+  return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+  countAllocation();
+  return __real_realloc(ptr, size);
+}
+}
+
+#endif
+
+void initHeapCounters() {
+  loopTask = xTaskGetCurrentTaskHandle();
+}
+
+bool heapCountersEnabled() {
+#ifdef HEAP_COUNTERS
+  return true;
+#else
+  return false;
+#endif
+}
+
+uint32_t getLoopAllocations() {
+  return loopAllocations;
+}
+
+uint32_t getTotalAllocations() {
+  return totalAllocations;
+}
@@ -0,0 +1,83 @@
+#include "json_arena.h"
+
+// Перед каждым блоком - его размер; выравнивание под double/uint64_t
+static const size_t ALIGN = 8;
+static const size_t HEADER = ALIGN;
+
+static size_t alignUp(size_t value) {
+  return (value + ALIGN - 1) & ~(ALIGN - 1);
+}
+
+JsonArena::JsonArena(uint8_t* buffer, size_t capacity) : buffer(buffer), size(capacity) {
+  // Смещения выравниваются от начала буфера - само начало тоже должно быть выровнено
+  size_t skip = (ALIGN - ((uintptr_t)buffer & (ALIGN - 1))) & (ALIGN - 1);
+  skip = skip < capacity ? skip : capacity;
+  this->buffer = buffer + skip;
+  size = capacity - skip;
+}
+
+void* JsonArena::allocate(size_t blockSize) {
+  size_t need = HEADER + alignUp(blockSize);
+  if (top + need > size) {
+    failedAllocations++;
+    return nullptr;
+  }
+  *(size_t*)(buffer + top) = blockSize;
+  lastBlock = top;
+  top += need;
+  live++;
+  if (top > peakUsed) {
+    peakUsed = top;
+  }
+  return buffer + lastBlock + HEADER;
+}
+
+void JsonArena::deallocate(void* ptr) {
+  if (!ptr || live == 0) {
+    return;
+  }
+  live--;
+  if (live == 0) {
+    // Документ освобождён целиком
+    top = 0;
+    lastBlock = 0;
+  } else if ((uint8_t*)ptr == buffer + lastBlock + HEADER) {
+    top = lastBlock;
+  }
+}
+
+void* JsonArena::reallocate(void* ptr, size_t newSize) {
+  if (!ptr) {
+    return allocate(newSize);
+  }
+  uint8_t* block = (uint8_t*)ptr - HEADER;
+  size_t oldSize = *(size_t*)block;
+
+  if (block == buffer + lastBlock) {
+    // Последний блок растёт или сжимается на месте
+    size_t need = HEADER + alignUp(newSize);
+    if (lastBlock + need > size) {
+      failedAllocations++;
+      return nullptr;
+    }
+    *(size_t*)block = newSize;
+    top = lastBlock + need;
+    if (top > peakUsed) {
+      peakUsed = top;
+    }
+    return ptr;
+  }
+
+  if (newSize <= oldSize) {
+    *(size_t*)block = newSize;
+    return ptr;
+  }
+  void* moved = allocate(newSize);
+  if (!moved) {
+    return nullptr;
+  }
+  memcpy(moved, ptr, oldSize);
+  // Старый блок не последний - место вернётся при освобождении документа
+  live--;
+  return moved;
+}
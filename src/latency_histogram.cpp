@@ -0,0 +1,96 @@
+#include "latency_histogram.h"
+
+static LatencyHistogram stages[LATENCY_STAGES];
+
+static const char* STAGE_NAMES[LATENCY_STAGES] = {
+  "capture", "sd_write", "header", "socket_write", "reconnect", "loop"
+};
+
+static const uint32_t SUB_BUCKETS = 1 << LATENCY_SUB_BITS;
+
+// Значения меньше SUB_BUCKETS - по корзине на значение, дальше - SUB_BUCKETS корзин на октаву
+static inline uint32_t bucketIndex(uint32_t us) {
+  if (us < SUB_BUCKETS) {
+    return us;
+  }
+  uint32_t msb = 31 - __builtin_clz(us);
+  if (msb >= LATENCY_MAX_BITS) {
+    return LATENCY_BUCKETS - 1;
+  }
+  uint32_t sub = (us >> (msb - LATENCY_SUB_BITS)) & (SUB_BUCKETS - 1);
+  return ((msb - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS) + sub;
+}
+
+// Середина корзины
+static uint32_t bucketValue(uint32_t index) {
+  if (index < SUB_BUCKETS) {
+    return index;
+  }
+  uint32_t msb = (index >> LATENCY_SUB_BITS) + LATENCY_SUB_BITS - 1;
+  uint32_t sub = index & (SUB_BUCKETS - 1);
+  uint32_t width = 1u << (msb - LATENCY_SUB_BITS);
+  return (1u << msb) + sub * width + width / 2;
+}
+
+void latencyRecord(LatencyHistogram& histogram, uint32_t us) {
+  __atomic_fetch_add(&histogram.buckets[bucketIndex(us)], 1, __ATOMIC_RELAXED);
+  uint32_t max = __atomic_load_n(&histogram.max, __ATOMIC_RELAXED);
+  while (us > max && !__atomic_compare_exchange_n(&histogram.max, &max, us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+LatencySummary latencyTake(LatencyHistogram& histogram) {
+  // Снимок окна; значения, записанные во время чтения, уходят в следующее окно
+  uint32_t counts[LATENCY_BUCKETS];
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    counts[i] = __atomic_exchange_n(&histogram.buckets[i], 0, __ATOMIC_RELAXED);
+    total += counts[i];
+  }
+  uint32_t max = __atomic_exchange_n(&histogram.max, 0, __ATOMIC_RELAXED);
+
+  LatencySummary summary = {};
+  summary.count = total;
+  summary.max = max;
+  if (total == 0) {
+    return summary;
+  }
+
+  // Ранги перцентилей (округление вверх)
+  uint64_t rank50 = ((uint64_t)total * 50 + 99) / 100;
+  uint64_t rank90 = ((uint64_t)total * 90 + 99) / 100;
+  uint64_t rank99 = ((uint64_t)total * 99 + 99) / 100;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++) {
+    if (counts[i] == 0) {
+      continue;
+    }
+    uint64_t before = seen;
+    seen += counts[i];
+    // Середина корзины, не больше точного максимума (max мог уйти в следующее окно - тогда 0);
+    // последняя корзина без верхней границы - максимум
+    uint32_t value = bucketValue(i);
+    if (max && (value > max || i == LATENCY_BUCKETS - 1)) {
+      value = max;
+    }
+    if (before < rank50 && seen >= rank50) summary.p50 = value;
+    if (before < rank90 && seen >= rank90) summary.p90 = value;
+    if (seen >= rank99) {
+      summary.p99 = value;
+      break;
+    }
+  }
+  return summary;
+}
+
+void latencyRecord(LatencyStage stage, uint32_t us) {
+  latencyRecord(stages[stage], us);
+}
+
+LatencySummary latencyTake(LatencyStage stage) {
+  return latencyTake(stages[stage]);
+}
+
+const char* latencyStageName(LatencyStage stage) {
+  return STAGE_NAMES[stage];
+}
@@ -6,10 +6,20 @@
  * Модули:
  *   - config.h             : Настройки (Wi-Fi, пины камеры, сервер)
  *   - camera.h/cpp         : Работа с камерой
- *   - wifi_client.h/cpp    : WiFi подключение
+ *   - wifi_client.h/cpp    : WiFi подключение (неблокирующее, события в loop)
  *   - stream_client.h/cpp  : Стриминг на сервер
  *   - server_settings.h/cpp: Получение настроек с сервера
  *   - sd_recorder.h/cpp    : Запись видео на SD карту
+ *   - segment_uploader.h/cpp: Фоновая выгрузка записей на сервер
+ *   - playback_server.h/cpp: Просмотр записей с устройства (HTTP Range)
+ *   - settings_channel.h/cpp: Long-poll доставка настроек с сервера
+ *   - async_http.h/cpp     : Очередь HTTP запросов управления в фоновой задаче
+ *   - stream_control.h/cpp : Настройки в ответах на кадры, статус в соединении потока
+ *   - settings_store.h/cpp : Группы настроек в NVS одним блобом, отложенная запись
+ *   - json_arena.h/cpp     : Аллокатор ArduinoJson в фиксированном буфере
+ *   - heap_counters.h/cpp  : Счётчики выделений памяти (сборка с HEAP_COUNTERS)
+ *   - latency_histogram.h/cpp: Гистограммы задержек этапов кадра (p50/p90/p99 в статусе)
+ *   - event_trace.h/cpp    : Бинарная трасса событий в PSRAM (GET /trace, дамп на SD)
  */
 
 #include <Arduino.h>
@@ -21,7 +31,15 @@
 #include "stream_client.h"
 #include "server_settings.h"
 #include "sd_recorder.h"
-#include "esp_wifi.h"
+#include "segment_uploader.h"
+#include "playback_server.h"
+#include "settings_channel.h"
+#include "async_http.h"
+#include "stream_control.h"
+#include "settings_store.h"
+#include "heap_counters.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
 
 // Connection state machine
 enum ConnectionState {
@@ -37,9 +55,49 @@ static unsigned long stateStartTime = 0;
 static int wifiRetryCount = 0;
 static const int MAX_WIFI_RETRIES = 3;
 static const unsigned long BLUETOOTH_TIMEOUT = 300000;  // 5 min waiting for BT config
+static unsigned long lastLoopStart = 0;  // Начало прошлой итерации loop (micros) - длительность итерации
+
+// Потеря WiFi в работе: сразу новая попытка (точка доступа из кэша - без сканирования),
+// пауза WIFI_RETRY_DELAY_MS - только после неудачи
+static void handleWiFiLinkLost(unsigned long now) {
+  Serial.println("WiFi connection lost!");
+  markStreamLinkLost();
+  connectionState = STATE_WIFI_CONNECTING;
+  wifiRetryCount = 0;
+  stateStartTime = now;
+  startWiFi();
+}
+
+// Событие подключения WiFi -> переход машины состояний (в остальных состояниях событие не нужно)
+static void handleWiFiEvent(WiFiLinkEvent event) {
+  unsigned long now = millis();
+  
+  switch (event) {
+    case WIFI_LINK_GOT_IP:
+      if (connectionState == STATE_WIFI_CONNECTING) {
+        connectionState = STATE_WIFI_CONNECTED;
+        stateStartTime = now;
+      }
+      break;
+      
+    case WIFI_LINK_DISCONNECTED:
+      if (connectionState == STATE_WIFI_CONNECTING) {
+        Serial.println("WiFi connection FAILED!");
+        connectionState = STATE_WIFI_RETRY;
+        stateStartTime = now;
+      } else if (connectionState == STATE_WIFI_CONNECTED) {
+        handleWiFiLinkLost(now);
+      }
+      break;
+      
+    default:
+      break;  // WIFI_LINK_CONNECTED - ждём IP
+  }
+}
 
 void setup() {
   Serial.begin(115200);
+  initHeapCounters();
   delay(1000);
   Serial.println("\n=== ESP32-CAM Video Stream Client (HD 60FPS Mode) ===");
   
@@ -47,6 +105,9 @@ void setup() {
   setCpuFrequencyMhz(240);
   Serial.printf("CPU Frequency: %d MHz\n", getCpuFrequencyMhz());
   
+  // Трасса событий - до всех модулей, которые в неё пишут
+  initEventTrace();
+  
   // 1. Initialize camera first
   if (!initCamera()) {
     Serial.println("CRITICAL: Camera init FAILED!");
@@ -64,15 +125,20 @@ void setup() {
   initStreaming();
   
   // 5. Initialize server settings (loads camera settings from NVS)
+  //    and the background task for settings/status requests
   initServerSettings();
+  initAsyncHttp();
   
   // 6. Initialize SD card recorder (loads settings from NVS automatically)
   initSDRecorder();
   
-  // 7. НЕ применяем настройки из NVS здесь - они будут загружены с сервера при первом подключении
+  // 7. Initialize background upload of recordings (resume position from NVS)
+  initSegmentUploader();
+  
+  // 8. НЕ применяем настройки из NVS здесь - они будут загружены с сервера при первом подключении
   // applyCameraSettings(getCurrentSettings());  // <-- Удалено
   
-  // 8. Start connection state machine
+  // 9. Start connection state machine
   connectionState = STATE_INIT;
   stateStartTime = millis();
   
@@ -80,12 +146,36 @@ void setup() {
 }
 
 void loop() {
+  // Период loop, вместе с задачами, вытеснившими её между итерациями
+  unsigned long loopStart = micros();
+  if (lastLoopStart != 0) {
+    latencyRecord(LATENCY_LOOP, loopStart - lastLoopStart);
+  }
+  lastLoopStart = loopStart;
+  
   // Primary task: send video frames (highest priority)
+  // Also feeds SD recording - it does not depend on WiFi or the server
   updateStreaming();
   
-  // WiFi management - НЕ вызываем если Bluetooth активен (конфликт радиомодуля!)
+  // Handle SD card hot-plug and recording (неблокирующий)
+  handleSDRecorder();
+  
+  // Results of settings/status requests done by the background task (callbacks run here)
+  handleAsyncHttp();
+  
+  // Settings that arrived in stream responses (applied here, not while a frame is being sent)
+  handleStreamControl();
+  
+  // Debounced NVS writes of changed settings (one group per call)
+  handleSettingsStore();
+  
+  // WiFi events - подключение идёт в фоне, loop узнаёт результат здесь
+  // НЕ вызываем если Bluetooth активен (конфликт радиомодуля!)
   if (connectionState != STATE_BLUETOOTH_WAITING) {
-    checkWiFiConnection();
+    WiFiLinkEvent wifiEvent;
+    while (pollWiFiEvent(wifiEvent)) {
+      handleWiFiEvent(wifiEvent);
+    }
   }
   
   // handleConnectionStateMachine() {
@@ -105,28 +195,11 @@ void loop() {
       
       // Check if we have saved WiFi credentials
       if (loadWiFiCredentials(ssid, password) && ssid.length() > 0) {
+        Serial.println("Found saved WiFi credentials and server host, attempting connection...");
         connectionState = STATE_WIFI_CONNECTING;
         wifiRetryCount = 0;
         stateStartTime = now;
-        
-        if (initWiFi()) {
-          connectionState = STATE_WIFI_CONNECTED;
-          esp_wifi_set_ps(WIFI_PS_NONE);
-        } else {
-          Serial.println("Found saved WiFi credentials and server host, attempting connection...");
-          connectionState = STATE_WIFI_CONNECTING;
-          wifiRetryCount = 0;
-          stateStartTime = now;
-          
-          if (initWiFi()) {
-            connectionState = STATE_WIFI_CONNECTED;
-            esp_wifi_set_ps(WIFI_PS_NONE);
-            Serial.println("WiFi connected successfully!");
-          } else {
-            connectionState = STATE_WIFI_RETRY;
-            stateStartTime = now;
-          }
-        }
+        startWiFi();
       } else {
         Serial.println("No WiFi credentials found, starting Bluetooth...");
         connectionState = STATE_BLUETOOTH_WAITING;
@@ -135,8 +208,12 @@ void loop() {
       }
       break;
       
+    case STATE_WIFI_CONNECTING:
+      // Результат попытки (IP или отказ/таймаут) приходит событием - см. handleWiFiEvent()
+      break;
+      
     case STATE_WIFI_RETRY:
-      if (now - stateStartTime > 5000) {  // Wait 5 sec before retry
+      if (now - stateStartTime > WIFI_RETRY_DELAY_MS) {
         wifiRetryCount++;
         if (wifiRetryCount >= MAX_WIFI_RETRIES) {
           Serial.println("WiFi connection failed after retries, starting Bluetooth...");
@@ -145,12 +222,9 @@ void loop() {
           wifiRetryCount = 0;
           startBluetoothConfig();
         } else {
-          if (initWiFi()) {
-            connectionState = STATE_WIFI_CONNECTED;
-            esp_wifi_set_ps(WIFI_PS_NONE);
-          } else {
-            stateStartTime = now;
-          }
+          connectionState = STATE_WIFI_CONNECTING;
+          stateStartTime = now;
+          startWiFi();
         }
       }
       break;
@@ -172,16 +246,9 @@ void loop() {
           stopBluetoothConfig();
           
           connectionState = STATE_WIFI_CONNECTING;
+          wifiRetryCount = 0;
           stateStartTime = now;
-          
-          if (initWiFi()) {
-            connectionState = STATE_WIFI_CONNECTED;
-            esp_wifi_set_ps(WIFI_PS_NONE);
-          } else {
-            connectionState = STATE_WIFI_RETRY;
-            wifiRetryCount = 0;
-            stateStartTime = now;
-          }
+          startWiFi();
         }
       }
       
@@ -198,10 +265,7 @@ void loop() {
     case STATE_WIFI_CONNECTED:
       // Check if WiFi is still connected
       if (!isWiFiConnected()) {
-        Serial.println("WiFi connection lost!");
-        connectionState = STATE_WIFI_RETRY;
-        wifiRetryCount = 0;
-        stateStartTime = now;
+        handleWiFiLinkLost(now);
       } else if (hasServerConnectionError()) {
         // Too many server connection failures - switch to Bluetooth for reconfiguration
         Serial.println("Too many server connection errors! Switching to Bluetooth mode for reconfiguration...");
@@ -219,10 +283,12 @@ void loop() {
         connectionState = STATE_BLUETOOTH_WAITING;
         stateStartTime = now;
         startBluetoothConfig();
+      } else if (handleWiFiRoaming()) {
+        // Переход на лучшую точку доступа (слабый сигнал или поток не успевает)
+        markStreamLinkLost();
+        connectionState = STATE_WIFI_CONNECTING;
+        stateStartTime = now;
       } else {
-        // Normal operation - check connection periodically
-        checkWiFiConnection();
-        
         // First-time: fetch settings from server before starting stream
         if (!areInitialSettingsLoaded()) {
           if (fetchInitialSettingsFromServer()) {
@@ -241,14 +307,24 @@ void loop() {
           startStreaming();
         }
         
-        // Handle server settings (неблокирующий, со своим таймером)
+        // Settings pushed by the server (long-poll, неблокирующий)
+        if (areInitialSettingsLoaded()) {
+          handleSettingsChannel();
+        }
+        
+        // Handle server settings (неблокирующий, со своим таймером; не опрашивает, пока работает канал)
         handleServerSettings();
         
         // Send status periodically (неблокирующий, со своим таймером)
         sendStatusToServer();
         
-        // Handle SD card hot-plug and recording (неблокирующий)
-        handleSDRecorder();
+        // Upload finished SD segments with bandwidth left over by the stream (неблокирующий)
+        if (areInitialSettingsLoaded()) {
+          handleSegmentUploader();
+        }
+        
+        // Serve recorded segments to operators on the LAN (неблокирующий, чтение уступает записи)
+        handlePlaybackServer();
       }
       break;
   }
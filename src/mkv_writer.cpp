@@ -0,0 +1,599 @@
+#include "mkv_writer.h"
+#include "config.h"
+#include <SD_MMC.h>
+
+// ==================== Идентификаторы элементов ====================
+static const uint32_t ID_EBML = 0x1A45DFA3;
+static const uint32_t ID_EBML_VERSION = 0x4286;
+static const uint32_t ID_EBML_READ_VERSION = 0x42F7;
+static const uint32_t ID_EBML_MAX_ID_LENGTH = 0x42F2;
+static const uint32_t ID_EBML_MAX_SIZE_LENGTH = 0x42F3;
+static const uint32_t ID_DOC_TYPE = 0x4282;
+static const uint32_t ID_DOC_TYPE_VERSION = 0x4287;
+static const uint32_t ID_DOC_TYPE_READ_VERSION = 0x4285;
+static const uint32_t ID_SEGMENT = 0x18538067;
+static const uint32_t ID_SEEK_HEAD = 0x114D9B74;
+static const uint32_t ID_SEEK = 0x4DBB;
+static const uint32_t ID_SEEK_ID = 0x53AB;
+static const uint32_t ID_SEEK_POSITION = 0x53AC;
+static const uint32_t ID_INFO = 0x1549A966;
+static const uint32_t ID_TIMESTAMP_SCALE = 0x2AD7B1;
+static const uint32_t ID_DURATION = 0x4489;
+static const uint32_t ID_MUXING_APP = 0x4D80;
+static const uint32_t ID_WRITING_APP = 0x5741;
+static const uint32_t ID_TRACKS = 0x1654AE6B;
+static const uint32_t ID_TRACK_ENTRY = 0xAE;
+static const uint32_t ID_TRACK_NUMBER = 0xD7;
+static const uint32_t ID_TRACK_UID = 0x73C5;
+static const uint32_t ID_TRACK_TYPE = 0x83;
+static const uint32_t ID_FLAG_LACING = 0x9C;
+static const uint32_t ID_CODEC_ID = 0x86;
+static const uint32_t ID_VIDEO = 0xE0;
+static const uint32_t ID_PIXEL_WIDTH = 0xB0;
+static const uint32_t ID_PIXEL_HEIGHT = 0xBA;
+static const uint32_t ID_CLUSTER = 0x1F43B675;
+static const uint32_t ID_TIMESTAMP = 0xE7;
+static const uint32_t ID_SIMPLE_BLOCK = 0xA3;
+static const uint32_t ID_CUES = 0x1C53BB6B;
+static const uint32_t ID_CUE_POINT = 0xBB;
+static const uint32_t ID_CUE_TIME = 0xB3;
+static const uint32_t ID_CUE_TRACK_POSITIONS = 0xB7;
+static const uint32_t ID_CUE_TRACK = 0xF7;
+static const uint32_t ID_CUE_CLUSTER_POSITION = 0xF1;
+static const uint32_t ID_VOID = 0xEC;
+
+static const uint8_t UNKNOWN_SIZE[8] = {0x01, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+static const size_t CLUSTER_HEADER_SIZE = 4 + 8 + 6;  // ID + размер (8 байт) + Timestamp (4 байта)
+static const size_t SIMPLE_BLOCK_HEADER_SIZE = 9;     // ID + размер (4 байта) + трек + время + флаги
+static const size_t CUE_POINT_SIZE = 19;
+static const size_t SEEK_ENTRY_SIZE = 17;             // Seek с 4-байтной позицией
+static const size_t DURATION_SIZE = 11;               // Duration (float64)
+
+// ==================== Буфер для заголовков ====================
+
+struct EbmlBuffer {
+  uint8_t data[256];
+  size_t len;
+};
+
+static void putByte(EbmlBuffer& b, uint8_t value) {
+  if (b.len < sizeof(b.data)) {
+    b.data[b.len] = value;
+  }
+  b.len++;
+}
+
+static void putId(EbmlBuffer& b, uint32_t id) {
+  if (id > 0xFFFFFF) putByte(b, id >> 24);
+  if (id > 0xFFFF) putByte(b, (id >> 16) & 0xFF);
+  if (id > 0xFF) putByte(b, (id >> 8) & 0xFF);
+  putByte(b, id & 0xFF);
+}
+
+static void putBigEndian(EbmlBuffer& b, uint64_t value, int bytes) {
+  for (int i = bytes - 1; i >= 0; i--) {
+    putByte(b, (value >> (8 * i)) & 0xFF);
+  }
+}
+
+static void putUint(EbmlBuffer& b, uint32_t id, uint32_t value) {
+  int bytes = value > 0xFFFFFF ? 4 : value > 0xFFFF ? 3 : value > 0xFF ? 2 : 1;
+  putId(b, id);
+  putByte(b, 0x80 | bytes);
+  putBigEndian(b, value, bytes);
+}
+
+static void putString(EbmlBuffer& b, uint32_t id, const char* value) {
+  size_t len = strlen(value);
+  putId(b, id);
+  putByte(b, 0x80 | len);
+  for (size_t i = 0; i < len; i++) {
+    putByte(b, value[i]);
+  }
+}
+
+// Master элемент с 2-байтным размером (закрывается endMaster)
+static size_t beginMaster(EbmlBuffer& b, uint32_t id) {
+  putId(b, id);
+  size_t pos = b.len;
+  putByte(b, 0x40);
+  putByte(b, 0x00);
+  return pos;
+}
+
+static void endMaster(EbmlBuffer& b, size_t pos) {
+  size_t size = b.len - pos - 2;
+  b.data[pos] = 0x40 | (size >> 8);
+  b.data[pos + 1] = size & 0xFF;
+}
+
+// Void заданного полного размера (резерв под элемент, который записывается при финализации)
+static void putVoid(EbmlBuffer& b, size_t totalSize) {
+  putByte(b, ID_VOID);
+  putByte(b, 0x80 | (totalSize - 2));
+  for (size_t i = 2; i < totalSize; i++) {
+    putByte(b, 0);
+  }
+}
+
+// Seek с 4-байтной позицией (SEEK_ENTRY_SIZE байт), возвращает смещение позиции
+static size_t putSeek(EbmlBuffer& b, uint32_t id, uint32_t position) {
+  size_t seek = beginMaster(b, ID_SEEK);
+  putId(b, ID_SEEK_ID);
+  putByte(b, 0x84);
+  putBigEndian(b, id, 4);
+  putId(b, ID_SEEK_POSITION);
+  putByte(b, 0x84);
+  size_t positionOffset = b.len;
+  putBigEndian(b, position, 4);
+  // Размер Seek помещается в 1 байт - сдвигаем содержимое на место второго байта размера
+  size_t size = b.len - seek - 2;
+  b.data[seek] = 0x80 | size;
+  memmove(&b.data[seek + 1], &b.data[seek + 2], size);
+  b.len--;
+  return positionOffset - 1;
+}
+
+static void setBigEndian(uint8_t* p, uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    p[i] = (value >> (8 * (bytes - 1 - i))) & 0xFF;
+  }
+}
+
+// 8-байтный размер элемента (для исправления после записи)
+static void writeSize8(File& file, uint32_t pos, uint64_t size) {
+  uint8_t bytes[8];
+  bytes[0] = 0x01;
+  setBigEndian(bytes + 1, size, 7);
+  file.seek(pos);
+  file.write(bytes, sizeof(bytes));
+}
+
+static void writeDuration(File& file, uint32_t pos, double durationMs) {
+  uint64_t bits;
+  memcpy(&bits, &durationMs, sizeof(bits));
+  uint8_t bytes[DURATION_SIZE] = {0x44, 0x89, 0x88};
+  setBigEndian(bytes + 3, bits, 8);
+  file.seek(pos);
+  file.write(bytes, sizeof(bytes));
+}
+
+// ==================== Кластеры и Cues ====================
+
+// Записать размер текущего кластера (он был открыт с неизвестным размером)
+static void closeCluster(File& file, MKVWriter& writer) {
+  writeSize8(file, writer.clusterPos + 4, writer.end - writer.clusterPos - 12);
+  file.seek(writer.end);
+}
+
+static void addCue(MKVWriter& writer, uint32_t timeMs, uint32_t position) {
+  if (writer.clusterCount % writer.cueStep != 0) {
+    return;
+  }
+  if (writer.cueCount == MKV_MAX_CUES) {
+    // Таблица заполнена - оставляем каждую вторую точку и реже добавляем новые
+    for (int i = 0; i < MKV_MAX_CUES / 2; i++) {
+      writer.cueTimes[i] = writer.cueTimes[i * 2];
+      writer.cuePositions[i] = writer.cuePositions[i * 2];
+    }
+    writer.cueCount = MKV_MAX_CUES / 2;
+    writer.cueStep *= 2;
+    if (writer.clusterCount % writer.cueStep != 0) {
+      return;
+    }
+  }
+  writer.cueTimes[writer.cueCount] = timeMs;
+  writer.cuePositions[writer.cueCount] = position;
+  writer.cueCount++;
+}
+
+static bool openCluster(File& file, MKVWriter& writer, uint32_t timeMs) {
+  if (writer.clusterPos) {
+    closeCluster(file, writer);
+  }
+
+  writer.clusterPos = writer.end;
+  addCue(writer, timeMs, writer.clusterPos - writer.segmentData);
+  writer.clusterCount++;
+  writer.clusterTime = timeMs;
+
+  uint8_t header[CLUSTER_HEADER_SIZE];
+  setBigEndian(header, ID_CLUSTER, 4);
+  memcpy(header + 4, UNKNOWN_SIZE, 8);
+  header[12] = ID_TIMESTAMP;
+  header[13] = 0x84;
+  setBigEndian(header + 14, timeMs, 4);
+  if (file.write(header, sizeof(header)) != sizeof(header)) {
+    return false;
+  }
+  writer.end += sizeof(header);
+  return true;
+}
+
+// ==================== Запись ====================
+
+bool mkvWriteHeader(File& file, MKVWriter& writer, uint16_t width, uint16_t height) {
+  memset(&writer, 0, sizeof(writer));
+  writer.cueStep = 1;
+
+  EbmlBuffer b;
+  b.len = 0;
+
+  size_t ebml = beginMaster(b, ID_EBML);
+  putUint(b, ID_EBML_VERSION, 1);
+  putUint(b, ID_EBML_READ_VERSION, 1);
+  putUint(b, ID_EBML_MAX_ID_LENGTH, 4);
+  putUint(b, ID_EBML_MAX_SIZE_LENGTH, 8);
+  putString(b, ID_DOC_TYPE, "matroska");
+  putUint(b, ID_DOC_TYPE_VERSION, 4);
+  putUint(b, ID_DOC_TYPE_READ_VERSION, 2);
+  endMaster(b, ebml);
+
+  // Segment с неизвестным размером - файл читается и без финализации
+  putId(b, ID_SEGMENT);
+  for (size_t i = 0; i < sizeof(UNKNOWN_SIZE); i++) {
+    putByte(b, UNKNOWN_SIZE[i]);
+  }
+  writer.segmentData = b.len;
+
+  size_t seekHead = beginMaster(b, ID_SEEK_HEAD);
+  size_t infoSeek = putSeek(b, ID_INFO, 0);
+  size_t tracksSeek = putSeek(b, ID_TRACKS, 0);
+  writer.seekVoidPos = b.len;
+  putVoid(b, SEEK_ENTRY_SIZE);  // Ссылка на Cues - при финализации
+  endMaster(b, seekHead);
+
+  setBigEndian(&b.data[infoSeek], b.len - writer.segmentData, 4);
+  size_t info = beginMaster(b, ID_INFO);
+  putUint(b, ID_TIMESTAMP_SCALE, 1000000);  // Время в миллисекундах
+  putString(b, ID_MUXING_APP, "esp32cam");
+  putString(b, ID_WRITING_APP, "esp32cam sd_recorder");
+  writer.durationVoidPos = b.len;
+  putVoid(b, DURATION_SIZE);  // Duration - при финализации
+  endMaster(b, info);
+
+  setBigEndian(&b.data[tracksSeek], b.len - writer.segmentData, 4);
+  size_t tracks = beginMaster(b, ID_TRACKS);
+  size_t entry = beginMaster(b, ID_TRACK_ENTRY);
+  putUint(b, ID_TRACK_NUMBER, 1);
+  putUint(b, ID_TRACK_UID, 1);
+  putUint(b, ID_TRACK_TYPE, 1);  // Видео
+  putUint(b, ID_FLAG_LACING, 0);
+  putString(b, ID_CODEC_ID, "V_MJPEG");
+  size_t video = beginMaster(b, ID_VIDEO);
+  putUint(b, ID_PIXEL_WIDTH, width);
+  putUint(b, ID_PIXEL_HEIGHT, height);
+  endMaster(b, video);
+  endMaster(b, entry);
+  endMaster(b, tracks);
+
+  if (b.len > sizeof(b.data) || file.write(b.data, b.len) != b.len) {
+    return false;
+  }
+  writer.end = b.len;
+  return true;
+}
+
+bool mkvWriteFrame(File& file, MKVWriter& writer, const uint8_t* data, size_t len, uint32_t timeMs) {
+  // Время в SimpleBlock - int16 относительно кластера
+  if (writer.clusterPos == 0 || timeMs < writer.clusterTime || timeMs - writer.clusterTime >= SD_MKV_CLUSTER_MS) {
+    if (!openCluster(file, writer, timeMs)) {
+      return false;
+    }
+  }
+
+  uint32_t size = len + 4;
+  uint32_t relative = timeMs - writer.clusterTime;
+  uint8_t header[SIMPLE_BLOCK_HEADER_SIZE];
+  header[0] = ID_SIMPLE_BLOCK;
+  header[1] = 0x10 | ((size >> 24) & 0x0F);
+  setBigEndian(header + 2, size & 0xFFFFFF, 3);
+  header[5] = 0x81;  // Трек 1
+  header[6] = (relative >> 8) & 0xFF;
+  header[7] = relative & 0xFF;
+  header[8] = 0x80;  // Ключевой кадр
+
+  if (file.write(header, sizeof(header)) != sizeof(header) || file.write(data, len) != len) {
+    return false;
+  }
+  writer.end += sizeof(header) + len;
+  writer.frames++;
+  return true;
+}
+
+bool mkvFinalize(File& file, MKVWriter& writer, uint32_t durationMs) {
+  if (!file) {
+    return false;
+  }
+  if (writer.clusterPos) {
+    closeCluster(file, writer);
+  }
+
+  // Cues в конце файла
+  uint32_t cuesPos = writer.end;
+  file.seek(cuesPos);
+  uint32_t cuesSize = writer.cueCount * CUE_POINT_SIZE;
+  uint8_t block[CUE_POINT_SIZE * 8];
+  setBigEndian(block, ID_CUES, 4);
+  block[4] = 0x10 | ((cuesSize >> 24) & 0x0F);
+  setBigEndian(block + 5, cuesSize & 0xFFFFFF, 3);
+  file.write(block, 8);
+
+  size_t used = 0;
+  for (int i = 0; i < writer.cueCount; i++) {
+    uint8_t* p = block + used;
+    p[0] = ID_CUE_POINT;
+    p[1] = 0x80 | (CUE_POINT_SIZE - 2);
+    p[2] = ID_CUE_TIME;
+    p[3] = 0x84;
+    setBigEndian(p + 4, writer.cueTimes[i], 4);
+    p[8] = ID_CUE_TRACK_POSITIONS;
+    p[9] = 0x80 | 9;
+    p[10] = ID_CUE_TRACK;
+    p[11] = 0x81;
+    p[12] = 1;
+    p[13] = ID_CUE_CLUSTER_POSITION;
+    p[14] = 0x84;
+    setBigEndian(p + 15, writer.cuePositions[i], 4);
+    used += CUE_POINT_SIZE;
+    if (used == sizeof(block) || i == writer.cueCount - 1) {
+      file.write(block, used);
+      used = 0;
+    }
+  }
+  writer.end = cuesPos + 8 + cuesSize;
+
+  // Ссылка на Cues вместо резерва в SeekHead
+  EbmlBuffer b;
+  b.len = 0;
+  putSeek(b, ID_CUES, cuesPos - writer.segmentData);
+  file.seek(writer.seekVoidPos);
+  file.write(b.data, b.len);
+
+  writeDuration(file, writer.durationVoidPos, durationMs);
+  writeSize8(file, writer.segmentData - 8, writer.end - writer.segmentData);
+  file.seek(writer.end);
+  return true;
+}
+
+// ==================== Разбор (восстановление и чтение параметров) ====================
+
+struct ElementHeader {
+  uint32_t id;
+  uint8_t idLength;
+  uint32_t sizePos;
+  uint8_t sizeLength;
+  uint32_t dataPos;
+  uint64_t size;
+  bool unknownSize;
+};
+
+static bool readElementHeader(File& file, uint32_t pos, uint32_t fileSize, ElementHeader& h) {
+  uint8_t buf[12];
+  size_t available = min((uint32_t)sizeof(buf), fileSize - pos);
+  if (pos >= fileSize || available < 2) {
+    return false;
+  }
+  file.seek(pos);
+  if (file.read(buf, available) != available) {
+    return false;
+  }
+
+  uint8_t first = buf[0];
+  h.idLength = (first & 0x80) ? 1 : (first & 0x40) ? 2 : (first & 0x20) ? 3 : (first & 0x10) ? 4 : 0;
+  if (h.idLength == 0 || h.idLength >= available) {
+    return false;
+  }
+  h.id = 0;
+  for (int i = 0; i < h.idLength; i++) {
+    h.id = (h.id << 8) | buf[i];
+  }
+
+  uint8_t marker = buf[h.idLength];
+  h.sizeLength = 0;
+  for (int i = 0; i < 8; i++) {
+    if (marker & (0x80 >> i)) {
+      h.sizeLength = i + 1;
+      break;
+    }
+  }
+  if (h.sizeLength == 0 || h.idLength + h.sizeLength > available) {
+    return false;
+  }
+  uint64_t size = marker & (0xFF >> h.sizeLength);
+  bool allOnes = size == (uint64_t)(0xFF >> h.sizeLength);
+  for (int i = 1; i < h.sizeLength; i++) {
+    uint8_t byte = buf[h.idLength + i];
+    size = (size << 8) | byte;
+    allOnes = allOnes && byte == 0xFF;
+  }
+  h.sizePos = pos + h.idLength;
+  h.dataPos = h.sizePos + h.sizeLength;
+  h.size = size;
+  h.unknownSize = allOnes;
+  return true;
+}
+
+static uint64_t readBigEndian(File& file, uint32_t pos, int bytes) {
+  uint8_t buf[8];
+  file.seek(pos);
+  file.read(buf, bytes);
+  uint64_t value = 0;
+  for (int i = 0; i < bytes; i++) {
+    value = (value << 8) | buf[i];
+  }
+  return value;
+}
+
+struct MKVScan {
+  uint32_t segmentData;      // 0 - Segment не найден
+  uint32_t segmentSizePos;
+  bool segmentSizePatchable; // Неизвестный 8-байтный размер
+  uint32_t durationVoidPos;  // Резерв Duration (0 - нет)
+  bool hasDuration;
+  double durationMs;
+  uint32_t clusterSizePos;   // Поле размера кластера, на котором остановился разбор (0 - нет)
+  uint8_t clusterSizeLength;
+  uint32_t clusterData;
+  uint32_t frames;
+  uint32_t lastTime;         // Время последнего полного кадра
+  uint32_t goodEnd;          // Конец последнего полностью записанного элемента
+};
+
+// Разобрать Info: Duration или резерв под неё
+static void scanInfo(File& file, const ElementHeader& info, uint32_t fileSize, MKVScan& scan) {
+  uint32_t pos = info.dataPos;
+  uint32_t end = info.dataPos + info.size;
+  ElementHeader h;
+  while (pos < end && readElementHeader(file, pos, fileSize, h)) {
+    if (h.id == ID_DURATION && (h.size == 4 || h.size == 8)) {
+      uint64_t bits = readBigEndian(file, h.dataPos, h.size);
+      if (h.size == 8) {
+        memcpy(&scan.durationMs, &bits, sizeof(double));
+      } else {
+        uint32_t bits32 = bits;
+        float value;
+        memcpy(&value, &bits32, sizeof(float));
+        scan.durationMs = value;
+      }
+      scan.hasDuration = true;
+    } else if (h.id == ID_VOID && h.dataPos + h.size - pos == DURATION_SIZE) {
+      scan.durationVoidPos = pos;
+    }
+    pos = h.dataPos + h.size;
+  }
+}
+
+// Обход кластера. false - файл оборван внутри кластера (дальше разбирать нечего)
+static bool scanCluster(File& file, const ElementHeader& cluster, uint32_t segmentEnd, uint32_t fileSize,
+                        MKVScan& scan, uint32_t& next) {
+  uint32_t end = cluster.unknownSize ? segmentEnd : min((uint64_t)segmentEnd, cluster.dataPos + cluster.size);
+  uint32_t pos = cluster.dataPos;
+  uint32_t clusterTime = 0;
+  scan.clusterSizePos = cluster.sizePos;
+  scan.clusterSizeLength = cluster.sizeLength;
+  scan.clusterData = cluster.dataPos;
+  scan.goodEnd = pos;
+
+  ElementHeader h;
+  while (pos < end) {
+    if (!readElementHeader(file, pos, fileSize, h) || h.unknownSize || h.dataPos + h.size > fileSize) {
+      return false;  // Оборванный элемент
+    }
+    // Кластер неизвестного размера заканчивается на следующем элементе верхнего уровня
+    if (cluster.unknownSize && h.idLength == 4) {
+      break;
+    }
+    if (h.id == ID_TIMESTAMP && h.size <= 8) {
+      clusterTime = readBigEndian(file, h.dataPos, h.size);
+    } else if (h.id == ID_SIMPLE_BLOCK && h.size >= 4) {
+      int16_t relative = (int16_t)readBigEndian(file, h.dataPos + 1, 2);
+      scan.lastTime = clusterTime + relative;
+      scan.frames++;
+    }
+    pos = h.dataPos + h.size;
+    scan.goodEnd = pos;
+  }
+  // Кластер дочитан до конца - размер исправлять не нужно
+  if (!cluster.unknownSize) {
+    scan.clusterSizePos = 0;
+  }
+  next = pos;
+  return true;
+}
+
+static bool mkvScan(File& file, MKVScan& scan) {
+  memset(&scan, 0, sizeof(scan));
+  uint32_t fileSize = file.size();
+
+  ElementHeader h;
+  if (!readElementHeader(file, 0, fileSize, h) || h.id != ID_EBML) {
+    return false;
+  }
+  uint32_t pos = h.dataPos + h.size;
+  if (!readElementHeader(file, pos, fileSize, h) || h.id != ID_SEGMENT) {
+    return false;
+  }
+  scan.segmentData = h.dataPos;
+  scan.segmentSizePos = h.sizePos;
+  scan.segmentSizePatchable = h.unknownSize && h.sizeLength == 8;
+  uint32_t segmentEnd = h.unknownSize ? fileSize : min((uint64_t)fileSize, h.dataPos + h.size);
+
+  pos = scan.segmentData;
+  scan.goodEnd = pos;
+  while (pos < segmentEnd && readElementHeader(file, pos, fileSize, h)) {
+    if (h.id == ID_CLUSTER) {
+      uint32_t next;
+      if (!scanCluster(file, h, segmentEnd, fileSize, scan, next)) {
+        break;
+      }
+      pos = h.unknownSize ? next : h.dataPos + h.size;
+      continue;
+    }
+    if (h.unknownSize || h.dataPos + h.size > fileSize) {
+      break;
+    }
+    if (h.id == ID_INFO) {
+      scanInfo(file, h, fileSize, scan);
+    }
+    pos = h.dataPos + h.size;
+    scan.goodEnd = pos;
+  }
+  return true;
+}
+
+// Длительность по времени последнего кадра + средняя длительность кадра
+static uint32_t estimateDuration(const MKVScan& scan) {
+  if (scan.frames < 2) {
+    return scan.frames * 1000 / 30;
+  }
+  return scan.lastTime + scan.lastTime / (scan.frames - 1);
+}
+
+bool mkvReadInfo(File& file, uint32_t& durationMs, uint32_t& frames) {
+  MKVScan scan;
+  if (!mkvScan(file, scan)) {
+    return false;
+  }
+  frames = scan.frames;
+  durationMs = scan.hasDuration ? (uint32_t)scan.durationMs : estimateDuration(scan);
+  return true;
+}
+
+bool recoverMKVFile(const String& tempPath, const String& finalPath, MKVRecoveryResult& result) {
+  File file = SD_MMC.open(tempPath, "r+");
+  if (!file) {
+    return false;
+  }
+
+  MKVScan scan;
+  result.originalSize = file.size();
+  result.frames = 0;
+  result.recoveredSize = 0;
+  if (!mkvScan(file, scan) || scan.frames == 0) {
+    file.close();
+    return false;
+  }
+  result.frames = scan.frames;
+  result.recoveredSize = scan.goodEnd;
+
+  // Последний кластер (открытый или оборванный) заканчивается на последнем полном кадре.
+  // Оборванный хвост остаётся за концом Segment и игнорируется плеерами
+  if (scan.clusterSizePos && scan.clusterSizeLength == 8) {
+    writeSize8(file, scan.clusterSizePos, scan.goodEnd - scan.clusterData);
+  }
+  if (scan.segmentSizePatchable) {
+    writeSize8(file, scan.segmentSizePos, scan.goodEnd - scan.segmentData);
+  }
+  if (!scan.hasDuration && scan.durationVoidPos) {
+    writeDuration(file, scan.durationVoidPos, estimateDuration(scan));
+  }
+  file.close();
+
+  if (!SD_MMC.rename(tempPath, finalPath)) {
+    return false;
+  }
+
+  Serial.printf("Recovered %s: %u frames\n", finalPath.c_str(), result.frames);
+  return true;
+}
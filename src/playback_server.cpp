@@ -0,0 +1,469 @@
+#include "playback_server.h"
+#include "config.h"
+#include "sd_recorder.h"
+#include "event_trace.h"
+#include <WiFi.h>
+#include <esp_heap_caps.h>
+
+// Состояние соединения
+enum PlaybackState {
+  PLAYBACK_IDLE,      // Нет клиента
+  PLAYBACK_REQUEST,   // Чтение заголовков запроса
+  PLAYBACK_LIST,      // Отправка списка сегментов
+  PLAYBACK_FILE,      // Отправка файла (диапазона)
+  PLAYBACK_TRACE      // Отправка дампа трассы событий
+};
+
+static WiFiServer playbackServer(PLAYBACK_PORT);
+static bool serverStarted = false;
+static WiFiClient playbackClient;
+static PlaybackState playbackState = PLAYBACK_IDLE;
+static unsigned long sessionTime = 0;
+
+// Запрос
+static char requestLine[160];
+static size_t requestLineLen = 0;
+static char requestPath[64];
+static int requestLines = 0;
+static bool requestHead = false;
+static bool requestValid = false;
+static bool requestComplete = false;     // Заголовки прочитаны, ждём свободный каталог
+static bool requestHasRange = false;
+static char rangeHeader[48];
+
+// Список: позиция в каталоге и время начала последнего отправленного сегмента
+static int listPosition = 0;
+static uint32_t listLastStart = 0;
+static bool listSeen = false;         // listLastStart задан
+static bool listFirst = true;         // Ещё ничего не отправлено (без запятой)
+static uint32_t listFrom = 0;
+static uint32_t listTo = UINT32_MAX;
+
+// Файл: отправляемый диапазон и блок с карты
+static SegmentInfo fileSegment;
+static uint32_t filePosition = 0;     // Следующий байт для чтения с карты
+static uint32_t fileEnd = 0;          // Конец диапазона (не включительно)
+static uint8_t* blockBuffer = nullptr;
+
+// Дамп трассы: трасса заморожена, пока он отправляется
+static bool traceFrozen = false;
+static uint32_t tracePosition = 0;
+static size_t blockLen = 0;
+static size_t blockSent = 0;
+
+static uint64_t bytesSent = 0;
+
+static const size_t SEND_SLICE = 4096;                // Не больше за один вызов (не задерживаем loop)
+static const int LIST_BATCH = 8;                      // Сегментов списка за вызов
+static const unsigned long REQUEST_TIMEOUT = 5000;
+static const unsigned long SESSION_TIMEOUT = 600000;  // Зависшее соединение
+
+static void closeSession() {
+  playbackClient.stop();
+  if (traceFrozen) {
+    traceUnfreeze();
+    traceFrozen = false;
+  }
+  if (blockBuffer) {
+    heap_caps_free(blockBuffer);
+    blockBuffer = nullptr;
+  }
+  playbackState = PLAYBACK_IDLE;
+}
+
+static void sendError(int status, const char* reason) {
+  char response[160];
+  int len = snprintf(response, sizeof(response),
+    "HTTP/1.1 %d %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status, reason);
+  playbackClient.write((const uint8_t*)response, len);
+  closeSession();
+}
+
+// Значение числового параметра запроса (?from=...&to=...)
+static bool getQueryValue(const char* query, const char* name, uint32_t& value) {
+  size_t nameLen = strlen(name);
+  for (const char* p = query; p && *p; p = strchr(p, '&')) {
+    if (*p == '&') p++;
+    if (strncmp(p, name, nameLen) == 0 && p[nameLen] == '=') {
+      value = strtoul(p + nameLen + 1, nullptr, 10);
+      return true;
+    }
+  }
+  return false;
+}
+
+// "bytes=a-b", "bytes=a-", "bytes=-n" (из нескольких диапазонов берётся первый)
+static bool parseRange(const char* header, uint32_t size, uint32_t& start, uint32_t& end) {
+  if (strncmp(header, "bytes=", 6) != 0 || size == 0) {
+    return false;
+  }
+  const char* spec = header + 6;
+  char* dash;
+  if (*spec == '-') {
+    uint32_t suffix = strtoul(spec + 1, nullptr, 10);
+    if (suffix == 0) {
+      return false;
+    }
+    start = suffix >= size ? 0 : size - suffix;
+    end = size;
+    return true;
+  }
+  start = strtoul(spec, &dash, 10);
+  if (*dash != '-' || start >= size) {
+    return false;
+  }
+  end = size;
+  if (dash[1] >= '0' && dash[1] <= '9') {
+    uint32_t last = strtoul(dash + 1, nullptr, 10);
+    if (last < start) {
+      return false;
+    }
+    end = min(last + 1, size);
+  }
+  return true;
+}
+
+static void startList(const char* query) {
+  listFrom = 0;
+  listTo = UINT32_MAX;
+  if (query) {
+    getQueryValue(query, "from", listFrom);
+    getQueryValue(query, "to", listTo);
+  }
+
+  const char* header =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: application/json\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Cache-Control: no-cache\r\n"
+    "Connection: close\r\n\r\n";
+  playbackClient.write((const uint8_t*)header, strlen(header));
+  if (requestHead) {
+    closeSession();
+    return;
+  }
+
+  // Длина ответа заранее неизвестна (сегменты выдаются порциями) - конец по закрытию соединения
+  playbackClient.write((const uint8_t*)"{\"segments\":[", 13);
+  listPosition = 0;
+  listLastStart = 0;
+  listSeen = false;
+  listFirst = true;
+  playbackState = PLAYBACK_LIST;
+}
+
+// Следующая порция списка
+static void sendList() {
+  SegmentInfo list[LIST_BATCH + 1];
+
+  // Читаем и предыдущую позицию: ротация удаляет старые сегменты, и список сдвигается
+  int from = listPosition > 0 ? listPosition - 1 : 0;
+  int count = readSegmentList(from, list, LIST_BATCH + 1);
+  if (count < 0) {
+    return;  // Каталог занят - в следующий раз
+  }
+  int first = 0;
+  if (listPosition > 0) {
+    if (count > 0 && listSeen && list[0].startTime > listLastStart) {
+      listPosition--;  // Ещё не отправленный сегмент сдвинулся назад
+      return;
+    }
+    first = 1;
+  }
+  if (count <= first) {
+    playbackClient.write((const uint8_t*)"]}\n", 3);
+    closeSession();
+    return;
+  }
+
+  for (int i = first; i < count; i++) {
+    const SegmentInfo& info = list[i];
+    listPosition++;
+    if (listSeen && info.startTime <= listLastStart) {
+      continue;  // Уже просмотрен (список сдвинулся)
+    }
+    listSeen = true;
+    listLastStart = info.startTime;
+    uint32_t end = info.startTime + (info.durationMs + 999) / 1000;
+    if (end < listFrom || info.startTime > listTo) {
+      continue;
+    }
+
+    char entry[256];
+    int len = snprintf(entry, sizeof(entry),
+      "%s{\"name\":\"%s\",\"start\":%lu,\"end\":%lu,\"duration_ms\":%lu,\"bytes\":%lu,\"frames\":%lu,"
+      "\"clock\":\"%s\",\"uploaded\":%s}",
+      listFirst ? "" : ",", getSegmentFileName(info).c_str(), (unsigned long)info.startTime,
+      (unsigned long)end, (unsigned long)info.durationMs, (unsigned long)info.bytes,
+      (unsigned long)info.frames, (info.flags & SEGMENT_FLAG_WALLCLOCK) ? "unix" : "uptime",
+      (info.flags & SEGMENT_FLAG_UPLOADED) ? "true" : "false");
+    if (playbackClient.write((const uint8_t*)entry, len) != (size_t)len) {
+      closeSession();
+      return;
+    }
+    listFirst = false;
+  }
+}
+
+static void startFile(const char* name) {
+  int found = findSegmentByName(name, fileSegment);
+  if (found == 0) {
+    return;  // Каталог занят - в следующий раз (запрос остаётся в PLAYBACK_REQUEST)
+  }
+  if (found < 0) {
+    sendError(404, "Not Found");
+    return;
+  }
+
+  uint32_t size = fileSegment.bytes;
+  uint32_t start = 0;
+  uint32_t end = size;
+  bool partial = false;
+  if (requestHasRange) {
+    if (!parseRange(rangeHeader, size, start, end)) {
+      char response[160];
+      int len = snprintf(response, sizeof(response),
+        "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lu\r\nContent-Length: 0\r\n"
+        "Connection: close\r\n\r\n", (unsigned long)size);
+      playbackClient.write((const uint8_t*)response, len);
+      closeSession();
+      return;
+    }
+    partial = true;
+  }
+
+  char header[384];
+  int len = snprintf(header, sizeof(header),
+    "HTTP/1.1 %s\r\n"
+    "Content-Type: %s\r\n"
+    "Content-Length: %lu\r\n"
+    "Accept-Ranges: bytes\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Connection: close\r\n",
+    partial ? "206 Partial Content" : "200 OK",
+    (fileSegment.flags & SEGMENT_FLAG_MKV) ? "video/x-matroska" : "video/x-msvideo",
+    (unsigned long)(end - start));
+  if (partial) {
+    len += snprintf(header + len, sizeof(header) - len, "Content-Range: bytes %lu-%lu/%lu\r\n",
+                    (unsigned long)start, (unsigned long)(end - 1), (unsigned long)size);
+  }
+  len += snprintf(header + len, sizeof(header) - len, "\r\n");
+  playbackClient.write((const uint8_t*)header, len);
+
+  if (requestHead || start == end) {
+    closeSession();
+    return;
+  }
+
+  // Буфер блока - во внутренней DMA памяти (SD_MMC читает без промежуточного копирования)
+  blockBuffer = (uint8_t*)heap_caps_malloc(PLAYBACK_BLOCK_SIZE, MALLOC_CAP_DMA);
+  if (!blockBuffer) {
+    closeSession();
+    return;
+  }
+  filePosition = start;
+  fileEnd = end;
+  blockLen = 0;
+  blockSent = 0;
+  playbackState = PLAYBACK_FILE;
+}
+
+// Следующий кусок файла: блок с карты (по границе PLAYBACK_BLOCK_SIZE), затем в сокет частями
+static void sendFile() {
+  if (blockSent == blockLen) {
+    if (filePosition >= fileEnd) {
+      closeSession();
+      return;
+    }
+    // Первый блок диапазона - до ближайшей границы, дальше чтения выровнены
+    size_t len = PLAYBACK_BLOCK_SIZE - filePosition % PLAYBACK_BLOCK_SIZE;
+    len = min(len, (size_t)(fileEnd - filePosition));
+    int read = readSegmentData(fileSegment, filePosition, blockBuffer, len);
+    if (read == 0) {
+      return;  // Карта нужна записи - в следующий раз
+    }
+    if (read < 0) {
+      closeSession();  // Сегмент удалён ротацией
+      return;
+    }
+    blockLen = read;
+    blockSent = 0;
+    filePosition += read;
+  }
+
+  size_t slice = min(blockLen - blockSent, SEND_SLICE);
+  size_t written = playbackClient.write(blockBuffer + blockSent, slice);
+  if (written == 0) {
+    closeSession();
+    return;
+  }
+  blockSent += written;
+  bytesSent += written;
+}
+
+static void startTrace() {
+  traceFreeze();
+  traceFrozen = true;
+  tracePosition = 0;
+
+  char header[192];
+  int len = snprintf(header, sizeof(header),
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: application/octet-stream\r\n"
+    "Content-Length: %lu\r\n"
+    "Content-Disposition: attachment; filename=\"trace.bin\"\r\n"
+    "Connection: close\r\n\r\n",
+    (unsigned long)traceDumpSize());
+  playbackClient.write((const uint8_t*)header, len);
+  if (requestHead) {
+    closeSession();
+    return;
+  }
+  playbackState = PLAYBACK_TRACE;
+}
+
+// Следующий кусок дампа (не больше SEND_SLICE за вызов)
+static void sendTrace() {
+  uint8_t chunk[512];
+  uint32_t size = traceDumpSize();
+  size_t sliceSent = 0;
+  while (sliceSent < SEND_SLICE && tracePosition < size) {
+    size_t len = traceRead(tracePosition, chunk, sizeof(chunk));
+    size_t written = len > 0 ? playbackClient.write(chunk, len) : 0;
+    if (written == 0) {
+      closeSession();
+      return;
+    }
+    tracePosition += written;
+    sliceSent += written;
+  }
+  if (tracePosition >= size) {
+    closeSession();
+  }
+}
+
+// Запрос прочитан: маршрутизация
+static void routeRequest() {
+  if (!requestValid) {
+    sendError(400, "Bad Request");
+    return;
+  }
+
+  char* query = strchr(requestPath, '?');
+  if (query) {
+    *query++ = 0;
+  }
+  if (strcmp(requestPath, "/records") == 0 || strcmp(requestPath, "/records/") == 0) {
+    startList(query);
+  } else if (strncmp(requestPath, "/records/", 9) == 0) {
+    startFile(requestPath + 9);
+  } else if (strcmp(requestPath, "/trace") == 0) {
+    startTrace();
+  } else {
+    sendError(404, "Not Found");
+  }
+}
+
+// Строка запроса или заголовка
+static bool parseRequestLine() {
+  requestLine[requestLineLen] = 0;
+  if (requestLineLen > 0 && requestLine[requestLineLen - 1] == '\r') {
+    requestLine[--requestLineLen] = 0;
+  }
+  requestLineLen = 0;
+
+  if (requestLines++ == 0) {
+    // "GET /records/001.mkv HTTP/1.1"
+    char method[8];
+    requestValid = sscanf(requestLine, "%7s %63s", method, requestPath) == 2;
+    requestHead = requestValid && strcmp(method, "HEAD") == 0;
+    if (requestValid && !requestHead && strcmp(method, "GET") != 0) {
+      sendError(405, "Method Not Allowed");
+    }
+  } else if (requestLine[0] == 0) {
+    requestComplete = true;  // Конец заголовков
+    return true;
+  } else if (strncasecmp(requestLine, "Range:", 6) == 0) {
+    const char* value = requestLine + 6;
+    while (*value == ' ') value++;
+    strncpy(rangeHeader, value, sizeof(rangeHeader) - 1);
+    rangeHeader[sizeof(rangeHeader) - 1] = 0;
+    requestHasRange = true;
+  }
+  return false;
+}
+
+static void readRequest(unsigned long now) {
+  while (playbackState == PLAYBACK_REQUEST && playbackClient.available()) {
+    int c = playbackClient.read();
+    if (c == '\n') {
+      if (parseRequestLine() && playbackState == PLAYBACK_REQUEST) {
+        routeRequest();
+        return;
+      }
+    } else if (c >= 0 && requestLineLen < sizeof(requestLine) - 1) {
+      requestLine[requestLineLen++] = c;
+    }
+  }
+
+  if (playbackState == PLAYBACK_REQUEST && now - sessionTime > REQUEST_TIMEOUT) {
+    closeSession();
+  }
+}
+
+void handlePlaybackServer() {
+#if PLAYBACK_SERVER_ENABLED
+  if (!serverStarted) {
+    playbackServer.begin();
+    serverStarted = true;
+    Serial.printf("Playback server on port %d\n", PLAYBACK_PORT);
+  }
+
+  unsigned long now = millis();
+
+  switch (playbackState) {
+    case PLAYBACK_IDLE:
+      playbackClient = playbackServer.available();
+      if (playbackClient) {
+        playbackState = PLAYBACK_REQUEST;
+        sessionTime = now;
+        requestLineLen = 0;
+        requestLines = 0;
+        requestPath[0] = 0;
+        requestValid = false;
+        requestComplete = false;
+        requestHead = false;
+        requestHasRange = false;
+      }
+      break;
+
+    case PLAYBACK_REQUEST:
+      if (requestComplete) {
+        routeRequest();  // Каталог был занят - повторяем
+      } else {
+        readRequest(now);
+      }
+      break;
+
+    case PLAYBACK_LIST:
+      sendList();
+      break;
+
+    case PLAYBACK_FILE:
+      sendFile();
+      break;
+
+    case PLAYBACK_TRACE:
+      sendTrace();
+      break;
+  }
+
+  if (playbackState != PLAYBACK_IDLE && (!playbackClient.connected() || now - sessionTime > SESSION_TIMEOUT)) {
+    closeSession();
+  }
+#endif
+}
+
+uint32_t getPlaybackSentKB() {
+  return (uint32_t)(bytesSent / 1024);
+}
@@ -0,0 +1,78 @@
+#include "sd_bench.h"
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static const uint32_t BLOCK_SIZES[SD_BENCH_BLOCK_SIZES] = {4096, 8192, 16384, 32768};
+
+static int compareUs(const void* a, const void* b) {
+  uint32_t x = *(const uint32_t*)a;
+  uint32_t y = *(const uint32_t*)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Один проход: файл из totalBytes блоками blockSize
+static bool benchBlockSize(fs::FS& fs, const char* path, uint32_t totalBytes, uint32_t blockSize,
+                           uint8_t* buffer, uint32_t* latencies, SDBenchResult& result) {
+  File file = fs.open(path, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+
+  uint32_t blocks = totalBytes / blockSize;
+  int64_t start = esp_timer_get_time();
+  for (uint32_t i = 0; i < blocks; i++) {
+    int64_t t = esp_timer_get_time();
+    if (file.write(buffer, blockSize) != blockSize) {
+      file.close();
+      fs.remove(path);
+      return false;
+    }
+    latencies[i] = (uint32_t)(esp_timer_get_time() - t);
+  }
+  file.flush();
+  file.close();
+  int64_t elapsed = esp_timer_get_time() - start;
+  fs.remove(path);
+
+  qsort(latencies, blocks, sizeof(uint32_t), compareUs);
+  result.blockSize = blockSize;
+  result.kbPerSec = elapsed > 0 ? (uint32_t)((uint64_t)blocks * blockSize * 1000000 / 1024 / elapsed) : 0;
+  result.p99Us = latencies[(blocks * 99) / 100];
+  result.maxUs = latencies[blocks - 1];
+  return true;
+}
+
+int runSDBenchmark(fs::FS& fs, const char* path, uint32_t totalBytes, SDBenchResult* results) {
+  uint32_t maxBlock = BLOCK_SIZES[SD_BENCH_BLOCK_SIZES - 1];
+  if (totalBytes < maxBlock) {
+    return 0;
+  }
+
+  // DMA буфер - измеряется шина, а не копирование драйвером через промежуточный буфер
+  uint8_t* buffer = (uint8_t*)heap_caps_malloc(maxBlock, MALLOC_CAP_DMA);
+  uint32_t* latencies = (uint32_t*)malloc((totalBytes / BLOCK_SIZES[0]) * sizeof(uint32_t));
+  if (!buffer || !latencies) {
+    heap_caps_free(buffer);
+    free(latencies);
+    return 0;
+  }
+  // Ненулевые данные, как у кадров
+  for (uint32_t i = 0; i < maxBlock; i++) {
+    buffer[i] = (uint8_t)(i * 131 + (i >> 8));
+  }
+
+  int count = 0;
+  for (int i = 0; i < SD_BENCH_BLOCK_SIZES; i++) {
+    if (!benchBlockSize(fs, path, totalBytes, BLOCK_SIZES[i], buffer, latencies, results[count])) {
+      break;
+    }
+    Serial.printf("SD bench %2luKB: %lu KB/s, p99 %lu us, max %lu us\n",
+                  (unsigned long)(BLOCK_SIZES[i] / 1024), (unsigned long)results[count].kbPerSec,
+                  (unsigned long)results[count].p99Us, (unsigned long)results[count].maxUs);
+    count++;
+  }
+
+  heap_caps_free(buffer);
+  free(latencies);
+  return count;
+}
@@ -1,8 +1,24 @@
 #include "sd_recorder.h"
+#include "segment_catalog.h"
+#include "frame_ring.h"
+#include "avi_recovery.h"
+#include "mkv_writer.h"
+#include "sd_bench.h"
 #include "config.h"
+#include "settings_store.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
 #include <SD_MMC.h>
 #include <FS.h>
 #include <Preferences.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+// В 4-bit режиме GPIO4, 12 и 13 - линии данных карты
+#if SD_BUS_WIDTH == 4 && (SD_TRIGGER_GPIO == 4 || SD_TRIGGER_GPIO == 12 || SD_TRIGGER_GPIO == 13)
+#error "SD_TRIGGER_GPIO conflicts with SD_BUS_WIDTH 4 (GPIO4/12/13 are SD data lines)"
+#endif
 
 // ==================== Настройки записи ====================
 static const int DEFAULT_RECORDING_INTERVAL = 10;  // Интервал записи в секундах
@@ -10,16 +26,39 @@ static const int MAX_FILES = 1000;                 // Максимальное 
 static const unsigned long MIN_FREE_SPACE = 10 * 1024 * 1024;  // 10MB минимум свободного места
 static const char* RECORD_DIR = "/records";        // Папка для записей
 static const char* TEMP_SUFFIX = ".tmp";           // Суффикс для временных файлов
+static const char* BENCH_PATH = "/sdbench.tmp";    // Файл теста скорости карты
 
 // ==================== NVS для настроек ====================
 static Preferences recPrefs;
 
+// ==================== Шина SD_MMC ====================
+static int sdBusWidth = SD_BUS_WIDTH;   // Настройка (NVS), применяется при монтировании
+static int mountedBusWidth = 0;         // Фактический режим (0 - карта не смонтирована)
+
+// Тест скорости карты (выполняет фоновая задача, запись на это время приостановлена)
+static volatile SDBenchState benchState = SD_BENCH_IDLE;
+static SDBenchResult benchResults[SD_BENCH_BLOCK_SIZES];
+static int benchResultCount = 0;
+static int benchBusWidth = 0;
+
 // ==================== Состояние модуля ====================
 static bool sdCardPresent = false;
 static bool sdCardWasPresent = false;  // Для отслеживания извлечения/вставки
 static bool recordingEnabled = false;
 static bool isCurrentlyRecording = false;
 static int recordingInterval = DEFAULT_RECORDING_INTERVAL;
+static int recordingFps = SD_RECORDING_FPS;          // 0 = частота захвата стриминга
+static int recordingEveryN = SD_RECORDING_EVERY_N;   // Прореживание: каждый N-й кадр
+static int segmentMaxMB = SD_SEGMENT_MAX_MB;         // 0 = сегменты только по времени
+static unsigned long framesOffered = 0;              // Кадров передано в recordFrame (для прореживания)
+static RecordingContainer recordingContainer = (RecordingContainer)SD_CONTAINER;
+
+// Timelapse
+static int timelapseInterval = SD_TIMELAPSE_INTERVAL;
+static int timelapseFps = SD_TIMELAPSE_FPS;
+static int timelapseSegmentHours = SD_TIMELAPSE_SEGMENT_HOURS;
+static int timelapseFrameSize = SD_TIMELAPSE_FRAMESIZE;
+static bool currentSegmentTimelapse = false;  // Файл текущего сегмента закрыт между кадрами
 static unsigned long lastCardCheck = 0;
 static const unsigned long CARD_CHECK_INTERVAL = 5000;  // Проверка карты каждые 5 секунд
 static int cardCheckFailCount = 0;  // Счётчик неудачных проверок для debounce
@@ -30,10 +69,28 @@ static File currentFile;
 static String currentFilePath = "";
 static String currentTempPath = "";
 static unsigned long recordingStartTime = 0;
+static uint32_t recordingStartStamp = 0;  // Время начала сегмента для каталога
+static uint8_t recordingStartFlags = 0;
 static unsigned long framesInCurrentFile = 0;
 static unsigned long totalFramesRecorded = 0;
 static unsigned long totalFilesCreated = 0;
 static bool recordingBusy = false;  // Флаг для предотвращения блокировки при долгих операциях
+static unsigned long firstFrameTime = 0;  // millis() захвата первого кадра сегмента
+static unsigned long lastFrameTime = 0;   // millis() захвата последнего кадра сегмента
+static unsigned long lastSyncTime = 0;    // Последняя синхронизация файла (flush)
+
+// ==================== Запись по событию ====================
+static const int PREEVENT_DRAIN_FRAMES = 4;  // Сколько кадров буфера писать за вызов (без долгой блокировки)
+static RecordingMode recordingMode = (RecordingMode)SD_RECORDING_MODE;
+static int preEventSeconds = SD_PREEVENT_SECONDS;
+static int postRollSeconds = SD_POSTROLL_SECONDS;
+static int motionThreshold = SD_MOTION_THRESHOLD;
+static FrameRing preEventRing = {};
+static bool eventActive = false;
+static unsigned long eventEndTime = 0;       // Конец post-roll (продлевается повторным событием)
+static const char* lastEventSource = "";
+static unsigned long eventCount = 0;
+static float motionAvgLen = 0;               // Скользящее среднее размера JPEG
 
 // AVI параметры
 static uint32_t aviMoviOffset = 0;  // Смещение до movi секции
@@ -41,24 +98,95 @@ static uint32_t aviTotalFrameSize = 0;  // Общий размер всех ка
 static uint16_t aviWidth = 1280;  // Ширина видео (будет определено из первого кадра)
 static uint16_t aviHeight = 720;  // Высота видео
 
-// Счетчик файлов
+// MKV параметры текущего сегмента
+static uint8_t currentContainerFlags = 0;  // SEGMENT_FLAG_MKV - сегмент в Matroska
+static MKVWriter currentMkv;
+
+// Счетчик файлов (старейший сегмент и количество берутся из каталога)
 static int currentFileIndex = 0;
-static int oldestFileIndex = 1;
-static int newestFileIndex = 0;
+static int newestFileIndex = 0;        // Номер последнего открытого сегмента
+static uint32_t currentFileBytes = 0;  // Размер текущего файла (для учёта места)
+
+// ==================== Учёт свободного места ====================
+// SD_MMC.totalBytes()/usedBytes() на FAT32 могут обходить всю FAT, поэтому
+// занятое место считаем сами (запись, удаление, округление до кластера),
+// а с файловой системой сверяемся редко и из фоновой задачи.
+static const unsigned long SPACE_RESYNC_INTERVAL = 1800000;      // Сверка раз в 30 минут (вне записи)
+static const unsigned long SPACE_RESYNC_MAX_INTERVAL = 21600000; // Во время записи - не реже раза в 6 часов
+static portMUX_TYPE spaceLock = portMUX_INITIALIZER_UNLOCKED;
+static uint64_t cardTotalBytes = 0;
+static uint64_t cardUsedBytes = 0;     // Последняя сверка + изменения с тех пор
+static int64_t spaceAdjustments = 0;   // Сумма всех изменений (для сверки во время записи)
+static volatile bool spaceKnown = false;
+static volatile bool spaceResyncRequested = false;
+static volatile bool traceDumpRequested = false;
+static unsigned long lastSpaceResync = 0;
+static TaskHandle_t sdTaskHandle = nullptr;
+
+// ==================== Смена сегментов без потери кадров ====================
+// Следующий сегмент открывается заранее в фоновой задаче, а завершение старого
+// (заголовок, close, rename, каталог) выполняется там же - в loop остаётся только обмен файлов
+enum NextSegmentState {
+  NEXT_SEGMENT_EMPTY = 0,
+  NEXT_SEGMENT_REQUESTED,   // Фоновая задача открывает файл
+  NEXT_SEGMENT_READY        // Файл открыт, заголовок записан
+};
+
+struct PreparedSegment {
+  File file;
+  int index;
+  uint8_t flags;        // SEGMENT_FLAG_MKV - контейнер сегмента
+  uint32_t bytes;       // Размер заголовка
+  MKVWriter mkv;
+};
+
+struct ClosingSegment {
+  File file;
+  SegmentInfo info;
+  uint32_t dataSize;    // Размер данных movi
+  uint32_t bytes;       // Размер файла (для учёта места при ошибке)
+  uint32_t playbackMs;  // Длительность для частоты в заголовке (0 - оставить частоту заголовка, timelapse)
+  MKVWriter mkv;
+};
+
+static PreparedSegment nextSegment;
+static volatile NextSegmentState nextSegmentState = NEXT_SEGMENT_EMPTY;
+static unsigned long nextSegmentRetryTime = 0;  // После ошибки открытия - пауза перед повтором
+static ClosingSegment closingSegment;
+static volatile bool closingPending = false;
+static SemaphoreHandle_t segmentMutex = nullptr;  // Каталог и файлы сегментов (loop и фоновая задача)
+static const unsigned long NEXT_SEGMENT_RETRY_INTERVAL = 1000;
+
+// Открытые на чтение сегменты (выгрузка, воспроизведение): без open/seek по цепочке FAT на каждый блок.
+// Используются под segmentMutex; закрываются перед удалением файла
+struct SegmentReader {
+  File file;
+  uint16_t index;         // 0 - слот свободен
+  uint32_t startTime;
+  uint32_t position;
+  unsigned long lastUse;
+};
+static const int SEGMENT_READERS = 2;
+static SegmentReader segmentReaders[SEGMENT_READERS];
 
 // ==================== Вспомогательные функции ====================
 
+// Расширение по контейнеру сегмента
+static const char* getFileExtension(uint8_t flags) {
+  return (flags & SEGMENT_FLAG_MKV) ? ".mkv" : ".avi";
+}
+
 // Формирование имени файла по индексу
-static String getFileName(int index) {
+static String getFileName(int index, uint8_t flags) {
   char name[20];
-  snprintf(name, sizeof(name), "/%03d.avi", index);
+  snprintf(name, sizeof(name), "/%03d%s", index, getFileExtension(flags));
   return String(RECORD_DIR) + name;
 }
 
 // Формирование имени временного файла по индексу
-static String getTempFileName(int index) {
+static String getTempFileName(int index, uint8_t flags) {
   char name[25];
-  snprintf(name, sizeof(name), "/%03d.avi%s", index, TEMP_SUFFIX);
+  snprintf(name, sizeof(name), "/%03d%s%s", index, getFileExtension(flags), TEMP_SUFFIX);
   return String(RECORD_DIR) + name;
 }
 
@@ -67,6 +195,13 @@ static bool fileExists(const String& path) {
   return SD_MMC.exists(path);
 }
 
+// Метка времени для каталога: unix time, если часы синхронизированы (иначе секунды с загрузки)
+static uint32_t getTimestamp(uint8_t& flags) {
+  time_t now = time(nullptr);
+  flags = (now > 1600000000) ? SEGMENT_FLAG_WALLCLOCK : 0;
+  return (uint32_t)now;
+}
+
 // Удаление файла
 static bool deleteFile(const String& path) {
   if (SD_MMC.exists(path)) {
@@ -75,9 +210,76 @@ static bool deleteFile(const String& path) {
   return true;
 }
 
-// Получить свободное место на SD карте (байты)
-static unsigned long getFreeSpace() {
-  return SD_MMC.totalBytes() - SD_MMC.usedBytes();
+// Округление размера файла до целых кластеров
+static uint64_t clusterAlign(uint64_t bytes) {
+  return (bytes + SD_CLUSTER_SIZE - 1) / SD_CLUSTER_SIZE * SD_CLUSTER_SIZE;
+}
+
+static void adjustUsedSpace(int64_t delta) {
+  portENTER_CRITICAL(&spaceLock);
+  cardUsedBytes += delta;
+  spaceAdjustments += delta;
+  portEXIT_CRITICAL(&spaceLock);
+}
+
+// Учесть дозапись в файл (новый кластер выделяется при пересечении границы)
+static void accountFileGrowth(uint64_t oldSize, uint64_t newSize) {
+  uint64_t delta = clusterAlign(newSize) - clusterAlign(oldSize);
+  if (delta > 0) {
+    adjustUsedSpace((int64_t)delta);
+  }
+}
+
+// Учесть удаление файла
+static void accountFileRemoved(uint64_t size) {
+  adjustUsedSpace(-(int64_t)clusterAlign(size));
+}
+
+// Сверка с файловой системой (медленно - только при монтировании и из фоновой задачи)
+static void resyncFreeSpace() {
+  portENTER_CRITICAL(&spaceLock);
+  int64_t adjustmentsBefore = spaceAdjustments;
+  portEXIT_CRITICAL(&spaceLock);
+  
+  uint64_t total = SD_MMC.totalBytes();
+  uint64_t used = SD_MMC.usedBytes();
+  
+  // Изменения, учтённые во время сверки, добавляем поверх результата
+  portENTER_CRITICAL(&spaceLock);
+  cardTotalBytes = total;
+  cardUsedBytes = used + (spaceAdjustments - adjustmentsBefore);
+  portEXIT_CRITICAL(&spaceLock);
+  
+  spaceKnown = true;
+  lastSpaceResync = millis();
+}
+
+// Разбудить фоновую задачу
+static void notifyMaintenanceTask() {
+  if (sdTaskHandle) {
+    xTaskNotifyGive(sdTaskHandle);
+  }
+}
+
+// Запросить сверку из фоновой задачи
+static void requestSpaceResync() {
+  spaceResyncRequested = true;
+  notifyMaintenanceTask();
+}
+
+// Получить свободное место на SD карте (байты, по учёту без обращения к ФС)
+static uint64_t getFreeSpace() {
+  portENTER_CRITICAL(&spaceLock);
+  uint64_t freeBytes = cardUsedBytes < cardTotalBytes ? cardTotalBytes - cardUsedBytes : 0;
+  portEXIT_CRITICAL(&spaceLock);
+  return freeBytes;
+}
+
+static uint64_t getUsedSpace() {
+  portENTER_CRITICAL(&spaceLock);
+  uint64_t usedBytes = min(cardUsedBytes, cardTotalBytes);
+  portEXIT_CRITICAL(&spaceLock);
+  return usedBytes;
 }
 
 // Записать 32-битное значение в little-endian
@@ -180,13 +382,22 @@ static bool writeAVIHeader(File& file, uint16_t width, uint16_t height, uint32_t
 }
 
 // Обновить AVI заголовок с финальными значениями
-static bool finalizeAVIHeader(File& file, uint32_t frameCount, uint32_t totalDataSize) {
+static bool finalizeAVIHeader(File& file, uint32_t frameCount, uint32_t totalDataSize, uint32_t durationMs) {
   if (!file) return false;
   
   // Обновляем RIFF размер
   file.seek(4);
   write32LE(file, file.size() - 8);
   
+  // Реальная частота кадров по времени захвата (пред-событийные кадры, переменный FPS)
+  if (frameCount > 1 && durationMs > 0) {
+    file.seek(32);
+    write32LE(file, (uint64_t)durationMs * 1000 / frameCount);  // Микросекунд на кадр
+    file.seek(128);
+    write32LE(file, 1000);  // Scale
+    write32LE(file, (uint64_t)frameCount * 1000000 / durationMs);  // Rate (FPS * 1000)
+  }
+  
   // Обновляем количество кадров в avih
   file.seek(48);
   write32LE(file, frameCount);
@@ -202,6 +413,15 @@ static bool finalizeAVIHeader(File& file, uint32_t frameCount, uint32_t totalDat
   return true;
 }
 
+// Длительность сегмента по времени захвата кадров (+ длительность последнего кадра)
+static uint32_t segmentDurationMs() {
+  if (framesInCurrentFile < 2) {
+    return framesInCurrentFile * 1000 / 30;
+  }
+  uint32_t span = lastFrameTime - firstFrameTime;
+  return span + span / (framesInCurrentFile - 1);
+}
+
 // Найти следующий доступный индекс для нового файла
 static int findNextFileIndex() {
   // Ищем первый свободный индекс или самый старый файл
@@ -212,32 +432,46 @@ static int findNextFileIndex() {
   return nextIndex;
 }
 
+// Закрыть открытые на чтение файлы сегмента (0 - все)
+static void closeSegmentReaders(uint16_t index) {
+  for (int i = 0; i < SEGMENT_READERS; i++) {
+    if (segmentReaders[i].index && (index == 0 || segmentReaders[i].index == index)) {
+      segmentReaders[i].file.close();
+      segmentReaders[i].file = File();
+      segmentReaders[i].index = 0;
+    }
+  }
+}
+
 // Удалить самый старый файл для освобождения места
 static bool deleteOldestFile() {
-  // Ищем самый старый файл
-  for (int i = 0; i < MAX_FILES; i++) {
-    int index = oldestFileIndex + i;
-    if (index > MAX_FILES) {
-      index = index - MAX_FILES;
-    }
-    
-    String path = getFileName(index);
-    if (fileExists(path)) {
-      if (deleteFile(path)) {
-        Serial.println("Deleted oldest file: " + path);
-        oldestFileIndex = index + 1;
-        if (oldestFileIndex > MAX_FILES) {
-          oldestFileIndex = 1;
-        }
-        return true;
-      }
-    }
+  // Самый старый сегмент берём из каталога (без перебора имён через exists()).
+  // Сначала - уже выгруженные на сервер; невыгруженные - только когда выгруженных не осталось
+  SegmentInfo oldest;
+  if (!catalogOldestWithFlag(SEGMENT_FLAG_UPLOADED, true, oldest) && !catalogOldestSegment(oldest)) {
+    return false;
   }
-  return false;
+  
+  String path = getFileName(oldest.index, oldest.flags);
+  closeSegmentReaders(oldest.index);
+  if (!SD_MMC.remove(path) && fileExists(path)) {
+    return false;
+  }
+  
+  // Файл удалён (или был удалён вручную) - убираем из каталога
+  catalogSegmentDeleted(oldest.index);
+  accountFileRemoved(oldest.bytes);
+  Serial.println("Deleted oldest file: " + path);
+  return true;
 }
 
 // Освободить место если нужно
 static bool ensureFreeSpace() {
+  // После вставки карты ждём первой сверки в фоновой задаче
+  if (!spaceKnown) {
+    return false;
+  }
+  
   int attempts = 0;
   while (getFreeSpace() < MIN_FREE_SPACE && attempts < 10) {
     if (!deleteOldestFile()) {
@@ -249,89 +483,565 @@ static bool ensureFreeSpace() {
   return getFreeSpace() >= MIN_FREE_SPACE;
 }
 
-// Удалить все временные файлы (незавершенные записи)
+// Каталог и файлы сегментов меняют loop и фоновая задача
+static void lockSegments() {
+  if (segmentMutex) {
+    xSemaphoreTake(segmentMutex, portMAX_DELAY);
+  }
+}
+
+// Без ожидания - для необязательных операций из loop (выгрузка на сервер)
+static bool tryLockSegments() {
+  return !segmentMutex || xSemaphoreTake(segmentMutex, 0) == pdTRUE;
+}
+
+static void unlockSegments() {
+  if (segmentMutex) {
+    xSemaphoreGive(segmentMutex);
+  }
+}
+
+// Открыть новый сегмент и записать заголовок (под lockSegments)
+static bool openSegmentFile(PreparedSegment& segment, uint32_t fps = 30) {
+  // Проверяем свободное место
+  if (!ensureFreeSpace()) {
+    return false;
+  }
+  
+  int index = findNextFileIndex();
+  
+  // Номер мог остаться от предыдущего круга нумерации - удаляем старый сегмент
+  SegmentInfo previous;
+  if (catalogFindSegment(index, previous)) {
+    closeSegmentReaders(index);
+    deleteFile(getFileName(index, previous.flags));
+    catalogSegmentDeleted(index);
+    accountFileRemoved(previous.bytes);
+  }
+  
+  // Отмечаем начало записи в каталоге (FILE_WRITE перезапишет остаток .tmp)
+  catalogSegmentOpened(index);
+  
+  uint8_t flags = (recordingContainer == RECORDING_MKV) ? SEGMENT_FLAG_MKV : 0;
+  File file = SD_MMC.open(getTempFileName(index, flags), FILE_WRITE);
+  if (!file) {
+    catalogSegmentDeleted(index);
+    return false;
+  }
+  
+  if (flags & SEGMENT_FLAG_MKV) {
+    // Время кадров пишется в блоки - частота в заголовке не нужна
+    mkvWriteHeader(file, segment.mkv, aviWidth, aviHeight);
+  } else {
+    // Записываем AVI заголовок (разрешение будет определено из первого кадра)
+    // По умолчанию 30 FPS как среднее значение - при завершении заменяется реальной частотой
+    writeAVIHeader(file, aviWidth, aviHeight, fps);
+  }
+  
+  segment.file = file;
+  segment.index = index;
+  segment.flags = flags;
+  segment.bytes = file.position();
+  accountFileGrowth(0, segment.bytes);
+  newestFileIndex = index;
+  return true;
+}
+
+// Задание фоновой задачи: открыть следующий сегмент заранее
+static void prepareNextSegment() {
+  if (nextSegmentState != NEXT_SEGMENT_REQUESTED) {
+    return;  // Отменено (извлечение карты)
+  }
+  
+  if (sdCardPresent && openSegmentFile(nextSegment)) {
+    nextSegmentState = NEXT_SEGMENT_READY;
+    return;
+  }
+  nextSegmentRetryTime = millis() + NEXT_SEGMENT_RETRY_INTERVAL;
+  nextSegmentState = NEXT_SEGMENT_EMPTY;
+}
+
+// Задание фоновой задачи: завершить сегмент (заголовок, close, rename, каталог)
+static void finalizeClosingSegment() {
+  if (!closingPending) {
+    return;
+  }
+  
+  ClosingSegment& segment = closingSegment;
+  String tempPath = getTempFileName(segment.info.index, segment.info.flags);
+  
+  if (segment.file && segment.info.frames > 0) {
+    if (segment.info.flags & SEGMENT_FLAG_MKV) {
+      mkvFinalize(segment.file, segment.mkv, segment.playbackMs);
+    } else {
+      finalizeAVIHeader(segment.file, segment.info.frames, segment.dataSize, segment.playbackMs);
+    }
+    segment.info.bytes = segment.file.size();
+    segment.file.close();
+    
+    // Переименовываем из .tmp в .avi/.mkv (это быстрая операция)
+    if (SD_MMC.rename(tempPath, getFileName(segment.info.index, segment.info.flags))) {
+      totalFilesCreated++;
+      catalogSegmentClosed(segment.info);
+    } else {
+      deleteFile(tempPath);
+      catalogSegmentDeleted(segment.info.index);
+      accountFileRemoved(segment.info.bytes);
+    }
+  } else {
+    // Нет кадров - закрываем и удаляем пустой файл
+    if (segment.file) {
+      segment.file.close();
+    }
+    deleteFile(tempPath);
+    catalogSegmentDeleted(segment.info.index);
+    accountFileRemoved(segment.bytes);
+  }
+  
+  segment.file = File();
+  closingPending = false;
+}
+
+// Дождаться фоновых операций с сегментами
+static void waitForSegmentJobs() {
+  while (closingPending || nextSegmentState == NEXT_SEGMENT_REQUESTED) {
+    notifyMaintenanceTask();
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+}
+
+// Закрыть и удалить заранее открытый сегмент (выключение записи, очистка карты)
+static void discardPreparedSegment() {
+  waitForSegmentJobs();
+  lockSegments();
+  if (nextSegmentState == NEXT_SEGMENT_READY) {
+    nextSegment.file.close();
+    deleteFile(getTempFileName(nextSegment.index, nextSegment.flags));
+    catalogSegmentDeleted(nextSegment.index);
+    accountFileRemoved(nextSegment.bytes);
+  }
+  nextSegment.file = File();
+  nextSegmentState = NEXT_SEGMENT_EMPTY;
+  unlockSegments();
+}
+
+// Карта извлечена - файлы потеряны, каталог перечитается при вставке
+static void dropSegmentSlots() {
+  lockSegments();  // Ждём операцию фоновой задачи (на извлечённой карте завершается ошибкой)
+  closeSegmentReaders(0);
+  nextSegment.file.close();
+  nextSegment.file = File();
+  nextSegmentState = NEXT_SEGMENT_EMPTY;
+  closingSegment.file.close();
+  closingSegment.file = File();
+  closingPending = false;
+  unlockSegments();
+}
+
+// Запросить открытие следующего сегмента в фоновой задаче
+static void requestNextSegment(unsigned long now) {
+  if (nextSegmentState != NEXT_SEGMENT_EMPTY || (long)(now - nextSegmentRetryTime) < 0) {
+    return;
+  }
+  nextSegmentState = NEXT_SEGMENT_REQUESTED;
+  notifyMaintenanceTask();
+}
+
+// Сделать открытый сегмент текущим (только обмен файлов - без обращения к карте)
+static void adoptSegment(PreparedSegment& segment, unsigned long now) {
+  currentFile = segment.file;
+  segment.file = File();
+  currentFileIndex = segment.index;
+  currentFileBytes = segment.bytes;
+  currentContainerFlags = segment.flags;
+  if (segment.flags & SEGMENT_FLAG_MKV) {
+    currentMkv = segment.mkv;
+  }
+  
+  currentTempPath = getTempFileName(currentFileIndex, currentContainerFlags);
+  currentFilePath = getFileName(currentFileIndex, currentContainerFlags);
+  recordingStartTime = now;
+  lastSyncTime = now;
+  recordingStartStamp = getTimestamp(recordingStartFlags);
+  framesInCurrentFile = 0;
+  aviTotalFrameSize = 0;
+}
+
+// Передать текущий сегмент на завершение в фоновую задачу
+static void handOffCurrentSegment() {
+  // Предыдущий сегмент ещё завершается (остановка сразу после смены сегмента)
+  while (closingPending) {
+    notifyMaintenanceTask();
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+  
+  // Файл timelapse закрыт между кадрами - открываем для финализации
+  if (currentSegmentTimelapse && framesInCurrentFile > 0) {
+    currentFile = SD_MMC.open(currentTempPath, "r+");
+  }
+  
+  SegmentInfo& info = closingSegment.info;
+  info.index = currentFileIndex;
+  info.flags = recordingStartFlags | currentContainerFlags;
+  info.startTime = recordingStartStamp;
+  info.durationMs = segmentDurationMs();
+  info.bytes = currentFileBytes;
+  info.frames = framesInCurrentFile;
+  closingSegment.dataSize = aviTotalFrameSize;
+  closingSegment.bytes = currentFileBytes;
+  closingSegment.playbackMs = info.durationMs;
+  if (currentSegmentTimelapse) {
+    // AVI: остаётся частота заголовка; MKV: длительность воспроизведения по времени кадров
+    closingSegment.playbackMs = (currentContainerFlags & SEGMENT_FLAG_MKV) ? info.frames * 1000 / timelapseFps : 0;
+  }
+  if (currentContainerFlags & SEGMENT_FLAG_MKV) {
+    closingSegment.mkv = currentMkv;
+  }
+  currentSegmentTimelapse = false;
+  closingSegment.file = currentFile;
+  currentFile = File();
+  
+  closingPending = true;
+  notifyMaintenanceTask();
+}
+
+// Смена сегмента по интервалу или размеру на границе кадра (вызывается перед записью кадра).
+// Если следующий файл ещё не готов - кадр пишется в текущий сегмент, он немного удлиняется
+static void updateSegmentRollover(unsigned long now) {
+  unsigned long elapsedMs = now - recordingStartTime;
+  unsigned long intervalMs = recordingInterval * 1000UL;
+  uint32_t maxBytes = segmentMaxMB * 1024UL * 1024UL;
+  
+  bool nearEnd = elapsedMs + SD_ROLLOVER_PREPARE_MS >= intervalMs ||
+                 (maxBytes > 0 && currentFileBytes >= maxBytes - maxBytes / 8);
+  if (nearEnd) {
+    requestNextSegment(now);
+  }
+  
+  bool segmentFull = elapsedMs >= intervalMs || (maxBytes > 0 && currentFileBytes >= maxBytes);
+  if (segmentFull && nextSegmentState == NEXT_SEGMENT_READY && !closingPending) {
+    handOffCurrentSegment();
+    adoptSegment(nextSegment, now);
+    nextSegmentState = NEXT_SEGMENT_EMPTY;
+  }
+}
+
+// Восстановить прерванную запись (.tmp -> .avi/.mkv); если полных кадров нет - удалить
+static bool recoverTempFile(int index, uint8_t flags) {
+  String tempPath = getTempFileName(index, flags);
+  String finalPath = getFileName(index, flags);
+  bool recovered;
+  uint32_t originalSize;
+  uint32_t recoveredSize;
+  if (flags & SEGMENT_FLAG_MKV) {
+    MKVRecoveryResult result;
+    recovered = recoverMKVFile(tempPath, finalPath, result);
+    originalSize = result.originalSize;
+    recoveredSize = result.recoveredSize;
+  } else {
+    AVIRecoveryResult result;
+    recovered = recoverAVIFile(tempPath, finalPath, result);
+    originalSize = result.originalSize;
+    recoveredSize = result.recoveredSize;
+  }
+  if (recovered) {
+    accountFileGrowth(originalSize, max(originalSize, recoveredSize));
+    return true;
+  }
+  
+  SD_MMC.remove(tempPath);
+  Serial.println("Removed incomplete file: " + tempPath);
+  return false;
+}
+
+// Восстановить все временные файлы (незавершенные записи) - только без каталога
 static void cleanupTempFiles() {
   File root = SD_MMC.open(RECORD_DIR);
   if (!root || !root.isDirectory()) {
     return;
   }
   
+  // Сначала собираем номера - переименование во время обхода папки небезопасно
+  static const int MAX_TEMP_FILES = 16;
+  int tempIndexes[MAX_TEMP_FILES];
+  uint8_t tempFlags[MAX_TEMP_FILES];
+  int tempCount = 0;
+  
   File file = root.openNextFile();
   while (file) {
     String name = file.name();
     if (name.endsWith(TEMP_SUFFIX)) {
-      String path = String(RECORD_DIR) + "/" + name;
-      file.close();
-      SD_MMC.remove(path);
-      Serial.println("Removed incomplete file: " + path);
+      int index = name.substring(0, 3).toInt();
+      if (index > 0 && index <= MAX_FILES && tempCount < MAX_TEMP_FILES) {
+        tempFlags[tempCount] = name.indexOf(".mkv") > 0 ? SEGMENT_FLAG_MKV : 0;
+        tempIndexes[tempCount++] = index;
+      } else {
+        String path = String(RECORD_DIR) + "/" + name;
+        file.close();
+        SD_MMC.remove(path);
+        Serial.println("Removed incomplete file: " + path);
+      }
     }
     file = root.openNextFile();
   }
   root.close();
+  
+  for (int i = 0; i < tempCount; i++) {
+    recoverTempFile(tempIndexes[i], tempFlags[i]);
+  }
+}
+
+// Прочитать параметры сегмента из заголовка AVI (avih: микросекунд на кадр и количество кадров)
+// или из кластеров MKV
+static bool readSegmentInfo(File& file, int index, SegmentInfo& info) {
+  static const uint8_t EBML_MAGIC[4] = {0x1A, 0x45, 0xDF, 0xA3};
+  uint8_t header[52];
+  size_t len = file.read(header, sizeof(header));
+  uint8_t containerFlags = 0;
+  
+  if (len >= 4 && memcmp(header, EBML_MAGIC, 4) == 0) {
+    if (!mkvReadInfo(file, info.durationMs, info.frames)) {
+      return false;
+    }
+    containerFlags = SEGMENT_FLAG_MKV;
+  } else if (len == sizeof(header) && memcmp(header, "RIFF", 4) == 0) {
+    uint32_t usPerFrame = header[32] | (header[33] << 8) | (header[34] << 16) | ((uint32_t)header[35] << 24);
+    uint32_t frames = header[48] | (header[49] << 8) | (header[50] << 16) | ((uint32_t)header[51] << 24);
+    info.frames = frames;
+    info.durationMs = (uint32_t)((uint64_t)frames * usPerFrame / 1000);
+  } else {
+    return false;
+  }
+  
+  info.index = index;
+  info.bytes = file.size();
+  
+  // Время начала восстанавливаем по времени изменения файла
+  time_t modified = file.getLastWrite();
+  info.flags = ((modified > 1600000000) ? SEGMENT_FLAG_WALLCLOCK : 0) | containerFlags;
+  info.startTime = (uint32_t)modified - info.durationMs / 1000;
+  return true;
 }
 
-// Сканировать существующие файлы для определения индексов
+// Сканировать существующие файлы и перестроить каталог сегментов
+// (только если каталог отсутствует или повреждён - обход всей папки медленный)
 static void scanExistingFiles() {
-  oldestFileIndex = MAX_FILES + 1;
-  newestFileIndex = 0;
+  clearSegmentCatalog();
   
   File root = SD_MMC.open(RECORD_DIR);
   if (!root || !root.isDirectory()) {
-    oldestFileIndex = 1;
     return;
   }
   
   File file = root.openNextFile();
   while (file) {
     String name = file.name();
-    // Парсим номер из имени файла (например "001.avi")
-    if (name.endsWith(".avi") && !name.endsWith(TEMP_SUFFIX)) {
+    // Парсим номер из имени файла (например "001.avi" или "001.mkv")
+    if (name.endsWith(".avi") || name.endsWith(".mkv")) {
       int index = name.substring(0, 3).toInt();
-      if (index > 0 && index <= MAX_FILES) {
-        if (index < oldestFileIndex) {
-          oldestFileIndex = index;
-        }
-        if (index > newestFileIndex) {
-          newestFileIndex = index;
-        }
+      SegmentInfo info;
+      if (index > 0 && index <= MAX_FILES && readSegmentInfo(file, index, info)) {
+        catalogRestoreSegment(info);
       }
     }
     file = root.openNextFile();
   }
   root.close();
   
-  // Если файлов нет
-  if (oldestFileIndex > MAX_FILES) {
-    oldestFileIndex = 1;
+  sortSegmentCatalog();
+  writeSegmentCatalog();
+  
+  Serial.printf("SD files scan: %d segments\n", catalogSegmentCount());
+}
+
+// Завершить незаконченный сегмент из каталога (вместо обхода папки)
+static void cleanupPendingSegment(uint16_t pending) {
+  // В каталоге только номер - контейнер определяем по имени файла
+  static const uint8_t containers[] = {0, SEGMENT_FLAG_MKV};
+  
+  // Прерванная запись - восстанавливаем кадры до последнего полностью записанного
+  for (uint8_t flags : containers) {
+    if (fileExists(getTempFileName(pending, flags))) {
+      recoverTempFile(pending, flags);
+    }
+  }
+  
+  if (catalogHasSegment(pending)) {
+    return;
+  }
+  
+  // Восстановленный файл или сбой между переименованием и записью в каталог
+  for (uint8_t flags : containers) {
+    String path = getFileName(pending, flags);
+    if (!fileExists(path)) {
+      continue;
+    }
+    File file = SD_MMC.open(path, FILE_READ);
+    SegmentInfo info;
+    bool valid = file && readSegmentInfo(file, pending, info);
+    file.close();
+    if (valid) {
+      catalogSegmentClosed(info);
+      return;
+    }
+  }
+  
+  // Закрываем отметку OPEN, чтобы не проверять её при каждом старте
+  catalogSegmentDeleted(pending);
+}
+
+// Загрузить каталог сегментов; при отсутствии или повреждении - полный обход папки
+static void loadRecordsIndex() {
+  if (!initSegmentCatalog(MAX_FILES)) {
+    return;
+  }
+  
+  if (loadSegmentCatalog()) {
+    // Текущий, завершаемый и заранее открытый сегменты - в порядке открытия
+    uint16_t pending[4];
+    int pendingCount = catalogPendingSegments(pending, 4);
+    for (int i = 0; i < pendingCount; i++) {
+      cleanupPendingSegment(pending[i]);
+    }
+  } else {
+    Serial.println("Segment catalog not found, scanning records...");
+    cleanupTempFiles();
+    scanExistingFiles();
   }
   
-  Serial.printf("SD files scan: oldest=%d, newest=%d\n", oldestFileIndex, newestFileIndex);
+  SegmentInfo newest;
+  newestFileIndex = catalogNewestSegment(newest) ? newest.index : 0;
+}
+
+// Настройки записи в NVS (settings_store): новые поля - только в конец, с увеличением версии
+struct RecordingSettingsBlob {
+  int32_t enabled;
+  int32_t interval;
+  int32_t mode;
+  int32_t pre;
+  int32_t post;
+  int32_t motion;
+  int32_t fps;
+  int32_t everyN;
+  int32_t container;
+  int32_t maxMB;
+  int32_t timelapseInterval;
+  int32_t timelapseFps;
+  int32_t timelapseHours;
+  int32_t timelapseFrameSize;
+  int32_t busWidth;
+};
+static const uint16_t RECORDING_BLOB_VERSION = 1;
+
+static RecordingSettingsBlob packRecordingSettings() {
+  RecordingSettingsBlob blob = {};
+  blob.enabled = recordingEnabled;
+  blob.interval = recordingInterval;
+  blob.mode = recordingMode;
+  blob.pre = preEventSeconds;
+  blob.post = postRollSeconds;
+  blob.motion = motionThreshold;
+  blob.fps = recordingFps;
+  blob.everyN = recordingEveryN;
+  blob.container = recordingContainer;
+  blob.maxMB = segmentMaxMB;
+  blob.timelapseInterval = timelapseInterval;
+  blob.timelapseFps = timelapseFps;
+  blob.timelapseHours = timelapseSegmentHours;
+  blob.timelapseFrameSize = timelapseFrameSize;
+  blob.busWidth = sdBusWidth;
+  return blob;
+}
+
+static void unpackRecordingSettings(const RecordingSettingsBlob& blob) {
+  recordingEnabled = blob.enabled;
+  recordingInterval = blob.interval;
+  recordingMode = (RecordingMode)blob.mode;
+  preEventSeconds = blob.pre;
+  postRollSeconds = blob.post;
+  motionThreshold = blob.motion;
+  recordingFps = blob.fps;
+  recordingEveryN = blob.everyN;
+  recordingContainer = (RecordingContainer)blob.container;
+  segmentMaxMB = blob.maxMB;
+  timelapseInterval = blob.timelapseInterval;
+  timelapseFps = blob.timelapseFps;
+  timelapseSegmentHours = blob.timelapseHours;
+  timelapseFrameSize = blob.timelapseFrameSize;
+  sdBusWidth = blob.busWidth;
+}
+
+// Сохранение настроек записи (отложенная запись одним блобом; без изменений - flash не трогается)
+static void saveRecordingSettings() {
+  RecordingSettingsBlob blob = packRecordingSettings();
+  settingsStoreSave("sdrec", RECORDING_BLOB_VERSION, &blob, sizeof(blob));
 }
 
 // Загрузка настроек записи из NVS
 static void loadRecordingSettings() {
+  // Старый формат (ключ на параметр) или значения по умолчанию из config.h
   recPrefs.begin("sdrec", true);  // RO mode
   recordingEnabled = recPrefs.getBool("enabled", SD_RECORDING_ENABLED);
   recordingInterval = recPrefs.getInt("interval", SD_RECORDING_INTERVAL);
+  recordingMode = (RecordingMode)recPrefs.getInt("mode", SD_RECORDING_MODE);
+  preEventSeconds = recPrefs.getInt("pre", SD_PREEVENT_SECONDS);
+  postRollSeconds = recPrefs.getInt("post", SD_POSTROLL_SECONDS);
+  motionThreshold = recPrefs.getInt("motion", SD_MOTION_THRESHOLD);
+  recordingFps = recPrefs.getInt("fps", SD_RECORDING_FPS);
+  recordingEveryN = recPrefs.getInt("everyn", SD_RECORDING_EVERY_N);
+  recordingContainer = (RecordingContainer)recPrefs.getInt("container", SD_CONTAINER);
+  segmentMaxMB = recPrefs.getInt("maxmb", SD_SEGMENT_MAX_MB);
+  timelapseInterval = recPrefs.getInt("tlint", SD_TIMELAPSE_INTERVAL);
+  timelapseFps = recPrefs.getInt("tlfps", SD_TIMELAPSE_FPS);
+  timelapseSegmentHours = recPrefs.getInt("tlhours", SD_TIMELAPSE_SEGMENT_HOURS);
+  timelapseFrameSize = recPrefs.getInt("tlsize", SD_TIMELAPSE_FRAMESIZE);
+  sdBusWidth = recPrefs.getInt("buswidth", SD_BUS_WIDTH);
   recPrefs.end();
   
+  RecordingSettingsBlob blob = packRecordingSettings();
+  if (settingsStoreLoad("sdrec", RECORDING_BLOB_VERSION, &blob, sizeof(blob))) {
+    unpackRecordingSettings(blob);
+  } else {
+    saveRecordingSettings();  // Блоба ещё нет - переносим старые ключи
+  }
+  
   Serial.printf("Loaded recording settings: enabled=%d, interval=%d\n", 
                 recordingEnabled, recordingInterval);
 }
 
-// Сохранение настроек записи в NVS
-static void saveRecordingSettings() {
-  recPrefs.begin("sdrec", false);  // RW mode
-  recPrefs.putBool("enabled", recordingEnabled);
-  recPrefs.putInt("interval", recordingInterval);
-  recPrefs.end();
+// 4-bit режим занимает GPIO4 (вспышка), GPIO12 (strapping) и GPIO13
+static bool busWidth4Allowed() {
+#if SD_TRIGGER_GPIO == 4 || SD_TRIGGER_GPIO == 12 || SD_TRIGGER_GPIO == 13
+  return false;
+#else
+  return true;
+#endif
+}
+
+// Монтирование SD_MMC в настроенном режиме шины; если 4-bit не поднялся - 1-bit
+static bool mountSDCard() {
+  mountedBusWidth = 0;
+  if (sdBusWidth == 4 && busWidth4Allowed()) {
+    if (SD_MMC.begin("/sdcard", false, false, SD_BUS_FREQ_KHZ, SD_MAX_OPEN_FILES)) {
+      mountedBusWidth = 4;
+      return true;
+    }
+    Serial.println("SD 4-bit mount failed, falling back to 1-bit");
+  }
+  
+  // 1-bit: GPIO4 (вспышка), 12 и 13 остаются свободными
+  if (SD_MMC.begin("/sdcard", true, false, SD_BUS_FREQ_KHZ, SD_MAX_OPEN_FILES)) {
+    mountedBusWidth = 1;
+    return true;
+  }
+  return false;
 }
 
 // Попытка переинициализации SD карты (для горячей вставки)
 static bool reinitSDCard() {
   // НЕ вызываем SD_MMC.end() чтобы не мешать камере и стримингу
   // Просто пробуем заново примонтировать
-  if (!SD_MMC.begin("/sdcard", true)) {
+  if (!mountSDCard()) {
     return false;
   }
   
@@ -343,6 +1053,91 @@ static bool reinitSDCard() {
   return true;
 }
 
+// Тест скорости карты (в фоновой задаче; запись остановлена в startSDBenchmark)
+static void runBenchmark() {
+  uint32_t totalBytes = SD_BENCH_MB * 1024UL * 1024UL;
+  lockSegments();
+  benchResultCount = 0;
+  if (getFreeSpace() > totalBytes + MIN_FREE_SPACE) {
+    Serial.printf("SD bench: %d-bit bus, %d MB per block size\n", mountedBusWidth, SD_BENCH_MB);
+    benchResultCount = runSDBenchmark(SD_MMC, BENCH_PATH, totalBytes, benchResults);
+  }
+  benchBusWidth = mountedBusWidth;
+  unlockSegments();
+  benchState = benchResultCount > 0 ? SD_BENCH_DONE : SD_BENCH_FAILED;
+}
+
+// Дамп трассы событий (в фоновой задаче, под lockSegments). Файл перезаписывается, в учёт места
+// не входит - TRACE_EVENTS * 12 байт много меньше MIN_FREE_SPACE
+static void writeTraceDump() {
+  File file = SD_MMC.open(TRACE_DUMP_PATH, FILE_WRITE);
+  if (!file) {
+    Serial.println("Trace dump: cannot open file");
+    return;
+  }
+  traceFreeze();
+  uint8_t chunk[512];
+  uint32_t size = traceDumpSize();
+  uint32_t offset = 0;
+  while (offset < size) {
+    size_t len = traceRead(offset, chunk, sizeof(chunk));
+    if (len == 0 || file.write(chunk, len) != len) {
+      break;
+    }
+    offset += len;
+  }
+  traceUnfreeze();
+  file.close();
+  Serial.printf("Trace dump: %lu bytes to %s\n", (unsigned long)offset, TRACE_DUMP_PATH);
+}
+
+// Фоновая задача обслуживания SD карты (не блокирует loop и видеопоток)
+static void sdMaintenanceTask(void*) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+    
+    // Сначала завершаем старый сегмент - освобождает слот для следующей смены
+    if (closingPending || nextSegmentState == NEXT_SEGMENT_REQUESTED) {
+      lockSegments();
+      finalizeClosingSegment();
+      prepareNextSegment();
+      unlockSegments();
+    }
+    
+    if (!sdCardPresent) {
+      continue;
+    }
+    
+    if (benchState == SD_BENCH_RUNNING) {
+      runBenchmark();
+      continue;
+    }
+    
+    if (traceDumpRequested) {
+      traceDumpRequested = false;
+      lockSegments();
+      writeTraceDump();
+      unlockSegments();
+    }
+    
+    // Сверка держит блокировку ФС на время обхода FAT - во время записи откладываем
+    unsigned long sinceResync = millis() - lastSpaceResync;
+    bool resyncDue = sinceResync > SPACE_RESYNC_INTERVAL &&
+                     (!isCurrentlyRecording || sinceResync > SPACE_RESYNC_MAX_INTERVAL);
+    if (spaceResyncRequested || resyncDue) {
+      spaceResyncRequested = false;
+      resyncFreeSpace();
+    }
+  }
+}
+
+// Фоновая задача на ядре 0 с низким приоритетом (loop и видеопоток - на ядре 1)
+static void startMaintenanceTask() {
+  if (!sdTaskHandle) {
+    xTaskCreatePinnedToCore(sdMaintenanceTask, "sd_maint", 4096, nullptr, 1, &sdTaskHandle, 0);
+  }
+}
+
 // ==================== Публичные функции ====================
 
 bool initSDRecorder() {
@@ -351,8 +1146,21 @@ bool initSDRecorder() {
   // Загружаем настройки из NVS
   loadRecordingSettings();
   
-  // Инициализация SD_MMC (использует 1-bit режим для освобождения пина flash)
-  // Для AI-Thinker ESP32-CAM используется 1-bit режим
+  if (!segmentMutex) {
+    segmentMutex = xSemaphoreCreateMutex();
+  }
+  
+  // Пред-событийный буфер нужен только в режиме записи по событию
+  if (recordingMode == RECORDING_EVENT && !frameRingInit(preEventRing, SD_PREEVENT_MAX_BYTES)) {
+    Serial.println("Pre-event buffer allocation failed (no PSRAM?)");
+  }
+  
+#if SD_TRIGGER_GPIO >= 0
+  pinMode(SD_TRIGGER_GPIO, INPUT_PULLUP);
+#endif
+  
+  // Инициализация SD_MMC: по умолчанию 1-bit (освобождает пин вспышки GPIO4),
+  // 4-bit - по настройке SD_BUS_WIDTH / NVS "buswidth" (см. mountSDCard)
   
   // Пробуем инициализировать несколько раз (SD карта может быть не готова)
   int attempts = 0;
@@ -361,7 +1169,7 @@ bool initSDRecorder() {
     attempts++;
     Serial.printf("SD card init attempt %d/3...\n", attempts);
     
-    if (SD_MMC.begin("/sdcard", true)) {  // true = 1-bit mode
+    if (mountSDCard()) {
       mounted = true;
       break;
     }
@@ -401,12 +1209,20 @@ bool initSDRecorder() {
     case CARD_SDHC: Serial.println("SDHC"); break;
     default:        Serial.println("UNKNOWN"); break;
   }
+  Serial.printf("SD bus: %d-bit, %d kHz\n", mountedBusWidth, SD_BUS_FREQ_KHZ);
   
-  Serial.printf("SD Card Size: %lluMB\n", SD_MMC.totalBytes() / (1024 * 1024));
-  Serial.printf("SD Card Free: %lluMB\n", getFreeSpace() / (1024 * 1024));
+  // Первая сверка места - при загрузке, пока видеопоток ещё не запущен
+  resyncFreeSpace();
+  Serial.printf("SD Card Size: %lluMB\n", (unsigned long long)(cardTotalBytes / (1024 * 1024)));
+  Serial.printf("SD Card Free: %lluMB\n", (unsigned long long)(getFreeSpace() / (1024 * 1024)));
   
   sdCardPresent = true;
   
+  // Файл теста скорости мог остаться после перезагрузки посреди теста
+  if (SD_MMC.exists(BENCH_PATH)) {
+    SD_MMC.remove(BENCH_PATH);
+  }
+  
   // Создаем папку для записей
   if (!SD_MMC.exists(RECORD_DIR)) {
     if (!SD_MMC.mkdir(RECORD_DIR)) {
@@ -416,13 +1232,13 @@ bool initSDRecorder() {
     Serial.println("Created records directory");
   }
   
-  // Удаляем незавершенные записи
-  cleanupTempFiles();
-  
-  // Сканируем существующие файлы
-  scanExistingFiles();
+  // Загружаем каталог сегментов (восстанавливает незавершённую запись)
+  loadRecordsIndex();
   
   sdCardWasPresent = true;
+  
+  startMaintenanceTask();
+  
   Serial.println("SD card recorder initialized");
   return true;
 }
@@ -457,6 +1273,7 @@ void handleSDRecorder() {
       // Debounce: детектим извлечение только после нескольких неудач подряд
       if (cardCheckFailCount >= CARD_CHECK_FAIL_THRESHOLD) {
         Serial.println("SD card removed");
+        sdCardPresent = false;
         if (isCurrentlyRecording) {
           // Принудительно останавливаем запись (файл потерян)
           isCurrentlyRecording = false;
@@ -466,8 +1283,10 @@ void handleSDRecorder() {
           framesInCurrentFile = 0;
           aviTotalFrameSize = 0;
         }
-        sdCardPresent = false;
+        dropSegmentSlots();
+        mountedBusWidth = 0;
         sdCardWasPresent = false;
+        spaceKnown = false;
         cardCheckFailCount = 0;
       }
     } else {
@@ -490,16 +1309,22 @@ void handleSDRecorder() {
         sdCardWasPresent = true;
         cardCheckFailCount = 0;
         
+        // Место пересчитает фоновая задача; до этого запись не начинается
+        spaceKnown = false;
+        requestSpaceResync();
+        
         // Создаем папку если нужно
         if (!SD_MMC.exists(RECORD_DIR)) {
           SD_MMC.mkdir(RECORD_DIR);
         }
         
-        // Очищаем временные файлы и сканируем
-        cleanupTempFiles();
-        scanExistingFiles();
+        // Загружаем каталог (очистка временных файлов и сканирование - только без каталога)
+        lockSegments();
+        loadRecordsIndex();
+        unlockSegments();
+        startMaintenanceTask();
         
-        Serial.printf("SD card ready: %lluMB free\n", getFreeSpace() / (1024 * 1024));
+        Serial.printf("SD card ready: %d segments\n", catalogSegmentCount());
         
         // Автоматически начинаем запись если включена
         if (recordingEnabled) {
@@ -524,40 +1349,52 @@ bool startRecording() {
     return true;  // Уже записываем
   }
   
-  recordingBusy = true;  // Устанавливаем флаг блокировки
-  
-  // Проверяем свободное место
-  if (!ensureFreeSpace()) {
-    recordingBusy = false;
+  // Идёт тест скорости карты - запись продолжится после него (recordFrame)
+  if (benchState == SD_BENCH_RUNNING) {
     return false;
   }
   
-  // Определяем индекс нового файла
-  currentFileIndex = findNextFileIndex();
-  
-  // Создаем временный файл
-  currentTempPath = getTempFileName(currentFileIndex);
-  currentFilePath = getFileName(currentFileIndex);
-  
-  // Удаляем старые файлы с этим индексом если есть
-  deleteFile(currentFilePath);
-  deleteFile(currentTempPath);
+  // В режиме по событию сегмент открывается только во время события
+  if (recordingMode == RECORDING_EVENT && !eventActive) {
+    return false;
+  }
   
-  // Открываем файл для записи
-  currentFile = SD_MMC.open(currentTempPath, FILE_WRITE);
-  if (!currentFile) {
-    recordingBusy = false;
+  // Фоновая задача уже открывает сегмент - подождём его, не блокируя видеопоток
+  if (nextSegmentState == NEXT_SEGMENT_REQUESTED) {
     return false;
   }
   
-  // Записываем AVI заголовок (разрешение будет определено из первого кадра)
-  // Используем 30 FPS как среднее значение
-  writeAVIHeader(currentFile, aviWidth, aviHeight, 30);
+  recordingBusy = true;  // Устанавливаем флаг блокировки
+  
+  if (recordingMode == RECORDING_TIMELAPSE) {
+    // Timelapse: файл открыт только на время записи кадра, заранее не готовим
+    PreparedSegment segment;
+    lockSegments();
+    bool opened = openSegmentFile(segment, timelapseFps);
+    unlockSegments();
+    if (!opened) {
+      recordingBusy = false;
+      return false;
+    }
+    segment.file.close();
+    adoptSegment(segment, millis());
+    currentSegmentTimelapse = true;
+  } else {
+    // Заранее открытый сегмент (остался от предыдущей записи) - старт без обращения к карте
+    if (nextSegmentState != NEXT_SEGMENT_READY) {
+      lockSegments();
+      bool opened = openSegmentFile(nextSegment);
+      unlockSegments();
+      if (!opened) {
+        recordingBusy = false;
+        return false;
+      }
+    }
+    adoptSegment(nextSegment, millis());
+    nextSegmentState = NEXT_SEGMENT_EMPTY;
+  }
   
   isCurrentlyRecording = true;
-  recordingStartTime = millis();
-  framesInCurrentFile = 0;
-  aviTotalFrameSize = 0;
   recordingBusy = false;  // Снимаем флаг блокировки
   
   Serial.println("Recording started: " + currentTempPath);
@@ -572,26 +1409,8 @@ void stopRecording() {
   recordingBusy = true;  // Устанавливаем флаг блокировки
   isCurrentlyRecording = false;
   
-  // Финализируем AVI заголовок
-  if (currentFile && framesInCurrentFile > 0) {
-    finalizeAVIHeader(currentFile, framesInCurrentFile, aviTotalFrameSize);
-    currentFile.close();  // Убрали flush() - он медленный
-    
-    // Переименовываем из .tmp в .avi (это быстрая операция)
-    if (SD_MMC.rename(currentTempPath, currentFilePath)) {
-      // Обновляем индекс самого нового файла
-      newestFileIndex = currentFileIndex;
-      totalFilesCreated++;
-    } else {
-      deleteFile(currentTempPath);
-    }
-  } else {
-    // Нет кадров - закрываем и удаляем пустой файл
-    if (currentFile) {
-      currentFile.close();
-    }
-    deleteFile(currentTempPath);
-  }
+  // Финализация AVI заголовка, rename и каталог - в фоновой задаче
+  handOffCurrentSegment();
   
   currentFilePath = "";
   currentTempPath = "";
@@ -600,33 +1419,36 @@ void stopRecording() {
   recordingBusy = false;  // Снимаем флаг блокировки
 }
 
-void recordFrame(uint8_t* jpegData, size_t jpegLen) {
-  // Быстрый выход если запись выключена или карты нет
-  if (!recordingEnabled || !isSDCardPresent()) {
-    return;
-  }
-  
-  // КРИТИЧНО: Пропускаем кадр если идёт долгая операция (start/stop)
-  // Это предотвращает блокировку видеопотока
-  if (recordingBusy) {
-    return;
+// Записать кадр в MKV (SimpleBlock). Время кадра - от первого кадра сегмента,
+// в timelapse - по частоте воспроизведения
+static bool writeMKVBlock(const uint8_t* jpegData, size_t jpegLen, unsigned long timestamp, uint32_t& blockSize) {
+  uint32_t timeMs = currentSegmentTimelapse ? framesInCurrentFile * 1000 / timelapseFps
+                                            : timestamp - firstFrameTime;
+  uint32_t before = currentMkv.end;
+  if (!mkvWriteFrame(currentFile, currentMkv, jpegData, jpegLen, timeMs)) {
+    return false;
   }
-  
-  // Проверяем нужно ли начать новую запись
-  if (!isCurrentlyRecording) {
-    startRecording();  // Может установить recordingBusy
-    return;  // Пропускаем этот кадр
+  blockSize = currentMkv.end - before;  // Вместе с заголовком нового кластера
+  return true;
+}
+
+// Записать кадр в текущий файл (00dc chunk или SimpleBlock). timestamp - millis() захвата кадра
+static bool appendFrameChunk(const uint8_t* jpegData, size_t jpegLen, unsigned long timestamp) {
+  if (!currentFile) {
+    return false;
   }
   
-  // Проверяем время - если прошло больше интервала, завершаем текущую запись
-  unsigned long elapsed = (millis() - recordingStartTime) / 1000;
-  if (elapsed >= (unsigned long)recordingInterval) {
-    stopRecording();  // Может установить recordingBusy
-    return;  // Пропускаем этот кадр, начнём новую запись на следующем
+  if (framesInCurrentFile == 0) {
+    firstFrameTime = timestamp;
   }
   
-  // Записываем кадр в AVI формате (00dc chunk)
-  if (currentFile) {
+  uint32_t chunkSize;
+  if (currentContainerFlags & SEGMENT_FLAG_MKV) {
+    if (!writeMKVBlock(jpegData, jpegLen, timestamp, chunkSize)) {
+      stopRecording();
+      return false;
+    }
+  } else {
     // Записываем chunk ID "00dc" (compressed video)
     writeFourCC(currentFile, "00dc");
     
@@ -638,45 +1460,244 @@ void recordFrame(uint8_t* jpegData, size_t jpegLen) {
     if (written != jpegLen) {
       // Тихо пропускаем ошибку чтобы не блокировать поток
       stopRecording();
-      return;
+      return false;
     }
     
     // Padding для выравнивания на 2 байта
+    chunkSize = jpegLen + 8;  // chunk header + data
     if (jpegLen % 2 != 0) {
       currentFile.write((uint8_t)0);
-      aviTotalFrameSize += jpegLen + 8 + 1;  // chunk header + data + padding
-    } else {
-      aviTotalFrameSize += jpegLen + 8;  // chunk header + data
+      chunkSize++;  // + padding
     }
+    aviTotalFrameSize += chunkSize;
+  }
+  accountFileGrowth(currentFileBytes, currentFileBytes + chunkSize);
+  currentFileBytes += chunkSize;
+  
+  lastFrameTime = timestamp;
+  framesInCurrentFile++;
+  totalFramesRecorded++;
+  
+  // flush() на каждом кадре блокирует выполнение на ~50-100мс, поэтому синхронизируем редко.
+  // Без синхронизации размер файла в FAT обновляется только при close(), и после сбоя
+  // питания .tmp файл оказывается пустым - восстанавливать нечего
+  unsigned long now = millis();
+  if (now - lastSyncTime >= SD_SYNC_INTERVAL_MS) {
+    currentFile.flush();
+    lastSyncTime = now;
+  }
+  return true;
+}
+
+// Кадр в файл с учётом времени записи (вместе с редкой синхронизацией flush())
+static bool writeFrameChunk(const uint8_t* jpegData, size_t jpegLen, unsigned long timestamp) {
+  traceEvent(TRACE_SD_WRITE_BEGIN, jpegLen);
+  unsigned long start = micros();
+  bool written = appendFrameChunk(jpegData, jpegLen, timestamp);
+  latencyRecord(LATENCY_SD_WRITE, micros() - start);
+  traceEvent(TRACE_SD_WRITE_END, written);
+  return written;
+}
+
+// Проверка источников события: GPIO и детектор движения по размеру JPEG
+static void checkEventTriggers(size_t jpegLen) {
+#if SD_TRIGGER_GPIO >= 0
+  if (digitalRead(SD_TRIGGER_GPIO) == LOW) {
+    triggerRecordingEvent("gpio");
+  }
+#endif
+  
+  if (motionThreshold > 0) {
+    // Размер JPEG заметно меняется при движении в кадре - дешёвая метрика без декодирования
+    if (motionAvgLen > 0) {
+      float change = fabsf((float)jpegLen - motionAvgLen) * 100.0f / motionAvgLen;
+      if (change > motionThreshold) {
+        triggerRecordingEvent("motion");
+      }
+    }
+    motionAvgLen = (motionAvgLen > 0) ? motionAvgLen * 0.9f + jpegLen * 0.1f : jpegLen;
+  }
+}
+
+// Записать часть пред-событийного буфера (ограниченно, чтобы не блокировать видеопоток)
+static void drainPreEventRing() {
+  const uint8_t* data;
+  size_t len;
+  uint32_t timestamp;
+  
+  for (int i = 0; i < PREEVENT_DRAIN_FRAMES && isCurrentlyRecording; i++) {
+    if (!frameRingPeek(preEventRing, data, len, timestamp)) {
+      return;
+    }
+    writeFrameChunk(data, len, timestamp);
+    frameRingPop(preEventRing);
+  }
+}
+
+// Запись по событию: кадры идут через пред-событийный буфер в хронологическом порядке
+static void recordEventFrame(uint8_t* jpegData, size_t jpegLen, unsigned long now) {
+  checkEventTriggers(jpegLen);
+  
+  if (!eventActive || recordingBusy) {
+    // Ожидание события: храним последние preEventSeconds секунд
+    frameRingPush(preEventRing, jpegData, jpegLen, now);
+    frameRingDropOlderThan(preEventRing, now - preEventSeconds * 1000UL);
+    return;
+  }
+  
+  if (!isCurrentlyRecording) {
+    // Событие: начинаем сегмент, время начала - по первому кадру буфера
+    const uint8_t* data;
+    size_t len;
+    uint32_t oldest = now;
+    frameRingPeek(preEventRing, data, len, oldest);
     
-    framesInCurrentFile++;
-    totalFramesRecorded++;
-    
-    // УБРАЛИ flush() - он блокирует выполнение на ~50-100мс
-    // Файловая система сама синхронизирует данные периодически
+    if (!startRecording()) {
+      frameRingPush(preEventRing, jpegData, jpegLen, now);  // Повторим на следующем кадре
+      return;
+    }
+    recordingStartTime = oldest;
+    recordingStartStamp -= (now - oldest) / 1000;
+  }
+  
+  // Смена сегмента по интервалу на границе кадра
+  updateSegmentRollover(now);
+  
+  // Кадры буфера пишем раньше текущего; пока буфер не пуст, текущий кадр встаёт в очередь
+  if (preEventRing.frames > 0) {
+    frameRingPush(preEventRing, jpegData, jpegLen, now);
+    drainPreEventRing();
+  } else {
+    writeFrameChunk(jpegData, jpegLen, now);
+  }
+  
+  if (!isCurrentlyRecording) {
+    return;  // Ошибка записи
+  }
+  
+  // Конец события (после записи буфера). Следующий сегмент остаётся открытым до нового события
+  bool postRollDone = (long)(now - eventEndTime) >= 0 && preEventRing.frames == 0;
+  if (postRollDone) {
+    eventActive = false;
+    Serial.println("Recording event finished");
+    stopRecording();
   }
 }
 
-bool isRecording() {
-  return isCurrentlyRecording;
+// Timelapse: файл открывается на время записи кадра, заголовок обновляется после каждого кадра.
+// Между кадрами файл закрыт и валиден - при сбое теряется не больше одного кадра
+static void recordTimelapseFrame(const uint8_t* jpegData, size_t jpegLen, unsigned long now) {
+  if (recordingBusy) {
+    return;
+  }
+  
+  // Сегмент по длительности реального времени
+  if (isCurrentlyRecording && now - recordingStartTime >= timelapseSegmentHours * 3600000UL) {
+    stopRecording();
+  }
+  if (!isCurrentlyRecording && !startRecording()) {
+    return;
+  }
+  
+  // Ротация по месту - перед кадром, сегмент растёт часами. Каталог занят фоновой
+  // задачей (завершение сегмента, восстановление, дамп трассы) - проверим на следующем кадре
+  if (tryLockSegments()) {
+    bool spaceOk = ensureFreeSpace();
+    unlockSegments();
+    if (!spaceOk) {
+      return;
+    }
+  }
+  
+  currentFile = SD_MMC.open(currentTempPath, "r+");
+  if (!currentFile) {
+    return;
+  }
+  currentFile.seek(currentFileBytes);
+  if (!writeFrameChunk(jpegData, jpegLen, now)) {
+    return;  // Сегмент остановлен и передан на финализацию
+  }
+  // MKV с неизвестными размерами валиден и без исправления заголовка
+  if (!(currentContainerFlags & SEGMENT_FLAG_MKV)) {
+    finalizeAVIHeader(currentFile, framesInCurrentFile, aviTotalFrameSize, 0);
+  }
+  currentFile.close();
 }
 
-String getRecordingStatus() {
-  if (!sdCardPresent) {
-    return "SD card not present";
+void recordFrame(uint8_t* jpegData, size_t jpegLen) {
+  // Быстрый выход если запись выключена или карты нет
+  if (!recordingEnabled || !isSDCardPresent()) {
+    return;
   }
   
-  if (!recordingEnabled) {
-    return "Recording disabled";
+  unsigned long now = millis();
+  if (recordingMode == RECORDING_TIMELAPSE) {
+    recordTimelapseFrame(jpegData, jpegLen, now);
+    return;
   }
   
-  if (isCurrentlyRecording) {
-    unsigned long elapsed = (millis() - recordingStartTime) / 1000;
-    return "Recording: " + String(elapsed) + "s / " + String(recordingInterval) + "s, " +
-           String(framesInCurrentFile) + " frames";
+  // Прореживание: на карту идёт только каждый N-й кадр
+  if (recordingEveryN > 1 && (framesOffered++ % recordingEveryN) != 0) {
+    return;
   }
   
-  return "Standby";
+  if (recordingMode == RECORDING_EVENT) {
+    recordEventFrame(jpegData, jpegLen, now);
+    return;
+  }
+  
+  // КРИТИЧНО: Пропускаем кадр если идёт долгая операция (start/stop)
+  // Это предотвращает блокировку видеопотока
+  if (recordingBusy) {
+    return;
+  }
+  
+  // Проверяем нужно ли начать новую запись
+  if (!isCurrentlyRecording) {
+    startRecording();  // Может установить recordingBusy
+    return;  // Пропускаем этот кадр
+  }
+  
+  // Смена сегмента по интервалу - кадр пишется уже в новый сегмент
+  updateSegmentRollover(now);
+  
+  // Записываем кадр в AVI формате (00dc chunk)
+  writeFrameChunk(jpegData, jpegLen, now);
+}
+
+bool isRecording() {
+  return isCurrentlyRecording;
+}
+
+String getRecordingStatus() {
+  char status[96];
+  formatRecordingStatus(status, sizeof(status));
+  return String(status);
+}
+
+size_t formatRecordingStatus(char* buf, size_t size) {
+  int len;
+  if (!sdCardPresent) {
+    len = snprintf(buf, size, "SD card not present");
+  } else if (!recordingEnabled) {
+    len = snprintf(buf, size, "Recording disabled");
+  } else if (recordingMode == RECORDING_EVENT && !isCurrentlyRecording) {
+    len = snprintf(buf, size, "Armed: %lu frames buffered (%lu KB), %lu events",
+                   (unsigned long)preEventRing.frames, (unsigned long)(preEventRing.bytes / 1024), eventCount);
+  } else if (isCurrentlyRecording) {
+    unsigned long elapsed = (millis() - recordingStartTime) / 1000;
+    if (recordingMode == RECORDING_EVENT) {
+      len = snprintf(buf, size, "Event (%s): %lus, %lu frames", lastEventSource, elapsed, framesInCurrentFile);
+    } else if (recordingMode == RECORDING_TIMELAPSE) {
+      len = snprintf(buf, size, "Timelapse: %lumin / %dh, %lu frames every %ds",
+                     elapsed / 60, timelapseSegmentHours, framesInCurrentFile, timelapseInterval);
+    } else {
+      len = snprintf(buf, size, "Recording: %lus / %ds, %lu frames", elapsed, recordingInterval, framesInCurrentFile);
+    }
+  } else {
+    len = snprintf(buf, size, "Standby");
+  }
+  return len < 0 ? 0 : min((size_t)len, size - 1);
 }
 
 SDCardInfo getSDCardInfo() {
@@ -691,11 +1712,11 @@ SDCardInfo getSDCardInfo() {
     return info;
   }
   
-  info.totalMB = SD_MMC.totalBytes() / (1024 * 1024);
+  // Значения из учёта места - без обращения к файловой системе
+  info.totalMB = cardTotalBytes / (1024 * 1024);
+  info.usedMB = getUsedSpace() / (1024 * 1024);
   info.freeMB = getFreeSpace() / (1024 * 1024);
-  info.usedMB = info.totalMB - info.freeMB;
-  info.fileCount = (newestFileIndex >= oldestFileIndex) ? 
-                   (newestFileIndex - oldestFileIndex + 1) : 0;
+  info.fileCount = catalogSegmentCount();
   
   return info;
 }
@@ -719,8 +1740,9 @@ void setRecordingEnabled(bool enabled) {
   recordingEnabled = enabled;
   saveRecordingSettings();  // Сохраняем в NVS
   
-  if (!enabled && isCurrentlyRecording) {
+  if (!enabled) {
     stopRecording();
+    discardPreparedSegment();
   }
   
   Serial.println(enabled ? "Recording enabled" : "Recording disabled");
@@ -732,7 +1754,7 @@ bool isRecordingEnabled() {
 
 void setRecordingInterval(int seconds) {
   if (seconds < 5) seconds = 5;
-  if (seconds > 300) seconds = 300;
+  if (seconds > 3600) seconds = 3600;  // Длинные сегменты - для прореженной записи
   
   if (recordingInterval == seconds) {
     return;
@@ -747,17 +1769,268 @@ int getRecordingInterval() {
   return recordingInterval;
 }
 
+void setRecordingFPS(int fps) {
+  fps = constrain(fps, 0, 60);
+  if (recordingFps == fps) {
+    return;
+  }
+  
+  recordingFps = fps;
+  saveRecordingSettings();
+  Serial.printf("Recording FPS set to %d\n", recordingFps);
+}
+
+int getRecordingFPS() {
+  return recordingFps;
+}
+
+void setRecordingDecimation(int everyN) {
+  everyN = constrain(everyN, 1, 100);
+  if (recordingEveryN == everyN) {
+    return;
+  }
+  
+  recordingEveryN = everyN;
+  framesOffered = 0;
+  saveRecordingSettings();
+  Serial.printf("Recording every %d frame(s)\n", recordingEveryN);
+}
+
+int getRecordingDecimation() {
+  return recordingEveryN;
+}
+
+void setSegmentMaxSize(int megabytes) {
+  megabytes = constrain(megabytes, 0, 4000);  // AVI 1.0 - не больше 4GB
+  if (segmentMaxMB == megabytes) {
+    return;
+  }
+  
+  segmentMaxMB = megabytes;
+  saveRecordingSettings();
+}
+
+int getSegmentMaxSize() {
+  return segmentMaxMB;
+}
+
+void setRecordingContainer(RecordingContainer container) {
+  if (recordingContainer == container) {
+    return;
+  }
+  
+  // Текущий сегмент дописывается в прежнем контейнере, заранее открытый - переоткрывается
+  recordingContainer = container;
+  discardPreparedSegment();
+  saveRecordingSettings();
+  Serial.printf("Recording container: %s\n", container == RECORDING_MKV ? "mkv" : "avi");
+}
+
+RecordingContainer getRecordingContainer() {
+  return recordingContainer;
+}
+
+unsigned long getRecordingCaptureInterval() {
+  if (recordingMode == RECORDING_TIMELAPSE) {
+    return timelapseInterval * 1000UL;
+  }
+  return recordingFps > 0 ? 1000 / recordingFps : 0;
+}
+
+int getRecordingFrameSize() {
+  return recordingMode == RECORDING_TIMELAPSE ? timelapseFrameSize : -1;
+}
+
+bool getNextSegmentToUpload(SegmentInfo& info) {
+  if (!sdCardPresent || !tryLockSegments()) {
+    return false;
+  }
+  bool found = catalogOldestWithFlag(SEGMENT_FLAG_UPLOADED, false, info);
+  unlockSegments();
+  return found;
+}
+
+String getSegmentFileName(const SegmentInfo& info) {
+  char name[12];
+  snprintf(name, sizeof(name), "%03d%s", info.index, getFileExtension(info.flags));
+  return String(name);
+}
+
+// Открытый на чтение файл сегмента (под lockSegments): свой слот или давно не использованный
+static SegmentReader* getSegmentReader(const SegmentInfo& info) {
+  SegmentReader* reader = &segmentReaders[0];
+  for (int i = 0; i < SEGMENT_READERS; i++) {
+    if (segmentReaders[i].index == info.index && segmentReaders[i].startTime == info.startTime) {
+      reader = &segmentReaders[i];
+      reader->lastUse = millis();
+      return reader;
+    }
+    if (!segmentReaders[i].index || segmentReaders[i].lastUse < reader->lastUse) {
+      reader = &segmentReaders[i];
+    }
+  }
+  
+  reader->file.close();
+  reader->file = SD_MMC.open(getFileName(info.index, info.flags), FILE_READ);
+  if (!reader->file) {
+    reader->index = 0;
+    return nullptr;
+  }
+  reader->index = info.index;
+  reader->startTime = info.startTime;
+  reader->position = 0;
+  reader->lastUse = millis();
+  return reader;
+}
+
+// Запись на карту ждёт своей очереди - чтение сегментов откладывается
+static bool isRecorderWritePending() {
+  // Фоновая задача завершает/открывает сегмент или пред-событийный буфер ещё сбрасывается на карту
+  const uint8_t* data;
+  size_t len;
+  uint32_t timestamp;
+  return closingPending || nextSegmentState == NEXT_SEGMENT_REQUESTED ||
+         (isCurrentlyRecording && frameRingPeek(preEventRing, data, len, timestamp));
+}
+
+int readSegmentData(const SegmentInfo& info, uint32_t offset, uint8_t* buffer, size_t len) {
+  if (!sdCardPresent) {
+    return -1;
+  }
+  // Чтение уступает записи: не ждём фоновую задачу и отложенную запись кадров
+  if (isRecorderWritePending() || !tryLockSegments()) {
+    return 0;
+  }
+  
+  // Номер мог быть занят новым сегментом после ротации - сверяем время начала
+  SegmentInfo current;
+  if (!catalogFindSegment(info.index, current) || current.startTime != info.startTime) {
+    unlockSegments();
+    return -1;
+  }
+  
+  int result = -1;
+  SegmentReader* reader = getSegmentReader(current);
+  if (reader && (reader->position == offset || reader->file.seek(offset))) {
+    result = reader->file.read(buffer, len);
+    reader->position = offset + (result > 0 ? result : 0);
+    if (result <= 0) {
+      // Ошибка чтения - файл переоткроется при следующем обращении
+      closeSegmentReaders(info.index);
+    }
+  }
+  unlockSegments();
+  return result > 0 ? result : -1;
+}
+
+int readSegmentList(int position, SegmentInfo* list, int maxCount) {
+  if (!sdCardPresent) {
+    return 0;
+  }
+  if (!tryLockSegments()) {
+    return -1;
+  }
+  int count = 0;
+  while (count < maxCount && catalogGetSegment(position + count, list[count])) {
+    count++;
+  }
+  unlockSegments();
+  return count;
+}
+
+int findSegmentByName(const String& name, SegmentInfo& info) {
+  // "001.mkv": номер и расширение должны совпадать с каталогом
+  int index = atoi(name.c_str());
+  if (!sdCardPresent || index <= 0 || index > MAX_FILES) {
+    return -1;
+  }
+  if (!tryLockSegments()) {
+    return 0;
+  }
+  bool found = catalogFindSegment(index, info) && name == getSegmentFileName(info);
+  unlockSegments();
+  return found ? 1 : -1;
+}
+
+void markSegmentUploaded(const SegmentInfo& info) {
+  lockSegments();
+  SegmentInfo current;
+  if (catalogFindSegment(info.index, current) && current.startTime == info.startTime) {
+    catalogSegmentUploaded(info.index);
+  }
+  unlockSegments();
+}
+
+void setSDBusWidth(int width) {
+  width = (width == 4) ? 4 : 1;
+  if (width == 4 && !busWidth4Allowed()) {
+    Serial.println("SD 4-bit mode unavailable: SD_TRIGGER_GPIO uses a data line");
+    return;
+  }
+  if (sdBusWidth == width) {
+    return;
+  }
+  sdBusWidth = width;
+  saveRecordingSettings();
+  Serial.printf("SD bus width: %d-bit (applies after restart or card reinsert)\n", width);
+}
+
+int getSDBusWidth() {
+  return sdBusWidth;
+}
+
+int getMountedSDBusWidth() {
+  return mountedBusWidth;
+}
+
+bool startSDBenchmark() {
+  if (!sdCardPresent || !spaceKnown || benchState == SD_BENCH_RUNNING) {
+    return false;
+  }
+  
+  // Тест занимает карту на несколько секунд - текущий сегмент закрываем, запись возобновит recordFrame
+  stopRecording();
+  benchState = SD_BENCH_RUNNING;
+  notifyMaintenanceTask();
+  return true;
+}
+
+bool requestTraceDump() {
+  if (!sdCardPresent) {
+    return false;
+  }
+  traceDumpRequested = true;
+  notifyMaintenanceTask();
+  return true;
+}
+
+SDBenchState getSDBenchmarkState() {
+  return benchState;
+}
+
+int getSDBenchmarkResults(SDBenchResult* results, int& busWidth) {
+  busWidth = benchBusWidth;
+  for (int i = 0; i < benchResultCount; i++) {
+    results[i] = benchResults[i];
+  }
+  return benchState == SD_BENCH_DONE ? benchResultCount : 0;
+}
+
 bool clearAllRecordings() {
   if (!sdCardPresent) {
     return false;
   }
   
-  // Останавливаем запись
+  // Останавливаем запись и дожидаемся фоновых операций с файлами
   stopRecording();
+  discardPreparedSegment();
+  lockSegments();
+  closeSegmentReaders(0);
   
   // Удаляем все файлы в папке записей
   File root = SD_MMC.open(RECORD_DIR);
   if (!root || !root.isDirectory()) {
+    unlockSegments();
     return false;
   }
   
@@ -774,11 +2047,127 @@ bool clearAllRecordings() {
   }
   root.close();
   
-  // Сбрасываем индексы
-  oldestFileIndex = 1;
+  // Сбрасываем индексы (файл каталога удалён вместе с записями)
+  clearSegmentCatalog();
   newestFileIndex = 0;
+  unlockSegments();
+  
+  // После массового удаления сверяем место с файловой системой
+  requestSpaceResync();
   currentFileIndex = 0;
   
   Serial.printf("Cleared %d recordings\n", deleted);
   return true;
 }
+
+void setRecordingMode(RecordingMode mode) {
+  if (recordingMode == mode) {
+    return;
+  }
+  
+  stopRecording();
+  eventActive = false;
+  recordingMode = mode;
+  
+  // Timelapse не держит файлы открытыми - заранее открытый сегмент не нужен
+  if (mode == RECORDING_TIMELAPSE) {
+    discardPreparedSegment();
+  }
+  
+  // Буфер в PSRAM держим только в режиме записи по событию
+  if (mode == RECORDING_EVENT) {
+    if (!preEventRing.buffer && !frameRingInit(preEventRing, SD_PREEVENT_MAX_BYTES)) {
+      Serial.println("Pre-event buffer allocation failed (no PSRAM?)");
+    }
+  } else {
+    frameRingFree(preEventRing);
+  }
+  
+  saveRecordingSettings();
+  static const char* modeNames[] = {"continuous", "event", "timelapse"};
+  Serial.printf("Recording mode: %s\n", modeNames[mode]);
+}
+
+RecordingMode getRecordingMode() {
+  return recordingMode;
+}
+
+void setEventWindow(int preSeconds, int postSeconds) {
+  if (preSeconds <= 0) preSeconds = preEventSeconds;
+  if (postSeconds <= 0) postSeconds = postRollSeconds;
+  preSeconds = constrain(preSeconds, 1, 30);
+  postSeconds = constrain(postSeconds, 1, 300);
+  
+  if (preEventSeconds == preSeconds && postRollSeconds == postSeconds) {
+    return;
+  }
+  
+  preEventSeconds = preSeconds;
+  postRollSeconds = postSeconds;
+  saveRecordingSettings();
+}
+
+void setMotionThreshold(int percent) {
+  percent = constrain(percent, 0, 100);
+  if (motionThreshold == percent) {
+    return;
+  }
+  
+  motionThreshold = percent;
+  motionAvgLen = 0;
+  saveRecordingSettings();
+}
+
+void triggerRecordingEvent(const char* source) {
+  if (recordingMode != RECORDING_EVENT || !recordingEnabled) {
+    return;
+  }
+  
+  if (!eventActive) {
+    eventActive = true;
+    eventCount++;
+    lastEventSource = source;
+    Serial.printf("Recording event: %s\n", source);
+  }
+  
+  // Повторное событие продлевает post-roll
+  eventEndTime = millis() + postRollSeconds * 1000UL;
+}
+
+unsigned long getRecordingEventCount() {
+  return eventCount;
+}
+
+void setTimelapseSettings(int intervalSeconds, int playbackFps, int segmentHours) {
+  if (intervalSeconds <= 0) intervalSeconds = timelapseInterval;
+  if (playbackFps <= 0) playbackFps = timelapseFps;
+  if (segmentHours <= 0) segmentHours = timelapseSegmentHours;
+  intervalSeconds = constrain(intervalSeconds, 1, 86400);
+  playbackFps = constrain(playbackFps, 1, 60);
+  segmentHours = constrain(segmentHours, 1, 168);
+  
+  if (timelapseInterval == intervalSeconds && timelapseFps == playbackFps &&
+      timelapseSegmentHours == segmentHours) {
+    return;
+  }
+  
+  // Частота воспроизведения записана в заголовке - начинаем новый сегмент
+  if (playbackFps != timelapseFps && recordingMode == RECORDING_TIMELAPSE) {
+    stopRecording();
+  }
+  
+  timelapseInterval = intervalSeconds;
+  timelapseFps = playbackFps;
+  timelapseSegmentHours = segmentHours;
+  saveRecordingSettings();
+}
+
+void setTimelapseFrameSize(int frameSize) {
+  frameSize = constrain(frameSize, -1, 13);  // 13 = FRAMESIZE_UXGA
+  if (timelapseFrameSize == frameSize) {
+    return;
+  }
+  
+  timelapseFrameSize = frameSize;
+  saveRecordingSettings();
+}
@@ -0,0 +1,459 @@
+#include "segment_catalog.h"
+#include <SD_MMC.h>
+#include <FS.h>
+#include <stdlib.h>
+
+// ==================== Формат каталога ====================
+static const char* CATALOG_PATH = "/records/segments.cat";
+static const char* CATALOG_TEMP_PATH = "/records/segments.cat.tmp";
+static const uint32_t CATALOG_MAGIC = 0x54414353;  // "SCAT"
+static const uint32_t CATALOG_VERSION = 1;
+static const size_t CATALOG_HEADER_SIZE = 8;
+static const size_t RECORD_SIZE = 24;
+static const int RECORDS_PER_READ = 16;  // Читаем блоками по 384 байта
+static const int MAX_PENDING = 4;        // Одновременно открытых сегментов (завершаемый, текущий, следующий)
+
+// Типы записей
+static const uint8_t RECORD_OPEN = 'O';     // Начата запись сегмента
+static const uint8_t RECORD_ADD = 'A';      // Сегмент завершён
+static const uint8_t RECORD_DELETE = 'D';   // Сегмент удалён
+static const uint8_t RECORD_UPLOADED = 'U'; // Сегмент выгружен на сервер
+
+// ==================== Состояние модуля ====================
+static SegmentInfo* entries = nullptr;  // Кольцевая таблица, от старых к новым
+static int capacity = 0;
+static int head = 0;                    // Позиция самого старого сегмента
+static int count = 0;
+static uint16_t pendingIndexes[MAX_PENDING];  // Сегменты без записи ADD, в порядке открытия
+static int pendingCount = 0;
+static uint64_t totalBytes = 0;
+static uint32_t fileRecords = 0;        // Записей в файле (для решения о сжатии)
+static bool tornTail = false;           // В конце файла оборванная запись - дозапись только после перезаписи
+
+// ==================== Вспомогательные функции ====================
+
+static uint32_t crc32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void encodeRecord(uint8_t* rec, uint8_t type, const SegmentInfo& info) {
+  rec[0] = type;
+  rec[1] = info.flags;
+  rec[2] = info.index & 0xFF;
+  rec[3] = (info.index >> 8) & 0xFF;
+  put32(rec + 4, info.startTime);
+  put32(rec + 8, info.durationMs);
+  put32(rec + 12, info.bytes);
+  put32(rec + 16, info.frames);
+  put32(rec + 20, crc32(rec, RECORD_SIZE - 4));
+}
+
+static bool decodeRecord(const uint8_t* rec, uint8_t& type, SegmentInfo& info) {
+  if (get32(rec + 20) != crc32(rec, RECORD_SIZE - 4)) {
+    return false;
+  }
+  type = rec[0];
+  info.flags = rec[1];
+  info.index = (uint16_t)rec[2] | ((uint16_t)rec[3] << 8);
+  info.startTime = get32(rec + 4);
+  info.durationMs = get32(rec + 8);
+  info.bytes = get32(rec + 12);
+  info.frames = get32(rec + 16);
+  return type == RECORD_OPEN || type == RECORD_ADD || type == RECORD_DELETE || type == RECORD_UPLOADED;
+}
+
+static SegmentInfo& entryAt(int position) {
+  return entries[(head + position) % capacity];
+}
+
+static int findPosition(uint16_t index) {
+  for (int i = count - 1; i >= 0; i--) {
+    if (entryAt(i).index == index) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void removeAt(int position) {
+  totalBytes -= entryAt(position).bytes;
+  if (position == 0) {
+    head = (head + 1) % capacity;
+  } else {
+    // Редкий случай (перезапись номера по кругу) - сдвигаем хвост
+    for (int i = position; i < count - 1; i++) {
+      entryAt(i) = entryAt(i + 1);
+    }
+  }
+  count--;
+}
+
+static bool appendEntry(const SegmentInfo& info) {
+  int existing = findPosition(info.index);
+  if (existing >= 0) {
+    removeAt(existing);
+  }
+  if (count >= capacity) {
+    removeAt(0);  // Таблица переполнена - забываем самый старый
+  }
+  entryAt(count) = info;
+  count++;
+  totalBytes += info.bytes;
+  return true;
+}
+
+static void removePending(uint16_t index) {
+  for (int i = 0; i < pendingCount; i++) {
+    if (pendingIndexes[i] == index) {
+      memmove(&pendingIndexes[i], &pendingIndexes[i + 1], sizeof(uint16_t) * (pendingCount - i - 1));
+      pendingCount--;
+      return;
+    }
+  }
+}
+
+static void addPending(uint16_t index) {
+  removePending(index);
+  if (pendingCount >= MAX_PENDING) {
+    removePending(pendingIndexes[0]);  // Забываем самый старый (без ADD/DELETE - сбой при записи каталога)
+  }
+  pendingIndexes[pendingCount++] = index;
+}
+
+static void applyRecord(uint8_t type, const SegmentInfo& info) {
+  switch (type) {
+    case RECORD_OPEN:
+      addPending(info.index);
+      break;
+    case RECORD_ADD:
+      appendEntry(info);
+      removePending(info.index);
+      break;
+    case RECORD_DELETE: {
+      int position = findPosition(info.index);
+      if (position >= 0) {
+        removeAt(position);
+      }
+      removePending(info.index);
+      break;
+    }
+    case RECORD_UPLOADED: {
+      int position = findPosition(info.index);
+      if (position >= 0) {
+        entryAt(position).flags |= SEGMENT_FLAG_UPLOADED;
+      }
+      break;
+    }
+  }
+}
+
+static bool writeHeader(File& file) {
+  uint8_t header[CATALOG_HEADER_SIZE];
+  put32(header, CATALOG_MAGIC);
+  put32(header + 4, CATALOG_VERSION);
+  return file.write(header, sizeof(header)) == sizeof(header);
+}
+
+static bool appendRecord(uint8_t type, const SegmentInfo& info) {
+  // Сжимаем каталог, если в нём накопилось много удалённых сегментов; после оборванной
+  // записи перезаписываем его - иначе новые записи лягут со сдвигом за её остатком
+  if (tornTail || fileRecords > (uint32_t)capacity * 3) {
+    return writeSegmentCatalog();
+  }
+
+  File file = SD_MMC.open(CATALOG_PATH, FILE_APPEND);
+  if (!file) {
+    return false;
+  }
+  if (file.size() == 0 && !writeHeader(file)) {
+    file.close();
+    return false;
+  }
+
+  uint8_t rec[RECORD_SIZE];
+  encodeRecord(rec, type, info);
+  bool ok = file.write(rec, RECORD_SIZE) == RECORD_SIZE;
+  file.close();
+  if (ok) {
+    fileRecords++;
+  }
+  return ok;
+}
+
+static int compareByStartTime(const void* a, const void* b) {
+  const SegmentInfo* sa = (const SegmentInfo*)a;
+  const SegmentInfo* sb = (const SegmentInfo*)b;
+  if (sa->startTime != sb->startTime) {
+    return sa->startTime < sb->startTime ? -1 : 1;
+  }
+  return (int)sa->index - (int)sb->index;
+}
+
+// ==================== Публичные функции ====================
+
+bool initSegmentCatalog(int maxSegments) {
+  if (entries) {
+    return true;
+  }
+
+  size_t size = sizeof(SegmentInfo) * maxSegments;
+  entries = (SegmentInfo*)(psramFound() ? ps_malloc(size) : malloc(size));
+  if (!entries) {
+    Serial.println("Segment catalog: out of memory");
+    return false;
+  }
+  capacity = maxSegments;
+  clearSegmentCatalog();
+  return true;
+}
+
+bool loadSegmentCatalog() {
+  if (!entries) {
+    return false;
+  }
+  clearSegmentCatalog();
+
+  File file = SD_MMC.open(CATALOG_PATH, FILE_READ);
+  if (!file) {
+    return false;
+  }
+
+  uint8_t header[CATALOG_HEADER_SIZE];
+  if (file.read(header, sizeof(header)) != sizeof(header) ||
+      get32(header) != CATALOG_MAGIC || get32(header + 4) != CATALOG_VERSION) {
+    file.close();
+    return false;
+  }
+
+  size_t remaining = file.size() - CATALOG_HEADER_SIZE;
+  uint8_t block[RECORD_SIZE * RECORDS_PER_READ];
+  bool corrupt = false;
+
+  while (remaining >= RECORD_SIZE && !corrupt) {
+    size_t toRead = min(remaining - remaining % RECORD_SIZE, sizeof(block));
+    if (file.read(block, toRead) != toRead) {
+      corrupt = true;
+      break;
+    }
+    remaining -= toRead;
+
+    for (size_t offset = 0; offset < toRead; offset += RECORD_SIZE) {
+      uint8_t type;
+      SegmentInfo info;
+      if (!decodeRecord(block + offset, type, info)) {
+        // Оборванная последняя запись допустима (сбой питания во время дозаписи)
+        bool lastRecord = remaining < RECORD_SIZE && offset + RECORD_SIZE == toRead;
+        corrupt = !lastRecord;
+        tornTail = lastRecord;
+        break;
+      }
+      applyRecord(type, info);
+      fileRecords++;
+    }
+  }
+  file.close();
+
+  if (corrupt) {
+    Serial.println("Segment catalog is corrupt");
+    clearSegmentCatalog();
+    return false;
+  }
+
+  // Недописанный остаток короче записи - тоже оборванная дозапись
+  if (remaining > 0) {
+    tornTail = true;
+  }
+  if (tornTail) {
+    // Отбрасываем хвост сразу; не вышло - перезапись при следующей дозаписи
+    Serial.println("Segment catalog: dropping torn last record");
+    writeSegmentCatalog();
+  }
+
+  Serial.printf("Segment catalog loaded: %d segments\n", count);
+  return true;
+}
+
+void clearSegmentCatalog() {
+  head = 0;
+  count = 0;
+  pendingCount = 0;
+  totalBytes = 0;
+  fileRecords = 0;
+  tornTail = false;
+}
+
+bool catalogRestoreSegment(const SegmentInfo& info) {
+  if (!entries) {
+    return false;
+  }
+  return appendEntry(info);
+}
+
+void sortSegmentCatalog() {
+  if (!entries || count < 2) {
+    return;
+  }
+  // Делаем таблицу непрерывной, чтобы отсортировать её qsort'ом
+  if (head + count > capacity) {
+    SegmentInfo* linear = (SegmentInfo*)malloc(sizeof(SegmentInfo) * count);
+    if (!linear) {
+      return;
+    }
+    for (int i = 0; i < count; i++) {
+      linear[i] = entryAt(i);
+    }
+    memcpy(entries, linear, sizeof(SegmentInfo) * count);
+    free(linear);
+    head = 0;
+  }
+  qsort(&entries[head], count, sizeof(SegmentInfo), compareByStartTime);
+}
+
+bool writeSegmentCatalog() {
+  if (!entries) {
+    return false;
+  }
+
+  File file = SD_MMC.open(CATALOG_TEMP_PATH, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+
+  bool ok = writeHeader(file);
+  uint8_t block[RECORD_SIZE * RECORDS_PER_READ];
+  size_t used = 0;
+  for (int i = 0; i < count && ok; i++) {
+    encodeRecord(block + used, RECORD_ADD, entryAt(i));
+    used += RECORD_SIZE;
+    if (used == sizeof(block) || i == count - 1) {
+      ok = file.write(block, used) == used;
+      used = 0;
+    }
+  }
+  for (int i = 0; i < pendingCount && ok; i++) {
+    SegmentInfo pending = {};
+    pending.index = pendingIndexes[i];
+    encodeRecord(block, RECORD_OPEN, pending);
+    ok = file.write(block, RECORD_SIZE) == RECORD_SIZE;
+  }
+  file.close();
+
+  if (!ok) {
+    SD_MMC.remove(CATALOG_TEMP_PATH);
+    return false;
+  }
+
+  SD_MMC.remove(CATALOG_PATH);
+  if (!SD_MMC.rename(CATALOG_TEMP_PATH, CATALOG_PATH)) {
+    return false;
+  }
+  fileRecords = count + pendingCount;
+  tornTail = false;
+  return true;
+}
+
+bool catalogSegmentOpened(uint16_t index) {
+  SegmentInfo info = {};
+  info.index = index;
+  addPending(index);
+  return appendRecord(RECORD_OPEN, info);
+}
+
+bool catalogSegmentClosed(const SegmentInfo& info) {
+  if (!entries) {
+    return false;
+  }
+  applyRecord(RECORD_ADD, info);
+  return appendRecord(RECORD_ADD, info);
+}
+
+bool catalogSegmentDeleted(uint16_t index) {
+  if (!entries) {
+    return false;
+  }
+  SegmentInfo info = {};
+  info.index = index;
+  applyRecord(RECORD_DELETE, info);
+  return appendRecord(RECORD_DELETE, info);
+}
+
+bool catalogSegmentUploaded(uint16_t index) {
+  if (!entries || findPosition(index) < 0) {
+    return false;
+  }
+  SegmentInfo info = {};
+  info.index = index;
+  applyRecord(RECORD_UPLOADED, info);
+  return appendRecord(RECORD_UPLOADED, info);
+}
+
+int catalogSegmentCount() {
+  return count;
+}
+
+bool catalogGetSegment(int position, SegmentInfo& info) {
+  if (position < 0 || position >= count) {
+    return false;
+  }
+  info = entryAt(position);
+  return true;
+}
+
+bool catalogOldestSegment(SegmentInfo& info) {
+  return catalogGetSegment(0, info);
+}
+
+bool catalogNewestSegment(SegmentInfo& info) {
+  return catalogGetSegment(count - 1, info);
+}
+
+bool catalogOldestWithFlag(uint8_t flag, bool set, SegmentInfo& info) {
+  for (int i = 0; i < count; i++) {
+    if (((entryAt(i).flags & flag) != 0) == set) {
+      info = entryAt(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool catalogHasSegment(uint16_t index) {
+  return findPosition(index) >= 0;
+}
+
+bool catalogFindSegment(uint16_t index, SegmentInfo& info) {
+  int position = findPosition(index);
+  if (position < 0) {
+    return false;
+  }
+  info = entryAt(position);
+  return true;
+}
+
+int catalogPendingSegments(uint16_t* indexes, int maxCount) {
+  int n = min(pendingCount, maxCount);
+  memcpy(indexes, pendingIndexes, sizeof(uint16_t) * n);
+  return n;
+}
+
+uint64_t catalogTotalBytes() {
+  return totalBytes;
+}
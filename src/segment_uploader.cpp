@@ -0,0 +1,462 @@
+#include "segment_uploader.h"
+#include "config.h"
+#include "sd_recorder.h"
+#include "stream_client.h"
+#include "wifi_client.h"
+#include "settings_store.h"
+#include <WiFi.h>
+#include <Preferences.h>
+
+// Состояние запроса
+enum UploadState {
+  UPLOAD_IDLE,      // Нет запроса (выбор сегмента, ожидание повтора)
+  UPLOAD_SENDING,   // Заголовок отправлен, отправляется тело
+  UPLOAD_WAITING    // Тело отправлено, ожидание ответа
+};
+
+static Preferences uploadPrefs;
+static bool uploadEnabled = SD_UPLOAD_ENABLED;
+static int uploadRateKB = SD_UPLOAD_RATE_KB;
+static WiFiClient uploadClient;
+static UploadState uploadState = UPLOAD_IDLE;
+
+// Выгружаемый сегмент
+static bool haveSegment = false;
+static SegmentInfo segment;
+static uint32_t uploadOffset = 0;     // Подтверждено сервером
+static uint32_t savedOffset = 0;      // Сохранено в NVS
+
+// Позиция из NVS (продолжение после перезагрузки)
+static uint16_t resumeIndex = 0;
+static uint32_t resumeStart = 0;
+static uint32_t resumeOffset = 0;
+
+// Часть сегмента текущего запроса
+static uint8_t* chunkBuffer = nullptr;
+static size_t chunkCapacity = 0;
+static size_t chunkLen = 0;
+static size_t chunkSent = 0;
+
+// Разбор ответа
+static char responseLine[96];
+static size_t responseLineLen = 0;
+static int responseStatus = 0;
+static long responseOffset = -1;
+static long responseBodyLeft = 0;
+static bool responseHeadersDone = false;
+static bool responseClose = false;
+static unsigned long requestTime = 0;
+
+// Ограничение скорости (token bucket, байты)
+static uint32_t tokens = 0;
+static unsigned long lastRefill = 0;
+
+// Повтор после ошибки
+static unsigned long retryTime = 0;
+static unsigned long backoffMs = 0;
+static unsigned long nextCheckTime = 0;
+
+// Пауза из-за видеопотока
+static bool paused = false;
+static unsigned long pauseStart = 0;
+
+// Статистика
+static uint32_t segmentsUploaded = 0;
+static uint64_t bytesSent = 0;
+static uint32_t pauseCount = 0;
+static uint32_t failureCount = 0;
+
+static const size_t SEND_SLICE = 4096;                     // Не больше за один вызов (не задерживаем loop)
+static const uint32_t BURST_BYTES = 8192;                  // Ёмкость token bucket
+static const uint32_t SAVE_BYTES = SD_UPLOAD_SAVE_KB * 1024UL;
+static const unsigned long CONNECT_TIMEOUT = 300;          // мс, connect() блокирующий
+static const unsigned long RESPONSE_TIMEOUT = 5000;
+static const unsigned long STALL_TIMEOUT = 10000;          // Пауза дольше - запрос прерывается
+static const unsigned long IDLE_CHECK_INTERVAL = 5000;     // Проверка новых сегментов
+static const unsigned long MAX_BACKOFF = 60000;
+
+static void saveUploadPosition() {
+  uploadPrefs.begin("upload", false);
+  uploadPrefs.putUShort("idx", segment.index);
+  uploadPrefs.putUInt("start", segment.startTime);
+  uploadPrefs.putUInt("off", uploadOffset);
+  uploadPrefs.end();
+  savedOffset = uploadOffset;
+}
+
+static void clearUploadPosition() {
+  uploadPrefs.begin("upload", false);
+  uploadPrefs.remove("idx");
+  uploadPrefs.remove("start");
+  uploadPrefs.remove("off");
+  uploadPrefs.end();
+  resumeIndex = 0;
+}
+
+// Настройки выгрузки в NVS (settings_store); позиция выгрузки - отдельные ключи
+struct UploadSettingsBlob {
+  int32_t enabled;
+  int32_t rateKB;
+};
+static const uint16_t UPLOAD_BLOB_VERSION = 1;
+
+static void saveUploadSettings() {
+  UploadSettingsBlob blob = {};
+  blob.enabled = uploadEnabled;
+  blob.rateKB = uploadRateKB;
+  settingsStoreSave("upload", UPLOAD_BLOB_VERSION, &blob, sizeof(blob));
+}
+
+void initSegmentUploader() {
+  uploadPrefs.begin("upload", true);  // RO mode
+  uploadEnabled = uploadPrefs.getBool("enabled", SD_UPLOAD_ENABLED);
+  uploadRateKB = uploadPrefs.getInt("rate", SD_UPLOAD_RATE_KB);
+  resumeIndex = uploadPrefs.getUShort("idx", 0);
+  resumeStart = uploadPrefs.getUInt("start", 0);
+  resumeOffset = uploadPrefs.getUInt("off", 0);
+  uploadPrefs.end();
+  
+  UploadSettingsBlob blob = {};
+  blob.enabled = uploadEnabled;
+  blob.rateKB = uploadRateKB;
+  if (settingsStoreLoad("upload", UPLOAD_BLOB_VERSION, &blob, sizeof(blob))) {
+    uploadEnabled = blob.enabled;
+    uploadRateKB = blob.rateKB;
+  } else {
+    saveUploadSettings();  // Блоба ещё нет - переносим старые ключи
+  }
+
+  // Буфер части сегмента: PSRAM, иначе уменьшенный в куче
+  chunkCapacity = SD_UPLOAD_CHUNK_KB * 1024;
+  chunkBuffer = (uint8_t*)(psramFound() ? ps_malloc(chunkCapacity) : nullptr);
+  if (!chunkBuffer) {
+    chunkCapacity = 8192;
+    chunkBuffer = (uint8_t*)malloc(chunkCapacity);
+  }
+  if (!chunkBuffer) {
+    chunkCapacity = 0;
+    Serial.println("Upload: no memory for buffer");
+  }
+
+  Serial.printf("Segment upload: %s, %d KB/s\n", uploadEnabled ? "ON" : "OFF", uploadRateKB);
+}
+
+// Прервать запрос; соединение закрывается (ответ на него уже не нужен)
+static void abortRequest() {
+  uploadClient.stop();
+  uploadState = UPLOAD_IDLE;
+}
+
+// Ошибка запроса - повтор с экспоненциальной задержкой
+static void failRequest(const char* reason) {
+  abortRequest();
+  failureCount++;
+  backoffMs = backoffMs ? min(backoffMs * 2, MAX_BACKOFF) : 1000;
+  retryTime = millis() + backoffMs;
+  Serial.printf("Upload %03d failed (%s), retry in %lus\n", segment.index, reason, backoffMs / 1000);
+}
+
+// Сегмент удалён ротацией до окончания выгрузки
+static void dropSegment() {
+  Serial.printf("Upload: segment %03d no longer on card\n", segment.index);
+  haveSegment = false;
+  clearUploadPosition();
+}
+
+static void refillTokens(unsigned long now) {
+  unsigned long elapsed = now - lastRefill;
+  lastRefill = now;
+  if (uploadRateKB <= 0) {
+    tokens = BURST_BYTES;
+    return;
+  }
+  uint64_t add = (uint64_t)elapsed * uploadRateKB * 1024 / 1000;
+  tokens = (uint32_t)min((uint64_t)BURST_BYTES, tokens + add);
+}
+
+// Выбрать самый старый невыгруженный сегмент
+static bool selectSegment(unsigned long now) {
+  if ((long)(now - nextCheckTime) < 0) {
+    return false;
+  }
+  nextCheckTime = now + IDLE_CHECK_INTERVAL;
+
+  if (!getNextSegmentToUpload(segment)) {
+    return false;
+  }
+
+  // Продолжаем с сохранённой позиции, если это тот же сегмент (сервер поправит через 409)
+  uploadOffset = 0;
+  if (resumeIndex == segment.index && resumeStart == segment.startTime && resumeOffset < segment.bytes) {
+    uploadOffset = resumeOffset;
+  }
+  savedOffset = uploadOffset;
+  haveSegment = true;
+  Serial.printf("Upload %03d: %lu bytes from %lu\n", segment.index, (unsigned long)segment.bytes,
+                (unsigned long)uploadOffset);
+  return true;
+}
+
+// Прочитать часть сегмента с карты, подключиться и отправить заголовок запроса
+static void startRequest() {
+  size_t len = min((size_t)(segment.bytes - uploadOffset), chunkCapacity);
+  int read = readSegmentData(segment, uploadOffset, chunkBuffer, len);
+  if (read == 0) {
+    return;  // Карта занята фоновой задачей - в следующий раз
+  }
+  if (read < 0) {
+    dropSegment();
+    return;
+  }
+  chunkLen = read;
+  chunkSent = 0;
+
+  if (!uploadClient.connected()) {
+    uploadClient.stop();
+    if (!uploadClient.connect(getServerHost().c_str(), SERVER_PORT, CONNECT_TIMEOUT)) {
+      failRequest("connect");
+      return;
+    }
+  }
+
+  char header[384];
+  String name = getSegmentFileName(segment);
+  int headerLen = snprintf(header, sizeof(header),
+    "POST %s HTTP/1.1\r\n"
+    "Host: %s:%d\r\n"
+    "X-Device-ID: %s\r\n"
+    "X-Segment: %s\r\n"
+    "X-Segment-Start: %lu\r\n"
+    "X-Segment-Duration: %lu\r\n"
+    "X-Upload-Offset: %lu\r\n"
+    "X-Upload-Total: %lu\r\n"
+    "Content-Type: application/octet-stream\r\n"
+    "Content-Length: %u\r\n"
+    "Connection: keep-alive\r\n\r\n",
+    SD_UPLOAD_PATH, getServerHost().c_str(), SERVER_PORT, WiFi.macAddress().c_str(), name.c_str(),
+    (unsigned long)segment.startTime, (unsigned long)segment.durationMs,
+    (unsigned long)uploadOffset, (unsigned long)segment.bytes, (unsigned)chunkLen);
+
+  if (uploadClient.write((const uint8_t*)header, headerLen) != (size_t)headerLen) {
+    failRequest("header");
+    return;
+  }
+  uploadState = UPLOAD_SENDING;
+}
+
+// Отправить очередной кусок тела (не больше SEND_SLICE и накопленных токенов)
+static void sendBody(unsigned long now) {
+  size_t slice = min(min(chunkLen - chunkSent, SEND_SLICE), (size_t)tokens);
+  if (slice == 0) {
+    return;
+  }
+
+  size_t written = uploadClient.write(chunkBuffer + chunkSent, slice);
+  if (written == 0) {
+    failRequest("send");
+    return;
+  }
+  chunkSent += written;
+  tokens -= written;
+  bytesSent += written;
+
+  if (chunkSent == chunkLen) {
+    uploadState = UPLOAD_WAITING;
+    requestTime = now;
+    responseLineLen = 0;
+    responseStatus = 0;
+    responseOffset = -1;
+    responseBodyLeft = 0;
+    responseHeadersDone = false;
+    responseClose = false;
+  }
+}
+
+// Строка заголовка ответа
+static void parseResponseLine() {
+  responseLine[responseLineLen] = 0;
+  if (responseLineLen > 0 && responseLine[responseLineLen - 1] == '\r') {
+    responseLine[--responseLineLen] = 0;
+  }
+
+  if (responseStatus == 0) {
+    // "HTTP/1.1 200 OK"
+    const char* space = strchr(responseLine, ' ');
+    responseStatus = space ? atoi(space + 1) : -1;
+  } else if (responseLineLen == 0) {
+    responseHeadersDone = true;
+  } else if (strncasecmp(responseLine, "X-Upload-Offset:", 16) == 0) {
+    responseOffset = strtol(responseLine + 16, nullptr, 10);
+  } else if (strncasecmp(responseLine, "Content-Length:", 15) == 0) {
+    responseBodyLeft = strtol(responseLine + 15, nullptr, 10);
+  } else if (strncasecmp(responseLine, "Connection:", 11) == 0 && strstr(responseLine + 11, "close")) {
+    responseClose = true;
+  }
+  responseLineLen = 0;
+}
+
+// Ответ получен полностью: сдвигаем подтверждённое смещение
+static void finishResponse() {
+  uploadState = UPLOAD_IDLE;
+  if (responseClose) {
+    uploadClient.stop();
+  }
+
+  if ((responseStatus != 200 && responseStatus != 409) || responseOffset < 0) {
+    char reason[16];
+    snprintf(reason, sizeof(reason), "HTTP %d", responseStatus);
+    failRequest(reason);
+    return;
+  }
+  backoffMs = 0;
+
+  if (responseStatus == 409) {
+    Serial.printf("Upload %03d: server has %ld bytes, resuming from there\n", segment.index, responseOffset);
+  }
+  uploadOffset = min((uint32_t)responseOffset, segment.bytes);
+
+  if (uploadOffset >= segment.bytes) {
+    markSegmentUploaded(segment);
+    segmentsUploaded++;
+    haveSegment = false;
+    clearUploadPosition();
+    nextCheckTime = 0;  // Сразу следующий сегмент
+    Serial.printf("Upload %03d: done\n", segment.index);
+  } else if (uploadOffset - savedOffset >= SAVE_BYTES || uploadOffset < savedOffset) {
+    saveUploadPosition();
+  }
+}
+
+// Неблокирующее чтение ответа
+static void readResponse(unsigned long now) {
+  while (uploadClient.available()) {
+    int c = uploadClient.read();
+    if (c < 0) {
+      break;
+    }
+    if (!responseHeadersDone) {
+      if (c == '\n') {
+        parseResponseLine();
+      } else if (responseLineLen < sizeof(responseLine) - 1) {
+        responseLine[responseLineLen++] = c;
+      }
+    } else {
+      responseBodyLeft--;
+    }
+    if (responseHeadersDone && responseBodyLeft <= 0) {
+      finishResponse();
+      return;
+    }
+  }
+
+  if (!uploadClient.connected()) {
+    failRequest("closed");
+  } else if (now - requestTime > RESPONSE_TIMEOUT) {
+    failRequest("timeout");
+  }
+}
+
+void handleSegmentUploader() {
+  if (!uploadEnabled || !chunkBuffer || !isWiFiConnected()) {
+    if (uploadState != UPLOAD_IDLE) {
+      abortRequest();
+    }
+    return;
+  }
+
+  unsigned long now = millis();
+  refillTokens(now);
+
+  // Канал занят видеопотоком - уступаем (ответ на уже отправленную часть читаем)
+  if (haveSegment && uploadState != UPLOAD_WAITING && isStreamCongested()) {
+    if (!paused) {
+      paused = true;
+      pauseStart = now;
+      pauseCount++;
+    }
+    // Сервер не будет ждать тело бесконечно - прерываем, продолжим с подтверждённого смещения
+    if (uploadState == UPLOAD_SENDING && now - pauseStart > STALL_TIMEOUT) {
+      abortRequest();
+    }
+    return;
+  }
+  paused = false;
+
+  switch (uploadState) {
+    case UPLOAD_IDLE:
+      if ((long)(now - retryTime) < 0) {
+        return;
+      }
+      if (!haveSegment && !selectSegment(now)) {
+        return;
+      }
+      // Не начинаем запрос без запаса токенов - тело пойдёт сразу
+      if (tokens >= BURST_BYTES / 2) {
+        startRequest();
+      }
+      break;
+
+    case UPLOAD_SENDING:
+      sendBody(now);
+      break;
+
+    case UPLOAD_WAITING:
+      readResponse(now);
+      break;
+  }
+}
+
+void setUploadEnabled(bool enabled) {
+  if (uploadEnabled == enabled) {
+    return;
+  }
+  uploadEnabled = enabled;
+  if (!enabled) {
+    // Позиция уже подтверждена сервером - сохраняем, чтобы продолжить при включении
+    abortRequest();
+    if (haveSegment) {
+      if (uploadOffset != savedOffset) {
+        saveUploadPosition();
+      }
+      resumeIndex = segment.index;
+      resumeStart = segment.startTime;
+      resumeOffset = uploadOffset;
+      haveSegment = false;
+    }
+  }
+  nextCheckTime = 0;
+  saveUploadSettings();
+  Serial.printf("Segment upload: %s\n", enabled ? "ON" : "OFF");
+}
+
+bool isUploadEnabled() {
+  return uploadEnabled;
+}
+
+void setUploadRate(int rateKB) {
+  if (rateKB < 0) rateKB = 0;
+  if (uploadRateKB == rateKB) {
+    return;
+  }
+  uploadRateKB = rateKB;
+  saveUploadSettings();
+}
+
+int getUploadRate() {
+  return uploadRateKB;
+}
+
+UploadStatus getUploadStatus() {
+  UploadStatus status;
+  status.enabled = uploadEnabled;
+  status.active = uploadEnabled && haveSegment;
+  status.paused = paused;
+  status.segment = haveSegment ? segment.index : 0;
+  status.offset = haveSegment ? uploadOffset : 0;
+  status.total = haveSegment ? segment.bytes : 0;
+  status.uploaded = segmentsUploaded;
+  status.sentKB = (uint32_t)(bytesSent / 1024);
+  status.pauses = pauseCount;
+  status.failures = failureCount;
+  return status;
+}
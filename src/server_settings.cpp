@@ -5,6 +5,16 @@
 #include "wifi_settings.h"
 #include "stream_client.h"
 #include "sd_recorder.h"
+#include "segment_uploader.h"
+#include "playback_server.h"
+#include "settings_channel.h"
+#include "async_http.h"
+#include "stream_control.h"
+#include "settings_store.h"
+#include "json_arena.h"
+#include "heap_counters.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
@@ -18,15 +28,39 @@ static unsigned long statusInterval = 30000;  // 30 sec - отправка ст
 static Preferences btPrefs;
 static Preferences cameraPrefs;
 static bool initialSettingsLoaded = false;  // Флаг первой загрузки настроек
-static bool settingsBusy = false;  // Флаг для предотвращения одновременных HTTP запросов
+static bool initialSettingsReceived = false;  // Ответ получен, ещё не отдан fetchInitialSettingsFromServer()
 static int initialSettingsAttempts = 0;  // Счётчик попыток загрузки начальных настроек
 static const int MAX_INITIAL_SETTINGS_ATTEMPTS = 5;  // Максимум попыток перед переключением на Bluetooth
+static const unsigned long INITIAL_SETTINGS_RETRY_MS = 5000;  // Пауза между попытками (отказ в соединении приходит сразу)
+static unsigned long lastInitialAttemptTime = 0;
 
 // Cached URLs to avoid String operations in loop
 static String settingsURL;
 static String statusURL;
 static bool urlsCached = false;
 
+// ETag последнего применённого ответа SETTINGS_PATH: отправляется в If-None-Match, сервер отвечает 304
+static char settingsETag[ASYNC_HTTP_HEADER_VALUE_MAX] = "";
+
+// Разбор настроек и сборка статуса - в арене, без выделения памяти в куче (по очереди:
+// на арене один документ). Фильтр настроек собирается один раз в своей арене
+alignas(8) static uint8_t arenaBuffer[JSON_ARENA_SIZE];
+static JsonArena arena(arenaBuffer, sizeof(arenaBuffer));
+alignas(8) static uint8_t filterArenaBuffer[JSON_FILTER_ARENA_SIZE];
+static JsonArena filterArena(filterArenaBuffer, sizeof(filterArenaBuffer));
+static JsonDocument settingsFilter(&filterArena);
+static bool settingsFilterBuilt = false;
+static char statusJson[STATUS_JSON_MAX];
+
+// Выделений памяти в loop за последний разбор настроек / сборку статуса (heap_counters)
+static uint32_t settingsAllocations = 0;
+static uint32_t statusAllocations = 0;
+
+// Виды запросов в очереди async_http (не больше одного каждого вида)
+static const uint8_t REQUEST_INITIAL_SETTINGS = 1;
+static const uint8_t REQUEST_SETTINGS = 2;
+static const uint8_t REQUEST_STATUS = 3;
+
 static CameraSettings currentSettings = {
   .frameSize = FRAMESIZE_VGA,    // 640x480
   .quality = STREAM_QUALITY,
@@ -39,7 +73,37 @@ static CameraSettings currentSettings = {
   .streaming = true
 };
 
+// Настройки камеры в NVS (settings_store): новые поля - только в конец, с увеличением версии
+struct CameraSettingsBlob {
+  int32_t frameSize;
+  int32_t quality;
+  int32_t brightness;
+  int32_t contrast;
+  int32_t saturation;
+  int32_t fps;
+  uint8_t vflip;
+  uint8_t hmirror;
+  uint8_t streaming;
+  uint8_t reserved;
+};
+static const uint16_t CAMERA_BLOB_VERSION = 1;
+
+static CameraSettingsBlob packCameraSettings() {
+  CameraSettingsBlob blob = {};
+  blob.frameSize = currentSettings.frameSize;
+  blob.quality = currentSettings.quality;
+  blob.brightness = currentSettings.brightness;
+  blob.contrast = currentSettings.contrast;
+  blob.saturation = currentSettings.saturation;
+  blob.fps = currentSettings.fps;
+  blob.vflip = currentSettings.vflip;
+  blob.hmirror = currentSettings.hmirror;
+  blob.streaming = currentSettings.streaming;
+  return blob;
+}
+
 void loadCameraSettings() {
+  // Старый формат (ключ на параметр) или значения по умолчанию из config.h
   cameraPrefs.begin("camera", true);  // Read-only mode
   
   // Load settings from NVS, or use defaults from config.h
@@ -54,22 +118,28 @@ void loadCameraSettings() {
   currentSettings.streaming = cameraPrefs.getBool("streaming", true);
   
   cameraPrefs.end();
+  
+  CameraSettingsBlob blob = packCameraSettings();
+  if (!settingsStoreLoad("camera", CAMERA_BLOB_VERSION, &blob, sizeof(blob))) {
+    // Блоба ещё нет - переносим старые ключи
+    saveCameraSettings();
+    return;
+  }
+  currentSettings.frameSize = blob.frameSize;
+  currentSettings.quality = blob.quality;
+  currentSettings.brightness = blob.brightness;
+  currentSettings.contrast = blob.contrast;
+  currentSettings.saturation = blob.saturation;
+  currentSettings.fps = blob.fps;
+  currentSettings.vflip = blob.vflip;
+  currentSettings.hmirror = blob.hmirror;
+  currentSettings.streaming = blob.streaming;
 }
 
 void saveCameraSettings() {
-  cameraPrefs.begin("camera", false);  // Read-write mode
-  
-  cameraPrefs.putInt("frameSize", currentSettings.frameSize);
-  cameraPrefs.putInt("quality", currentSettings.quality);
-  cameraPrefs.putInt("brightness", currentSettings.brightness);
-  cameraPrefs.putInt("contrast", currentSettings.contrast);
-  cameraPrefs.putInt("saturation", currentSettings.saturation);
-  cameraPrefs.putInt("fps", currentSettings.fps);
-  cameraPrefs.putBool("vflip", currentSettings.vflip);
-  cameraPrefs.putBool("hmirror", currentSettings.hmirror);
-  cameraPrefs.putBool("streaming", currentSettings.streaming);
-  
-  cameraPrefs.end();
+  // Отложенная запись одним блобом; без изменений - flash не трогается
+  CameraSettingsBlob blob = packCameraSettings();
+  settingsStoreSave("camera", CAMERA_BLOB_VERSION, &blob, sizeof(blob));
 }
 
 void initServerSettings() {
@@ -120,13 +190,53 @@ CameraSettings getCurrentSettings() {
   return currentSettings;
 }
 
-static void processSettings(const String& json) {
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, json);
+// Поля настроек, которые читает applySettings() - остальное при разборе пропускается
+static void buildSettingsFilter(JsonDocument& filter) {
+  filter["command"] = true;
+  filter["sdcard"]["bus_width"] = true;
+  filter["wifi"]["ssid"] = true;
+  filter["wifi"]["password"] = true;
+  filter["wifi"]["ip"] = true;
+  filter["wifi"]["gateway"] = true;
+  filter["wifi"]["subnet"] = true;
+  filter["wifi"]["dns"] = true;
+  filter["wifi"]["networks"][0]["ssid"] = true;
+  filter["wifi"]["networks"][0]["password"] = true;
+  filter["bluetooth"]["name"] = true;
+  filter["bluetooth"]["enabled"] = true;
+  filter["frameSize"] = true;
+  filter["quality"] = true;
+  filter["brightness"] = true;
+  filter["contrast"] = true;
+  filter["saturation"] = true;
+  filter["fps"] = true;
+  filter["vflip"] = true;
+  filter["hmirror"] = true;
+  filter["streaming"] = true;
+  filter["recording"] = true;
+}
+
+static bool applySettings(const char* json, size_t length) {
+  // Настройки могли прийти не из опроса (settings_channel) - старый ETag им уже не соответствует
+  settingsETag[0] = 0;
+  
+  if (!settingsFilterBuilt) {
+    buildSettingsFilter(settingsFilter);
+    settingsFilterBuilt = true;
+    if (settingsFilter.overflowed()) {
+      Serial.println("Settings filter: arena overflow, parsing unfiltered");
+    }
+  }
+  
+  // Строки копируются - json после разбора не нужен
+  JsonDocument doc(&arena);
+  DeserializationError error = settingsFilter.overflowed()
+    ? deserializeJson(doc, json, length)
+    : deserializeJson(doc, json, length, DeserializationOption::Filter(settingsFilter));
   
   if (error) {
     Serial.printf("JSON parse error: %s\n", error.c_str());
-    return;
+    return false;
   }
   
   // Check for commands
@@ -134,14 +244,49 @@ static void processSettings(const String& json) {
   
   if (strcmp(command, "restart") == 0) {
     Serial.println("Restart command received");
+    settingsStoreFlush();  // Отложенные записи настроек
     delay(100);
     ESP.restart();
-    return;
+    return true;
+  }
+  
+  if (strcmp(command, "sdbench") == 0) {
+    Serial.println(startSDBenchmark() ? "SD benchmark started" : "SD benchmark not started");
+  }
+  
+  if (strcmp(command, "trace") == 0) {
+    Serial.println(requestTraceDump() ? "Trace dump requested" : "Trace dump not possible: no SD card");
+  }
+  
+  // Handle SD card bus settings (применяется при следующем монтировании)
+  if (doc["sdcard"]["bus_width"].is<int>()) {
+    setSDBusWidth(doc["sdcard"]["bus_width"].as<int>());
   }
   
   // Handle WiFi settings
   if (doc["wifi"].is<JsonObject>()) {
     JsonObject wifi = doc["wifi"];
+    // Профили сетей в порядке приоритета - со следующего подключения или роуминга
+    if (wifi["networks"].is<JsonArray>()) {
+      WiFiProfile profiles[WIFI_MAX_PROFILES];
+      size_t count = 0;
+      for (JsonObject network : wifi["networks"].as<JsonArray>()) {
+        const char* ssid = network["ssid"] | "";
+        const char* password = network["password"] | "";
+        if (count >= WIFI_MAX_PROFILES || ssid[0] == 0 || strlen(ssid) >= sizeof(profiles[0].ssid) ||
+            strlen(password) >= sizeof(profiles[0].password)) {
+          continue;
+        }
+        strlcpy(profiles[count].ssid, ssid, sizeof(profiles[count].ssid));
+        strlcpy(profiles[count].password, password, sizeof(profiles[count].password));
+        count++;
+      }
+      saveWiFiProfiles(profiles, count);
+    }
+    // Статический IP ("" - DHCP) - со следующего подключения
+    if (wifi["ip"].is<const char*>()) {
+      saveWiFiStaticIP(wifi["ip"], wifi["gateway"] | "", wifi["subnet"] | "", wifi["dns"] | "");
+    }
     if (wifi["ssid"].is<const char*>() && wifi["password"].is<const char*>()) {
       String newSSID = wifi["ssid"].as<String>();
       String newPassword = wifi["password"].as<String>();
@@ -149,9 +294,10 @@ static void processSettings(const String& json) {
       if (newSSID.length() > 0) {
         saveWiFiCredentials(newSSID, newPassword);
         Serial.println("WiFi credentials updated. Restarting...");
+        settingsStoreFlush();
         delay(500);
         ESP.restart();
-        return;
+        return true;
       }
     }
   }
@@ -160,16 +306,23 @@ static void processSettings(const String& json) {
   if (doc["bluetooth"].is<JsonObject>()) {
     JsonObject bt = doc["bluetooth"];
     if (bt["name"].is<const char*>()) {
-      String btName = bt["name"].as<String>();
-      if (btName.length() > 0 && btName.length() < 32) {
+      const char* btName = bt["name"];
+      char storedName[32];
+      size_t nameLen = strlen(btName);
+      if (btPrefs.getString("name", storedName, sizeof(storedName)) == 0) {
+        storedName[0] = 0;
+      }
+      if (nameLen > 0 && nameLen < 32 && strcmp(btName, storedName) != 0) {
         btPrefs.putString("name", btName);
         Serial.println("Bluetooth name updated. Restart required.");
       }
     }
     if (bt["enabled"].is<bool>()) {
       bool enabled = bt["enabled"].as<bool>();
-      btPrefs.putBool("enabled", enabled);
-      Serial.printf("Bluetooth %s\n", enabled ? "enabled" : "disabled");
+      if (!btPrefs.isKey("enabled") || btPrefs.getBool("enabled") != enabled) {
+        btPrefs.putBool("enabled", enabled);
+        Serial.printf("Bluetooth %s\n", enabled ? "enabled" : "disabled");
+      }
     }
   }
   
@@ -218,118 +371,292 @@ static void processSettings(const String& json) {
     }
     if (rec["interval"].is<int>()) {
       int interval = rec["interval"].as<int>();
-      if (interval >= 5 && interval <= 60) {
+      if (interval >= 5 && interval <= 3600) {
         setRecordingInterval(interval);
       }
     }
+    if (rec["fps"].is<int>()) {
+      setRecordingFPS(rec["fps"].as<int>());
+    }
+    if (rec["every"].is<int>()) {
+      setRecordingDecimation(rec["every"].as<int>());
+    }
+    if (rec["max_mb"].is<int>()) {
+      setSegmentMaxSize(rec["max_mb"].as<int>());
+    }
+    if (rec["container"].is<const char*>()) {
+      setRecordingContainer(strcmp(rec["container"], "mkv") == 0 ? RECORDING_MKV : RECORDING_AVI);
+    }
     if (rec["clear"].is<bool>() && rec["clear"].as<bool>()) {
       clearAllRecordings();
     }
+    
+    // Запись по событию
+    if (rec["mode"].is<const char*>()) {
+      const char* mode = rec["mode"];
+      if (strcmp(mode, "event") == 0) {
+        setRecordingMode(RECORDING_EVENT);
+      } else if (strcmp(mode, "timelapse") == 0) {
+        setRecordingMode(RECORDING_TIMELAPSE);
+      } else {
+        setRecordingMode(RECORDING_CONTINUOUS);
+      }
+    }
+    if (rec["pre"].is<int>() || rec["post"].is<int>()) {
+      setEventWindow(rec["pre"] | 0, rec["post"] | 0);
+    }
+    if (rec["motion"].is<int>()) {
+      setMotionThreshold(rec["motion"].as<int>());
+    }
+    if (rec["trigger"].is<bool>() && rec["trigger"].as<bool>()) {
+      triggerRecordingEvent("server");
+    }
+    
+    // Timelapse
+    if (rec["timelapse"].is<JsonObject>()) {
+      JsonObject tl = rec["timelapse"];
+      setTimelapseSettings(tl["interval"] | 0, tl["fps"] | 0, tl["hours"] | 0);
+      if (tl["frameSize"].is<int>()) {
+        setTimelapseFrameSize(tl["frameSize"].as<int>());
+      }
+    }
+    
+    // Выгрузка сегментов на сервер
+    if (rec["upload"].is<JsonObject>()) {
+      JsonObject upload = rec["upload"];
+      if (upload["enabled"].is<bool>()) {
+        setUploadEnabled(upload["enabled"].as<bool>());
+      }
+      if (upload["rate"].is<int>()) {
+        setUploadRate(upload["rate"].as<int>());
+      }
+    }
   }
   
   // Применяем только если что-то изменилось
   if (memcmp(&newSettings, &currentSettings, sizeof(CameraSettings)) != 0) {
     applyCameraSettings(newSettings);
   }
+  return true;
 }
 
-void handleServerSettings() {
-  if (!isWiFiConnected()) return;
-  
-  // КРИТИЧНО: Пропускаем если уже идёт HTTP операция
-  if (settingsBusy) return;
-  
-  unsigned long now = millis();
-  if (now - lastPollTime < pollInterval) return;
-  lastPollTime = now;
-  
-  // Пропускаем если идёт активная отправка видео (не мешаем стримингу)
-  if (isStreaming()) {
-    // Проверяем только если стриминг не слишком активен
-    static unsigned long lastCheckTime = 0;
-    if (now - lastCheckTime < 100) {
-      return;  // Слишком частые кадры - откладываем проверку
-    }
-    lastCheckTime = now;
-  }
-  
-  settingsBusy = true;  // Устанавливаем флаг занятости
-  
-  // Cache URLs on first call (use dynamic server host from NVS)
+bool processSettings(const char* json, size_t length) {
+  uint32_t before = getLoopAllocations();
+  bool applied = applySettings(json, length);
+  traceEvent(TRACE_SETTINGS_APPLIED, length);
+  settingsAllocations = getLoopAllocations() - before;
+  return applied;
+}
+
+// Заголовки ответа SETTINGS_PATH: версия настроек (если сервер её присылает) и ETag
+static const char* VERSION_HEADER = "X-Settings-Version";
+static const char* ETAG_HEADER = "ETag";
+
+static void cacheURLs() {
   if (!urlsCached) {
     String serverHost = getCurrentServerHost();
     settingsURL = String("http://") + serverHost + ":" + String(SERVER_PORT) + SETTINGS_PATH;
     statusURL = String("http://") + serverHost + ":" + String(SERVER_PORT) + STATUS_PATH;
     urlsCached = true;
   }
-  
-  HTTPClient http;
-  http.setConnectTimeout(200);  // Уменьшили с 300 до 200
-  http.setTimeout(400);  // Уменьшили с 500 до 400
-  http.setReuse(false);  // Don't reuse connection for settings
-  
-  if (http.begin(settingsURL)) {
-    http.addHeader("X-Device-ID", WiFi.macAddress());
-    http.addHeader("X-Device-IP", getLocalIP());
-    
-    int httpCode = http.GET();
-    
-    if (httpCode == HTTP_CODE_OK) {
-      String payload = http.getString();
-      if (payload.length() > 2) {
-        processSettings(payload);
-      }
+}
+
+// Запрос настроек (GET SETTINGS_PATH) через очередь async_http
+// conditional - с If-None-Match: без изменений сервер отвечает 304 без тела
+static AsyncHttpRequest settingsRequest(uint8_t tag, bool conditional, uint16_t timeoutMs, AsyncHttpCallback callback) {
+  cacheURLs();
+  char localIP[16];
+  formatLocalIP(localIP, sizeof(localIP));
+  AsyncHttpRequest request;
+  request.tag = tag;
+  request.url = settingsURL.c_str();
+  int len = snprintf(request.headers, sizeof(request.headers), "X-Device-ID: %s\nX-Device-IP: %s\n", getDeviceId(), localIP);
+  if (conditional && settingsETag[0] && len > 0 && (size_t)len < sizeof(request.headers)) {
+    int added = snprintf(request.headers + len, sizeof(request.headers) - len, "If-None-Match: %s\n", settingsETag);
+    if (added < 0 || (size_t)(len + added) >= sizeof(request.headers)) {
+      // Не поместился целиком - обычный запрос вместо заведомо несовпадающего тега
+      request.headers[len] = 0;
+      Serial.println("Settings: ETag does not fit request headers, conditional GET skipped");
+    }
+  }
+  request.collectHeaders[0] = VERSION_HEADER;
+  request.collectHeaders[1] = ETAG_HEADER;
+  request.timeoutMs = timeoutMs;
+  request.callback = callback;
+  return request;
+}
+
+// Ответ применён: запоминаем версию и ETag (headers[] в порядке settingsRequest)
+static void updateSettingsVersion(const AsyncHttpResponse& response) {
+  if (response.headers[0][0]) {
+    setSettingsVersion(strtoul(response.headers[0], nullptr, 10));
+  }
+  strlcpy(settingsETag, response.headers[1], sizeof(settingsETag));
+}
+
+// Ответ на периодический опрос (вызывается из loop через handleAsyncHttp)
+// 304 Not Modified - настройки не изменились, JSON не разбирается
+static void onSettingsResponse(const AsyncHttpResponse& response) {
+  // Не разобранные настройки не подтверждаем: без версии и ETag следующий опрос получит их снова
+  if (response.status == HTTP_CODE_OK) {
+    if (response.length <= 2 || processSettings(response.body, response.length)) {
+      updateSettingsVersion(response);
     }
-    
-    http.end();
   }
+}
+
+void handleServerSettings() {
+  if (!isWiFiConnected()) return;
   
-  settingsBusy = false;  // Снимаем флаг занятости
+  // Настройки приходят через long-poll канал или в ответах видеопотока - опрос не нужен
+  if (isSettingsChannelActive() || isStreamControlActive()) return;
+  
+  unsigned long now = millis();
+  if (now - lastPollTime < pollInterval) return;
+  
+  // Предыдущий запрос ещё выполняется - не копим очередь
+  if (asyncHttpPending(REQUEST_SETTINGS)) return;
+  lastPollTime = now;
+  
+  asyncHttpSubmit(settingsRequest(REQUEST_SETTINGS, true, 2000, onSettingsResponse));
 }
 
+static size_t buildStatusJson();
+
 void sendStatusToServer() {
   if (!isWiFiConnected()) return;
   
-  // КРИТИЧНО: Пропускаем если уже идёт HTTP операция
-  if (settingsBusy) return;
-  
   unsigned long now = millis();
   if (now - lastStatusTime < statusInterval) return;
-  lastStatusTime = now;
   
-  // Пропускаем если идёт активная отправка видео
-  if (isStreaming()) {
-    static unsigned long lastStatusCheckTime = 0;
-    if (now - lastStatusCheckTime < 100) {
-      return;  // Слишком частые кадры - откладываем отправку статуса
-    }
-    lastStatusCheckTime = now;
-  }
-  
-  settingsBusy = true;  // Устанавливаем флаг занятости
+  // Предыдущий статус ещё отправляется
+  if (asyncHttpPending(REQUEST_STATUS)) return;
+  lastStatusTime = now;
   
-  // Cache URLs on first call (use dynamic server host from NVS)
-  if (!urlsCached) {
-    String serverHost = getCurrentServerHost();
-    settingsURL = String("http://") + serverHost + ":" + String(SERVER_PORT) + SETTINGS_PATH;
-    statusURL = String("http://") + serverHost + ":" + String(SERVER_PORT) + STATUS_PATH;
-    urlsCached = true;
+  cacheURLs();
+  
+  uint32_t allocationsBefore = getLoopAllocations();
+  size_t length = buildStatusJson();
+  
+  // Между кадрами в соединении потока, если сервер отвечает в нём управлением
+  if (length > 0 && !sendStatusInBand(statusJson, length)) {
+    AsyncHttpRequest request;
+    request.tag = REQUEST_STATUS;
+    request.post = true;
+    request.url = statusURL.c_str();
+    strlcpy(request.headers, "Content-Type: application/json\n", sizeof(request.headers));
+    request.body = statusJson;
+    request.bodyLength = length;
+    request.timeoutMs = 2000;
+    asyncHttpSubmit(request);
   }
-  
-  JsonDocument doc;
-  doc["device_id"] = WiFi.macAddress();
-  doc["ip"] = getLocalIP();
+  // Уходит в следующем статусе
+  statusAllocations = getLoopAllocations() - allocationsBefore;
+}
+
+// Статус в statusJson, возвращает длину (0 - не поместился)
+static size_t buildStatusJson() {
+  char localIP[16];
+  formatLocalIP(localIP, sizeof(localIP));
+  char recordingStatus[96];
+  formatRecordingStatus(recordingStatus, sizeof(recordingStatus));
+  
+  JsonDocument doc(&arena);
+  doc["device_id"] = getDeviceId();
+  doc["ip"] = localIP;
   doc["streaming"] = isStreaming();
   doc["wifi_rssi"] = WiFi.RSSI();
   doc["uptime"] = millis() / 1000;
   doc["free_heap"] = ESP.getFreeHeap();
   doc["frames_sent"] = getFramesSent();
   doc["frames_failed"] = getFailedFrames();
+  doc["settings_version"] = getSettingsVersion();
+  doc["settings_push"] = isSettingsChannelActive();
+  doc["settings_inband"] = isStreamControlActive();
+  
+  // Подключение WiFi и время до первого кадра (0 - ещё не было)
+  JsonObject wifi = doc["wifi"].to<JsonObject>();
+  wifi["connect_ms"] = getWiFiConnectTime();
+  wifi["directed"] = wasWiFiConnectDirected();
+  wifi["disconnect_reason"] = getWiFiDisconnectReason();
+  char bssid[18];
+  formatWiFiBSSID(bssid, sizeof(bssid));
+  wifi["ssid"] = getWiFiSSID();
+  wifi["bssid"] = bssid;
+  wifi["roams"] = getWiFiRoamCount();
+  WiFiRoamDecision roamDecisions[WIFI_ROAM_LOG];
+  size_t roamCount = getWiFiRoamLog(roamDecisions, WIFI_ROAM_LOG);
+  if (roamCount > 0) {
+    JsonArray roamLog = wifi["roam_log"].to<JsonArray>();
+    for (size_t i = 0; i < roamCount; i++) {
+      const WiFiRoamDecision& decision = roamDecisions[i];
+      JsonObject entry = roamLog.add<JsonObject>();
+      entry["t"] = decision.uptime;
+      entry["reason"] = decision.reason == WIFI_ROAM_REASON_SEND ? "send" : "rssi";
+      entry["roamed"] = decision.roamed;
+      entry["rssi"] = decision.rssi;
+      entry["kb_s"] = decision.throughputKB;
+      entry["from"] = decision.from;
+      if (decision.targetProfile >= 0) {
+        entry["to"] = decision.to;
+        entry["to_rssi"] = decision.targetRssi;
+        entry["to_profile"] = decision.targetProfile;
+      }
+    }
+  }
+  JsonObject ttff = doc["ttff"].to<JsonObject>();
+  ttff["boot_ms"] = getBootTimeToFirstFrame();
+  ttff["link_loss_ms"] = getLinkLossTimeToFirstFrame();
+  
+  // Записи настроек в NVS (flash)
+  SettingsStoreStats nvs = getSettingsStoreStats();
+  JsonObject nvsObj = doc["nvs"].to<JsonObject>();
+  nvsObj["writes"] = nvs.writes;
+  nvsObj["skipped"] = nvs.skipped;
+  nvsObj["coalesced"] = nvs.coalesced;
+  nvsObj["failures"] = nvs.failures;
+  nvsObj["pending"] = nvs.pending;
+  nvsObj["last_write_us"] = nvs.lastWriteUs;
+  nvsObj["max_write_us"] = nvs.maxWriteUs;
+  
+  // Кадры, накопленные за время обрыва связи
+  SpoolStatus spoolStatus = getSpoolStatus();
+  if (spoolStatus.enabled) {
+    JsonObject spool = doc["spool"].to<JsonObject>();
+    spool["active"] = spoolStatus.active;
+    spool["frames"] = spoolStatus.frames;
+    spool["kb"] = spoolStatus.bytes / 1024;
+    spool["spooled"] = spoolStatus.spooled;
+    spool["backfilled"] = spoolStatus.backfilled;
+  }
   
   // SD card recording status
   JsonObject recording = doc["recording"].to<JsonObject>();
   recording["active"] = isRecording();
-  recording["status"] = getRecordingStatus();
+  recording["status"] = recordingStatus;
+  static const char* modeNames[] = {"continuous", "event", "timelapse"};
+  recording["mode"] = modeNames[getRecordingMode()];
+  recording["events"] = getRecordingEventCount();
+  recording["fps"] = getRecordingFPS();
+  recording["every"] = getRecordingDecimation();
+  recording["container"] = getRecordingContainer() == RECORDING_MKV ? "mkv" : "avi";
+  
+  UploadStatus uploadStatus = getUploadStatus();
+  JsonObject upload = recording["upload"].to<JsonObject>();
+  upload["enabled"] = uploadStatus.enabled;
+  upload["active"] = uploadStatus.active;
+  upload["paused"] = uploadStatus.paused;
+  upload["rate"] = getUploadRate();
+  if (uploadStatus.active) {
+    upload["segment"] = uploadStatus.segment;
+    upload["offset"] = uploadStatus.offset;
+    upload["total"] = uploadStatus.total;
+  }
+  upload["uploaded"] = uploadStatus.uploaded;
+  upload["sent_kb"] = uploadStatus.sentKB;
+  upload["pauses"] = uploadStatus.pauses;
+  upload["failures"] = uploadStatus.failures;
+  recording["playback_kb"] = getPlaybackSentKB();
   
   SDCardInfo sdInfo = getSDCardInfo();
   if (sdInfo.mounted) {
@@ -339,9 +666,34 @@ void sendStatusToServer() {
     sdcard["used_mb"] = sdInfo.usedMB;
     sdcard["free_mb"] = sdInfo.freeMB;
     sdcard["file_count"] = sdInfo.fileCount;
+    sdcard["bus_width"] = getMountedSDBusWidth();
   } else {
     doc["sdcard"]["mounted"] = false;
   }
+  doc["sdcard"]["bus_width_config"] = getSDBusWidth();
+  doc["sdcard"]["freq_khz"] = SD_BUS_FREQ_KHZ;
+  
+  // Результаты теста скорости карты
+  static const char* benchStateNames[] = {"idle", "running", "done", "failed"};
+  SDBenchState benchState = getSDBenchmarkState();
+  if (benchState != SD_BENCH_IDLE) {
+    JsonObject bench = doc["sdcard"]["bench"].to<JsonObject>();
+    bench["state"] = benchStateNames[benchState];
+    SDBenchResult benchResults[SD_BENCH_BLOCK_SIZES];
+    int benchBusWidth = 0;
+    int benchCount = getSDBenchmarkResults(benchResults, benchBusWidth);
+    if (benchCount > 0) {
+      bench["bus_width"] = benchBusWidth;
+      JsonArray results = bench["results"].to<JsonArray>();
+      for (int i = 0; i < benchCount; i++) {
+        JsonObject result = results.add<JsonObject>();
+        result["block_kb"] = benchResults[i].blockSize / 1024;
+        result["mb_s"] = benchResults[i].kbPerSec / 1024.0;
+        result["p99_ms"] = benchResults[i].p99Us / 1000.0;
+        result["max_ms"] = benchResults[i].maxUs / 1000.0;
+      }
+    }
+  }
   
   // Current camera settings
   JsonObject camera = doc["camera"].to<JsonObject>();
@@ -354,67 +706,86 @@ void sendStatusToServer() {
   camera["vflip"] = currentSettings.vflip;
   camera["hmirror"] = currentSettings.hmirror;
   
-  String json;
-  serializeJson(doc, json);
-  
-  HTTPClient http;
-  http.setConnectTimeout(200);  // Уменьшили с 300 до 200
-  http.setTimeout(400);  // Уменьшили с 500 до 400
-  http.setReuse(false);
+  // Задержки этапов кадра за окно с прошлого статуса, мкс
+  JsonObject latency = doc["latency"].to<JsonObject>();
+  for (int i = 0; i < LATENCY_STAGES; i++) {
+    LatencySummary summary = latencyTake((LatencyStage)i);
+    JsonObject stage = latency[latencyStageName((LatencyStage)i)].to<JsonObject>();
+    stage["n"] = summary.count;
+    stage["p50"] = summary.p50;
+    stage["p90"] = summary.p90;
+    stage["p99"] = summary.p99;
+    stage["max"] = summary.max;
+  }
   
-  if (http.begin(statusURL)) {
-    http.addHeader("Content-Type", "application/json");
-    http.POST(json);
-    http.end();
+  // Память: куча и арена; счётчики выделений - при сборке с HEAP_COUNTERS
+  JsonObject heap = doc["heap"].to<JsonObject>();
+  heap["min_free"] = ESP.getMinFreeHeap();
+  heap["largest_block"] = ESP.getMaxAllocHeap();
+  heap["arena_peak"] = arena.peak();
+  heap["arena_failures"] = arena.failures();
+  if (heapCountersEnabled()) {
+    heap["loop_allocs"] = getLoopAllocations();
+    heap["status_allocs"] = statusAllocations;
+    heap["settings_allocs"] = settingsAllocations;
   }
   
-  settingsBusy = false;  // Снимаем флаг занятости
+  if (doc.overflowed()) {
+    Serial.println("Status JSON: arena overflow");
+    return 0;
+  }
+  // Сериализация прямо в сокет шла бы по символу на вызов write() - собираем в буфер
+  size_t length = measureJson(doc);
+  if (length >= sizeof(statusJson)) {
+    Serial.printf("Status JSON too large: %u bytes\n", (unsigned)length);
+    return 0;
+  }
+  return serializeJson(doc, statusJson, sizeof(statusJson));
+}
+
+// Ответ на запрос начальных настроек (вызывается из loop через handleAsyncHttp)
+static void onInitialSettingsResponse(const AsyncHttpResponse& response) {
+  if (response.status == HTTP_CODE_OK) {
+    if (processSettings(response.body, response.length)) {
+      updateSettingsVersion(response);
+    }
+    initialSettingsReceived = true;
+    initialSettingsAttempts = 0;  // Сбрасываем счётчик при успехе
+  } else {
+    Serial.printf("Failed to fetch settings, HTTP code: %d\n", response.status);
+    initialSettingsAttempts++;  // Увеличиваем счётчик при неудаче
+  }
 }
 
 bool fetchInitialSettingsFromServer() {
+  // Ответ пришёл - настройки уже применены в onInitialSettingsResponse
+  if (initialSettingsReceived) {
+    initialSettingsReceived = false;
+    initialSettingsLoaded = true;
+    return true;
+  }
+  
   if (!isWiFiConnected()) {
     Serial.println("Cannot fetch settings: WiFi not connected");
     return false;
   }
   
-  // Cache URLs if needed
-  if (!urlsCached) {
-    String serverHost = getCurrentServerHost();
-    settingsURL = String("http://") + serverHost + ":" + String(SERVER_PORT) + SETTINGS_PATH;
-    statusURL = String("http://") + serverHost + ":" + String(SERVER_PORT) + STATUS_PATH;
-    urlsCached = true;
-  }
-  
-  Serial.println("Fetching initial settings from server: " + settingsURL);
-  
-  HTTPClient http;
-  http.setConnectTimeout(5000);  // 5 seconds timeout
-  http.setTimeout(5000);
-  http.setReuse(false);
-  
-  if (!http.begin(settingsURL)) {
-    Serial.println("Failed to begin HTTP connection");
+  // Запрос уже в очереди - ждём ответа, loop не блокируется
+  if (asyncHttpPending(REQUEST_INITIAL_SETTINGS)) {
     return false;
   }
   
-  int httpCode = http.GET();
-  
-  if (httpCode == HTTP_CODE_OK) {
-    String payload = http.getString();
-    
-    // Process settings
-    processSettings(payload);
-    
-    initialSettingsLoaded = true;
-    initialSettingsAttempts = 0;  // Сбрасываем счётчик при успехе
-    http.end();
-    return true;
-  } else {
-    Serial.printf("Failed to fetch settings, HTTP code: %d\n", httpCode);
-    initialSettingsAttempts++;  // Увеличиваем счётчик при неудаче
-    http.end();
+  unsigned long now = millis();
+  if (lastInitialAttemptTime != 0 && now - lastInitialAttemptTime < INITIAL_SETTINGS_RETRY_MS) {
     return false;
   }
+  lastInitialAttemptTime = now;
+  
+  cacheURLs();
+  Serial.println("Fetching initial settings from server: " + settingsURL);
+  // Без If-None-Match: после загрузки нужны все настройки
+  asyncHttpSubmit(settingsRequest(REQUEST_INITIAL_SETTINGS, false, 5000, onInitialSettingsResponse));
+  return false;
 }
 
 bool areInitialSettingsLoaded() {
@@ -0,0 +1,367 @@
+#include "settings_channel.h"
+#include "config.h"
+#include "server_settings.h"
+#include "stream_client.h"
+#include "stream_control.h"
+#include "wifi_client.h"
+#include <WiFi.h>
+#include <lwip/sockets.h>
+
+// Состояние запроса
+enum WatchState {
+  WATCH_IDLE,       // Нет запроса (ожидание повтора)
+  WATCH_CONNECTING, // Неблокирующий connect(), готовность проверяется в loop
+  WATCH_WAITING     // Запрос отправлен, сервер держит его до изменения настроек
+};
+
+static WiFiClient watchClient;
+static WatchState watchState = WATCH_IDLE;
+static int connectFd = -1;             // Сокет в WATCH_CONNECTING (потом переходит в watchClient)
+static unsigned long connectStart = 0;
+static uint32_t settingsVersion = 0;
+static bool channelActive = false;     // Последний запрос получил ответ
+
+// Разбор ответа
+static char responseLine[96];
+static size_t responseLineLen = 0;
+static int responseStatus = 0;
+static long responseVersion = -1;
+static long responseBodyLeft = 0;
+static bool responseHeadersDone = false;
+static bool responseClose = false;
+static char responseBody[SETTINGS_JSON_MAX + 1];
+static size_t responseBodyLen = 0;
+static unsigned long requestTime = 0;
+
+// Адрес сервера по имени: разрешается один раз, повторно - только после ошибки connect()
+// (WiFi.hostByName() блокирует loop на время DNS запроса)
+static IPAddress serverIP;
+static bool serverIPValid = false;
+static String resolvedHost;            // Имя последнего запроса DNS
+static unsigned long resolveTime = 0;
+static bool serverIPStale = false;     // Был сбой connect() - после RESOLVE_INTERVAL разрешить заново
+
+// Повтор после ошибки
+static unsigned long retryTime = 0;
+static unsigned long backoffMs = 0;
+
+static const unsigned long CONNECT_TIMEOUT = 3000;                   // мс, connect() не блокирует loop
+static const unsigned long RESPONSE_TIMEOUT = (SETTINGS_WATCH_TIMEOUT_S + 10) * 1000UL;
+static const unsigned long MAX_BACKOFF = 60000;
+static const unsigned long UNSUPPORTED_RETRY = 600000;               // Старый сервер - проверяем раз в 10 мин
+static const unsigned long RESOLVE_INTERVAL = 60000;                 // DNS запросы к одному имени - не чаще
+
+static void abortRequest() {
+  if (connectFd >= 0) {
+    close(connectFd);
+    connectFd = -1;
+  }
+  watchClient.stop();
+  watchState = WATCH_IDLE;
+}
+
+// Ошибка запроса - повтор с экспоненциальной задержкой, настройки пока получает опрос
+static void failRequest(const char* reason) {
+  abortRequest();
+  channelActive = false;
+  backoffMs = backoffMs ? min(backoffMs * 2, MAX_BACKOFF) : 1000;
+  retryTime = millis() + backoffMs;
+  Serial.printf("Settings channel failed (%s), retry in %lus\n", reason, backoffMs / 1000);
+}
+
+// Адрес сервера - обычно IP. Имя разрешается при первом подключении и после сбоев connect()
+// (сервер мог сменить адрес), но не чаще RESOLVE_INTERVAL: повторы с задержкой не ждут DNS
+static bool resolveServer(unsigned long now, IPAddress& ip) {
+  const String& host = getServerHost();
+  if (ip.fromString(host.c_str())) {
+    return true;
+  }
+  if (resolvedHost != host) {
+    serverIPValid = false;  // Другой сервер - прежний адрес не подходит
+  } else if (now - resolveTime < RESOLVE_INTERVAL) {
+    // Имя недавно разрешалось: адрес из кэша, а без адреса (DNS не ответил) - ждём интервала
+    ip = serverIP;
+    return serverIPValid;
+  } else if (serverIPValid && !serverIPStale) {
+    ip = serverIP;
+    return true;
+  }
+
+  resolveTime = now;
+  resolvedHost = host;
+  IPAddress resolved;
+  if (WiFi.hostByName(host.c_str(), resolved)) {
+    serverIP = resolved;
+    serverIPValid = true;
+    serverIPStale = false;
+  }
+  // DNS не ответил - пробуем прежний адрес, если он был
+  ip = serverIP;
+  return serverIPValid;
+}
+
+// Начать connect() без ожидания: при недоступном сервере блокирующий connect() на каждом
+// повторе останавливал бы захват и видеопоток на CONNECT_TIMEOUT
+static bool beginConnect(unsigned long now) {
+  IPAddress ip;
+  if (!resolveServer(now, ip)) {
+    return false;
+  }
+  int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (fd < 0) {
+    return false;
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(SERVER_PORT);
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+    close(fd);
+    serverIPStale = true;
+    return false;
+  }
+  connectFd = fd;
+  connectStart = now;
+  watchState = WATCH_CONNECTING;
+  return true;
+}
+
+// Готовность connect(): 1 - соединение установлено, 0 - ещё нет, -1 - ошибка
+static int pollConnect() {
+  fd_set writeSet;
+  FD_ZERO(&writeSet);
+  FD_SET(connectFd, &writeSet);
+  struct timeval tv = {0, 0};
+  int ready = select(connectFd + 1, nullptr, &writeSet, nullptr, &tv);
+  if (ready == 0) {
+    return 0;
+  }
+  int error = 0;
+  socklen_t len = sizeof(error);
+  if (ready < 0 || getsockopt(connectFd, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
+    return -1;
+  }
+  return 1;
+}
+
+static void sendRequest(unsigned long now) {
+  char localIP[16];
+  formatLocalIP(localIP, sizeof(localIP));
+  char header[320];
+  int headerLen = snprintf(header, sizeof(header),
+    "GET %s?version=%lu&timeout=%d HTTP/1.1\r\n"
+    "Host: %s:%d\r\n"
+    "X-Device-ID: %s\r\n"
+    "X-Device-IP: %s\r\n"
+    "X-Settings-Version: %lu\r\n"
+    "Connection: keep-alive\r\n\r\n",
+    SETTINGS_WATCH_PATH, (unsigned long)settingsVersion, SETTINGS_WATCH_TIMEOUT_S,
+    getServerHost().c_str(), SERVER_PORT, getDeviceId(), localIP,
+    (unsigned long)settingsVersion);
+
+  if (watchClient.write((const uint8_t*)header, headerLen) != (size_t)headerLen) {
+    failRequest("send");
+    return;
+  }
+  watchState = WATCH_WAITING;
+  requestTime = now;
+  responseLineLen = 0;
+  responseStatus = 0;
+  responseVersion = -1;
+  responseBodyLeft = 0;
+  responseHeadersDone = false;
+  responseClose = false;
+  responseBodyLen = 0;
+}
+
+// Запрос в открытом keep-alive соединении, иначе сначала connect()
+static void startRequest(unsigned long now) {
+  if (watchClient.connected()) {
+    sendRequest(now);
+    return;
+  }
+  watchClient.stop();
+  if (!beginConnect(now)) {
+    failRequest("connect");
+  }
+}
+
+static void finishConnect(unsigned long now) {
+  int result = pollConnect();
+  if (result == 0) {
+    if (now - connectStart > CONNECT_TIMEOUT) {
+      serverIPStale = true;
+      failRequest("connect timeout");
+    }
+    return;
+  }
+  if (result < 0) {
+    serverIPStale = true;
+    failRequest("connect");
+    return;
+  }
+  // Сокет - в WiFiClient в обычном (блокирующем) режиме, как после WiFiClient::connect()
+  fcntl(connectFd, F_SETFL, fcntl(connectFd, F_GETFL, 0) & ~O_NONBLOCK);
+  watchClient = WiFiClient(connectFd);
+  connectFd = -1;
+  watchClient.setNoDelay(true);
+  sendRequest(now);
+}
+
+// Строка заголовка ответа
+static void parseResponseLine() {
+  responseLine[responseLineLen] = 0;
+  if (responseLineLen > 0 && responseLine[responseLineLen - 1] == '\r') {
+    responseLine[--responseLineLen] = 0;
+  }
+
+  if (responseStatus == 0) {
+    // "HTTP/1.1 200 OK"
+    const char* space = strchr(responseLine, ' ');
+    responseStatus = space ? atoi(space + 1) : -1;
+  } else if (responseLineLen == 0) {
+    responseHeadersDone = true;
+  } else if (strncasecmp(responseLine, "X-Settings-Version:", 19) == 0) {
+    responseVersion = strtol(responseLine + 19, nullptr, 10);
+  } else if (strncasecmp(responseLine, "Content-Length:", 15) == 0) {
+    responseBodyLeft = strtol(responseLine + 15, nullptr, 10);
+  } else if (strncasecmp(responseLine, "Connection:", 11) == 0 && strstr(responseLine + 11, "close")) {
+    responseClose = true;
+  }
+  responseLineLen = 0;
+}
+
+// Ответ получен полностью: применяем настройки, следующий запрос подтвердит версию
+static void finishResponse() {
+  watchState = WATCH_IDLE;
+  if (responseClose) {
+    watchClient.stop();
+  }
+
+  if (responseStatus == 404) {
+    // Сервер без канала настроек - остаётся опрос
+    abortRequest();
+    channelActive = false;
+    retryTime = millis() + UNSUPPORTED_RETRY;
+    Serial.println("Settings channel not supported by server, using polling");
+    return;
+  }
+  if (responseStatus != 200 && responseStatus != 204) {
+    char reason[16];
+    snprintf(reason, sizeof(reason), "HTTP %d", responseStatus);
+    failRequest(reason);
+    return;
+  }
+
+  if (!channelActive) {
+    Serial.println("Settings channel active");
+  }
+  channelActive = true;
+  backoffMs = 0;
+
+  if (responseStatus == 200 && responseBodyLen > 2) {
+    Serial.printf("Settings pushed: version %ld\n", responseVersion);
+    bool applied = processSettings(responseBody, responseBodyLen);
+    responseBodyLen = 0;
+    if (!applied) {
+      // Версию не подтверждаем - сервер ответит этими настройками снова; повтор с задержкой,
+      // иначе неразбираемый JSON гонял бы запросы без паузы
+      failRequest("settings not applied");
+      return;
+    }
+  }
+  if (responseVersion >= 0) {
+    settingsVersion = responseVersion;
+  }
+}
+
+// Неблокирующее чтение ответа
+static void readResponse(unsigned long now) {
+  while (watchClient.available()) {
+    int c = watchClient.read();
+    if (c < 0) {
+      break;
+    }
+    if (!responseHeadersDone) {
+      if (c == '\n') {
+        parseResponseLine();
+        if (responseHeadersDone && responseBodyLeft > SETTINGS_JSON_MAX) {
+          failRequest("body too large");
+          return;
+        }
+      } else if (responseLineLen < sizeof(responseLine) - 1) {
+        responseLine[responseLineLen++] = c;
+      }
+    } else {
+      responseBody[responseBodyLen++] = (char)c;
+      responseBodyLeft--;
+    }
+    if (responseHeadersDone && responseBodyLeft <= 0) {
+      finishResponse();
+      return;
+    }
+  }
+
+  if (!watchClient.connected()) {
+    // Сервер закрыл простаивающее keep-alive соединение - обычная ситуация, переподключаемся
+    // (канал остаётся активным, опрос не включается)
+    if (responseStatus == 0 && channelActive && now - requestTime > 1000) {
+      abortRequest();
+      return;
+    }
+    failRequest("closed");
+  } else if (now - requestTime > RESPONSE_TIMEOUT) {
+    failRequest("timeout");
+  }
+}
+
+void handleSettingsChannel() {
+#if SETTINGS_WATCH_ENABLED
+  if (!isWiFiConnected()) {
+    if (watchState != WATCH_IDLE || channelActive) {
+      abortRequest();
+      channelActive = false;
+    }
+    return;
+  }
+
+  // Настройки приходят в ответах видеопотока - отдельное соединение не держим
+  if (isStreamControlActive()) {
+    if (watchState != WATCH_IDLE || channelActive) {
+      abortRequest();
+      channelActive = false;
+    }
+    return;
+  }
+
+  unsigned long now = millis();
+  switch (watchState) {
+    case WATCH_IDLE:
+      if ((long)(now - retryTime) >= 0) {
+        startRequest(now);
+      }
+      break;
+
+    case WATCH_CONNECTING:
+      finishConnect(now);
+      break;
+
+    case WATCH_WAITING:
+      readResponse(now);
+      break;
+  }
+#endif
+}
+
+bool isSettingsChannelActive() {
+  return channelActive;
+}
+
+uint32_t getSettingsVersion() {
+  return settingsVersion;
+}
+
+void setSettingsVersion(uint32_t version) {
+  settingsVersion = version;
+}
@@ -0,0 +1,187 @@
+#include "settings_store.h"
+#include "config.h"
+#include <Preferences.h>
+
+// Заголовок блоба в NVS, за ним size байт данных
+struct BlobHeader {
+  uint16_t version;
+  uint16_t size;
+  uint32_t crc;        // CRC32 данных
+};
+
+struct StoreGroup {
+  const char* ns;             // Namespace NVS (строковый литерал модуля)
+  uint16_t version;
+  uint16_t size;
+  uint8_t data[SETTINGS_STORE_MAX_BLOB];
+  bool stored;                // Во flash лежит блоб storedVersion/storedSize с storedCrc
+  uint16_t storedVersion;
+  uint16_t storedSize;
+  uint32_t storedCrc;
+  bool dirty;                 // data ждёт записи
+  unsigned long firstChange;  // Первое незаписанное изменение
+  unsigned long lastChange;
+};
+
+static StoreGroup groups[SETTINGS_STORE_GROUPS];
+static int groupCount = 0;
+static Preferences storePrefs;
+static SettingsStoreStats stats = {};
+
+static const char* BLOB_KEY = "blob";
+
+static uint32_t crc32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static StoreGroup* findGroup(const char* ns) {
+  for (int i = 0; i < groupCount; i++) {
+    if (strcmp(groups[i].ns, ns) == 0) {
+      return &groups[i];
+    }
+  }
+  if (groupCount >= SETTINGS_STORE_GROUPS) {
+    return nullptr;
+  }
+  StoreGroup* group = &groups[groupCount++];
+  memset(group, 0, sizeof(StoreGroup));
+  group->ns = ns;
+  return group;
+}
+
+bool settingsStoreLoad(const char* ns, uint16_t version, void* data, size_t size) {
+  StoreGroup* group = findGroup(ns);
+  if (!group || size > SETTINGS_STORE_MAX_BLOB) {
+    return false;
+  }
+
+  uint8_t buffer[sizeof(BlobHeader) + SETTINGS_STORE_MAX_BLOB];
+  BlobHeader header;
+  bool valid = false;
+  // Namespace ещё не создан - begin() в RO режиме вернёт false
+  if (storePrefs.begin(ns, true)) {
+    size_t len = storePrefs.getBytesLength(BLOB_KEY);
+    if (len >= sizeof(BlobHeader) && len <= sizeof(buffer) && storePrefs.getBytes(BLOB_KEY, buffer, len) == len) {
+      memcpy(&header, buffer, sizeof(BlobHeader));
+      valid = header.size == len - sizeof(BlobHeader) &&
+              header.crc == crc32(buffer + sizeof(BlobHeader), header.size) &&
+              header.version <= version && header.size <= size;
+    }
+    storePrefs.end();
+  }
+  if (!valid) {
+    return false;
+  }
+
+  // Старая версия - короче, остальные поля data остаются как были
+  memcpy(data, buffer + sizeof(BlobHeader), header.size);
+  group->stored = true;
+  group->storedVersion = header.version;
+  group->storedSize = header.size;
+  group->storedCrc = header.crc;
+  return true;
+}
+
+void settingsStoreSave(const char* ns, uint16_t version, const void* data, size_t size) {
+  StoreGroup* group = findGroup(ns);
+  if (!group || size > SETTINGS_STORE_MAX_BLOB) {
+    Serial.printf("Settings store: cannot save %s\n", ns);
+    return;
+  }
+
+  uint32_t crc = crc32((const uint8_t*)data, size);
+  if (group->stored && group->storedVersion == version && group->storedSize == size && group->storedCrc == crc) {
+    // Совпадает с flash (в том числе вернулись к записанным значениям до истечения задержки)
+    group->dirty = false;
+    stats.skipped++;
+    return;
+  }
+
+  unsigned long now = millis();
+  if (group->dirty) {
+    stats.coalesced++;
+  } else {
+    group->dirty = true;
+    group->firstChange = now;
+  }
+  group->lastChange = now;
+  group->version = version;
+  group->size = size;
+  memcpy(group->data, data, size);
+}
+
+static void writeGroup(StoreGroup& group) {
+  uint8_t buffer[sizeof(BlobHeader) + SETTINGS_STORE_MAX_BLOB];
+  BlobHeader header;
+  header.version = group.version;
+  header.size = group.size;
+  header.crc = crc32(group.data, group.size);
+  memcpy(buffer, &header, sizeof(BlobHeader));
+  memcpy(buffer + sizeof(BlobHeader), group.data, group.size);
+  size_t len = sizeof(BlobHeader) + group.size;
+
+  unsigned long start = micros();
+  size_t written = 0;
+  if (storePrefs.begin(group.ns, false)) {
+    written = storePrefs.putBytes(BLOB_KEY, buffer, len);
+    storePrefs.end();
+  }
+  unsigned long elapsed = micros() - start;
+
+  stats.lastWriteUs = elapsed;
+  if (elapsed > stats.maxWriteUs) {
+    stats.maxWriteUs = elapsed;
+  }
+  if (written != len) {
+    // Повтор после следующей задержки
+    stats.failures++;
+    group.lastChange = millis();
+    group.firstChange = group.lastChange;
+    Serial.printf("Settings store: failed to write %s\n", group.ns);
+    return;
+  }
+  stats.writes++;
+  group.dirty = false;
+  group.stored = true;
+  group.storedVersion = header.version;
+  group.storedSize = header.size;
+  group.storedCrc = header.crc;
+}
+
+void settingsStoreFlush() {
+  for (int i = 0; i < groupCount; i++) {
+    if (groups[i].dirty) {
+      writeGroup(groups[i]);
+    }
+  }
+}
+
+void handleSettingsStore() {
+  unsigned long now = millis();
+  for (int i = 0; i < groupCount; i++) {
+    StoreGroup& group = groups[i];
+    if (group.dirty && (now - group.lastChange >= SETTINGS_STORE_DEBOUNCE_MS ||
+                        now - group.firstChange >= SETTINGS_STORE_MAX_DELAY_MS)) {
+      writeGroup(group);
+      return;  // Не больше одной записи за вызов
+    }
+  }
+}
+
+SettingsStoreStats getSettingsStoreStats() {
+  SettingsStoreStats result = stats;
+  result.pending = 0;
+  for (int i = 0; i < groupCount; i++) {
+    if (groups[i].dirty) {
+      result.pending++;
+    }
+  }
+  return result;
+}
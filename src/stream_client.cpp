@@ -4,18 +4,49 @@
 #include "wifi_client.h"
 #include "wifi_settings.h"
 #include "sd_recorder.h"
+#include "frame_ring.h"
+#include "settings_channel.h"
+#include "stream_control.h"
+#include "latency_histogram.h"
+#include "event_trace.h"
 #include <WiFi.h>
+#include <sys/time.h>
 
 static bool streamingEnabled = false;
 static unsigned long lastFrameTime = 0;
+static unsigned long lastRecordTime = 0;  // Последний кадр для записи на SD
 static unsigned long frameInterval = 1000 / STREAM_FPS;
 static unsigned long framesSent = 0;
 static unsigned long failedFrames = 0;
 static unsigned long streamStartTime = 0;
 static unsigned long lastReconnect = 0;
+
+// Время до первого кадра (TTFF): от загрузки и от потери WiFi до первого кадра, принятого сервером
+static unsigned long ttffStart = 0;          // millis() начала отсчёта (0 - загрузка)
+static bool ttffPending = true;
+static bool ttffAfterLinkLoss = false;
+static unsigned long ttffBootMs = 0;
+static unsigned long ttffLinkLossMs = 0;
 static WiFiClient client;
 static bool clientConnected = false;
 
+// Загрузка канала: среднее время отправки кадра и последняя неудачная отправка
+static unsigned long sendTimeAvgUs = 0;
+static unsigned long sendRateAvgKB = 0;    // Скорость записи кадра в сокет, KB/s (среднее 1/8)
+static unsigned long lastSendFailure = 0;
+static const unsigned long CONGESTION_HOLD_MS = 2000;
+
+// Кадры, захваченные пока сервер недоступен (досылаются после восстановления связи)
+static FrameRing spoolRing = {};
+static bool spoolActive = false;           // Идёт обрыв: кадры копятся в spoolRing
+static unsigned long lastSpoolTime = 0;
+static unsigned long nextBackfillTime = 0;
+static unsigned long spooledFrames = 0;    // Сохранено за всё время
+static unsigned long backfilledFrames = 0; // Дослано за всё время
+// Версия настроек накопленных кадров: запоминается с первым кадром в пустом буфере.
+// Пока сервер недоступен, новые настройки от него не приходят - версия за обрыв не меняется
+static uint32_t spoolSettingsVersion = 0;
+
 // Динамический адрес сервера (загружается из NVS)
 static String serverHost = "";
 
@@ -27,14 +58,40 @@ static const int MAX_SERVER_CONNECTION_FAILURES = 5;
 static const unsigned long RECONNECT_INTERVAL = 3000;
 
 // Кэшированные данные для HTTP запроса (не пересоздаём каждый раз)
-static char httpHeader[256];
+static char httpHeader[320];
 static const char* HEADER_TEMPLATE = 
   "POST %s HTTP/1.1\r\n"
   "Host: %s:%d\r\n"
   "Content-Type: image/jpeg\r\n"
-  "Content-Length: %d\r\n"
+  "Content-Length: %u\r\n"
   "Connection: keep-alive\r\n"
   "X-Frame: %lu\r\n"
+  "X-Settings-Version: %lu\r\n"
+  "\r\n";
+
+// Статус в соединении потока (вместо отдельного запроса STATUS_PATH)
+static const char* STATUS_HEADER_TEMPLATE = 
+  "POST %s HTTP/1.1\r\n"
+  "Host: %s:%d\r\n"
+  "Content-Type: application/json\r\n"
+  "Content-Length: %u\r\n"
+  "Connection: keep-alive\r\n"
+  "X-Settings-Version: %lu\r\n"
+  "\r\n";
+
+// Досылаемый кадр: X-Historical отличает его от живого потока, время захвата - X-Age-Ms
+// (и X-Capture-Ms, если часы синхронизированы)
+static const char* HISTORICAL_HEADER_TEMPLATE = 
+  "POST %s HTTP/1.1\r\n"
+  "Host: %s:%d\r\n"
+  "Content-Type: image/jpeg\r\n"
+  "Content-Length: %u\r\n"
+  "Connection: keep-alive\r\n"
+  "X-Historical: 1\r\n"
+  "X-Age-Ms: %lu\r\n"
+  "X-Backlog: %lu\r\n"
+  "X-Settings-Version: %lu\r\n"
+  "%s"
   "\r\n";
 
 void initStreaming() {
@@ -47,6 +104,13 @@ void initStreaming() {
   
   // Загружаем адрес сервера из NVS
   serverHost = getCurrentServerHost();
+  
+#if STREAM_SPOOL_ENABLED
+  // Буфер выделяется один раз: во время обрыва память не выделяется
+  if (!spoolRing.buffer && !frameRingInit(spoolRing, STREAM_SPOOL_MAX_BYTES)) {
+    Serial.println("Stream spool disabled: no PSRAM");
+  }
+#endif
 }
 
 void setStreamFPS(int fps) {
@@ -80,6 +144,8 @@ static bool ensureConnected() {
     return false;
   }
   lastReconnect = now;
+  unsigned long reconnectStart = micros();
+  traceEvent(TRACE_RECONNECT_BEGIN);
   
   clientConnected = false;
   if (client.connected()) {
@@ -90,9 +156,14 @@ static bool ensureConnected() {
   // Подключаемся
   client.setTimeout(500);  // Уменьшен таймаут для быстрого обнаружения проблем
   
-  if (client.connect(serverHost.c_str(), SERVER_PORT)) {
+  bool connected = client.connect(serverHost.c_str(), SERVER_PORT);
+  // Вся попытка, вместе с паузой - столько loop не обрабатывает кадры
+  latencyRecord(LATENCY_RECONNECT, micros() - reconnectStart);
+  traceEvent(TRACE_RECONNECT_END, connected);
+  if (connected) {
     clientConnected = true;
     client.setNoDelay(true);
+    streamControlReset();
     serverConnectionFailures = 0;  // Сбрасываем только при УСПЕШНОМ подключении
     return true;
   }
@@ -103,6 +174,25 @@ static bool ensureConnected() {
   return false;
 }
 
+void markStreamLinkLost() {
+  // Кадр ещё не уходил после загрузки - продолжаем отсчёт от загрузки
+  if (!ttffPending) {
+    ttffPending = true;
+    ttffAfterLinkLoss = true;
+    ttffStart = millis();
+  }
+  // Первое переподключение к серверу после восстановления WiFi - без паузы RECONNECT_INTERVAL
+  lastReconnect = millis() - RECONNECT_INTERVAL;
+}
+
+unsigned long getBootTimeToFirstFrame() {
+  return ttffBootMs;
+}
+
+unsigned long getLinkLossTimeToFirstFrame() {
+  return ttffLinkLossMs;
+}
+
 bool startStreaming() {
   if (!isWiFiConnected()) {
     Serial.println("Cannot start streaming: WiFi not connected");
@@ -127,29 +217,27 @@ void stopStreaming() {
   streamingEnabled = false;
   client.stop();
   clientConnected = false;
+  streamControlReset();
 }
 
-// Fast frame sending via raw socket
-static inline bool sendFrameData(camera_fb_t* fb) {
+// Fast frame sending via raw socket (заголовок уже собран в httpHeader)
+static inline bool sendFrameData(const uint8_t* data, size_t len, int headerLen) {
   // Check connection is alive
   if (!client.connected()) {
     return false;
   }
   
-  // Быстрая очистка входящего буфера (не более 100 байт)
-  int clearCount = 0;
-  while (client.available() && clearCount < 100) {
-    client.read();
-    clearCount++;
-  }
+  // Ответы на предыдущие запросы (настройки в ответах разбирает stream_control)
+  streamControlRead(client);
   
-  // Build HTTP header
-  int headerLen = snprintf(httpHeader, sizeof(httpHeader), HEADER_TEMPLATE,
-    STREAM_PATH, serverHost.c_str(), SERVER_PORT, fb->len, framesSent);
+  // Ошибка или обрезка заголовка в snprintf
+  if (headerLen < 0 || (size_t)headerLen >= sizeof(httpHeader)) {
+    return false;
+  }
   
   // Send header
   size_t sent = client.write((uint8_t*)httpHeader, headerLen);
-  if (sent != headerLen) {
+  if (sent != (size_t)headerLen) {
     return false;
   }
   
@@ -157,9 +245,9 @@ static inline bool sendFrameData(camera_fb_t* fb) {
   const size_t CHUNK_SIZE = 16384;  // 16KB chunks for maximum performance
   size_t offset = 0;
   
-  while (offset < fb->len) {
-    size_t toSend = min(CHUNK_SIZE, fb->len - offset);
-    sent = client.write(fb->buf + offset, toSend);
+  while (offset < len) {
+    size_t toSend = min(CHUNK_SIZE, len - offset);
+    sent = client.write(data + offset, toSend);
     
     if (sent != toSend) {
       return false;
@@ -171,62 +259,254 @@ static inline bool sendFrameData(camera_fb_t* fb) {
   return true;
 }
 
-void sendFrame() {
-  if (!streamingEnabled || !isWiFiConnected()) return;
+// Интервал захвата для записи на SD (профиль записи не зависит от стриминга)
+static bool isRecordingCaptureDue(unsigned long now) {
+  if (!isRecordingEnabled() || !isSDCardPresent()) {
+    return false;
+  }
+  unsigned long interval = getRecordingCaptureInterval();
+  if (interval == 0) {
+    interval = frameInterval;
+  }
+  return now - lastRecordTime >= interval;
+}
+
+// Обрыв связи: дальше кадры копятся в spoolRing (прореживание - STREAM_SPOOL_INTERVAL_MS)
+static void beginSpool() {
+  if (spoolRing.buffer && !spoolActive) {
+    spoolActive = true;
+    Serial.println("Server unreachable, spooling frames");
+  }
+}
+
+// Отправка в соединение потока не удалась: переподключение, кадры копятся
+static void dropConnection() {
+  lastSendFailure = millis();
+  clientConnected = false;
+  client.stop();
+  beginSpool();
+}
+
+static bool isSpoolDue(unsigned long now) {
+  return spoolActive && now - lastSpoolTime >= STREAM_SPOOL_INTERVAL_MS;
+}
+
+static void spoolFrame(const uint8_t* data, size_t len, unsigned long captureTime) {
+  lastSpoolTime = captureTime;
+  if (spoolRing.frames == 0) {
+    spoolSettingsVersion = getSettingsVersion();
+  }
+  if (frameRingPush(spoolRing, data, len, captureTime)) {
+    spooledFrames++;
+  }
+}
+
+// Отправка одного накопленного кадра, не чаще STREAM_BACKFILL_RATE_KB и только при свободном канале
+static void backfillFrame(unsigned long now) {
+  if (spoolRing.frames == 0 || (long)(now - nextBackfillTime) < 0 || isStreamCongested()) {
+    return;
+  }
+  const uint8_t* data;
+  size_t len;
+  uint32_t captureTime;
+  if (!frameRingPeek(spoolRing, data, len, captureTime)) {
+    return;
+  }
   
-  unsigned long now = millis();
-  if (now - lastFrameTime < frameInterval) return;
-  lastFrameTime = now;
+  unsigned long age = now - captureTime;
+  char captureHeader[40] = "";
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  if (tv.tv_sec > 1600000000) {
+    uint64_t captureMs = (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000 - age;
+    snprintf(captureHeader, sizeof(captureHeader), "X-Capture-Ms: %llu\r\n", (unsigned long long)captureMs);
+  }
+  int headerLen = snprintf(httpHeader, sizeof(httpHeader), HISTORICAL_HEADER_TEMPLATE,
+    STREAM_PATH, serverHost.c_str(), SERVER_PORT, (unsigned)len, age, (unsigned long)spoolRing.frames - 1,
+    (unsigned long)spoolSettingsVersion, captureHeader);
   
-  // Проверяем/восстанавливаем соединение
-  if (!ensureConnected()) {
-    failedFrames++;
+  if (!sendFrameData(data, len, headerLen)) {
+    // Кадр остаётся в буфере до следующего соединения
+    dropConnection();
     return;
   }
+  frameRingPop(spoolRing);
+  backfilledFrames++;
+  nextBackfillTime = now + (unsigned long)((uint64_t)len * 1000 / (STREAM_BACKFILL_RATE_KB * 1024UL));
+  if (spoolRing.frames == 0) {
+    Serial.printf("Backfill complete: %lu frames\n", backfilledFrames);
+  }
+}
+
+void sendFrame() {
+  unsigned long now = millis();
+  bool streamDue = streamingEnabled && isWiFiConnected() && now - lastFrameTime >= frameInterval;
+  bool recordDue = isRecordingCaptureDue(now);
+  
+  // Нет WiFi - кадры потока тоже копятся
+  if (streamingEnabled && !isWiFiConnected()) {
+    beginSpool();
+  }
+  bool spoolDue = isSpoolDue(now);
+  if (!streamDue && !recordDue && !spoolDue) return;
+  
+  // Кадр записи с собственным разрешением (timelapse) - отдельный захват
+  int recordFrameSize = getRecordingFrameSize();
+  if (recordDue && recordFrameSize >= 0) {
+    lastRecordTime = now;
+    recordDue = false;
+    camera_fb_t* fb = captureFrameAtSize((framesize_t)recordFrameSize);
+    if (fb) {
+      recordFrame(fb->buf, fb->len);
+      releaseFrame(fb);
+    }
+  }
+  
+  if (streamDue) {
+    lastFrameTime = now;
+    // Проверяем/восстанавливаем соединение (запись на SD от него не зависит)
+    if (!ensureConnected()) {
+      failedFrames++;
+      traceEvent(TRACE_FRAME_DROPPED, TRACE_DROP_NO_CONNECTION);
+      streamDue = false;
+      beginSpool();
+      spoolDue = isSpoolDue(now);
+    }
+  }
+  if (!streamDue && !recordDue && !spoolDue) return;
   
-  // Захватываем кадр
+  // Захватываем кадр (один захват на стриминг, запись и буфер обрыва)
   camera_fb_t* fb = captureFrame();
   if (!fb) {
-    failedFrames++;
+    if (streamDue) {
+      failedFrames++;
+      traceEvent(TRACE_FRAME_DROPPED, TRACE_DROP_CAPTURE);
+    }
     return;
   }
   
   // Записываем на SD карту (если включено)
-  if (isRecordingEnabled() && isSDCardPresent()) {
+  if (recordDue) {
+    lastRecordTime = now;
     recordFrame(fb->buf, fb->len);
   }
   
   // Отправляем на сервер
-  if (sendFrameData(fb)) {
+  if (!streamDue) {
+    if (spoolDue) {
+      spoolFrame(fb->buf, fb->len, now);
+    }
+    releaseFrame(fb);
+    return;
+  }
+  
+  unsigned long headerStart = micros();
+  int headerLen = snprintf(httpHeader, sizeof(httpHeader), HEADER_TEMPLATE,
+    STREAM_PATH, serverHost.c_str(), SERVER_PORT, (unsigned)fb->len, framesSent, (unsigned long)getSettingsVersion());
+  unsigned long sendStart = micros();
+  latencyRecord(LATENCY_HEADER, sendStart - headerStart);
+  traceEvent(TRACE_SEND_BEGIN, fb->len);
+  bool sent = sendFrameData(fb->buf, fb->len, headerLen);
+  traceEvent(TRACE_SEND_END, sent);
+  // Экспоненциальное среднее (1/8): write() блокируется, пока TCP окно заполнено
+  unsigned long sendTime = micros() - sendStart;
+  if (sent) {
+    latencyRecord(LATENCY_SOCKET_WRITE, sendTime);
+    unsigned long rate = (unsigned long)((uint64_t)fb->len * 1000000 / (sendTime ? sendTime : 1) / 1024);
+    sendRateAvgKB = sendRateAvgKB ? (sendRateAvgKB * 7 + rate) / 8 : rate;
+  }
+  sendTimeAvgUs = sendTimeAvgUs ? (sendTimeAvgUs * 7 + sendTime) / 8 : sendTime;
+  
+  if (sent) {
+    traceEvent(TRACE_FRAME_SENT, framesSent);
     framesSent++;
     
+    if (ttffPending) {
+      ttffPending = false;
+      unsigned long elapsed = millis() - ttffStart;
+      if (ttffAfterLinkLoss) {
+        ttffLinkLossMs = elapsed;
+        Serial.printf("First frame %lu ms after link loss (WiFi %lu ms)\n", elapsed, getWiFiConnectTime());
+      } else {
+        ttffBootMs = elapsed;
+        Serial.printf("First frame %lu ms after boot (WiFi %lu ms)\n", elapsed, getWiFiConnectTime());
+      }
+    }
+    
     // Async чтение ответа сервера (не ждем полного ответа)
     // Это предотвращает переполнение TCP буфера
-    if (client.available()) {
-      while (client.available() && client.read() != -1) {
-        // Быстро очищаем буфер
-      }
+    streamControlRead(client);
+    
+    if (spoolActive) {
+      spoolActive = false;
+      Serial.printf("Server reachable, %lu frames to backfill\n", (unsigned long)spoolRing.frames);
     }
   } else {
     failedFrames++;
-    clientConnected = false;
-    client.stop();
+    traceEvent(TRACE_FRAME_DROPPED, TRACE_DROP_SEND);
+    dropConnection();
+    if (isSpoolDue(now)) {
+      spoolFrame(fb->buf, fb->len, now);
+    }
   }
   
   // Освобождаем буфер камеры
   releaseFrame(fb);
+  
+  // Накопленные кадры - между живыми, в том же соединении
+  if (sent) {
+    backfillFrame(now);
+  }
 }
 
-void updateStreaming() {
-  if (streamingEnabled) {
-    sendFrame();
+bool sendStatusInBand(const char* json, size_t length) {
+  if (!streamingEnabled || !clientConnected || !isStreamControlActive()) {
+    return false;
+  }
+  int headerLen = snprintf(httpHeader, sizeof(httpHeader), STATUS_HEADER_TEMPLATE,
+    STATUS_PATH, serverHost.c_str(), SERVER_PORT, (unsigned)length, (unsigned long)getSettingsVersion());
+  if (!sendFrameData((const uint8_t*)json, length, headerLen)) {
+    dropConnection();
+    return false;
   }
+  return true;
+}
+
+void updateStreaming() {
+  // Кадры захватываются и без стриминга - для записи на SD
+  sendFrame();
 }
 
 bool isStreaming() {
   return streamingEnabled;
 }
 
+bool isStreamCongested() {
+  if (!streamingEnabled) {
+    return false;
+  }
+  if (lastSendFailure && millis() - lastSendFailure < CONGESTION_HOLD_MS) {
+    return true;
+  }
+  // Отправка занимает больше 3/4 интервала кадра - свободной полосы нет
+  return sendTimeAvgUs > frameInterval * 750;
+}
+
+unsigned long getStreamThroughputKB() {
+  return sendRateAvgKB;
+}
+
+SpoolStatus getSpoolStatus() {
+  SpoolStatus status;
+  status.enabled = spoolRing.buffer != nullptr;
+  status.active = spoolActive;
+  status.frames = spoolRing.frames;
+  status.bytes = spoolRing.bytes;
+  status.spooled = spooledFrames;
+  status.backfilled = backfilledFrames;
+  return status;
+}
+
 unsigned long getFramesSent() {
   return framesSent;
 }
@@ -262,6 +542,6 @@ void setServerHost(const String& host) {
   }
 }
 
-String getServerHost() {
+const String& getServerHost() {
   return serverHost;
 }
@@ -0,0 +1,136 @@
+#include "stream_control.h"
+#include "config.h"
+#include "server_settings.h"
+#include "settings_channel.h"
+
+// Разбор текущего ответа
+static char responseLine[96];
+static size_t responseLineLen = 0;
+static int responseStatus = 0;
+static long responseVersion = -1;
+static long responseBodyLeft = 0;
+static bool responseHeadersDone = false;
+static bool responseTooLarge = false;   // Тело не сохраняется, только пропускается
+static char responseBody[SETTINGS_JSON_MAX];
+static size_t responseBodyLen = 0;
+static bool desynced = false;           // Ответ без Content-Length (chunked) - границы не найти до переподключения
+
+// Последний ответ с X-Settings-Version
+static unsigned long lastControlTime = 0;
+
+// Настройки, ждущие handleStreamControl()
+static char pendingBody[SETTINGS_JSON_MAX + 1];
+static size_t pendingBodyLen = 0;
+static long pendingVersion = -1;
+
+static void resetResponse() {
+  responseLineLen = 0;
+  responseStatus = 0;
+  responseVersion = -1;
+  responseBodyLeft = 0;
+  responseHeadersDone = false;
+  responseTooLarge = false;
+  responseBodyLen = 0;
+}
+
+void streamControlReset() {
+  resetResponse();
+  desynced = false;
+}
+
+// Строка заголовка ответа
+static void parseResponseLine() {
+  responseLine[responseLineLen] = 0;
+  if (responseLineLen > 0 && responseLine[responseLineLen - 1] == '\r') {
+    responseLine[--responseLineLen] = 0;
+  }
+
+  if (responseStatus == 0) {
+    // "HTTP/1.1 200 OK"; пустые строки между ответами пропускаем
+    if (responseLineLen > 0) {
+      const char* space = strchr(responseLine, ' ');
+      responseStatus = space ? atoi(space + 1) : -1;
+    }
+  } else if (responseLineLen == 0) {
+    responseHeadersDone = true;
+    responseTooLarge = responseBodyLeft > SETTINGS_JSON_MAX;
+  } else if (strncasecmp(responseLine, "X-Settings-Version:", 19) == 0) {
+    responseVersion = strtol(responseLine + 19, nullptr, 10);
+  } else if (strncasecmp(responseLine, "Content-Length:", 15) == 0) {
+    responseBodyLeft = strtol(responseLine + 15, nullptr, 10);
+  } else if (strncasecmp(responseLine, "Transfer-Encoding:", 18) == 0 && strstr(responseLine + 18, "chunked")) {
+    desynced = true;
+  }
+  responseLineLen = 0;
+}
+
+// Ответ получен полностью
+static void finishResponse() {
+  if (responseVersion >= 0) {
+    lastControlTime = millis();
+    // Версию уже применили или она уже ждёт применения - повтор из-за конвейера кадров
+    bool known = (uint32_t)responseVersion == getSettingsVersion() || responseVersion == pendingVersion;
+    if (responseStatus == 200 && !known && !responseTooLarge && responseBodyLen > 2) {
+      memcpy(pendingBody, responseBody, responseBodyLen);
+      pendingBodyLen = responseBodyLen;
+      pendingVersion = responseVersion;
+    }
+  }
+  resetResponse();
+}
+
+static void processByte(char c) {
+  if (!responseHeadersDone) {
+    if (c == '\n') {
+      parseResponseLine();
+    } else if (responseLineLen < sizeof(responseLine) - 1) {
+      responseLine[responseLineLen++] = c;
+    }
+  } else {
+    if (!responseTooLarge) {
+      responseBody[responseBodyLen++] = c;
+    }
+    responseBodyLeft--;
+  }
+  if (responseHeadersDone && responseBodyLeft <= 0) {
+    finishResponse();
+  }
+}
+
+void streamControlRead(WiFiClient& client) {
+  uint8_t buffer[128];
+  while (client.available() > 0) {
+    int len = client.read(buffer, sizeof(buffer));
+    if (len <= 0) {
+      break;
+    }
+#if STREAM_CONTROL_ENABLED
+    for (int i = 0; i < len && !desynced; i++) {
+      processByte((char)buffer[i]);
+    }
+#endif
+  }
+}
+
+void handleStreamControl() {
+  if (pendingVersion < 0) {
+    return;
+  }
+  // Снимаем до применения: processSettings() может перезапустить поток.
+  // Буфер не копируем - JSON разобран до того, как применяются настройки
+  uint32_t version = pendingVersion;
+  pendingVersion = -1;
+
+  Serial.printf("Settings in stream response: version %lu\n", (unsigned long)version);
+  if (processSettings(pendingBody, pendingBodyLen)) {
+    setSettingsVersion(version);
+  }
+}
+
+bool isStreamControlActive() {
+#if STREAM_CONTROL_ENABLED
+  return lastControlTime != 0 && millis() - lastControlTime < STREAM_CONTROL_HOLD_MS;
+#else
+  return false;
+#endif
+}
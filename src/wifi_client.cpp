@@ -1,73 +1,597 @@
 #include "wifi_client.h"
 #include "wifi_settings.h"
+#include "stream_client.h"
 #include "config.h"
+#include "esp_wifi.h"
+
+// Очередь событий: пишет задача событий WiFi (onWiFiEvent), читает loop (pollWiFiEvent)
+#define WIFI_EVENT_QUEUE 8               // Степень двойки
+#define WIFI_PENALTY_SLOTS 4             // Оштрафованных точек доступа одновременно
+
+struct LinkEventEntry {
+  WiFiLinkEvent event;
+  uint16_t reason;
+};
+
+static LinkEventEntry eventQueue[WIFI_EVENT_QUEUE];
+static volatile uint8_t eventHead = 0;   // Пишет только onWiFiEvent
+static volatile uint8_t eventTail = 0;   // Пишет только loop
+
+// Попытка подключения: сначала к точке доступа из кэша, при неудаче - выбор по сканированию
+enum AttemptPhase {
+  ATTEMPT_NONE,
+  ATTEMPT_DIRECTED,    // Кэшированные BSSID и канал, без сканирования
+  ATTEMPT_SCANNING,    // Асинхронное сканирование - выбор точки доступа среди профилей
+  ATTEMPT_SELECTED,    // Точка доступа, выбранная по сканированию (или роуминг)
+  ATTEMPT_BLIND        // Основной профиль без выбора (в эфире профилей не нашлось - возможно, скрытая сеть)
+};
+
+// Точка доступа - кандидат на подключение
+struct Candidate {
+  int8_t profile;
+  int8_t rssi;
+  uint8_t channel;
+  uint8_t bssid[6];
+  int score;
+};
+
+// Точка доступа, где поток не успевал или подключение не удалось
+struct BssidPenalty {
+  uint8_t bssid[6];
+  bool used;
+  unsigned long since;
+};
+
+static volatile bool linkUp = false;     // IP получен (читают модули из loop)
+static bool eventsRegistered = false;
+static AttemptPhase attemptPhase = ATTEMPT_NONE;  // NONE - WIFI_LINK_GOT_IP/DISCONNECTED уже было
+static unsigned long attemptStart = 0;
+static unsigned long attemptTimeout = 0;
+static bool attemptRescanned = false;    // Выбранная точка уже подвела - второй раз не сканируем
+static Candidate attemptTarget;          // Точка текущей попытки ATTEMPT_SELECTED
+static unsigned long connectStart = 0;   // startWiFi() - вместе с запасными попытками
+static unsigned long lastConnectMs = 0;
+static bool lastConnectDirected = false;
+static uint16_t disconnectReason = 0;
+static WiFiLinkCache linkCache;
+static bool linkCacheValid = false;
+static bool leaseReused = false;         // Адрес текущей попытки - прошлая аренда из кэша, а не DHCP
+static bool staticAddress = false;       // Адрес текущей попытки - статический из настроек
+
+static WiFiProfile profiles[WIFI_MAX_PROFILES];
+static size_t profileCount = 0;
+static int currentProfile = 0;           // Профиль текущей попытки/подключения
+static uint8_t currentBssid[6] = {0};
+
+// Роуминг
+static BssidPenalty penalties[WIFI_PENALTY_SLOTS];
+static unsigned long lastRoamCheck = 0;
+static unsigned long lastRoamScan = 0;
+static unsigned long lastFailedFrames = 0;
+static uint8_t roamBadSamples = 0;
+static WiFiRoamReason roamReason = WIFI_ROAM_REASON_RSSI;
+static bool roamScanActive = false;
+static WiFiRoamDecision roamLog[WIFI_ROAM_LOG];
+static uint8_t roamLogNext = 0;
+static uint32_t roamDecisions = 0;
+static uint32_t roamCount = 0;
+
+static char deviceId[18] = "";
+
+static void pushEvent(WiFiLinkEvent event, uint16_t reason) {
+  uint8_t head = eventHead;
+  if ((uint8_t)(head - eventTail) >= WIFI_EVENT_QUEUE) {
+    return;  // loop не забирает события - старые важнее (порядок connect/disconnect)
+  }
+  eventQueue[head & (WIFI_EVENT_QUEUE - 1)] = {event, reason};
+  eventHead = head + 1;
+}
+
+// Задача событий WiFi - только флаг и очередь, вся реакция в loop
+static void onWiFiEvent(arduino_event_id_t id, arduino_event_info_t info) {
+  switch (id) {
+    case ARDUINO_EVENT_WIFI_STA_CONNECTED:
+      pushEvent(WIFI_LINK_CONNECTED, 0);
+      break;
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:
+      linkUp = true;
+      pushEvent(WIFI_LINK_GOT_IP, 0);
+      break;
+    case ARDUINO_EVENT_WIFI_STA_LOST_IP:
+      linkUp = false;
+      pushEvent(WIFI_LINK_DISCONNECTED, WIFI_DISCONNECT_LOST_IP);
+      break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED:
+      linkUp = false;
+      // ASSOC_LEAVE - отключение по нашему вызову (disconnect, begin, выключение радио):
+      // о нём уже знает вызвавший, повторное событие сбило бы новую попытку
+      if (info.wifi_sta_disconnected.reason != WIFI_REASON_ASSOC_LEAVE) {
+        pushEvent(WIFI_LINK_DISCONNECTED, info.wifi_sta_disconnected.reason);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+static void formatBssid(char* buf, size_t size, const uint8_t* bssid) {
+  snprintf(buf, size, "%02X:%02X:%02X:%02X:%02X:%02X",
+           bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5]);
+}
+
+static void penalizeBssid(const uint8_t* bssid) {
+  int slot = 0;
+  for (int i = 0; i < WIFI_PENALTY_SLOTS; i++) {
+    if (penalties[i].used && memcmp(penalties[i].bssid, bssid, 6) == 0) {
+      slot = i;
+      break;
+    }
+    // Свободный слот, иначе самый старый штраф
+    if (!penalties[i].used || (penalties[slot].used && penalties[i].since < penalties[slot].since)) {
+      slot = i;
+    }
+  }
+  memcpy(penalties[slot].bssid, bssid, 6);
+  penalties[slot].used = true;
+  penalties[slot].since = millis();
+}
+
+static bool isPenalized(const uint8_t* bssid) {
+  for (int i = 0; i < WIFI_PENALTY_SLOTS; i++) {
+    if (penalties[i].used && memcmp(penalties[i].bssid, bssid, 6) == 0) {
+      if (millis() - penalties[i].since < WIFI_ROAM_PENALTY_MS) {
+        return true;
+      }
+      penalties[i].used = false;
+    }
+  }
+  return false;
+}
+
+static int findProfile(const char* ssid) {
+  for (size_t i = 0; i < profileCount; i++) {
+    if (strcmp(profiles[i].ssid, ssid) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Оценка точки доступа: RSSI, минус позиция профиля в списке, минус штраф за плохой поток/отказ
+static int scoreAccessPoint(int rssi, int profile, const uint8_t* bssid) {
+  int score = rssi - profile * WIFI_PROFILE_PRIORITY_DB;
+  if (isPenalized(bssid)) {
+    score -= WIFI_ROAM_PENALTY_DB;
+  }
+  return score;
+}
+
+// Лучшая точка доступа из результатов сканирования (false - ни одного профиля в эфире)
+static bool pickCandidate(int count, const uint8_t* excludeBssid, Candidate& best) {
+  bool found = false;
+  for (int i = 0; i < count; i++) {
+    int profile = findProfile(WiFi.SSID(i).c_str());
+    uint8_t* bssid = WiFi.BSSID(i);
+    if (profile < 0 || !bssid || (excludeBssid && memcmp(bssid, excludeBssid, 6) == 0)) {
+      continue;
+    }
+    int rssi = WiFi.RSSI(i);
+    int score = scoreAccessPoint(rssi, profile, bssid);
+    if (!found || score > best.score) {
+      best.profile = profile;
+      best.rssi = rssi;
+      best.channel = WiFi.channel(i);
+      memcpy(best.bssid, bssid, 6);
+      best.score = score;
+      found = true;
+    }
+  }
+  return found;
+}
+
+// Прошлая аренда ещё в окне WIFI_LEASE_REUSE_S. time() переживает перезагрузку, но не
+// отключение питания: часы до получения аренды или скачок NTP - аренда не используется
+static bool leaseUsable() {
+  uint32_t now = time(nullptr);
+  return linkCache.ip != 0 && linkCache.leaseTime != 0 && now >= linkCache.leaseTime &&
+         now - linkCache.leaseTime < WIFI_LEASE_REUSE_S;
+}
+
+// Адрес: статический из настроек сервера, иначе прошлая аренда (та же сеть), иначе DHCP
+static void configureAddress(bool reuseLease) {
+  IPAddress ip, gateway, subnet, dns;
+  staticAddress = false;
+  leaseReused = false;
+  if (loadWiFiStaticIP(ip, gateway, subnet, dns)) {
+    WiFi.config(ip, gateway, subnet, dns);
+    staticAddress = true;
+  } else if (reuseLease && WIFI_REUSE_LEASE && leaseUsable()) {
+    WiFi.config(IPAddress(linkCache.ip), IPAddress(linkCache.gateway), IPAddress(linkCache.subnet),
+                IPAddress(linkCache.dns));
+    leaseReused = true;
+  } else {
+    WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));  // DHCP
+  }
+}
+
+static void beginDirected(int profile) {
+  currentProfile = profile;
+  Serial.printf("Connecting to WiFi: %s (cached BSSID, channel %u)\n", profiles[profile].ssid, linkCache.channel);
+  configureAddress(true);
+  WiFi.begin(profiles[profile].ssid, profiles[profile].password, linkCache.channel, linkCache.bssid);
+  attemptPhase = ATTEMPT_DIRECTED;
+  attemptStart = millis();
+  attemptTimeout = WIFI_DIRECTED_TIMEOUT_MS;
+}
+
+// Роуминг в пределах той же сети (SSID) - прошлая аренда остаётся действительной
+static void beginSelected(const Candidate& candidate, bool reuseLease) {
+  char bssid[18];
+  formatBssid(bssid, sizeof(bssid), candidate.bssid);
+  currentProfile = candidate.profile;
+  attemptTarget = candidate;
+  Serial.printf("Connecting to WiFi: %s (%s, channel %u, RSSI %d)\n",
+                profiles[candidate.profile].ssid, bssid, candidate.channel, candidate.rssi);
+  configureAddress(reuseLease && strcmp(linkCache.ssid, profiles[candidate.profile].ssid) == 0);
+  WiFi.begin(profiles[candidate.profile].ssid, profiles[candidate.profile].password,
+             candidate.channel, candidate.bssid);
+  attemptPhase = ATTEMPT_SELECTED;
+  attemptStart = millis();
+  attemptTimeout = WIFI_DIRECTED_TIMEOUT_MS;
+}
+
+static void beginBlind() {
+  currentProfile = 0;
+  Serial.printf("Connecting to WiFi: %s\n", profiles[0].ssid);
+  configureAddress(false);
+  WiFi.begin(profiles[0].ssid, profiles[0].password);
+  attemptPhase = ATTEMPT_BLIND;
+  attemptStart = millis();
+  attemptTimeout = WIFI_CONNECT_TIMEOUT_MS;
+}
+
+static void beginScan() {
+  if (WiFi.scanNetworks(true) == WIFI_SCAN_FAILED) {
+    beginBlind();
+    return;
+  }
+  attemptPhase = ATTEMPT_SCANNING;
+  attemptStart = millis();
+  attemptTimeout = WIFI_CONNECT_TIMEOUT_MS;
+}
+
+// Сканирование попытки подключения завершено - выбрать точку доступа
+static void finishScan(int16_t count) {
+  Candidate candidate;
+  bool found = count > 0 && pickCandidate(count, nullptr, candidate);
+  WiFi.scanDelete();
+  if (found) {
+    beginSelected(candidate, false);
+  } else {
+    beginBlind();
+  }
+}
+
+// Точка доступа и аренда удачного подключения - для следующего раза (после перезагрузки тоже).
+// Подключение с прошлой арендой её не продлевает: адрес и время остаются от последнего DHCP
+static void updateLinkCache() {
+  WiFiLinkCache previous = linkCache;
+  memset(&linkCache, 0, sizeof(linkCache));
+  strlcpy(linkCache.ssid, profiles[currentProfile].ssid, sizeof(linkCache.ssid));
+  uint8_t* bssid = WiFi.BSSID();
+  if (bssid) {
+    memcpy(linkCache.bssid, bssid, sizeof(linkCache.bssid));
+    memcpy(currentBssid, bssid, sizeof(currentBssid));
+  }
+  linkCache.channel = WiFi.channel();
+  if (leaseReused) {
+    linkCache.ip = previous.ip;
+    linkCache.gateway = previous.gateway;
+    linkCache.subnet = previous.subnet;
+    linkCache.dns = previous.dns;
+    linkCache.leaseTime = previous.leaseTime;
+  } else if (!staticAddress) {
+    linkCache.ip = WiFi.localIP();
+    linkCache.gateway = WiFi.gatewayIP();
+    linkCache.subnet = WiFi.subnetMask();
+    linkCache.dns = WiFi.dnsIP(0);
+    linkCache.leaseTime = time(nullptr);
+  }
+  linkCacheValid = bssid != nullptr && linkCache.channel != 0;
+  if (linkCacheValid) {
+    saveWiFiLinkCache(linkCache);
+  }
+}
+
+void startWiFi() {
+  if (!eventsRegistered) {
+    WiFi.onEvent(onWiFiEvent);
+    eventsRegistered = true;
+  }
+
+  // Профили сетей (основной - credentials из NVS или config.h)
+  profileCount = loadWiFiProfiles(profiles, WIFI_MAX_PROFILES);
+  if (profileCount == 0) {
+    memset(&profiles[0], 0, sizeof(profiles[0]));
+    profileCount = 1;
+  }
 
-static unsigned long lastReconnectAttempt = 0;
-static const unsigned long RECONNECT_INTERVAL = 5000;
-static String currentSSID;
-static String currentPassword;
-
-bool initWiFi() {
-  // Load WiFi credentials from storage (or use defaults)
-  loadWiFiCredentials(currentSSID, currentPassword);
-  
-  Serial.println("Connecting to WiFi: " + currentSSID);
-  
   WiFi.mode(WIFI_STA);
   WiFi.setSleep(false);  // Отключаем WiFi sleep для минимальных задержек
-  WiFi.begin(currentSSID.c_str(), currentPassword.c_str());
-  
-  int attempts = 0;
-  while (WiFi.status() != WL_CONNECTED && attempts < 20) {
-    delay(500);
-    Serial.print(".");
-    attempts++;
-  }
-  
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("\nWiFi connected!");
-    Serial.println("IP: " + WiFi.localIP().toString());
-    
-    // Оптимизация TCP для стриминга
-    WiFi.setTxPower(WIFI_POWER_19_5dBm);  // Максимальная мощность передачи
-    
+  WiFi.setAutoReconnect(false);  // Повторные попытки - машина состояний main
+  linkUp = false;
+  connectStart = millis();
+  attemptRescanned = false;
+  roamBadSamples = 0;
+  if (roamScanActive) {
+    WiFi.scanDelete();  // Связь пропала во время сканирования для роуминга
+    roamScanActive = false;
+  }
+
+  // Кэш - из RAM после потери связи, из NVS после перезагрузки; сеть не из профилей - сканирование
+  if (!linkCacheValid) {
+    linkCacheValid = loadWiFiLinkCache(linkCache);
+  }
+  int cachedProfile = linkCacheValid ? findProfile(linkCache.ssid) : -1;
+  if (WIFI_FAST_RECONNECT && cachedProfile >= 0) {
+    beginDirected(cachedProfile);
+  } else {
+    beginScan();
+  }
+}
+
+bool pollWiFiEvent(WiFiLinkEvent& event) {
+  while (true) {
+    uint16_t reason = 0;
+    if (attemptPhase == ATTEMPT_SCANNING) {
+      int16_t count = WiFi.scanComplete();
+      if (count != WIFI_SCAN_RUNNING) {
+        finishScan(count);
+        continue;
+      }
+    }
+
+    if (eventTail != eventHead) {
+      LinkEventEntry entry = eventQueue[eventTail & (WIFI_EVENT_QUEUE - 1)];
+      eventTail = eventTail + 1;
+      event = entry.event;
+      reason = entry.reason;
+    } else if (attemptPhase != ATTEMPT_NONE && millis() - attemptStart > attemptTimeout) {
+      if (attemptPhase == ATTEMPT_SCANNING) {
+        WiFi.scanDelete();
+      } else {
+        WiFi.disconnect(false);  // Прервать ассоциацию/DHCP (событие ASSOC_LEAVE пропускается)
+      }
+      linkUp = false;
+      event = WIFI_LINK_DISCONNECTED;
+      reason = WIFI_DISCONNECT_TIMEOUT;
+    } else {
+      return false;
+    }
+
+    switch (event) {
+      case WIFI_LINK_CONNECTED:
+        if (attemptPhase == ATTEMPT_DIRECTED || attemptPhase == ATTEMPT_SELECTED) {
+          // Ассоциация есть - ждём IP как при обычном подключении
+          attemptStart = millis();
+          attemptTimeout = WIFI_CONNECT_TIMEOUT_MS;
+        }
+        break;
+      case WIFI_LINK_GOT_IP:
+        lastConnectMs = millis() - connectStart;
+        lastConnectDirected = attemptPhase == ATTEMPT_DIRECTED;
+        attemptPhase = ATTEMPT_NONE;
+        Serial.printf("WiFi connected to %s in %lu ms (%s)\n", profiles[currentProfile].ssid, lastConnectMs,
+                      lastConnectDirected ? "cached BSSID" : "scan");
+        Serial.println("IP: " + WiFi.localIP().toString());
+
+        // Оптимизация TCP для стриминга
+        WiFi.setTxPower(WIFI_POWER_19_5dBm);  // Максимальная мощность передачи
+        esp_wifi_set_ps(WIFI_PS_NONE);
+        updateLinkCache();
+        lastRoamCheck = millis();
+        lastFailedFrames = getFailedFrames();
+        break;
+      case WIFI_LINK_DISCONNECTED:
+        if (attemptPhase == ATTEMPT_DIRECTED) {
+          // Точка доступа сменила канал/BSSID или аренда не подошла - выбор по сканированию, main не узнаёт
+          Serial.printf("Cached BSSID failed (reason %u), scanning...\n", reason);
+          linkCacheValid = false;
+          beginScan();
+          continue;
+        }
+        if (attemptPhase == ATTEMPT_SELECTED && !attemptRescanned) {
+          // Выбранная точка (или цель роуминга) не приняла - штраф и ещё один выбор
+          Serial.printf("Selected AP failed (reason %u), scanning...\n", reason);
+          penalizeBssid(attemptTarget.bssid);
+          attemptRescanned = true;
+          beginScan();
+          continue;
+        }
+        attemptPhase = ATTEMPT_NONE;
+        disconnectReason = reason;
+        Serial.printf("WiFi disconnected (reason %u)\n", reason);
+        break;
+    }
     return true;
+  }
+}
+
+static void logRoamDecision(bool roamed, int rssi, const Candidate* target) {
+  WiFiRoamDecision& entry = roamLog[roamLogNext];
+  roamLogNext = (roamLogNext + 1) % WIFI_ROAM_LOG;
+  roamDecisions++;
+
+  entry.uptime = millis() / 1000;
+  entry.reason = roamReason;
+  entry.roamed = roamed;
+  entry.rssi = rssi;
+  entry.throughputKB = getStreamThroughputKB();
+  formatBssid(entry.from, sizeof(entry.from), currentBssid);
+  if (target) {
+    entry.targetRssi = target->rssi;
+    entry.targetProfile = target->profile;
+    formatBssid(entry.to, sizeof(entry.to), target->bssid);
   } else {
-    Serial.println("\nWiFi connection FAILED!");
-    return false;
+    entry.targetRssi = 0;
+    entry.targetProfile = -1;
+    entry.to[0] = 0;
   }
 }
 
-bool isWiFiConnected() {
-  return WiFi.status() == WL_CONNECTED;
-}
-
-void checkWiFiConnection() {
-  if (WiFi.status() != WL_CONNECTED) {
-    unsigned long now = millis();
-    if (now - lastReconnectAttempt > RECONNECT_INTERVAL) {
-      lastReconnectAttempt = now;
-      Serial.println("WiFi lost. Reconnecting...");
-      WiFi.disconnect();
-      
-      // Reload credentials in case they were updated
-      loadWiFiCredentials(currentSSID, currentPassword);
-      WiFi.begin(currentSSID.c_str(), currentPassword.c_str());
+bool handleWiFiRoaming() {
+  if (!WIFI_ROAM_ENABLED || !linkUp || attemptPhase != ATTEMPT_NONE) {
+    return false;
+  }
+  unsigned long now = millis();
+
+  // Результат сканирования: переход, только если кандидат заметно лучше текущей точки
+  if (roamScanActive) {
+    int16_t count = WiFi.scanComplete();
+    if (count == WIFI_SCAN_RUNNING) {
+      return false;
+    }
+    roamScanActive = false;
+    Candidate candidate;
+    bool found = count > 0 && pickCandidate(count, currentBssid, candidate);
+    WiFi.scanDelete();
+
+    int rssi = WiFi.RSSI();
+    int currentScore = scoreAccessPoint(rssi, currentProfile, currentBssid);
+    if (roamReason == WIFI_ROAM_REASON_SEND) {
+      currentScore -= WIFI_ROAM_PENALTY_DB;  // Поток здесь уже не успевает
+    }
+    bool roam = found && candidate.score >= currentScore + WIFI_ROAM_HYSTERESIS_DB;
+    logRoamDecision(roam, rssi, found ? &candidate : nullptr);
+    if (!roam) {
+      Serial.printf("Roaming: no better AP (RSSI %d)\n", rssi);
+      return false;
+    }
+
+    Serial.printf("Roaming: RSSI %d -> %d (%s)\n", rssi, candidate.rssi,
+                  roamReason == WIFI_ROAM_REASON_SEND ? "stream too slow" : "weak signal");
+    if (roamReason == WIFI_ROAM_REASON_SEND) {
+      penalizeBssid(currentBssid);
     }
+    roamCount++;
+    linkUp = false;
+    connectStart = now;
+    attemptRescanned = false;
+    beginSelected(candidate, true);
+    return true;
+  }
+
+  if (now - lastRoamCheck < WIFI_ROAM_CHECK_MS) {
+    return false;
+  }
+  lastRoamCheck = now;
+
+  // Проверка: сигнал и отправка кадров (не укладывается в интервал кадра или обрывается)
+  unsigned long failed = getFailedFrames();
+  bool framesFailed = failed != lastFailedFrames;
+  lastFailedFrames = failed;
+  if (WiFi.RSSI() < WIFI_ROAM_RSSI) {
+    roamReason = WIFI_ROAM_REASON_RSSI;
+  } else if (isStreamCongested() || framesFailed) {
+    roamReason = WIFI_ROAM_REASON_SEND;
+  } else {
+    roamBadSamples = 0;
+    return false;
   }
+
+  if (++roamBadSamples < WIFI_ROAM_SAMPLES) {
+    return false;
+  }
+  if (lastRoamScan != 0 && now - lastRoamScan < WIFI_ROAM_COOLDOWN_MS) {
+    return false;
+  }
+  lastRoamScan = now;
+  roamBadSamples = 0;
+
+  // Сканирование при подключении - короткие уходы с канала; поток и так не успевает
+  if (WiFi.scanNetworks(true) != WIFI_SCAN_FAILED) {
+    roamScanActive = true;
+  }
+  return false;
+}
+
+size_t getWiFiRoamLog(WiFiRoamDecision* decisions, size_t maxDecisions) {
+  size_t available = roamDecisions < WIFI_ROAM_LOG ? roamDecisions : WIFI_ROAM_LOG;
+  size_t count = 0;
+  // Новые первыми
+  for (size_t i = 0; i < available && count < maxDecisions; i++) {
+    decisions[count++] = roamLog[(roamLogNext + WIFI_ROAM_LOG - 1 - i) % WIFI_ROAM_LOG];
+  }
+  return count;
+}
+
+uint32_t getWiFiRoamCount() {
+  return roamCount;
+}
+
+const char* getWiFiSSID() {
+  return linkUp ? profiles[currentProfile].ssid : "";
+}
+
+void formatWiFiBSSID(char* buf, size_t size) {
+  if (!linkUp) {
+    strlcpy(buf, "", size);
+    return;
+  }
+  formatBssid(buf, size, currentBssid);
+}
+
+bool isWiFiConnected() {
+  return linkUp;
+}
+
+uint16_t getWiFiDisconnectReason() {
+  return disconnectReason;
+}
+
+unsigned long getWiFiConnectTime() {
+  return lastConnectMs;
+}
+
+bool wasWiFiConnectDirected() {
+  return lastConnectDirected;
 }
 
 String getLocalIP() {
-  if (WiFi.status() == WL_CONNECTED) {
+  if (linkUp) {
     return WiFi.localIP().toString();
   }
   return "Not connected";
 }
 
+void formatLocalIP(char* buf, size_t size) {
+  if (!linkUp) {
+    strlcpy(buf, "Not connected", size);
+    return;
+  }
+  IPAddress ip = WiFi.localIP();
+  snprintf(buf, size, "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+}
+
+const char* getDeviceId() {
+  if (deviceId[0] == 0) {
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    formatBssid(deviceId, sizeof(deviceId), mac);
+  }
+  return deviceId;
+}
+
 void disconnectWiFi() {
   Serial.println("Disconnecting WiFi...");
+  if (attemptPhase == ATTEMPT_SCANNING || roamScanActive) {
+    WiFi.scanDelete();
+    roamScanActive = false;
+  }
+  attemptPhase = ATTEMPT_NONE;
+  linkUp = false;
   WiFi.disconnect(true);  // true = очистить сохраненные данные
-  WiFi.mode(WIFI_OFF);    // Полностью выключаем WiFi
-  delay(100);
+  WiFi.mode(WIFI_OFF);    // Полностью выключаем WiFi (esp_wifi_stop синхронный - пауза перед Bluetooth не нужна)
+  eventTail = eventHead;  // События выключенного WiFi не нужны
   Serial.println("WiFi disconnected and radio off");
 }
@@ -8,9 +8,16 @@ void initWiFiSettings() {
   preferences.begin("wifi", false);
 }
 
+// Запись в flash только изменённых значений (настройки с сервера приходят повторно)
+static void putStringIfChanged(const char* key, const String& value) {
+  if (!preferences.isKey(key) || preferences.getString(key, "") != value) {
+    preferences.putString(key, value);
+  }
+}
+
 void saveWiFiCredentials(const String& ssid, const String& password) {
-  preferences.putString("ssid", ssid);
-  preferences.putString("password", password);
+  putStringIfChanged("ssid", ssid);
+  putStringIfChanged("password", password);
 }
 
 bool loadWiFiCredentials(String& ssid, String& password) {
@@ -25,8 +32,97 @@ String getCurrentSSID() {
   return preferences.getString("ssid", WIFI_SSID);
 }
 
+size_t loadWiFiProfiles(WiFiProfile* profiles, size_t maxProfiles) {
+  size_t count = 0;
+  String ssid, password;
+  loadWiFiCredentials(ssid, password);
+  if (ssid.length() > 0 && maxProfiles > 0) {
+    strlcpy(profiles[0].ssid, ssid.c_str(), sizeof(profiles[0].ssid));
+    strlcpy(profiles[0].password, password.c_str(), sizeof(profiles[0].password));
+    count = 1;
+  }
+  
+  // Остальные профили - одним блобом
+  WiFiProfile extra[WIFI_MAX_PROFILES - 1];
+  if (preferences.getBytesLength("networks") != sizeof(extra)) {
+    return count;
+  }
+  preferences.getBytes("networks", extra, sizeof(extra));
+  for (size_t i = 0; i < WIFI_MAX_PROFILES - 1 && count < maxProfiles; i++) {
+    extra[i].ssid[sizeof(extra[i].ssid) - 1] = 0;
+    extra[i].password[sizeof(extra[i].password) - 1] = 0;
+    if (extra[i].ssid[0] == 0 || (count > 0 && strcmp(extra[i].ssid, profiles[0].ssid) == 0)) {
+      continue;
+    }
+    profiles[count++] = extra[i];
+  }
+  return count;
+}
+
+void saveWiFiProfiles(const WiFiProfile* profiles, size_t count) {
+  if (count == 0) {
+    return;
+  }
+  saveWiFiCredentials(profiles[0].ssid, profiles[0].password);
+  
+  WiFiProfile extra[WIFI_MAX_PROFILES - 1];
+  memset(extra, 0, sizeof(extra));
+  for (size_t i = 1; i < count && i < WIFI_MAX_PROFILES; i++) {
+    extra[i - 1] = profiles[i];
+  }
+  WiFiProfile stored[WIFI_MAX_PROFILES - 1];
+  if (preferences.getBytesLength("networks") == sizeof(stored)) {
+    preferences.getBytes("networks", stored, sizeof(stored));
+    if (memcmp(stored, extra, sizeof(extra)) == 0) {
+      return;
+    }
+  }
+  preferences.putBytes("networks", extra, sizeof(extra));
+}
+
+bool loadWiFiLinkCache(WiFiLinkCache& cache) {
+  if (preferences.getBytesLength("link") != sizeof(WiFiLinkCache)) {
+    return false;
+  }
+  preferences.getBytes("link", &cache, sizeof(cache));
+  cache.ssid[sizeof(cache.ssid) - 1] = 0;
+  return cache.channel != 0;
+}
+
+void saveWiFiLinkCache(const WiFiLinkCache& cache) {
+  WiFiLinkCache stored;
+  if (loadWiFiLinkCache(stored) && memcmp(&stored, &cache, sizeof(cache)) == 0) {
+    return;  // Та же точка доступа и аренда - обычный случай, flash не трогаем
+  }
+  preferences.putBytes("link", &cache, sizeof(cache));
+}
+
+void saveWiFiStaticIP(const char* ip, const char* gateway, const char* subnet, const char* dns) {
+  putStringIfChanged("static_ip", ip);
+  putStringIfChanged("gateway", gateway);
+  putStringIfChanged("subnet", subnet);
+  putStringIfChanged("dns", dns);
+}
+
+bool loadWiFiStaticIP(IPAddress& ip, IPAddress& gateway, IPAddress& subnet, IPAddress& dns) {
+  char value[16];
+  if (preferences.getString("static_ip", value, sizeof(value)) == 0 || !ip.fromString(value)) {
+    return false;
+  }
+  if (preferences.getString("gateway", value, sizeof(value)) == 0 || !gateway.fromString(value)) {
+    return false;
+  }
+  if (preferences.getString("subnet", value, sizeof(value)) == 0 || !subnet.fromString(value)) {
+    subnet = IPAddress(255, 255, 255, 0);
+  }
+  if (preferences.getString("dns", value, sizeof(value)) == 0 || !dns.fromString(value)) {
+    dns = gateway;
+  }
+  return true;
+}
+
 void saveServerHost(const String& host) {
-  preferences.putString("server_host", host);
+  putStringIfChanged("server_host", host);
 }
 
 String loadServerHost() {
@@ -0,0 +1,59 @@
+#ifndef NATIVE_TEST_H
+#define NATIVE_TEST_H
+
+/*
+ * Общее окружение тестов env:native (pio test -e native)
+ *
+ * Каждый тест получает пустой каталог данных (NVS и SD карта шимов native/),
+ * журнал прошивки (Serial) по умолчанию выключен, чтобы не мешать выводу Unity.
+ *
+ * Использование:
+ *   #include "../native_test.h"
+ *   void setUp() { nativeTestReset("segment_catalog"); }
+ */
+
+#include <Arduino.h>
+#include <SD_MMC.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "native_hal.h"
+
+static int nativeTestRemoveEntry(const char* path, const struct stat*, int, struct FTW*) {
+  return remove(path);
+}
+
+// Пустой каталог данных /tmp/esp32cam-test-<suite> и смонтированная в нём SD карта
+static inline void nativeTestReset(const char* suite) {
+  static char path[128];
+  snprintf(path, sizeof(path), "/tmp/esp32cam-test-%s", suite);
+  nftw(path, nativeTestRemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+  nativeSerialSetEnabled(false);
+  nativeSetDataDir(path);
+  nativeSdSetPresent(true);
+  SD_MMC.begin("/sdcard", true);
+}
+
+// Прочитать файл карты целиком. Возвращает размер (0 - нет файла)
+static inline size_t nativeTestReadFile(const char* path, uint8_t* buffer, size_t size) {
+  File file = SD_MMC.open(path, FILE_READ);
+  if (!file) {
+    return 0;
+  }
+  size_t len = file.read(buffer, size);
+  file.close();
+  return len;
+}
+
+// Записать файл карты целиком (заменяя существующий)
+static inline bool nativeTestWriteFile(const char* path, const uint8_t* data, size_t len) {
+  File file = SD_MMC.open(path, FILE_WRITE);
+  if (!file) {
+    return false;
+  }
+  bool ok = file.write(data, len) == len;
+  file.close();
+  return ok;
+}
+
+#endif // NATIVE_TEST_H
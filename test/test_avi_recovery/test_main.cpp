@@ -0,0 +1,191 @@
+// Восстановление прерванной записи (avi_recovery): обрезка по последнему целому кадру, idx1, размеры
+
+#include <unity.h>
+#include "../native_test.h"
+#include "avi_recovery.h"
+
+static const char* TEMP_PATH = "/records/007.avi.tmp";
+static const char* FINAL_PATH = "/records/007.avi";
+
+// Раскладка заголовка как у sd_recorder (writeAVIHeader): movi начинается с 212
+static const uint32_t AVIH_TOTAL_FRAMES = 48;
+static const uint32_t STRH_LENGTH = 140;
+static const uint32_t MOVI_START = 212;
+static const uint32_t MOVI_DATA = MOVI_START + 8;  // Смещения idx1 - от fourcc "movi"
+
+static uint8_t file[64 * 1024];
+static size_t fileLen = 0;
+
+static void put32(uint32_t pos, uint32_t value) {
+  file[pos] = value & 0xFF;
+  file[pos + 1] = (value >> 8) & 0xFF;
+  file[pos + 2] = (value >> 16) & 0xFF;
+  file[pos + 3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void append(const char* fourcc, uint32_t size) {
+  memcpy(file + fileLen, fourcc, 4);
+  put32(fileLen + 4, size);
+  fileLen += 8;
+}
+
+// Заголовок .tmp в момент сбоя: размеры и количество кадров ещё не записаны
+static void beginAvi() {
+  memset(file, 0, sizeof(file));
+  fileLen = 0;
+  append("RIFF", 0);
+  memcpy(file + fileLen, "AVI ", 4);
+  fileLen += 4;
+  append("LIST", 192);
+  memcpy(file + fileLen, "hdrl", 4);
+  fileLen += 4;
+  append("avih", 56);
+  put32(fileLen, 33333);
+  fileLen += 56;
+  append("LIST", 116);
+  memcpy(file + fileLen, "strl", 4);
+  fileLen += 4;
+  append("strh", 56);
+  memcpy(file + fileLen, "vidsMJPG", 8);
+  fileLen += 56;
+  append("strf", 40);
+  fileLen += 40;
+  TEST_ASSERT_EQUAL(MOVI_START, fileLen);
+  append("LIST", 4);
+  memcpy(file + fileLen, "movi", 4);
+  fileLen += 4;
+}
+
+// Кадр 00dc с выравниванием до чётного размера; возвращает смещение chunk'а
+static uint32_t appendFrame(uint32_t size, uint8_t fill) {
+  uint32_t pos = fileLen;
+  append("00dc", size);
+  memset(file + fileLen, fill, size);
+  fileLen += size + (size & 1);
+  return pos;
+}
+
+static void writeTemp(size_t len) {
+  TEST_ASSERT_TRUE(nativeTestWriteFile(TEMP_PATH, file, len));
+}
+
+void setUp() {
+  nativeTestReset("avi_recovery");
+  SD_MMC.mkdir("/records");
+}
+
+void tearDown() {}
+
+void test_truncated_mid_frame() {
+  const uint32_t sizes[] = {1000, 1001, 1200, 900, 1500};
+  uint32_t offsets[5];
+  beginAvi();
+  for (int i = 0; i < 5; i++) {
+    offsets[i] = appendFrame(sizes[i], 0x10 + i);
+  }
+  // Питание пропало во время записи пятого кадра
+  size_t truncated = offsets[4] + 8 + 700;
+  writeTemp(truncated);
+
+  AVIRecoveryResult result;
+  TEST_ASSERT_TRUE(recoverAVIFile(TEMP_PATH, FINAL_PATH, result));
+  TEST_ASSERT_EQUAL(4, result.frames);
+  TEST_ASSERT_EQUAL(truncated, result.originalSize);
+  TEST_ASSERT_FALSE(SD_MMC.exists(TEMP_PATH));
+
+  uint8_t recovered[sizeof(file)];
+  size_t len = nativeTestReadFile(FINAL_PATH, recovered, sizeof(recovered));
+  uint32_t cut = offsets[4];
+  TEST_ASSERT_EQUAL(cut + 8 + 4 * 16, result.recoveredSize);
+  TEST_ASSERT_GREATER_OR_EQUAL(result.recoveredSize, len);
+
+  // Размеры и количество кадров в заголовке
+  TEST_ASSERT_EQUAL(result.recoveredSize - 8, get32(recovered + 4));
+  TEST_ASSERT_EQUAL(cut - MOVI_DATA, get32(recovered + MOVI_START + 4));
+  TEST_ASSERT_EQUAL(4, get32(recovered + AVIH_TOTAL_FRAMES));
+  TEST_ASSERT_EQUAL(4, get32(recovered + STRH_LENGTH));
+
+  // idx1 сразу за последним целым кадром, смещения - от "movi"
+  TEST_ASSERT_EQUAL_MEMORY("idx1", recovered + cut, 4);
+  TEST_ASSERT_EQUAL(4 * 16, get32(recovered + cut + 4));
+  for (int i = 0; i < 4; i++) {
+    const uint8_t* entry = recovered + cut + 8 + i * 16;
+    TEST_ASSERT_EQUAL_MEMORY("00dc", entry, 4);
+    TEST_ASSERT_EQUAL(offsets[i] - MOVI_DATA, get32(entry + 8));
+    TEST_ASSERT_EQUAL(sizes[i], get32(entry + 12));
+    // Данные кадров не тронуты
+    TEST_ASSERT_EQUAL_UINT8(0x10 + i, recovered[offsets[i] + 8]);
+    TEST_ASSERT_EQUAL_UINT8(0x10 + i, recovered[offsets[i] + 8 + sizes[i] - 1]);
+  }
+}
+
+void test_truncated_in_chunk_header() {
+  beginAvi();
+  appendFrame(500, 1);
+  appendFrame(501, 2);
+  uint32_t third = appendFrame(502, 3);
+  writeTemp(third + 4);  // От заголовка третьего кадра - только fourcc
+
+  AVIRecoveryResult result;
+  TEST_ASSERT_TRUE(recoverAVIFile(TEMP_PATH, FINAL_PATH, result));
+  TEST_ASSERT_EQUAL(2, result.frames);
+  TEST_ASSERT_EQUAL(third + 8 + 2 * 16, result.recoveredSize);
+}
+
+void test_complete_file_keeps_all_frames() {
+  beginAvi();
+  appendFrame(300, 1);
+  appendFrame(301, 2);
+  writeTemp(fileLen);
+
+  AVIRecoveryResult result;
+  TEST_ASSERT_TRUE(recoverAVIFile(TEMP_PATH, FINAL_PATH, result));
+  TEST_ASSERT_EQUAL(2, result.frames);
+  TEST_ASSERT_EQUAL(fileLen + 8 + 2 * 16, result.recoveredSize);
+}
+
+void test_no_complete_frame() {
+  beginAvi();
+  uint32_t first = appendFrame(800, 1);
+  writeTemp(first + 8 + 100);
+
+  // Восстанавливать нечего - .tmp остаётся как есть
+  AVIRecoveryResult result;
+  TEST_ASSERT_FALSE(recoverAVIFile(TEMP_PATH, FINAL_PATH, result));
+  TEST_ASSERT_EQUAL(0, result.frames);
+  TEST_ASSERT_TRUE(SD_MMC.exists(TEMP_PATH));
+  TEST_ASSERT_FALSE(SD_MMC.exists(FINAL_PATH));
+}
+
+void test_truncated_header() {
+  beginAvi();
+  writeTemp(100);  // Сбой до LIST movi
+
+  AVIRecoveryResult result;
+  TEST_ASSERT_FALSE(recoverAVIFile(TEMP_PATH, FINAL_PATH, result));
+  TEST_ASSERT_FALSE(SD_MMC.exists(FINAL_PATH));
+}
+
+void test_not_avi() {
+  uint8_t junk[64];
+  memset(junk, 0xAB, sizeof(junk));
+  TEST_ASSERT_TRUE(nativeTestWriteFile(TEMP_PATH, junk, sizeof(junk)));
+
+  AVIRecoveryResult result;
+  TEST_ASSERT_FALSE(recoverAVIFile(TEMP_PATH, FINAL_PATH, result));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_truncated_mid_frame);
+  RUN_TEST(test_truncated_in_chunk_header);
+  RUN_TEST(test_complete_file_keeps_all_frames);
+  RUN_TEST(test_no_complete_frame);
+  RUN_TEST(test_truncated_header);
+  RUN_TEST(test_not_avi);
+  return UNITY_END();
+}
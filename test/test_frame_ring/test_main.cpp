@@ -0,0 +1,143 @@
+// Кольцевой буфер кадров (frame_ring): порядок, вытеснение, переход через конец буфера
+
+#include <unity.h>
+#include <Arduino.h>
+#include "frame_ring.h"
+
+static FrameRing ring;
+
+// Кадр с содержимым, по которому видно, какой это кадр
+static void pushFrame(uint32_t timestamp, size_t len) {
+  uint8_t data[512];
+  for (size_t i = 0; i < len; i++) {
+    data[i] = (uint8_t)(timestamp + i);
+  }
+  TEST_ASSERT_TRUE(frameRingPush(ring, data, len, timestamp));
+}
+
+static void expectFrame(uint32_t timestamp, size_t len) {
+  const uint8_t* data;
+  size_t frameLen;
+  uint32_t frameTime;
+  TEST_ASSERT_TRUE(frameRingPeek(ring, data, frameLen, frameTime));
+  TEST_ASSERT_EQUAL(timestamp, frameTime);
+  TEST_ASSERT_EQUAL(len, frameLen);
+  for (size_t i = 0; i < len; i++) {
+    TEST_ASSERT_EQUAL_UINT8((uint8_t)(timestamp + i), data[i]);
+  }
+}
+
+void setUp() {
+  TEST_ASSERT_TRUE(frameRingInit(ring, 256));
+}
+
+void tearDown() {
+  frameRingFree(ring);
+}
+
+void test_fifo_order() {
+  pushFrame(10, 30);
+  pushFrame(20, 17);
+  pushFrame(30, 1);
+  TEST_ASSERT_EQUAL(3, ring.frames);
+  TEST_ASSERT_EQUAL(48, ring.bytes);
+
+  expectFrame(10, 30);
+  frameRingPop(ring);
+  expectFrame(20, 17);
+  frameRingPop(ring);
+  expectFrame(30, 1);
+  frameRingPop(ring);
+
+  const uint8_t* data;
+  size_t len;
+  uint32_t timestamp;
+  TEST_ASSERT_FALSE(frameRingPeek(ring, data, len, timestamp));
+  TEST_ASSERT_EQUAL(0, ring.bytes);
+}
+
+void test_frame_larger_than_buffer() {
+  uint8_t data[300] = {};
+  TEST_ASSERT_FALSE(frameRingPush(ring, data, sizeof(data), 1));
+  TEST_ASSERT_EQUAL(0, ring.frames);
+}
+
+void test_wrap_evicts_oldest() {
+  // 50 байт + заголовок = 60 байт в буфере: помещается 4 кадра, дальше - по кругу
+  for (uint32_t t = 1; t <= 10; t++) {
+    pushFrame(t, 50);
+    TEST_ASSERT_LESS_OR_EQUAL(4, ring.frames);
+    TEST_ASSERT_EQUAL(ring.frames * 50, ring.bytes);
+  }
+
+  // Остались самые новые кадры подряд, каждый - непрерывный и целый
+  uint32_t first = 10 - ring.frames + 1;
+  for (uint32_t t = first; t <= 10; t++) {
+    expectFrame(t, 50);
+    frameRingPop(ring);
+  }
+  TEST_ASSERT_EQUAL(0, ring.frames);
+}
+
+void test_wrap_with_mixed_sizes() {
+  // Кадры разного размера: переход в начало оставляет пустой остаток (маркер)
+  uint32_t t = 0;
+  size_t sizes[] = {100, 90, 70, 120, 30, 60, 110, 5};
+  for (size_t len : sizes) {
+    pushFrame(++t, len);
+    expectFrame(t - ring.frames + 1, sizes[t - ring.frames]);
+  }
+  // Самый новый кадр читается последним
+  while (ring.frames > 1) {
+    frameRingPop(ring);
+  }
+  expectFrame(t, 5);
+}
+
+void test_drop_older_than() {
+  for (uint32_t t = 100; t <= 105; t++) {
+    pushFrame(t, 10);
+  }
+  frameRingDropOlderThan(ring, 103);
+  TEST_ASSERT_EQUAL(3, ring.frames);
+  expectFrame(103, 10);
+
+  // Все кадры новее - ничего не удаляется
+  frameRingDropOlderThan(ring, 50);
+  TEST_ASSERT_EQUAL(3, ring.frames);
+
+  frameRingDropOlderThan(ring, 1000);
+  TEST_ASSERT_EQUAL(0, ring.frames);
+}
+
+void test_drop_older_than_millis_overflow() {
+  // millis() переполняется через ~49 дней: сравнение по разности, а не по значению
+  pushFrame(0xFFFFFFF0, 10);
+  pushFrame(0xFFFFFFF8, 10);
+  pushFrame(0x00000008, 10);
+  frameRingDropOlderThan(ring, 0);
+  TEST_ASSERT_EQUAL(1, ring.frames);
+  expectFrame(0x00000008, 10);
+}
+
+void test_clear() {
+  pushFrame(1, 40);
+  pushFrame(2, 40);
+  frameRingClear(ring);
+  TEST_ASSERT_EQUAL(0, ring.frames);
+  TEST_ASSERT_EQUAL(0, ring.bytes);
+  pushFrame(3, 200);
+  expectFrame(3, 200);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_fifo_order);
+  RUN_TEST(test_frame_larger_than_buffer);
+  RUN_TEST(test_wrap_evicts_oldest);
+  RUN_TEST(test_wrap_with_mixed_sizes);
+  RUN_TEST(test_drop_older_than);
+  RUN_TEST(test_drop_older_than_millis_overflow);
+  RUN_TEST(test_clear);
+  return UNITY_END();
+}
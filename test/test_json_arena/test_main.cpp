@@ -0,0 +1,131 @@
+// Арена ArduinoJson (json_arena): освобождение документа, нехватка места, выравнивание
+
+#include <unity.h>
+#include <Arduino.h>
+#include "config.h"
+#include "json_arena.h"
+
+alignas(8) static uint8_t buffer[JSON_ARENA_SIZE];
+
+static const char* SETTINGS_JSON =
+  "{\"quality\":12,\"framesize\":\"VGA\",\"brightness\":1,\"contrast\":0,"
+  "\"sd_recording\":{\"enabled\":true,\"segment_minutes\":5},\"poll_interval\":30000}";
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_allocations_are_aligned() {
+  JsonArena arena(buffer, sizeof(buffer));
+  void* a = arena.allocate(3);
+  void* b = arena.allocate(13);
+  TEST_ASSERT_NOT_NULL(a);
+  TEST_ASSERT_NOT_NULL(b);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)a % 8);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)b % 8);
+}
+
+void test_unaligned_buffer_start_skipped() {
+  // Буфер без alignas: невыровненное начало пропускается
+  JsonArena arena(buffer + 3, 256);
+  TEST_ASSERT_EQUAL(256 - 5, arena.capacity());
+  void* block = arena.allocate(16);
+  TEST_ASSERT_NOT_NULL(block);
+  TEST_ASSERT_EQUAL(0, (uintptr_t)block % 8);
+  TEST_ASSERT_TRUE((uint8_t*)block >= buffer + 3);
+}
+
+void test_free_last_block_returns_space() {
+  JsonArena arena(buffer, sizeof(buffer));
+  void* a = arena.allocate(100);
+  size_t afterFirst = arena.used();
+  void* b = arena.allocate(100);
+  arena.deallocate(b);
+  TEST_ASSERT_EQUAL(afterFirst, arena.used());
+  arena.deallocate(a);
+  TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+void test_reset_when_all_blocks_freed() {
+  // Освобождение не по порядку: место возвращается вместе с последним живым блоком
+  JsonArena arena(buffer, sizeof(buffer));
+  void* a = arena.allocate(64);
+  void* b = arena.allocate(64);
+  void* c = arena.allocate(64);
+  arena.deallocate(a);
+  TEST_ASSERT_GREATER_THAN(0, arena.used());
+  arena.deallocate(c);
+  arena.deallocate(b);
+  TEST_ASSERT_EQUAL(0, arena.used());
+  TEST_ASSERT_EQUAL((uintptr_t)a, (uintptr_t)arena.allocate(8));
+}
+
+void test_reallocate_last_block_in_place() {
+  JsonArena arena(buffer, sizeof(buffer));
+  char* block = (char*)arena.allocate(10);
+  memcpy(block, "abcdefghi", 10);
+  char* grown = (char*)arena.reallocate(block, 1000);
+  TEST_ASSERT_EQUAL((uintptr_t)block, (uintptr_t)grown);
+  TEST_ASSERT_EQUAL_STRING("abcdefghi", grown);
+  TEST_ASSERT_LESS_THAN(1100, arena.used());
+
+  // Не последний блок растёт копированием
+  void* next = arena.allocate(10);
+  TEST_ASSERT_NOT_NULL(next);
+  char* moved = (char*)arena.reallocate(grown, 2000);
+  TEST_ASSERT_NOT_NULL(moved);
+  TEST_ASSERT_TRUE(moved != grown);
+  TEST_ASSERT_EQUAL_STRING("abcdefghi", moved);
+}
+
+void test_overflow_returns_null() {
+  JsonArena arena(buffer, 128);
+  TEST_ASSERT_NOT_NULL(arena.allocate(64));
+  TEST_ASSERT_NULL(arena.allocate(64));
+  TEST_ASSERT_EQUAL(1, arena.failures());
+  TEST_ASSERT_LESS_OR_EQUAL(128, arena.peak());
+}
+
+void test_document_reset_reuses_arena() {
+  JsonArena arena(buffer, sizeof(buffer));
+  size_t peak = 0;
+  for (int i = 0; i < 3; i++) {
+    JsonDocument doc(&arena);
+    TEST_ASSERT_FALSE(deserializeJson(doc, SETTINGS_JSON));
+    TEST_ASSERT_EQUAL(12, doc["quality"].as<int>());
+    TEST_ASSERT_GREATER_THAN(0, arena.used());
+    if (i == 0) {
+      peak = arena.peak();
+    }
+    doc.clear();
+    TEST_ASSERT_EQUAL(0, arena.used());
+  }
+  // Повторный разбор - с начала буфера, пик не растёт
+  TEST_ASSERT_EQUAL(peak, arena.peak());
+  TEST_ASSERT_EQUAL(0, arena.failures());
+}
+
+void test_document_overflow_reports_no_memory() {
+  JsonArena arena(buffer, 64);
+  {
+    JsonDocument doc(&arena);
+    DeserializationError error = deserializeJson(doc, SETTINGS_JSON);
+    TEST_ASSERT_TRUE(error == DeserializationError::NoMemory);
+    TEST_ASSERT_GREATER_THAN(0, arena.failures());
+  }
+  // Документ освобождён - арена снова пуста
+  TEST_ASSERT_EQUAL(0, arena.used());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_allocations_are_aligned);
+  RUN_TEST(test_unaligned_buffer_start_skipped);
+  RUN_TEST(test_free_last_block_returns_space);
+  RUN_TEST(test_reset_when_all_blocks_freed);
+  RUN_TEST(test_reallocate_last_block_in_place);
+  RUN_TEST(test_overflow_returns_null);
+  RUN_TEST(test_document_reset_reuses_arena);
+  RUN_TEST(test_document_overflow_reports_no_memory);
+  return UNITY_END();
+}
@@ -0,0 +1,132 @@
+// Гистограммы задержек (latency_histogram): перцентили, точность корзин, сброс окна
+
+#include <unity.h>
+#include <Arduino.h>
+#include "latency_histogram.h"
+
+static LatencyHistogram histogram;
+
+// Погрешность перцентиля - не больше 1/16 значения (8 корзин на октаву, середина корзины)
+static void expectWithin(uint32_t expected, uint32_t actual) {
+  TEST_ASSERT_UINT32_WITHIN(expected / 16 + 1, expected, actual);
+}
+
+void setUp() {
+  memset(&histogram, 0, sizeof(histogram));
+}
+
+void tearDown() {}
+
+void test_empty_window() {
+  LatencySummary s = latencyTake(histogram);
+  TEST_ASSERT_EQUAL(0, s.count);
+  TEST_ASSERT_EQUAL(0, s.p50);
+  TEST_ASSERT_EQUAL(0, s.p99);
+  TEST_ASSERT_EQUAL(0, s.max);
+}
+
+void test_small_values_exact() {
+  // Меньше 8 мкс - корзина на значение
+  for (uint32_t us = 0; us < 8; us++) {
+    for (int i = 0; i < 10; i++) {
+      latencyRecord(histogram, us);
+    }
+  }
+  LatencySummary s = latencyTake(histogram);
+  TEST_ASSERT_EQUAL(80, s.count);
+  TEST_ASSERT_EQUAL(3, s.p50);
+  TEST_ASSERT_EQUAL(7, s.p90);
+  TEST_ASSERT_EQUAL(7, s.max);
+}
+
+void test_uniform_percentiles() {
+  for (uint32_t us = 1; us <= 10000; us++) {
+    latencyRecord(histogram, us);
+  }
+  LatencySummary s = latencyTake(histogram);
+  TEST_ASSERT_EQUAL(10000, s.count);
+  expectWithin(5000, s.p50);
+  expectWithin(9000, s.p90);
+  expectWithin(9900, s.p99);
+  TEST_ASSERT_EQUAL(10000, s.max);
+  TEST_ASSERT_LESS_OR_EQUAL(s.max, s.p99);
+}
+
+void test_tail_percentiles() {
+  // 2% медленных кадров: p50/p90 - быстрые, p99 - медленные
+  for (int i = 0; i < 980; i++) {
+    latencyRecord(histogram, 2000);
+  }
+  for (int i = 0; i < 20; i++) {
+    latencyRecord(histogram, 150000);
+  }
+  LatencySummary s = latencyTake(histogram);
+  expectWithin(2000, s.p50);
+  expectWithin(2000, s.p90);
+  expectWithin(150000, s.p99);
+  TEST_ASSERT_EQUAL(150000, s.max);
+}
+
+void test_percentile_not_above_max() {
+  // Середина корзины выше самого значения - перцентиль ограничен точным максимумом
+  for (int i = 0; i < 100; i++) {
+    latencyRecord(histogram, 1025);
+  }
+  LatencySummary s = latencyTake(histogram);
+  TEST_ASSERT_LESS_OR_EQUAL(1025, s.p50);
+  TEST_ASSERT_LESS_OR_EQUAL(1025, s.p99);
+  expectWithin(1025, s.p50);
+}
+
+void test_overflow_bucket() {
+  // Больше 2^26 мкс - последняя корзина, значение - точный максимум
+  latencyRecord(histogram, 10);
+  latencyRecord(histogram, 100000000);
+  LatencySummary s = latencyTake(histogram);
+  TEST_ASSERT_EQUAL(2, s.count);
+  TEST_ASSERT_EQUAL(10, s.p50);
+  TEST_ASSERT_EQUAL(100000000, s.p99);
+  TEST_ASSERT_EQUAL(100000000, s.max);
+}
+
+void test_take_resets_window() {
+  latencyRecord(histogram, 500);
+  TEST_ASSERT_EQUAL(1, latencyTake(histogram).count);
+
+  LatencySummary s = latencyTake(histogram);
+  TEST_ASSERT_EQUAL(0, s.count);
+  TEST_ASSERT_EQUAL(0, s.max);
+
+  // Следующее окно считается с нуля
+  latencyRecord(histogram, 40);
+  s = latencyTake(histogram);
+  TEST_ASSERT_EQUAL(1, s.count);
+  TEST_ASSERT_EQUAL(40, s.max);
+  expectWithin(40, s.p50);
+}
+
+void test_stages() {
+  latencyTake(LATENCY_SD_WRITE);
+  latencyRecord(LATENCY_SD_WRITE, 3000);
+  latencyRecord(LATENCY_SD_WRITE, 5000);
+  LatencySummary s = latencyTake(LATENCY_SD_WRITE);
+  TEST_ASSERT_EQUAL(2, s.count);
+  TEST_ASSERT_EQUAL(5000, s.max);
+  TEST_ASSERT_EQUAL(0, latencyTake(LATENCY_CAPTURE).count);
+
+  TEST_ASSERT_EQUAL_STRING("capture", latencyStageName(LATENCY_CAPTURE));
+  TEST_ASSERT_EQUAL_STRING("loop", latencyStageName(LATENCY_LOOP));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty_window);
+  RUN_TEST(test_small_values_exact);
+  RUN_TEST(test_uniform_percentiles);
+  RUN_TEST(test_tail_percentiles);
+  RUN_TEST(test_percentile_not_above_max);
+  RUN_TEST(test_overflow_bucket);
+  RUN_TEST(test_take_resets_window);
+  RUN_TEST(test_stages);
+  return UNITY_END();
+}
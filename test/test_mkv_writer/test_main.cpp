@@ -0,0 +1,197 @@
+// Запись MKV (sd_recorder + mkv_writer): сегмент проверяется разбором tools/mkv_inspect.cpp
+
+// Разборщик - первым: макросы config.h не должны попасть в его код
+#define MKV_INSPECT_NO_MAIN
+#include "../../tools/mkv_inspect.cpp"
+
+#include <unity.h>
+#include "../native_test.h"
+#include "config.h"
+#include "mkv_writer.h"
+#include "sd_recorder.h"
+
+static const uint32_t FRAME_INTERVAL_MS = 100;
+static const int RECORDED_FRAMES = 120;  // 12 с - три кластера по SD_MKV_CLUSTER_MS
+
+static uint8_t jpeg[4096];
+static uint8_t file[1024 * 1024];
+
+// Синтетический JPEG: SOI, данные, EOI; размер меняется от кадра к кадру
+static size_t makeFrame(int n) {
+  size_t len = 1500 + (n * 37) % 700;
+  jpeg[0] = 0xFF;
+  jpeg[1] = 0xD8;
+  memset(jpeg + 2, 0x20 + n % 64, len - 4);
+  jpeg[len - 2] = 0xFF;
+  jpeg[len - 1] = 0xD9;
+  return len;
+}
+
+static Report inspect(const char* name, size_t len) {
+  Report r;
+  r.path = name;
+  std::vector<uint8_t> data(file, file + len);
+  TEST_ASSERT_TRUE_MESSAGE(inspectData(r, data), "not an EBML file");
+  return r;
+}
+
+// Сегмент, записанный через recordFrame: пишется один раз на весь набор тестов
+static SegmentInfo segment;
+static size_t segmentLen = 0;
+
+static void recordSegment() {
+  if (segmentLen > 0) {
+    return;
+  }
+  nativeTestReset("mkv_writer");
+  TEST_ASSERT_TRUE(initSDRecorder());
+  setRecordingContainer(RECORDING_MKV);
+  setRecordingInterval(60);
+  setRecordingEnabled(true);
+
+  // Первый кадр открывает сегмент и не записывается
+  uint8_t* data = jpeg;
+  recordFrame(data, makeFrame(0));
+  TEST_ASSERT_TRUE(isRecording());
+  for (int i = 0; i < RECORDED_FRAMES; i++) {
+    recordFrame(data, makeFrame(i));
+    nativeClockAdvance(FRAME_INTERVAL_MS);
+  }
+  stopRecording();
+
+  // Финализация (Cues, Duration, переименование .tmp) - в фоновой задаче
+  for (int i = 0; i < 500 && !getNextSegmentToUpload(segment); i++) {
+    delay(10);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(getNextSegmentToUpload(segment), "segment not closed");
+  String path = String("/records/") + getSegmentFileName(segment);
+  segmentLen = nativeTestReadFile(path.c_str(), file, sizeof(file));
+  TEST_ASSERT_GREATER_THAN(0, segmentLen);
+  TEST_ASSERT_LESS_THAN(sizeof(file), segmentLen);
+}
+
+// Незавершённый файл (как .tmp при сбое питания): заголовок и кадры без mkvFinalize
+static size_t writeUnfinalized(const char* path, int frames, size_t& lastFrameLen) {
+  File out = SD_MMC.open(path, FILE_WRITE);
+  TEST_ASSERT_TRUE(out);
+  MKVWriter writer;
+  TEST_ASSERT_TRUE(mkvWriteHeader(out, writer, 640, 480));
+  for (int i = 0; i < frames; i++) {
+    lastFrameLen = makeFrame(i);
+    TEST_ASSERT_TRUE(mkvWriteFrame(out, writer, jpeg, lastFrameLen, i * FRAME_INTERVAL_MS));
+  }
+  out.close();
+  return nativeTestReadFile(path, file, sizeof(file));
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_recorded_segment_is_valid() {
+  recordSegment();
+  TEST_ASSERT_TRUE(segment.flags & SEGMENT_FLAG_MKV);
+  Report r = inspect("recorded", segmentLen);
+  TEST_ASSERT_EQUAL(0, r.errors);
+  TEST_ASSERT_FALSE(r.truncated);
+  TEST_ASSERT_EQUAL_STRING("matroska", r.docType.c_str());
+  TEST_ASSERT_EQUAL_STRING("V_MJPEG", r.codecId.c_str());
+  TEST_ASSERT_NOT_EQUAL(0, r.mjpegTrack);
+  TEST_ASSERT_EQUAL(RECORDED_FRAMES, r.frames);
+  TEST_ASSERT_GREATER_OR_EQUAL(r.lastBlockTime, r.duration);
+}
+
+void test_cluster_timecodes() {
+  recordSegment();
+  Report r = inspect("recorded", segmentLen);
+  TEST_ASSERT_GREATER_OR_EQUAL(3, r.clusters);
+  TEST_ASSERT_EQUAL(r.clusters, r.clusterTimes.size());
+
+  // Кластеры по порядку позиций идут с возрастающим временем, не чаще SD_MKV_CLUSTER_MS
+  int64_t previous = -1;
+  for (const auto& cluster : r.clusterTimes) {
+    if (previous >= 0) {
+      TEST_ASSERT_GREATER_OR_EQUAL(previous + SD_MKV_CLUSTER_MS, cluster.second);
+    }
+    previous = cluster.second;
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(previous + SD_MKV_CLUSTER_MS, r.lastBlockTime);
+}
+
+void test_cues_point_at_clusters() {
+  recordSegment();
+  Report r = inspect("recorded", segmentLen);
+  TEST_ASSERT_EQUAL(r.clusters, r.cues.size());
+  for (const auto& cue : r.cues) {
+    auto cluster = r.clusterTimes.find(cue.second);
+    TEST_ASSERT_TRUE_MESSAGE(cluster != r.clusterTimes.end(), "cue does not point at a cluster");
+    TEST_ASSERT_EQUAL((int64_t)cue.first, cluster->second);
+  }
+}
+
+void test_segment_info_read_back() {
+  recordSegment();
+  String path = String("/records/") + getSegmentFileName(segment);
+  File in = SD_MMC.open(path.c_str(), FILE_READ);
+  TEST_ASSERT_TRUE(in);
+  uint32_t durationMs = 0;
+  uint32_t frames = 0;
+  TEST_ASSERT_TRUE(mkvReadInfo(in, durationMs, frames));
+  in.close();
+  TEST_ASSERT_EQUAL(RECORDED_FRAMES, frames);
+  TEST_ASSERT_UINT32_WITHIN(2 * FRAME_INTERVAL_MS, RECORDED_FRAMES * FRAME_INTERVAL_MS, durationMs);
+}
+
+void test_truncated_mid_cluster() {
+  nativeTestReset("mkv_writer_truncated");
+  const int frames = 130;
+  size_t lastFrameLen = 0;
+  size_t len = writeUnfinalized("/cut.mkv", frames, lastFrameLen);
+  TEST_ASSERT_GREATER_THAN(lastFrameLen, len);
+
+  // Незавершённый файл без обрыва: размеры Segment и последнего Cluster неизвестны
+  Report whole = inspect("unfinalized", len);
+  TEST_ASSERT_EQUAL(0, whole.errors);
+  TEST_ASSERT_EQUAL(frames, whole.frames);
+
+  // Обрыв посреди последнего блока третьего кластера - разбор до последнего целого блока
+  Report r = inspect("truncated", len - lastFrameLen / 2);
+  TEST_ASSERT_EQUAL(0, r.errors);
+  TEST_ASSERT_TRUE(r.truncated);
+  TEST_ASSERT_EQUAL(frames - 1, r.frames);
+  TEST_ASSERT_EQUAL(3, r.clusters);
+  TEST_ASSERT_EQUAL((frames - 2) * FRAME_INTERVAL_MS, r.lastBlockTime);
+}
+
+void test_recovery_of_truncated_file() {
+  nativeTestReset("mkv_writer_recovery");
+  SD_MMC.mkdir("/records");
+  const int frames = 80;
+  size_t lastFrameLen = 0;
+  size_t len = writeUnfinalized("/records/005.mkv.tmp", frames, lastFrameLen);
+  TEST_ASSERT_TRUE(nativeTestWriteFile("/records/005.mkv.tmp", file, len - lastFrameLen / 2));
+
+  MKVRecoveryResult result;
+  TEST_ASSERT_TRUE(recoverMKVFile("/records/005.mkv.tmp", "/records/005.mkv", result));
+  TEST_ASSERT_EQUAL(frames - 1, result.frames);
+  TEST_ASSERT_FALSE(SD_MMC.exists("/records/005.mkv.tmp"));
+
+  // Восстановленный файл - без обрыва, Duration покрывает последний кадр
+  size_t recovered = nativeTestReadFile("/records/005.mkv", file, sizeof(file));
+  Report r = inspect("recovered", recovered);
+  TEST_ASSERT_EQUAL(0, r.errors);
+  TEST_ASSERT_FALSE(r.truncated);
+  TEST_ASSERT_EQUAL(frames - 1, r.frames);
+  TEST_ASSERT_GREATER_OR_EQUAL(r.lastBlockTime, r.duration);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_recorded_segment_is_valid);
+  RUN_TEST(test_cluster_timecodes);
+  RUN_TEST(test_cues_point_at_clusters);
+  RUN_TEST(test_segment_info_read_back);
+  RUN_TEST(test_truncated_mid_cluster);
+  RUN_TEST(test_recovery_of_truncated_file);
+  return UNITY_END();
+}
@@ -0,0 +1,199 @@
+// Каталог сегментов (segment_catalog): загрузка, дозапись, оборванный и повреждённый хвост
+
+#include <unity.h>
+#include "../native_test.h"
+#include "segment_catalog.h"
+
+static const char* CATALOG = "/records/segments.cat";
+static const size_t HEADER_SIZE = 8;
+static const size_t RECORD_SIZE = 24;
+
+static SegmentInfo segment(uint16_t index, uint32_t startTime) {
+  SegmentInfo info = {};
+  info.index = index;
+  info.flags = SEGMENT_FLAG_WALLCLOCK;
+  info.startTime = startTime;
+  info.durationMs = 60000;
+  info.bytes = 1000 + index;
+  info.frames = 1500;
+  return info;
+}
+
+// Сегмент записан целиком: OPEN + ADD
+static void recordSegment(uint16_t index, uint32_t startTime) {
+  TEST_ASSERT_TRUE(catalogSegmentOpened(index));
+  TEST_ASSERT_TRUE(catalogSegmentClosed(segment(index, startTime)));
+}
+
+static size_t catalogSize() {
+  File file = SD_MMC.open(CATALOG, FILE_READ);
+  size_t size = file ? file.size() : 0;
+  file.close();
+  return size;
+}
+
+void setUp() {
+  nativeTestReset("segment_catalog");
+  SD_MMC.mkdir("/records");
+  TEST_ASSERT_TRUE(initSegmentCatalog(8));
+  clearSegmentCatalog();
+}
+
+void tearDown() {}
+
+void test_load_restores_segments() {
+  recordSegment(1, 1000);
+  recordSegment(2, 1060);
+  recordSegment(3, 1120);
+  TEST_ASSERT_TRUE(catalogSegmentDeleted(1));
+  TEST_ASSERT_TRUE(catalogSegmentUploaded(2));
+
+  clearSegmentCatalog();
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(2, catalogSegmentCount());
+  TEST_ASSERT_FALSE(catalogHasSegment(1));
+
+  SegmentInfo info;
+  TEST_ASSERT_TRUE(catalogOldestSegment(info));
+  TEST_ASSERT_EQUAL(2, info.index);
+  TEST_ASSERT_EQUAL(1060, info.startTime);
+  TEST_ASSERT_EQUAL(1002, info.bytes);
+  TEST_ASSERT_EQUAL(SEGMENT_FLAG_WALLCLOCK | SEGMENT_FLAG_UPLOADED, info.flags);
+  TEST_ASSERT_TRUE(catalogNewestSegment(info));
+  TEST_ASSERT_EQUAL(3, info.index);
+  TEST_ASSERT_EQUAL(1002 + 1003, catalogTotalBytes());
+
+  uint16_t pending[4];
+  TEST_ASSERT_EQUAL(0, catalogPendingSegments(pending, 4));
+}
+
+void test_missing_catalog() {
+  TEST_ASSERT_FALSE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(0, catalogSegmentCount());
+}
+
+void test_append_after_load() {
+  recordSegment(1, 1000);
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  recordSegment(2, 1060);
+  TEST_ASSERT_TRUE(catalogSegmentOpened(3));  // Запись прервана сбоем
+
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(2, catalogSegmentCount());
+  uint16_t pending[4];
+  TEST_ASSERT_EQUAL(1, catalogPendingSegments(pending, 4));
+  TEST_ASSERT_EQUAL(3, pending[0]);
+}
+
+void test_torn_tail_is_cut() {
+  recordSegment(1, 1000);
+  recordSegment(2, 1060);
+  size_t intact = catalogSize();
+
+  // Сбой питания во время дозаписи: от записи осталось 10 байт
+  File file = SD_MMC.open(CATALOG, FILE_APPEND);
+  uint8_t partial[10] = {'A', 0, 3, 0};
+  file.write(partial, sizeof(partial));
+  file.close();
+
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(2, catalogSegmentCount());
+  TEST_ASSERT_EQUAL(0, (catalogSize() - HEADER_SIZE) % RECORD_SIZE);
+  TEST_ASSERT_LESS_OR_EQUAL(intact, catalogSize());
+
+  // Новые записи - с границы записи, а не за остатком оборванной
+  recordSegment(3, 1120);
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(3, catalogSegmentCount());
+  TEST_ASSERT_TRUE(catalogHasSegment(3));
+}
+
+void test_corrupt_last_record_is_dropped() {
+  recordSegment(1, 1000);
+  recordSegment(2, 1060);
+
+  // Последняя запись (ADD 2) записана не полностью - CRC не сходится
+  uint8_t data[512];
+  size_t len = nativeTestReadFile(CATALOG, data, sizeof(data));
+  data[len - 6] ^= 0xFF;
+  TEST_ASSERT_TRUE(nativeTestWriteFile(CATALOG, data, len));
+
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(1, catalogSegmentCount());
+  uint16_t pending[4];
+  TEST_ASSERT_EQUAL(1, catalogPendingSegments(pending, 4));
+  TEST_ASSERT_EQUAL(2, pending[0]);
+  TEST_ASSERT_EQUAL(0, (catalogSize() - HEADER_SIZE) % RECORD_SIZE);
+
+  // Каталог перезаписан живыми записями: начатый сегмент 2 остаётся незавершённым
+  recordSegment(3, 1120);
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(2, catalogSegmentCount());
+  TEST_ASSERT_EQUAL(1, catalogPendingSegments(pending, 4));
+  TEST_ASSERT_EQUAL(2, pending[0]);
+}
+
+void test_corrupt_middle_record_fails_load() {
+  recordSegment(1, 1000);
+  recordSegment(2, 1060);
+
+  uint8_t data[512];
+  size_t len = nativeTestReadFile(CATALOG, data, sizeof(data));
+  data[HEADER_SIZE + 5] ^= 0xFF;
+  TEST_ASSERT_TRUE(nativeTestWriteFile(CATALOG, data, len));
+
+  // Повреждение не в конце - не сбой дозаписи; каталог восстанавливается сканированием
+  TEST_ASSERT_FALSE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(0, catalogSegmentCount());
+}
+
+void test_bad_header_fails_load() {
+  uint8_t data[HEADER_SIZE] = {'X', 'X', 'X', 'X', 1, 0, 0, 0};
+  TEST_ASSERT_TRUE(nativeTestWriteFile(CATALOG, data, sizeof(data)));
+  TEST_ASSERT_FALSE(loadSegmentCatalog());
+}
+
+void test_restore_and_write() {
+  // Восстановление сканированием: сегменты в любом порядке, затем сортировка и перезапись
+  TEST_ASSERT_TRUE(catalogRestoreSegment(segment(5, 3000)));
+  TEST_ASSERT_TRUE(catalogRestoreSegment(segment(4, 2000)));
+  sortSegmentCatalog();
+  TEST_ASSERT_TRUE(writeSegmentCatalog());
+  TEST_ASSERT_EQUAL(HEADER_SIZE + 2 * RECORD_SIZE, catalogSize());
+
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  SegmentInfo info;
+  TEST_ASSERT_TRUE(catalogGetSegment(0, info));
+  TEST_ASSERT_EQUAL(4, info.index);
+  TEST_ASSERT_TRUE(catalogGetSegment(1, info));
+  TEST_ASSERT_EQUAL(5, info.index);
+}
+
+void test_capacity_forgets_oldest() {
+  for (uint16_t i = 1; i <= 10; i++) {
+    recordSegment(i, 1000 + i * 60);
+  }
+  TEST_ASSERT_EQUAL(8, catalogSegmentCount());
+  SegmentInfo info;
+  TEST_ASSERT_TRUE(catalogOldestSegment(info));
+  TEST_ASSERT_EQUAL(3, info.index);
+
+  TEST_ASSERT_TRUE(loadSegmentCatalog());
+  TEST_ASSERT_EQUAL(8, catalogSegmentCount());
+  TEST_ASSERT_TRUE(catalogOldestSegment(info));
+  TEST_ASSERT_EQUAL(3, info.index);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_load_restores_segments);
+  RUN_TEST(test_missing_catalog);
+  RUN_TEST(test_append_after_load);
+  RUN_TEST(test_torn_tail_is_cut);
+  RUN_TEST(test_corrupt_last_record_is_dropped);
+  RUN_TEST(test_corrupt_middle_record_fails_load);
+  RUN_TEST(test_bad_header_fails_load);
+  RUN_TEST(test_restore_and_write);
+  RUN_TEST(test_capacity_forgets_oldest);
+  return UNITY_END();
+}
@@ -0,0 +1,231 @@
+// Выгрузка сегментов (segment_uploader): против tools/upload_server.cpp в том же процессе
+
+// Сервер - первым: макросы config.h не должны попасть в его код
+#define UPLOAD_SERVER_NO_MAIN
+#include "../../tools/upload_server.cpp"
+
+#include <unity.h>
+#include <Preferences.h>
+#include "../native_test.h"
+#include "config.h"
+#include "sd_recorder.h"
+#include "segment_uploader.h"
+#include "stream_client.h"
+#include "wifi_client.h"
+#include "wifi_settings.h"
+
+static const uint32_t CHUNK = SD_UPLOAD_CHUNK_KB * 1024;  // PSRAM шимов - полный размер части
+static const uint32_t FRAME_INTERVAL_MS = 100;
+static const uint64_t MIN_FREE_SPACE = 10 * 1024 * 1024;  // Как в sd_recorder.cpp
+static const char* UPLOAD_ROOT = "/tmp/esp32cam-test-segment_uploader/uploads";
+
+static int server = -1;
+static SegmentInfo segments[3];  // Записаны по порядку: самый старый - первый
+static uint8_t jpeg[16384];
+static uint8_t file[1024 * 1024];
+
+// Сервер и выгрузка по очереди в одном потоке, пока не выполнится условие (не дольше timeoutMs)
+template <typename Condition>
+static bool pump(Condition done, long long timeoutMs = 3000) {
+  long long deadline = nowMs() + timeoutMs;
+  while (nowMs() < deadline) {
+    serveOnce(server, UPLOAD_ROOT, 2);
+    handleSegmentUploader();
+    if (done()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Синтетический JPEG: SOI, данные, EOI; около 10 KB - сегмент в несколько сохранений позиции
+static size_t makeFrame(int n) {
+  size_t len = 9000 + (n * 37) % 700;
+  jpeg[0] = 0xFF;
+  jpeg[1] = 0xD8;
+  memset(jpeg + 2, 0x20 + n % 64, len - 4);
+  jpeg[len - 2] = 0xFF;
+  jpeg[len - 1] = 0xD9;
+  return len;
+}
+
+// Сегмент из frames кадров; выключение записи дожидается его завершения в фоновой задаче
+static void recordSegment(int frames) {
+  setRecordingEnabled(true);
+  uint8_t* data = jpeg;
+  recordFrame(data, makeFrame(0));  // Открывает сегмент и не записывается
+  TEST_ASSERT_TRUE(isRecording());
+  for (int i = 0; i < frames; i++) {
+    recordFrame(data, makeFrame(i));
+    nativeClockAdvance(FRAME_INTERVAL_MS);
+  }
+  setRecordingEnabled(false);
+}
+
+static bool hasSegment(const SegmentInfo& info) {
+  SegmentInfo list[8];
+  int count = readSegmentList(0, list, 8);
+  for (int i = 0; i < count; i++) {
+    if (list[i].index == info.index && list[i].startTime == info.startTime) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static uint32_t segmentFlags(const SegmentInfo& info) {
+  SegmentInfo list[8];
+  int count = readSegmentList(0, list, 8);
+  for (int i = 0; i < count; i++) {
+    if (list[i].index == info.index) {
+      return list[i].flags;
+    }
+  }
+  return 0;
+}
+
+static uint64_t clusterAlign(uint64_t bytes) {
+  return (bytes + SD_CLUSTER_SIZE - 1) / SD_CLUSTER_SIZE * SD_CLUSTER_SIZE;
+}
+
+// WiFi шимов (127.0.0.1), три сегмента на карте и сервер на SERVER_PORT: один раз на весь набор
+static void startEnvironment() {
+  if (server >= 0) {
+    return;
+  }
+  nativeTestReset("segment_uploader");
+  initWiFiSettings();
+  saveWiFiCredentials("lab", "");
+  NativeAccessPoint ap = {"lab", {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01}, 6, -50};
+  nativeWiFiSetNetworks(&ap, 1);
+  startWiFi();
+  bool connected = false;
+  for (int i = 0; i < 200 && !connected; i++) {
+    WiFiLinkEvent event;
+    while (pollWiFiEvent(event)) {
+      connected = connected || event == WIFI_LINK_GOT_IP;
+    }
+    delay(5);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(connected, "no WiFi link");
+  setServerHost("127.0.0.1");
+
+  TEST_ASSERT_TRUE(initSDRecorder());
+  for (int i = 0; i < 3; i++) {
+    recordSegment(40);
+    nativeClockAdvance(2000);  // Разное время начала
+  }
+  TEST_ASSERT_EQUAL(3, readSegmentList(0, segments, 3));
+  TEST_ASSERT_GREATER_THAN(9 * CHUNK, segments[0].bytes);
+
+  initSegmentUploader();
+  setUploadRate(0);
+  server = listenOn(SERVER_PORT);
+  TEST_ASSERT_TRUE_MESSAGE(server >= 0, "upload server port busy");
+}
+
+void setUp() {
+  startEnvironment();
+}
+
+void tearDown() {}
+
+void test_offsets_follow_chunks_and_position_saved() {
+  setUploadEnabled(true);
+  TEST_ASSERT_TRUE(pump([] { return getUploadStatus().offset >= 9 * CHUNK; }));
+  TEST_ASSERT_EQUAL(segments[0].index, getUploadStatus().segment);
+
+  // Части идут подряд, каждый ответ подтверждает смещение следующей
+  TEST_ASSERT_GREATER_OR_EQUAL(9, exchanges.size());
+  for (size_t i = 0; i < 9; i++) {
+    TEST_ASSERT_EQUAL(i * CHUNK, exchanges[i].offset);
+    TEST_ASSERT_EQUAL(200, exchanges[i].status);
+    TEST_ASSERT_EQUAL((i + 1) * CHUNK, exchanges[i].answered);
+  }
+
+  // Позиция в NVS - каждые SD_UPLOAD_SAVE_KB, а не после каждой части
+  Preferences prefs;
+  prefs.begin("upload", true);
+  TEST_ASSERT_EQUAL(segments[0].index, prefs.getUShort("idx", 0));
+  TEST_ASSERT_EQUAL(segments[0].startTime, prefs.getUInt("start", 0));
+  TEST_ASSERT_EQUAL(SD_UPLOAD_SAVE_KB * 1024, prefs.getUInt("off", 0));
+  prefs.end();
+}
+
+void test_resume_after_lost_response() {
+  // Сервер сохранил часть, но ответ до камеры не дошёл
+  size_t before = exchanges.size();
+  loseRate = 1;
+  TEST_ASSERT_TRUE(pump([] { return !exchanges.empty() && exchanges.back().status == 0; }));
+  loseRate = 0;
+  uint64_t lost = exchanges.back().offset;
+  TEST_ASSERT_GREATER_THAN(before, exchanges.size());
+  TEST_ASSERT_TRUE(pump([] { return getUploadStatus().failures == 1; }));
+  TEST_ASSERT_EQUAL(lost, getUploadStatus().offset);
+
+  // Повтор через 1 с с тем же смещением: 409 со смещением сервера, дальше - с него
+  size_t retry = exchanges.size();
+  nativeClockAdvance(1000);
+  TEST_ASSERT_TRUE(pump([retry] { return exchanges.size() >= retry + 2; }));
+  TEST_ASSERT_EQUAL(lost, exchanges[retry].offset);
+  TEST_ASSERT_EQUAL(409, exchanges[retry].status);
+  TEST_ASSERT_EQUAL(lost + CHUNK, exchanges[retry].answered);
+  TEST_ASSERT_EQUAL(lost + CHUNK, exchanges[retry + 1].offset);
+  TEST_ASSERT_EQUAL(200, exchanges[retry + 1].status);
+
+  // Сегмент принят целиком и без повторов внутри файла
+  TEST_ASSERT_TRUE(pump([] { return getUploadStatus().uploaded == 1; }));
+  setUploadEnabled(false);
+  TEST_ASSERT_TRUE(segmentFlags(segments[0]) & SEGMENT_FLAG_UPLOADED);
+  TEST_ASSERT_FALSE(segmentFlags(segments[1]) & SEGMENT_FLAG_UPLOADED);
+
+  String name = getSegmentFileName(segments[0]);
+  size_t len = nativeTestReadFile((String("/records/") + name).c_str(), file, sizeof(file));
+  TEST_ASSERT_EQUAL(segments[0].bytes, len);
+  std::string received = std::string(UPLOAD_ROOT) + "/24-0A-C4-00-00-01/" +
+                         std::to_string(segments[0].startTime) + "_" + name.c_str();
+  FILE* in = fopen(received.c_str(), "rb");
+  TEST_ASSERT_TRUE_MESSAGE(in != nullptr, "segment not complete on server");
+  static uint8_t copy[sizeof(file)];
+  size_t copyLen = fread(copy, 1, sizeof(copy), in);
+  fclose(in);
+  TEST_ASSERT_EQUAL(len, copyLen);
+  TEST_ASSERT_EQUAL_MEMORY(file, copy, len);
+}
+
+void test_rotation_deletes_uploaded_first() {
+  // Выгружены самый старый и самый новый; средний (старше нового) - нет
+  markSegmentUploaded(segments[2]);
+  TEST_ASSERT_TRUE(segmentFlags(segments[2]) & SEGMENT_FLAG_UPLOADED);
+
+  // Карта заполнена: места хватит после удаления обоих выгруженных, но не одного
+  uint64_t capacity = SD_MMC.usedBytes() + MIN_FREE_SPACE - clusterAlign(segments[0].bytes) -
+                      clusterAlign(segments[2].bytes) / 2;
+  nativeSdSetCapacity(capacity);
+  // Сверка места - в фоновой задаче раз в 30 минут вне записи
+  nativeClockAdvance(1800001);
+  for (int i = 0; i < 300 && getSDCardInfo().totalMB != capacity / (1024 * 1024); i++) {
+    delay(10);
+  }
+  TEST_ASSERT_EQUAL(capacity / (1024 * 1024), getSDCardInfo().totalMB);
+
+  // Новый сегмент освобождает место ротацией
+  setRecordingEnabled(true);
+  TEST_ASSERT_TRUE(startRecording());
+  TEST_ASSERT_FALSE(hasSegment(segments[0]));
+  TEST_ASSERT_FALSE(hasSegment(segments[2]));
+  TEST_ASSERT_TRUE(hasSegment(segments[1]));
+  TEST_ASSERT_FALSE(SD_MMC.exists((String("/records/") + getSegmentFileName(segments[2])).c_str()));
+  TEST_ASSERT_TRUE(SD_MMC.exists((String("/records/") + getSegmentFileName(segments[1])).c_str()));
+  setRecordingEnabled(false);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_offsets_follow_chunks_and_position_saved);
+  RUN_TEST(test_resume_after_lost_response);
+  RUN_TEST(test_rotation_deletes_uploaded_first);
+  int failures = UNITY_END();
+  close(server);
+  return failures;
+}
@@ -0,0 +1,164 @@
+// Канал настроек (settings_channel): long-poll против tools/settings_server.cpp в том же процессе
+
+// Сервер - первым: макросы config.h (SETTINGS_PATH) не должны попасть в его код
+#define SETTINGS_SERVER_NO_MAIN
+#include "../../tools/settings_server.cpp"
+
+#include <unity.h>
+#include "../native_test.h"
+#include "config.h"
+#include "sd_recorder.h"
+#include "settings_channel.h"
+#include "stream_client.h"
+#include "wifi_client.h"
+#include "wifi_settings.h"
+
+static int server = -1;
+static int noInput = -1;
+
+// Сервер и канал по очереди в одном потоке, пока не выполнится условие (не дольше timeoutMs)
+template <typename Condition>
+static bool pump(Condition done, long long timeoutMs = 2000) {
+  long long deadline = nowMs() + timeoutMs;
+  while (nowMs() < deadline) {
+    serveOnce(server, noInput, 2);
+    handleSettingsChannel();
+    if (done()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Запрос камеры ждёт изменения настроек на сервере
+static bool watching() {
+  return connections.size() == 1 && connections[0].watching;
+}
+
+// Обрыв всех соединений со стороны сервера (перезапуск, балансировщик)
+static void dropConnections() {
+  for (auto& conn : connections) {
+    close(conn.fd);
+  }
+  connections.clear();
+}
+
+// WiFi шимов (127.0.0.1) и сервер на SERVER_PORT: один раз на весь набор, тесты идут по порядку
+static void startEnvironment() {
+  if (server >= 0) {
+    return;
+  }
+  nativeTestReset("settings_channel");
+  initWiFiSettings();
+  saveWiFiCredentials("lab", "");
+  NativeAccessPoint ap = {"lab", {0x24, 0x0A, 0xC4, 0x00, 0x00, 0x01}, 6, -50};
+  nativeWiFiSetNetworks(&ap, 1);
+  startWiFi();
+  bool connected = false;
+  for (int i = 0; i < 200 && !connected; i++) {
+    WiFiLinkEvent event;
+    while (pollWiFiEvent(event)) {
+      connected = connected || event == WIFI_LINK_GOT_IP;
+    }
+    delay(5);
+  }
+  TEST_ASSERT_TRUE_MESSAGE(connected, "no WiFi link");
+  setServerHost("127.0.0.1");
+
+  server = listenOn(SERVER_PORT);
+  TEST_ASSERT_TRUE_MESSAGE(server >= 0, "settings server port busy");
+  // Применение настроек видно по интервалу записи: сенсора камеры в тесте нет
+  settings = "{\"recording\":{\"interval\":12}}";
+}
+
+void setUp() {
+  startEnvironment();
+}
+
+void tearDown() {}
+
+void test_initial_settings_delivered() {
+  // Камера ещё не знает версию - сервер отвечает сразу
+  TEST_ASSERT_TRUE(pump([] { return isSettingsChannelActive() && getSettingsVersion() == version; }));
+  TEST_ASSERT_EQUAL(12, getRecordingInterval());
+  TEST_ASSERT_TRUE(pump(watching));
+}
+
+void test_change_delivered_immediately() {
+  TEST_ASSERT_TRUE(pump(watching));
+  long long changed = nowMs();
+  setSettings("{\"recording\":{\"interval\":20}}");
+  TEST_ASSERT_TRUE(pump([] { return getSettingsVersion() == version; }));
+
+  // Ответ на ждущий запрос, а не 204 через SETTINGS_WATCH_TIMEOUT_S и не опрос
+  TEST_ASSERT_LESS_THAN(500, nowMs() - changed);
+  TEST_ASSERT_EQUAL(20, getRecordingInterval());
+  TEST_ASSERT_TRUE(isSettingsChannelActive());
+}
+
+void test_applied_version_acknowledged() {
+  setSettings("{\"recording\":{\"interval\":25}}");
+  // Следующий запрос несёт применённую версию - сервер записывает подтверждение
+  TEST_ASSERT_TRUE(pump([] { return acked[getDeviceId()] == version; }));
+  TEST_ASSERT_EQUAL(version, getSettingsVersion());
+  TEST_ASSERT_TRUE(watching());
+}
+
+void test_reconnect_after_idle_drop() {
+  TEST_ASSERT_TRUE(pump(watching));
+  // Запрос ждал дольше секунды - закрытие простаивающего соединения, не ошибка
+  nativeClockAdvance(2000);
+  dropConnections();
+  TEST_ASSERT_TRUE(pump(watching));
+  TEST_ASSERT_TRUE(isSettingsChannelActive());
+
+  setSettings("{\"recording\":{\"interval\":30}}");
+  TEST_ASSERT_TRUE(pump([] { return getSettingsVersion() == version; }));
+  TEST_ASSERT_EQUAL(30, getRecordingInterval());
+}
+
+void test_reconnect_after_backoff() {
+  TEST_ASSERT_TRUE(pump(watching));
+  // Соединение оборвано сразу после запроса - ошибка, опрос до повтора
+  dropConnections();
+  TEST_ASSERT_TRUE(pump([] { return !isSettingsChannelActive(); }));
+  TEST_ASSERT_FALSE(pump(watching, 100));
+
+  // Повтор после задержки (1 с после первой ошибки)
+  nativeClockAdvance(1000);
+  TEST_ASSERT_TRUE(pump(watching));
+  setSettings("{\"recording\":{\"interval\":35}}");
+  TEST_ASSERT_TRUE(pump([] { return isSettingsChannelActive() && getSettingsVersion() == version; }));
+  TEST_ASSERT_EQUAL(35, getRecordingInterval());
+}
+
+void test_unparsed_settings_not_acknowledged() {
+  TEST_ASSERT_TRUE(pump(watching));
+  unsigned long applied = version;
+  setSettings("{\"recording\":{\"interval\":");
+  // Ответ не разобран - версия не подтверждается, повтор после задержки
+  TEST_ASSERT_TRUE(pump([] { return !isSettingsChannelActive(); }));
+  TEST_ASSERT_EQUAL(applied, getSettingsVersion());
+  TEST_ASSERT_EQUAL(35, getRecordingInterval());
+
+  // Сервер исправил настройки - повтор получает их, подтверждение уже новой версии
+  setSettings("{\"recording\":{\"interval\":40}}");
+  nativeClockAdvance(1000);
+  TEST_ASSERT_TRUE(pump([] { return acked[getDeviceId()] == version; }));
+  TEST_ASSERT_EQUAL(version, getSettingsVersion());
+  TEST_ASSERT_EQUAL(40, getRecordingInterval());
+  TEST_ASSERT_TRUE(isSettingsChannelActive());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_initial_settings_delivered);
+  RUN_TEST(test_change_delivered_immediately);
+  RUN_TEST(test_applied_version_acknowledged);
+  RUN_TEST(test_reconnect_after_idle_drop);
+  RUN_TEST(test_reconnect_after_backoff);
+  RUN_TEST(test_unparsed_settings_not_acknowledged);
+  int failures = UNITY_END();
+  close(server);
+  return failures;
+}
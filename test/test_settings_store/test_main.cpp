@@ -0,0 +1,180 @@
+// Хранилище настроек (settings_store): отложенная запись, CRC блоба, миграция версий
+
+#include <unity.h>
+#include <Preferences.h>
+#include "../native_test.h"
+#include "config.h"
+#include "settings_store.h"
+
+// Группа версии 1 и та же группа после добавления поля (версия 2)
+struct GroupV1 {
+  uint32_t interval;
+  uint32_t quality;
+};
+
+struct GroupV2 {
+  uint32_t interval;
+  uint32_t quality;
+  uint32_t added;
+};
+
+// Модуль помнит группы (не больше SETTINGS_STORE_GROUPS) и записанный CRC до перезагрузки:
+// тесты делят имена групп прошивки, данные в каждом тесте свои
+static SettingsStoreStats before;
+
+// Изменение статистики с начала теста (модуль держит её с загрузки)
+static uint32_t writes() { return getSettingsStoreStats().writes - before.writes; }
+static uint32_t skipped() { return getSettingsStoreStats().skipped - before.skipped; }
+static uint32_t coalesced() { return getSettingsStoreStats().coalesced - before.coalesced; }
+
+void setUp() {
+  nativeTestReset("settings_store");
+  before = getSettingsStoreStats();
+}
+
+void tearDown() {
+  settingsStoreFlush();
+}
+
+void test_roundtrip() {
+  GroupV1 saved = {5000, 12};
+  settingsStoreSave("camera", 1, &saved, sizeof(saved));
+  settingsStoreFlush();
+  TEST_ASSERT_EQUAL(1, writes());
+
+  GroupV1 loaded = {};
+  TEST_ASSERT_TRUE(settingsStoreLoad("camera", 1, &loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL(5000, loaded.interval);
+  TEST_ASSERT_EQUAL(12, loaded.quality);
+}
+
+void test_missing_blob() {
+  GroupV1 data = {7, 8};
+  TEST_ASSERT_FALSE(settingsStoreLoad("sdrec", 1, &data, sizeof(data)));
+  TEST_ASSERT_EQUAL(7, data.interval);
+}
+
+void test_debounce_coalesces_changes() {
+  GroupV1 data = {1000, 10};
+  settingsStoreSave("upload", 1, &data, sizeof(data));
+  data.quality = 11;
+  settingsStoreSave("upload", 1, &data, sizeof(data));
+  data.quality = 12;
+  settingsStoreSave("upload", 1, &data, sizeof(data));
+  TEST_ASSERT_EQUAL(2, coalesced());
+  TEST_ASSERT_EQUAL(1, getSettingsStoreStats().pending);
+
+  // До паузы в изменениях flash не трогается
+  handleSettingsStore();
+  nativeClockAdvance(SETTINGS_STORE_DEBOUNCE_MS / 2);
+  handleSettingsStore();
+  TEST_ASSERT_EQUAL(0, writes());
+
+  nativeClockAdvance(SETTINGS_STORE_DEBOUNCE_MS);
+  handleSettingsStore();
+  TEST_ASSERT_EQUAL(1, writes());
+  TEST_ASSERT_EQUAL(0, getSettingsStoreStats().pending);
+
+  GroupV1 loaded = {};
+  TEST_ASSERT_TRUE(settingsStoreLoad("upload", 1, &loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL(12, loaded.quality);
+}
+
+void test_max_delay_bounds_debounce() {
+  // Изменения чаще задержки - запись всё равно не позже SETTINGS_STORE_MAX_DELAY_MS
+  GroupV1 data = {1000, 0};
+  unsigned long elapsed = 0;
+  while (writes() == 0 && elapsed <= SETTINGS_STORE_MAX_DELAY_MS) {
+    data.quality++;
+    settingsStoreSave("camera", 1, &data, sizeof(data));
+    nativeClockAdvance(SETTINGS_STORE_DEBOUNCE_MS / 2);
+    elapsed += SETTINGS_STORE_DEBOUNCE_MS / 2;
+    handleSettingsStore();
+  }
+  TEST_ASSERT_EQUAL(1, writes());
+  TEST_ASSERT_GREATER_OR_EQUAL(SETTINGS_STORE_MAX_DELAY_MS, elapsed);
+}
+
+void test_unchanged_save_skipped() {
+  GroupV1 data = {2000, 20};
+  settingsStoreSave("sdrec", 1, &data, sizeof(data));
+  settingsStoreFlush();
+  TEST_ASSERT_EQUAL(1, writes());
+
+  settingsStoreSave("sdrec", 1, &data, sizeof(data));
+  TEST_ASSERT_EQUAL(1, skipped());
+  TEST_ASSERT_EQUAL(0, getSettingsStoreStats().pending);
+
+  // Изменение и возврат к записанному до истечения задержки - записи нет
+  data.quality = 21;
+  settingsStoreSave("sdrec", 1, &data, sizeof(data));
+  data.quality = 20;
+  settingsStoreSave("sdrec", 1, &data, sizeof(data));
+  TEST_ASSERT_EQUAL(0, getSettingsStoreStats().pending);
+  settingsStoreFlush();
+  TEST_ASSERT_EQUAL(1, writes());
+}
+
+void test_crc_mismatch_rejected() {
+  GroupV1 data = {3000, 30};
+  settingsStoreSave("upload", 1, &data, sizeof(data));
+  settingsStoreFlush();
+
+  // Повреждаем байт данных блоба в NVS
+  Preferences prefs;
+  TEST_ASSERT_TRUE(prefs.begin("upload", false));
+  uint8_t blob[64];
+  size_t len = prefs.getBytes("blob", blob, sizeof(blob));
+  TEST_ASSERT_GREATER_THAN(sizeof(data), len);
+  blob[len - 1] ^= 0x5A;
+  prefs.putBytes("blob", blob, len);
+  prefs.end();
+
+  GroupV1 loaded = {1, 2};
+  TEST_ASSERT_FALSE(settingsStoreLoad("upload", 1, &loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL(1, loaded.interval);
+  TEST_ASSERT_EQUAL(2, loaded.quality);
+}
+
+void test_older_version_fills_prefix() {
+  GroupV1 old = {4000, 40};
+  settingsStoreSave("camera", 1, &old, sizeof(old));
+  settingsStoreFlush();
+
+  // Новые поля сохраняют значения по умолчанию
+  GroupV2 loaded = {0, 0, 777};
+  TEST_ASSERT_TRUE(settingsStoreLoad("camera", 2, &loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL(4000, loaded.interval);
+  TEST_ASSERT_EQUAL(40, loaded.quality);
+  TEST_ASSERT_EQUAL(777, loaded.added);
+
+  // Сохранение новой версии пишет блоб заново, хотя начало данных совпадает
+  settingsStoreSave("camera", 2, &loaded, sizeof(loaded));
+  TEST_ASSERT_EQUAL(1, getSettingsStoreStats().pending);
+  settingsStoreFlush();
+  TEST_ASSERT_EQUAL(2, writes());
+}
+
+void test_newer_version_rejected() {
+  // Блоб прошивки новее (откат прошивки) - не разбираем чужой формат
+  GroupV2 newer = {5000, 50, 5};
+  settingsStoreSave("sdrec", 3, &newer, sizeof(newer));
+  settingsStoreFlush();
+
+  GroupV2 loaded = {1, 1, 1};
+  TEST_ASSERT_FALSE(settingsStoreLoad("sdrec", 2, &loaded, sizeof(loaded)));
+  TEST_ASSERT_EQUAL(1, loaded.interval);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_roundtrip);
+  RUN_TEST(test_missing_blob);
+  RUN_TEST(test_debounce_coalesces_changes);
+  RUN_TEST(test_max_delay_bounds_debounce);
+  RUN_TEST(test_unchanged_save_skipped);
+  RUN_TEST(test_crc_mismatch_rejected);
+  RUN_TEST(test_older_version_fills_prefix);
+  RUN_TEST(test_newer_version_rejected);
+  return UNITY_END();
+}
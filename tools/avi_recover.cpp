@@ -0,0 +1,228 @@
+/*
+ * AVI Recover - хост-версия восстановления прерванных записей
+ *
+ * Тот же алгоритм, что и src/avi_recovery.cpp на устройстве, для карт,
+ * извлечённых из камеры до перезагрузки:
+ * - обход кадров 00dc в LIST movi по заголовкам chunk'ов
+ * - обрезка по последнему полностью записанному кадру
+ * - запись idx1, исправление размеров RIFF/movi и количества кадров
+ * - NNN.avi.tmp -> NNN.avi
+ *
+ * Сборка:
+ *   g++ -std=c++17 -O2 -o avi_recover tools/avi_recover.cpp
+ *
+ * Использование:
+ *   ./avi_recover [--dry-run] file.avi.tmp [...]
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const uint32_t AVIIF_KEYFRAME = 0x10;
+
+static uint32_t read32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  p[2] = (value >> 16) & 0xFF;
+  p[3] = (value >> 24) & 0xFF;
+}
+
+static bool readAt(FILE* f, uint64_t pos, uint8_t* buf, size_t len) {
+  return fseek(f, (long)pos, SEEK_SET) == 0 && fread(buf, 1, len, f) == len;
+}
+
+static void write32At(FILE* f, uint64_t pos, uint32_t value) {
+  uint8_t bytes[4];
+  put32(bytes, value);
+  fseek(f, (long)pos, SEEK_SET);
+  fwrite(bytes, 1, sizeof(bytes), f);
+}
+
+static void findHeaderChunks(FILE* f, uint64_t pos, uint64_t end, uint64_t& avihData, uint64_t& strhData) {
+  while (pos + 8 <= end) {
+    uint8_t chunk[12] = {0};
+    if (!readAt(f, pos, chunk, 8)) {
+      return;
+    }
+    readAt(f, pos + 8, chunk + 8, 4);
+    uint32_t size = read32(chunk + 4);
+
+    if (memcmp(chunk, "avih", 4) == 0) {
+      avihData = pos + 8;
+    } else if (memcmp(chunk, "strh", 4) == 0 && strhData == 0) {
+      strhData = pos + 8;
+    } else if (memcmp(chunk, "LIST", 4) == 0 && memcmp(chunk + 8, "strl", 4) == 0) {
+      findHeaderChunks(f, pos + 12, pos + 8 + size, avihData, strhData);
+    }
+    pos += 8 + (uint64_t)size + (size & 1);
+  }
+}
+
+static std::string finalName(const std::string& path) {
+  const std::string suffix = ".tmp";
+  if (path.size() > suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0) {
+    return path.substr(0, path.size() - suffix.size());
+  }
+  return path;
+}
+
+// 0 - восстановлен, 1 - восстанавливать нечего, 2 - ошибка ввода/вывода
+static int recoverFile(const std::string& path, bool dryRun) {
+  std::error_code ec;
+  uint64_t fileSize = fs::file_size(path, ec);
+  if (ec) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), ec.message().c_str());
+    return 2;
+  }
+
+  FILE* f = fopen(path.c_str(), dryRun ? "rb" : "r+b");
+  if (!f) {
+    perror(path.c_str());
+    return 2;
+  }
+
+  uint8_t riff[12];
+  if (!readAt(f, 0, riff, sizeof(riff)) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "AVI ", 4) != 0) {
+    fprintf(stderr, "%s: not an AVI file\n", path.c_str());
+    fclose(f);
+    return 1;
+  }
+
+  uint64_t avihData = 0;
+  uint64_t strhData = 0;
+  uint64_t moviStart = 0;
+  uint64_t pos = 12;
+  while (pos + 12 <= fileSize) {
+    uint8_t chunk[12];
+    if (!readAt(f, pos, chunk, sizeof(chunk))) {
+      break;
+    }
+    uint32_t size = read32(chunk + 4);
+    if (memcmp(chunk, "LIST", 4) == 0 && memcmp(chunk + 8, "movi", 4) == 0) {
+      moviStart = pos;
+      break;
+    }
+    if (memcmp(chunk, "LIST", 4) == 0 && memcmp(chunk + 8, "hdrl", 4) == 0) {
+      findHeaderChunks(f, pos + 12, pos + 8 + size, avihData, strhData);
+    }
+    pos += 8 + (uint64_t)size + (size & 1);
+  }
+
+  if (moviStart == 0) {
+    fprintf(stderr, "%s: no movi list\n", path.c_str());
+    fclose(f);
+    return 1;
+  }
+
+  uint64_t moviData = moviStart + 8;
+  uint64_t cut = moviStart + 12;
+  std::vector<uint32_t> index;  // Пары (смещение, размер)
+
+  while (cut + 8 <= fileSize) {
+    uint8_t chunk[8];
+    if (!readAt(f, cut, chunk, sizeof(chunk)) || memcmp(chunk + 2, "dc", 2) != 0) {
+      break;
+    }
+    uint32_t size = read32(chunk + 4);
+    uint64_t next = cut + 8 + size + (size & 1);
+    if (next > fileSize) {
+      break;
+    }
+    index.push_back((uint32_t)(cut - moviData));
+    index.push_back(size);
+    cut = next;
+  }
+
+  uint32_t frames = index.size() / 2;
+  uint64_t end = cut + 8 + (uint64_t)frames * 16;
+  printf("%s: %u frames, %llu -> %llu bytes%s\n", path.c_str(), frames,
+         (unsigned long long)fileSize, (unsigned long long)end, dryRun ? " (dry run)" : "");
+
+  if (frames == 0) {
+    fclose(f);
+    return 1;
+  }
+  if (dryRun) {
+    fclose(f);
+    return 0;
+  }
+
+  std::vector<uint8_t> idx1(8 + (size_t)frames * 16);
+  memcpy(idx1.data(), "idx1", 4);
+  put32(idx1.data() + 4, frames * 16);
+  for (uint32_t i = 0; i < frames; i++) {
+    uint8_t* entry = idx1.data() + 8 + i * 16;
+    memcpy(entry, "00dc", 4);
+    put32(entry + 4, AVIIF_KEYFRAME);
+    put32(entry + 8, index[i * 2]);
+    put32(entry + 12, index[i * 2 + 1]);
+  }
+  fseek(f, (long)cut, SEEK_SET);
+  fwrite(idx1.data(), 1, idx1.size(), f);
+
+  write32At(f, 4, (uint32_t)(end - 8));
+  write32At(f, moviStart + 4, (uint32_t)(cut - moviData));
+  if (avihData) {
+    write32At(f, avihData + 16, frames);
+  }
+  if (strhData) {
+    write32At(f, strhData + 32, frames);
+  }
+  if (fclose(f) != 0) {
+    perror(path.c_str());
+    return 2;
+  }
+
+  // На компьютере хвост оборванного кадра можно отрезать
+  fs::resize_file(path, end, ec);
+  if (ec) {
+    fprintf(stderr, "%s: truncate failed: %s\n", path.c_str(), ec.message().c_str());
+  }
+
+  std::string target = finalName(path);
+  if (target != path) {
+    fs::rename(path, target, ec);
+    if (ec) {
+      fprintf(stderr, "%s: rename failed: %s\n", path.c_str(), ec.message().c_str());
+      return 2;
+    }
+    printf("  -> %s\n", target.c_str());
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  bool dryRun = false;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--dry-run") == 0) {
+      dryRun = true;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+
+  if (files.empty()) {
+    fprintf(stderr, "usage: %s [--dry-run] file.avi.tmp [...]\n", argv[0]);
+    return 2;
+  }
+
+  int status = 0;
+  for (const std::string& path : files) {
+    int result = recoverFile(path, dryRun);
+    if (result > status) {
+      status = result;
+    }
+  }
+  return status;
+}
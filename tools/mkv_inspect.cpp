@@ -0,0 +1,504 @@
+/*
+ * MKV Inspect - проверка сегментов Matroska, записанных камерой
+ *
+ * Независимый от src/mkv_writer.cpp разбор EBML для проверки записей с карты
+ * и после изменений в записи MKV:
+ * - дерево элементов, размеры вложенных элементов в пределах родителя
+ * - SeekHead указывает на элементы с нужными ID
+ * - трек V_MJPEG с размерами кадра
+ * - время блоков не убывает, блоки - ключевые кадры с JPEG (FFD8 ... FFD9)
+ * - каждая точка Cues указывает на Cluster с тем же временем
+ * - Duration не меньше времени последнего кадра
+ * - оборванный файл (неизвестный размер Segment/Cluster, обрыв блока) - предупреждение, не ошибка
+ *
+ * Сборка:
+ *   g++ -std=c++17 -O2 -o mkv_inspect tools/mkv_inspect.cpp
+ *
+ * Использование:
+ *   ./mkv_inspect [--tree] file.mkv [...]
+ *
+ * Код возврата: 0 - файлы корректны, 1 - есть ошибки, 2 - ошибка чтения
+ *
+ * Тесты (test/test_mkv_writer) подключают файл с MKV_INSPECT_NO_MAIN и вызывают inspectData()
+ */
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+static const uint32_t ID_EBML = 0x1A45DFA3;
+static const uint32_t ID_DOC_TYPE = 0x4282;
+static const uint32_t ID_SEGMENT = 0x18538067;
+static const uint32_t ID_SEEK_HEAD = 0x114D9B74;
+static const uint32_t ID_SEEK = 0x4DBB;
+static const uint32_t ID_SEEK_ID = 0x53AB;
+static const uint32_t ID_SEEK_POSITION = 0x53AC;
+static const uint32_t ID_INFO = 0x1549A966;
+static const uint32_t ID_TIMESTAMP_SCALE = 0x2AD7B1;
+static const uint32_t ID_DURATION = 0x4489;
+static const uint32_t ID_TRACKS = 0x1654AE6B;
+static const uint32_t ID_TRACK_ENTRY = 0xAE;
+static const uint32_t ID_TRACK_NUMBER = 0xD7;
+static const uint32_t ID_CODEC_ID = 0x86;
+static const uint32_t ID_VIDEO = 0xE0;
+static const uint32_t ID_PIXEL_WIDTH = 0xB0;
+static const uint32_t ID_PIXEL_HEIGHT = 0xBA;
+static const uint32_t ID_CLUSTER = 0x1F43B675;
+static const uint32_t ID_TIMESTAMP = 0xE7;
+static const uint32_t ID_SIMPLE_BLOCK = 0xA3;
+static const uint32_t ID_CUES = 0x1C53BB6B;
+static const uint32_t ID_CUE_POINT = 0xBB;
+static const uint32_t ID_CUE_TIME = 0xB3;
+static const uint32_t ID_CUE_TRACK_POSITIONS = 0xB7;
+static const uint32_t ID_CUE_TRACK = 0xF7;
+static const uint32_t ID_CUE_CLUSTER_POSITION = 0xF1;
+static const uint32_t ID_VOID = 0xEC;
+
+static const std::map<uint32_t, const char*> ELEMENT_NAMES = {
+  {ID_EBML, "EBML"}, {ID_DOC_TYPE, "DocType"}, {ID_SEGMENT, "Segment"}, {ID_SEEK_HEAD, "SeekHead"},
+  {ID_SEEK, "Seek"}, {ID_SEEK_ID, "SeekID"}, {ID_SEEK_POSITION, "SeekPosition"}, {ID_INFO, "Info"},
+  {ID_TIMESTAMP_SCALE, "TimestampScale"}, {ID_DURATION, "Duration"}, {ID_TRACKS, "Tracks"},
+  {ID_TRACK_ENTRY, "TrackEntry"}, {ID_TRACK_NUMBER, "TrackNumber"}, {ID_CODEC_ID, "CodecID"},
+  {ID_VIDEO, "Video"}, {ID_PIXEL_WIDTH, "PixelWidth"}, {ID_PIXEL_HEIGHT, "PixelHeight"},
+  {ID_CLUSTER, "Cluster"}, {ID_TIMESTAMP, "Timestamp"}, {ID_SIMPLE_BLOCK, "SimpleBlock"},
+  {ID_CUES, "Cues"}, {ID_CUE_POINT, "CuePoint"}, {ID_CUE_TIME, "CueTime"},
+  {ID_CUE_TRACK_POSITIONS, "CueTrackPositions"}, {ID_CUE_TRACK, "CueTrack"},
+  {ID_CUE_CLUSTER_POSITION, "CueClusterPosition"}, {ID_VOID, "Void"},
+  {0x4286, "EBMLVersion"}, {0x42F7, "EBMLReadVersion"}, {0x42F2, "EBMLMaxIDLength"},
+  {0x42F3, "EBMLMaxSizeLength"}, {0x4287, "DocTypeVersion"}, {0x4285, "DocTypeReadVersion"},
+  {0x4D80, "MuxingApp"}, {0x5741, "WritingApp"}, {0x73C5, "TrackUID"}, {0x83, "TrackType"},
+  {0x9C, "FlagLacing"},
+};
+
+static bool isMaster(uint32_t id) {
+  switch (id) {
+    case ID_EBML: case ID_SEGMENT: case ID_SEEK_HEAD: case ID_SEEK: case ID_INFO: case ID_TRACKS:
+    case ID_TRACK_ENTRY: case ID_VIDEO: case ID_CLUSTER: case ID_CUES: case ID_CUE_POINT:
+    case ID_CUE_TRACK_POSITIONS:
+      return true;
+  }
+  return false;
+}
+
+struct Element {
+  uint32_t id;
+  uint64_t pos;       // Начало элемента (ID)
+  uint64_t dataPos;
+  uint64_t size;      // Для неизвестного размера - до конца родителя или следующего элемента уровня 1
+  bool unknownSize;
+  int idLength;
+};
+
+struct Report {
+  std::string path;
+  bool tree = false;
+  int errors = 0;
+  int warnings = 0;
+  bool truncated = false;
+  std::string docType;
+  std::string codecId;
+  uint64_t segmentData = 0;
+  uint64_t timestampScale = 1000000;
+  double duration = -1;
+  std::vector<std::pair<uint32_t, uint64_t>> seeks;   // (ID, позиция от начала Segment)
+  std::map<uint64_t, uint32_t> elementsAt;           // Позиция от начала Segment -> ID
+  std::map<uint64_t, int64_t> clusterTimes;          // Позиция кластера -> Timestamp
+  std::vector<std::pair<uint64_t, uint64_t>> cues;   // (CueTime, CueClusterPosition)
+  uint64_t mjpegTrack = 0;
+  uint64_t width = 0;
+  uint64_t height = 0;
+  uint64_t frames = 0;
+  uint64_t clusters = 0;
+  int64_t clusterTime = -1;
+  int64_t lastBlockTime = -1;
+  uint64_t cueTime = 0;
+  uint64_t cueTrack = 0;
+  uint64_t cuePosition = 0;
+};
+
+static void error(Report& r, uint64_t pos, const char* fmt, ...) {
+  fprintf(stderr, "%s: error at %llu: ", r.path.c_str(), (unsigned long long)pos);
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+  r.errors++;
+}
+
+static void warning(Report& r, uint64_t pos, const char* message) {
+  fprintf(stderr, "%s: warning at %llu: %s\n", r.path.c_str(), (unsigned long long)pos, message);
+  r.warnings++;
+}
+
+static uint64_t readUint(const std::vector<uint8_t>& data, uint64_t pos, uint64_t size) {
+  uint64_t value = 0;
+  for (uint64_t i = 0; i < size && i < 8; i++) {
+    value = (value << 8) | data[pos + i];
+  }
+  return value;
+}
+
+static double readFloat(const std::vector<uint8_t>& data, uint64_t pos, uint64_t size) {
+  uint64_t bits = readUint(data, pos, size);
+  if (size == 4) {
+    uint32_t bits32 = (uint32_t)bits;
+    float value;
+    memcpy(&value, &bits32, sizeof(value));
+    return value;
+  }
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Прочитать заголовок элемента. false - заголовок не помещается в файл или некорректен
+static bool readHeader(const std::vector<uint8_t>& data, uint64_t pos, Element& e) {
+  if (pos >= data.size()) {
+    return false;
+  }
+  uint8_t first = data[pos];
+  e.idLength = (first & 0x80) ? 1 : (first & 0x40) ? 2 : (first & 0x20) ? 3 : (first & 0x10) ? 4 : 0;
+  if (e.idLength == 0 || pos + e.idLength >= data.size()) {
+    return false;
+  }
+  e.id = (uint32_t)readUint(data, pos, e.idLength);
+
+  uint64_t sizePos = pos + e.idLength;
+  uint8_t marker = data[sizePos];
+  int sizeLength = 0;
+  while (sizeLength < 8 && !(marker & (0x80 >> sizeLength))) {
+    sizeLength++;
+  }
+  sizeLength++;
+  if (sizeLength > 8 || sizePos + sizeLength > data.size()) {
+    return false;
+  }
+  uint64_t mask = 0xFF >> sizeLength;
+  uint64_t size = marker & mask;
+  bool allOnes = size == mask;
+  for (int i = 1; i < sizeLength; i++) {
+    size = (size << 8) | data[sizePos + i];
+    allOnes = allOnes && data[sizePos + i] == 0xFF;
+  }
+  e.pos = pos;
+  e.dataPos = sizePos + sizeLength;
+  e.size = size;
+  e.unknownSize = allOnes;
+  return true;
+}
+
+static std::string elementName(uint32_t id) {
+  auto it = ELEMENT_NAMES.find(id);
+  if (it != ELEMENT_NAMES.end()) {
+    return it->second;
+  }
+  char buf[16];
+  snprintf(buf, sizeof(buf), "0x%X", id);
+  return buf;
+}
+
+static void checkBlock(Report& r, const std::vector<uint8_t>& data, const Element& e) {
+  if (e.size < 4 || (data[e.dataPos] & 0x80) == 0) {
+    error(r, e.pos, "SimpleBlock too short or multi-byte track number");
+    return;
+  }
+  uint64_t track = data[e.dataPos] & 0x7F;
+  int16_t relative = (int16_t)readUint(data, e.dataPos + 1, 2);
+  uint8_t flags = data[e.dataPos + 3];
+  uint64_t payload = e.dataPos + 4;
+  uint64_t payloadSize = e.size - 4;
+
+  if (r.clusterTime < 0) {
+    error(r, e.pos, "SimpleBlock before cluster Timestamp");
+  }
+  if (track != r.mjpegTrack) {
+    error(r, e.pos, "SimpleBlock for unknown track");
+  }
+  if ((flags & 0x80) == 0) {
+    error(r, e.pos, "SimpleBlock is not a keyframe");
+  }
+  if ((flags & 0x06) != 0) {
+    error(r, e.pos, "laced SimpleBlock");
+  }
+  if (payloadSize < 4 || data[payload] != 0xFF || data[payload + 1] != 0xD8 ||
+      data[payload + payloadSize - 2] != 0xFF || data[payload + payloadSize - 1] != 0xD9) {
+    error(r, e.pos, "SimpleBlock payload is not a JPEG image");
+  }
+
+  int64_t time = r.clusterTime + relative;
+  if (time < r.lastBlockTime) {
+    error(r, e.pos, "block timestamp goes backwards");
+  }
+  r.lastBlockTime = time;
+  r.frames++;
+}
+
+// Значения простых элементов, нужные для проверок
+static void checkLeaf(Report& r, const std::vector<uint8_t>& data, const Element& e, uint32_t parent) {
+  switch (e.id) {
+    case ID_DOC_TYPE:
+      r.docType.assign((const char*)&data[e.dataPos], e.size);
+      r.docType = r.docType.c_str();  // Без завершающих нулей
+      break;
+    case ID_TIMESTAMP_SCALE:
+      r.timestampScale = readUint(data, e.dataPos, e.size);
+      break;
+    case ID_DURATION:
+      if (e.size != 4 && e.size != 8) {
+        error(r, e.pos, "Duration must be a 4 or 8 byte float");
+      } else {
+        r.duration = readFloat(data, e.dataPos, e.size);
+      }
+      break;
+    case ID_SEEK_ID:
+      r.seeks.push_back({(uint32_t)readUint(data, e.dataPos, e.size), 0});
+      break;
+    case ID_SEEK_POSITION:
+      if (r.seeks.empty()) {
+        error(r, e.pos, "SeekPosition without SeekID");
+      } else {
+        r.seeks.back().second = readUint(data, e.dataPos, e.size);
+      }
+      break;
+    case ID_TRACK_NUMBER:
+      r.mjpegTrack = readUint(data, e.dataPos, e.size);
+      break;
+    case ID_CODEC_ID: {
+      r.codecId = std::string((const char*)&data[e.dataPos], e.size).c_str();
+      if (r.codecId != "V_MJPEG") {
+        error(r, e.pos, "unexpected CodecID %s", r.codecId.c_str());
+      }
+      break;
+    }
+    case ID_PIXEL_WIDTH:
+      r.width = readUint(data, e.dataPos, e.size);
+      break;
+    case ID_PIXEL_HEIGHT:
+      r.height = readUint(data, e.dataPos, e.size);
+      break;
+    case ID_TIMESTAMP:
+      if (parent == ID_CLUSTER) {
+        r.clusterTime = (int64_t)readUint(data, e.dataPos, e.size);
+        r.clusterTimes[r.elementsAt.rbegin()->first] = r.clusterTime;
+      }
+      break;
+    case ID_SIMPLE_BLOCK:
+      checkBlock(r, data, e);
+      break;
+    case ID_CUE_TIME:
+      r.cueTime = readUint(data, e.dataPos, e.size);
+      break;
+    case ID_CUE_TRACK:
+      r.cueTrack = readUint(data, e.dataPos, e.size);
+      break;
+    case ID_CUE_CLUSTER_POSITION:
+      r.cuePosition = readUint(data, e.dataPos, e.size);
+      break;
+  }
+}
+
+// Обход дочерних элементов [pos, end). false - файл оборван внутри
+static bool walk(Report& r, const std::vector<uint8_t>& data, uint64_t pos, uint64_t end,
+                 uint32_t parent, bool parentUnknown, int depth) {
+  while (pos < end) {
+    // После Segment - хвост оборванного кадра, оставленный восстановлением
+    if (parent == 0 && r.segmentData != 0) {
+      warning(r, pos, "data after end of Segment (ignored by players)");
+      return true;
+    }
+    Element e;
+    if (!readHeader(data, pos, e)) {
+      r.truncated = true;
+      warning(r, pos, "truncated element header");
+      return false;
+    }
+
+    // Элемент неизвестного размера заканчивается на следующем элементе уровня 1
+    if (parentUnknown && parent == ID_CLUSTER && e.idLength == 4) {
+      return true;
+    }
+
+    if (e.unknownSize) {
+      if (e.id != ID_SEGMENT && e.id != ID_CLUSTER) {
+        error(r, pos, "unknown size on %s", elementName(e.id).c_str());
+        return false;
+      }
+      e.size = end - e.dataPos;
+    } else if (e.dataPos + e.size > data.size()) {
+      r.truncated = true;
+      warning(r, pos, "element runs past end of file");
+      if (!isMaster(e.id)) {
+        return false;
+      }
+      e.size = data.size() - e.dataPos;  // Разбираем то, что успело записаться
+    } else if (e.dataPos + e.size > end) {
+      error(r, pos, "%s overflows its parent", elementName(e.id).c_str());
+      return false;
+    }
+
+    if (r.tree) {
+      printf("%*s%s @%llu size=%s%llu\n", depth * 2, "", elementName(e.id).c_str(), (unsigned long long)pos,
+             e.unknownSize ? "unknown/" : "", (unsigned long long)e.size);
+    }
+
+    if (parent == ID_SEGMENT) {
+      r.elementsAt[pos - r.segmentData] = e.id;
+      if (e.unknownSize && e.id == ID_CLUSTER) {
+        warning(r, pos, "cluster with unknown size (unfinalized recording)");
+      }
+    }
+
+    if (e.id == ID_SEGMENT) {
+      r.segmentData = e.dataPos;
+      if (e.unknownSize) {
+        warning(r, pos, "segment with unknown size (unfinalized recording)");
+      }
+    } else if (e.id == ID_CLUSTER) {
+      r.clusters++;
+      r.clusterTime = -1;
+    } else if (e.id == ID_CUE_POINT) {
+      r.cueTime = r.cueTrack = r.cuePosition = 0;
+    }
+
+    if (isMaster(e.id)) {
+      uint64_t childEnd = e.dataPos + e.size;
+      bool complete = walk(r, data, e.dataPos, childEnd, e.id, e.unknownSize, depth + 1);
+      if (e.id == ID_CUE_POINT) {
+        if (r.cueTrack != r.mjpegTrack) {
+          error(r, pos, "CuePoint for unknown track");
+        }
+        r.cues.push_back({r.cueTime, r.cuePosition});
+      }
+      if (!complete) {
+        return false;
+      }
+      // Кластер неизвестного размера - продолжаем с элемента, на котором он закончился
+      if (e.unknownSize && e.id == ID_CLUSTER) {
+        Element next;
+        uint64_t p = e.dataPos;
+        while (p < end && readHeader(data, p, next) && next.idLength != 4) {
+          p = next.dataPos + next.size;
+        }
+        pos = p;
+        continue;
+      }
+    } else {
+      checkLeaf(r, data, e, parent);
+    }
+    pos = e.dataPos + e.size;
+  }
+  return true;
+}
+
+static void checkReferences(Report& r) {
+  for (const auto& seek : r.seeks) {
+    auto it = r.elementsAt.find(seek.second);
+    if (it == r.elementsAt.end() || it->second != seek.first) {
+      error(r, r.segmentData + seek.second, "SeekHead entry for %s does not point at it", elementName(seek.first).c_str());
+    }
+  }
+
+  uint64_t previous = 0;
+  for (size_t i = 0; i < r.cues.size(); i++) {
+    uint64_t time = r.cues[i].first;
+    auto it = r.clusterTimes.find(r.cues[i].second);
+    if (it == r.clusterTimes.end()) {
+      error(r, r.segmentData + r.cues[i].second, "CuePoint does not point at a cluster");
+    } else if ((uint64_t)it->second != time) {
+      error(r, r.segmentData + r.cues[i].second, "CueTime differs from cluster Timestamp");
+    }
+    if (i > 0 && time <= previous) {
+      error(r, r.segmentData + r.cues[i].second, "CuePoints are not in time order");
+    }
+    previous = time;
+  }
+
+  if (r.duration >= 0 && r.lastBlockTime >= 0 && r.duration < (double)r.lastBlockTime) {
+    error(r, 0, "Duration is shorter than the last frame");
+  }
+}
+
+// Разбор и проверка файла в памяти; false - не EBML
+static bool inspectData(Report& r, const std::vector<uint8_t>& data) {
+  Element first;
+  if (!readHeader(data, 0, first) || first.id != ID_EBML) {
+    return false;
+  }
+  walk(r, data, 0, data.size(), 0, false, 0);
+
+  if (r.docType != "matroska" && r.docType != "webm") {
+    error(r, 0, "unexpected DocType '%s'", r.docType.c_str());
+  }
+  if (r.segmentData == 0) {
+    error(r, 0, "no Segment");
+  }
+  if (r.mjpegTrack == 0) {
+    error(r, 0, "no video track");
+  }
+  checkReferences(r);
+  return true;
+}
+
+#ifndef MKV_INSPECT_NO_MAIN
+// 0 - корректен, 1 - есть ошибки, 2 - ошибка чтения
+static int inspectFile(const std::string& path, bool tree) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    perror(path.c_str());
+    return 2;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  Report r;
+  r.path = path;
+  r.tree = tree;
+  if (!inspectData(r, data)) {
+    fprintf(stderr, "%s: not an EBML file\n", path.c_str());
+    return 1;
+  }
+
+  double scaleMs = r.timestampScale / 1000000.0;
+  printf("%s: %dx%d, %llu frames in %llu clusters, %zu cues, last frame %.0f ms, duration %s",
+         path.c_str(), (int)r.width, (int)r.height, (unsigned long long)r.frames,
+         (unsigned long long)r.clusters, r.cues.size(), r.lastBlockTime * scaleMs,
+         r.duration >= 0 ? "" : "not set");
+  if (r.duration >= 0) {
+    printf("%.0f ms", r.duration * scaleMs);
+  }
+  printf("%s, %d error(s), %d warning(s)\n", r.truncated ? " (truncated)" : "", r.errors, r.warnings);
+  return r.errors ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  bool tree = false;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--tree") == 0) {
+      tree = true;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+
+  if (files.empty()) {
+    fprintf(stderr, "usage: %s [--tree] file.mkv [...]\n", argv[0]);
+    return 2;
+  }
+
+  int status = 0;
+  for (const std::string& path : files) {
+    int result = inspectFile(path, tree);
+    if (result > status) {
+      status = result;
+    }
+  }
+  return status;
+}
+#endif // MKV_INSPECT_NO_MAIN
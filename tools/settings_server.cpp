@@ -0,0 +1,351 @@
+/*
+ * Settings Server - тестовый сервер настроек для settings_channel
+ *
+ * Минимальная реализация API настроек (см. docs/api.md) для проверки доставки
+ * настроек на камеру без настоящего сервера:
+ * - GET  /api/camera          - текущие настройки + X-Settings-Version и ETag;
+ *                               304 без тела, если If-None-Match совпадает с ETag
+ * - GET  /api/camera/watch    - long-poll: ответ сразу, если версия камеры устарела,
+ *                               иначе при изменении настроек или 204 через timeout секунд
+ * - POST /api/camera          - заменить настройки (JSON в теле), версия +1
+ * - POST /api/status          - статус камеры (печатается применённая версия)
+ * - POST /stream              - кадры принимаются и отбрасываются
+ *
+ * Управление в соединении потока (stream_control): на кадр или статус с X-Settings-Version
+ * ответ несёт текущую версию, а если версия камеры устарела - и JSON настроек.
+ *
+ * Новые настройки можно вводить и в stdin - одна строка JSON = новая версия.
+ * В лог пишется подтверждение: какую версию камера применила и через сколько мс
+ * после изменения пришёл запрос с ней.
+ *
+ * Сборка:
+ *   g++ -std=c++17 -O2 -o settings_server tools/settings_server.cpp
+ *
+ * Использование:
+ *   ./settings_server [--port 8081] [--settings initial.json]
+ *   curl -X POST --data '{"quality":12}' http://localhost:8081/api/camera
+ *
+ * Тест канала настроек (test/test_settings_channel) подключает файл с SETTINGS_SERVER_NO_MAIN
+ * и крутит serveOnce() в одном потоке с handleSettingsChannel()
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const char* SETTINGS_PATH = "/api/camera";
+static const char* WATCH_PATH = "/api/camera/watch";
+static const size_t MAX_BODY = 4 * 1024 * 1024;
+
+static std::string settings = "{}";
+static unsigned long version = 1;
+static std::chrono::steady_clock::time_point changeTime = std::chrono::steady_clock::now();
+static bool settingsChanged = false;              // Ждущим long-poll запросам - ответить сразу
+static std::map<std::string, unsigned long> acked;  // Устройство -> подтверждённая версия
+
+static long long nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct Request {
+  std::string method;
+  std::string path;
+  std::map<std::string, std::string> query;
+  std::map<std::string, std::string> headers;  // Имена в нижнем регистре
+  std::string body;
+
+  std::string header(const char* name) const {
+    auto it = headers.find(name);
+    return it == headers.end() ? "" : it->second;
+  }
+};
+
+struct Connection {
+  int fd;
+  std::string buffer;
+  bool watching = false;       // Держим long-poll запрос
+  long long deadline = 0;      // Когда ответить 204
+};
+
+// Разобрать запрос из буфера. false - запрос ещё не пришёл целиком
+static bool parseRequest(std::string& buffer, Request& req, bool& bad) {
+  size_t end = buffer.find("\r\n\r\n");
+  if (end == std::string::npos) {
+    bad = buffer.size() > 16384;
+    return false;
+  }
+  std::istringstream head(buffer.substr(0, end));
+  std::string line;
+  std::getline(head, line);
+  char method[16], target[512];
+  if (sscanf(line.c_str(), "%15s %511s", method, target) != 2) {
+    bad = true;
+    return false;
+  }
+  req = Request();
+  req.method = method;
+  std::string t = target;
+  size_t q = t.find('?');
+  req.path = t.substr(0, q);
+  if (q != std::string::npos) {
+    std::istringstream params(t.substr(q + 1));
+    std::string param;
+    while (std::getline(params, param, '&')) {
+      size_t eq = param.find('=');
+      req.query[param.substr(0, eq)] = eq == std::string::npos ? "" : param.substr(eq + 1);
+    }
+  }
+  while (std::getline(head, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string name = line.substr(0, colon);
+    for (char& c : name) {
+      c = tolower(c);
+    }
+    size_t value = line.find_first_not_of(' ', colon + 1);
+    req.headers[name] = value == std::string::npos ? "" : line.substr(value);
+  }
+
+  size_t length = strtoull(req.header("content-length").c_str(), nullptr, 10);
+  if (length > MAX_BODY) {
+    bad = true;
+    return false;
+  }
+  if (buffer.size() < end + 4 + length) {
+    return false;
+  }
+  req.body = buffer.substr(end + 4, length);
+  buffer.erase(0, end + 4 + length);
+  return true;
+}
+
+static void respond(int fd, int status, const char* reason, const std::string& body, bool withVersion) {
+  char head[256];
+  int len = snprintf(head, sizeof(head), "HTTP/1.1 %d %s\r\n", status, reason);
+  std::string response(head, len);
+  if (withVersion) {
+    response += "X-Settings-Version: " + std::to_string(version) + "\r\n";
+    response += "ETag: \"" + std::to_string(version) + "\"\r\n";
+  }
+  if (!body.empty()) {
+    response += "Content-Type: application/json\r\n";
+  }
+  response += "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+  send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+}
+
+static void setSettings(const std::string& json) {
+  settings = json;
+  version++;
+  changeTime = std::chrono::steady_clock::now();
+  settingsChanged = true;
+  printf("settings v%lu: %s\n", version, settings.c_str());
+}
+
+// Ответ на отложенный long-poll запрос
+static void answerWatch(Connection& conn, bool changed) {
+  conn.watching = false;
+  if (changed) {
+    respond(conn.fd, 200, "OK", settings, true);
+  } else {
+    respond(conn.fd, 204, "No Content", "", true);
+  }
+}
+
+// Первое подтверждение каждой версии от каждой камеры
+static void logAck(const Request& req) {
+  std::string applied = req.header("x-settings-version");
+  if (applied.empty()) {
+    return;
+  }
+  unsigned long ackVersion = strtoul(applied.c_str(), nullptr, 10);
+  std::string device = req.header("x-device-id");
+  if (ackVersion == version && acked[device] != ackVersion) {
+    acked[device] = ackVersion;
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                     std::chrono::steady_clock::now() - changeTime).count();
+    printf("%s applied v%lu (%lld ms after change)\n", device.c_str(), ackVersion, ms);
+  }
+}
+
+static void handleRequest(Connection& conn, Request& req) {
+  if (req.method == "GET" && req.path == WATCH_PATH) {
+    logAck(req);
+    unsigned long known = strtoul(req.query["version"].c_str(), nullptr, 10);
+    int timeout = atoi(req.query["timeout"].c_str());
+    if (timeout <= 0 || timeout > 120) {
+      timeout = 25;
+    }
+    if (known != version) {
+      respond(conn.fd, 200, "OK", settings, true);
+    } else {
+      conn.watching = true;
+      conn.deadline = nowMs() + timeout * 1000LL;
+    }
+  } else if (req.method == "GET" && req.path == SETTINGS_PATH) {
+    logAck(req);
+    if (req.header("if-none-match") == "\"" + std::to_string(version) + "\"") {
+      respond(conn.fd, 304, "Not Modified", "", true);
+    } else {
+      respond(conn.fd, 200, "OK", settings, true);
+    }
+  } else if (req.method == "POST" && req.path == SETTINGS_PATH) {
+    setSettings(req.body);
+    respond(conn.fd, 200, "OK", "", true);
+  } else if (req.method == "POST" && (req.path == "/api/status" || req.path == "/stream")) {
+    if (req.path == "/api/status") {
+      printf("status: %s\n", req.body.c_str());
+    }
+    // Старая камера без версии в запросе - пустой ответ, как раньше
+    std::string applied = req.header("x-settings-version");
+    if (applied.empty()) {
+      respond(conn.fd, 200, "OK", "", false);
+    } else {
+      logAck(req);
+      bool stale = strtoul(applied.c_str(), nullptr, 10) != version;
+      respond(conn.fd, 200, "OK", stale ? settings : "", true);
+    }
+  } else {
+    respond(conn.fd, 404, "Not Found", "", false);
+  }
+}
+
+static int listenOn(int port) {
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(server, 8) < 0) {
+    perror("bind");
+    close(server);
+    return -1;
+  }
+  return server;
+}
+
+static std::vector<Connection> connections;
+
+// Один проход цикла сервера: новые соединения, запросы, ответы ждущим.
+// input - поток строк JSON с настройками (-1 - нет; закрывается при конце ввода)
+static void serveOnce(int server, int& input, int timeoutMs) {
+  std::vector<pollfd> fds;
+  fds.push_back({server, POLLIN, 0});
+  fds.push_back({input, POLLIN, 0});
+  for (auto& conn : connections) {
+    fds.push_back({conn.fd, POLLIN, 0});
+  }
+  poll(fds.data(), fds.size(), settingsChanged ? 0 : timeoutMs);
+
+  if (fds[1].revents & (POLLIN | POLLHUP)) {
+    std::string line;
+    if (std::getline(std::cin, line)) {
+      if (!line.empty()) {
+        setSettings(line);
+      }
+    } else {
+      input = -1;
+    }
+  }
+
+  for (size_t i = 0; i < connections.size(); i++) {
+    Connection& conn = connections[i];
+    bool closed = false;
+    if (fds[i + 2].revents & (POLLIN | POLLHUP | POLLERR)) {
+      char tmp[16384];
+      ssize_t n = recv(conn.fd, tmp, sizeof(tmp), 0);
+      if (n <= 0) {
+        closed = true;
+      } else {
+        conn.buffer.append(tmp, n);
+      }
+    }
+    Request req;
+    bool bad = false;
+    while (!closed && !conn.watching && parseRequest(conn.buffer, req, bad)) {
+      handleRequest(conn, req);
+    }
+    if (bad) {
+      closed = true;
+    }
+    if (closed) {
+      close(conn.fd);
+      connections.erase(connections.begin() + i);
+      fds.erase(fds.begin() + i + 2);
+      i--;
+    }
+  }
+
+  // Изменение настроек - сразу отвечаем всем ждущим; остальным 204 по истечении timeout
+  bool changed = settingsChanged;
+  settingsChanged = false;
+  long long now = nowMs();
+  for (auto& conn : connections) {
+    if (conn.watching && (changed || now >= conn.deadline)) {
+      answerWatch(conn, changed);
+    }
+  }
+
+  // Новое соединение - после разбора: у него ещё нет своего элемента в fds
+  if (fds[0].revents & POLLIN) {
+    int fd = accept(server, nullptr, nullptr);
+    if (fd >= 0) {
+      connections.push_back({fd, ""});
+    }
+  }
+  fflush(stdout);
+}
+
+#ifndef SETTINGS_SERVER_NO_MAIN
+int main(int argc, char** argv) {
+  int port = 8081;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--port" && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (arg == "--settings" && i + 1 < argc) {
+      std::ifstream file(argv[++i]);
+      std::stringstream content;
+      content << file.rdbuf();
+      settings = content.str();
+    } else {
+      fprintf(stderr, "Usage: %s [--port 8081] [--settings initial.json]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  int server = listenOn(port);
+  if (server < 0) {
+    return 1;
+  }
+  printf("Listening on :%d, settings v%lu\n", port, version);
+  fflush(stdout);
+
+  int input = 0;
+  while (true) {
+    serveOnce(server, input, 200);
+  }
+}
+#endif // SETTINGS_SERVER_NO_MAIN
@@ -0,0 +1,252 @@
+/*
+ * Trace to Chrome - перевод дампа трассы событий камеры в формат Chrome Trace
+ *
+ * Дамп - GET http://<ip>/trace (сервер записей) или файл /trace.bin на SD (команда "trace").
+ * Формат - TraceDumpHeader и события TraceEvent из include/event_trace.h.
+ *
+ * Результат открывается в chrome://tracing или https://ui.perfetto.dev:
+ * - по дорожке на ядро ESP32
+ * - пары событий BEGIN/END (отправка кадра, запись на SD, переподключение) - интервалы с длительностью
+ * - захват, отправка, потеря кадра, применение настроек - отметки времени
+ * - размер захваченного кадра - счётчик frame_kb
+ * Время - от первого события дампа; 32-битное время устройства разворачивается при переполнении.
+ *
+ * В stderr - сводка: события, перезаписанные и потерянные при выгрузке, самые долгие паузы
+ * между захватами кадров (подвисания).
+ *
+ * Сборка:
+ *   g++ -std=c++17 -O2 -o trace_to_chrome tools/trace_to_chrome.cpp
+ *
+ * Использование:
+ *   ./trace_to_chrome trace.bin > trace.json
+ *   ./trace_to_chrome trace.bin trace.json
+ *
+ * Код возврата: 0 - готово, 1 - неверный формат дампа, 2 - ошибка чтения/записи
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Типы событий (event_trace.h)
+enum EventType : uint8_t {
+  FRAME_CAPTURED = 1,
+  FRAME_SENT = 2,
+  FRAME_DROPPED = 3,
+  SD_WRITE_BEGIN = 4,
+  SD_WRITE_END = 5,
+  RECONNECT_BEGIN = 6,
+  RECONNECT_END = 7,
+  SETTINGS_APPLIED = 8,
+  SEND_BEGIN = 9,
+  SEND_END = 10
+};
+
+static const size_t HEADER_SIZE = 24;
+static const size_t EVENT_SIZE = 12;
+static const int CORES = 2;
+
+struct Event {
+  uint64_t timeUs;     // Развёрнутое время
+  uint8_t type;
+  uint8_t core;
+  uint32_t arg;
+};
+
+static uint16_t readLE16(const uint8_t* p) {
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t readLE32(const uint8_t* p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static const char* dropReason(uint32_t reason) {
+  switch (reason) {
+    case 1: return "no_connection";
+    case 2: return "capture";
+    case 3: return "send";
+    default: return "unknown";
+  }
+}
+
+// Интервал: тип BEGIN -> имя (END = BEGIN + 1)
+static const char* spanName(uint8_t beginType) {
+  switch (beginType) {
+    case SD_WRITE_BEGIN: return "sd_write";
+    case RECONNECT_BEGIN: return "reconnect";
+    case SEND_BEGIN: return "send";
+    default: return nullptr;
+  }
+}
+
+static bool isSpanEnd(uint8_t type) {
+  return type == SD_WRITE_END || type == RECONNECT_END || type == SEND_END;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "Usage: %s trace.bin [trace.json]\n", argv[0]);
+    return 2;
+  }
+
+  std::ifstream in(argv[1], std::ios::binary);
+  if (!in) {
+    fprintf(stderr, "Cannot open %s\n", argv[1]);
+    return 2;
+  }
+  std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+  if (data.size() < HEADER_SIZE || memcmp(data.data(), "ECTR", 4) != 0) {
+    fprintf(stderr, "%s: not a trace dump\n", argv[1]);
+    return 1;
+  }
+  uint16_t version = readLE16(&data[4]);
+  uint16_t eventSize = readLE16(&data[6]);
+  uint32_t count = readLE32(&data[8]);
+  uint32_t total = readLE32(&data[12]);
+  uint32_t lost = readLE32(&data[16]);
+  if (version != 1 || eventSize != EVENT_SIZE) {
+    fprintf(stderr, "%s: unsupported dump version %u (event size %u)\n", argv[1], version, eventSize);
+    return 1;
+  }
+  if (data.size() < HEADER_SIZE + (size_t)count * EVENT_SIZE) {
+    fprintf(stderr, "%s: truncated, %u events expected\n", argv[1], count);
+    return 1;
+  }
+
+  // События в порядке записи; время разных ядер может идти чуть не по порядку -
+  // переполнение 32 бит определяем по скачку назад больше чем на половину диапазона
+  std::vector<Event> events;
+  events.reserve(count);
+  uint64_t epoch = 0;
+  uint32_t last = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    const uint8_t* p = &data[HEADER_SIZE + (size_t)i * EVENT_SIZE];
+    uint32_t time = readLE32(p);
+    if (i > 0 && time < last && last - time > 0x80000000u) {
+      epoch += 0x100000000ull;
+    }
+    last = time;
+    Event event;
+    event.timeUs = epoch + time;
+    event.type = p[4];
+    event.core = p[5] < CORES ? p[5] : 0;
+    event.arg = readLE32(p + 8);
+    events.push_back(event);
+  }
+  uint64_t start = events.empty() ? 0 : events[0].timeUs;
+  for (const Event& event : events) {
+    start = std::min(start, event.timeUs);
+  }
+
+  FILE* out = stdout;
+  if (argc == 3) {
+    out = fopen(argv[2], "w");
+    if (!out) {
+      fprintf(stderr, "Cannot write %s\n", argv[2]);
+      return 2;
+    }
+  }
+
+  fprintf(out, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"events\":%u,\"overwritten\":%u,\"lost\":%u},\n",
+          count, total - count, lost);
+  fprintf(out, "\"traceEvents\":[\n");
+  fprintf(out, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"ESP32-CAM\"}}");
+  for (int core = 0; core < CORES; core++) {
+    fprintf(out, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"core %d\"}}",
+            core, core);
+  }
+
+  // Открытые интервалы: индекс события BEGIN по ядру и типу (-1 - нет)
+  long open[CORES][256];
+  for (int core = 0; core < CORES; core++) {
+    std::fill(std::begin(open[core]), std::end(open[core]), -1);
+  }
+  size_t unmatched = 0;
+
+  for (size_t i = 0; i < events.size(); i++) {
+    const Event& event = events[i];
+    double ts = (double)(event.timeUs - start);
+    switch (event.type) {
+      case SD_WRITE_BEGIN:
+      case RECONNECT_BEGIN:
+      case SEND_BEGIN:
+        open[event.core][event.type] = (long)i;
+        break;
+
+      case FRAME_CAPTURED:
+        fprintf(out, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"capture\",\"pid\":1,\"tid\":%u,\"ts\":%.0f,"
+                "\"args\":{\"bytes\":%u}}", event.core, ts, event.arg);
+        fprintf(out, ",\n{\"ph\":\"C\",\"name\":\"frame_kb\",\"pid\":1,\"ts\":%.0f,\"args\":{\"kb\":%u}}",
+                ts, event.arg / 1024);
+        break;
+
+      case FRAME_SENT:
+        fprintf(out, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"sent\",\"pid\":1,\"tid\":%u,\"ts\":%.0f,"
+                "\"args\":{\"frame\":%u}}", event.core, ts, event.arg);
+        break;
+
+      case FRAME_DROPPED:
+        fprintf(out, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"dropped\",\"cname\":\"terrible\",\"pid\":1,"
+                "\"tid\":%u,\"ts\":%.0f,\"args\":{\"reason\":\"%s\"}}", event.core, ts, dropReason(event.arg));
+        break;
+
+      case SETTINGS_APPLIED:
+        fprintf(out, ",\n{\"ph\":\"i\",\"s\":\"p\",\"name\":\"settings\",\"pid\":1,\"tid\":%u,\"ts\":%.0f,"
+                "\"args\":{\"json_bytes\":%u}}", event.core, ts, event.arg);
+        break;
+
+      default:
+        if (isSpanEnd(event.type)) {
+          uint8_t beginType = event.type - 1;
+          long begin = open[event.core][beginType];
+          if (begin < 0) {
+            unmatched++;   // BEGIN перезаписан или потерян
+            break;
+          }
+          open[event.core][beginType] = -1;
+          const Event& beginEvent = events[begin];
+          fprintf(out, ",\n{\"ph\":\"X\",\"name\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%.0f,\"dur\":%.0f,"
+                  "\"args\":{\"arg\":%u,\"ok\":%u}}", spanName(beginType), event.core,
+                  (double)(beginEvent.timeUs - start), (double)(event.timeUs - beginEvent.timeUs),
+                  beginEvent.arg, event.arg);
+        }
+        break;
+    }
+  }
+  fprintf(out, "\n]}\n");
+  if (out != stdout && fclose(out) != 0) {
+    fprintf(stderr, "Cannot write %s\n", argv[2]);
+    return 2;
+  }
+
+  // Сводка: самые долгие паузы между захватами
+  std::vector<std::pair<uint64_t, uint64_t>> gaps;   // (длительность, начало)
+  uint64_t previous = 0;
+  bool havePrevious = false;
+  for (const Event& event : events) {
+    if (event.type != FRAME_CAPTURED) {
+      continue;
+    }
+    if (havePrevious && event.timeUs > previous) {
+      gaps.push_back(std::make_pair(event.timeUs - previous, previous - start));
+    }
+    previous = event.timeUs;
+    havePrevious = true;
+  }
+  std::sort(gaps.rbegin(), gaps.rend());
+
+  double span = events.empty() ? 0 : (double)(events.back().timeUs - start) / 1000.0;
+  fprintf(stderr, "%u events over %.1f ms (%u overwritten, %u lost during dump, %zu unmatched ends)\n",
+          count, span, total - count, lost, unmatched);
+  for (size_t i = 0; i < gaps.size() && i < 5; i++) {
+    fprintf(stderr, "  capture gap %.1f ms at %.1f ms\n", gaps[i].first / 1000.0, gaps[i].second / 1000.0);
+  }
+  return 0;
+}
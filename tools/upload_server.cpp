@@ -0,0 +1,361 @@
+/*
+ * Upload Server - тестовый приёмник сегментов для segment_uploader
+ *
+ * Минимальная реализация POST /api/records/upload (см. docs/api.md) для проверки
+ * выгрузки с камеры без настоящего сервера:
+ * - части сегмента дописываются в <dir>/<device>/<start>_<name>.part
+ * - смещение части должно совпадать с размером .part, иначе 409 с текущим смещением
+ * - после получения X-Upload-Total байт .part переименовывается в <start>_<name>
+ * - keep-alive, одно соединение за раз (одна камера)
+ *
+ * Имитация плохой сети:
+ *   --fail P   ответить 500 без сохранения части (вероятность 0..1)
+ *   --drop P   оборвать соединение посреди тела запроса
+ *   --lose P   сохранить часть и закрыть соединение без ответа (ответ потерян)
+ *
+ * Сборка:
+ *   g++ -std=c++17 -O2 -o upload_server tools/upload_server.cpp
+ *
+ * Использование:
+ *   ./upload_server [--port 8081] [--dir uploads] [--fail 0.1] [--drop 0.05] [--lose 0.05]
+ *
+ * Тест выгрузки (test/test_segment_uploader) подключает файл с UPLOAD_SERVER_NO_MAIN
+ * и крутит serveOnce() в одном потоке с handleSegmentUploader()
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Не fs: так называется пространство имён FS.h прошивки, тест выгрузки подключает оба
+namespace files = std::filesystem;
+
+static const char* UPLOAD_PATH = "/api/records/upload";
+static const uint64_t MAX_CHUNK = 4 * 1024 * 1024;
+static const long long IDLE_TIMEOUT_MS = 30000;  // Камера пропала (перезагрузка) - принимаем новое соединение
+
+static std::mt19937 rng(std::random_device{}());
+
+static long long nowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool chance(double p) {
+  return p > 0 && std::uniform_real_distribution<double>(0, 1)(rng) < p;
+}
+
+struct Request {
+  std::string method;
+  std::string path;
+  std::map<std::string, std::string> headers;  // Имена в нижнем регистре
+  std::string body;
+
+  std::string header(const char* name) const {
+    auto it = headers.find(name);
+    return it == headers.end() ? "" : it->second;
+  }
+};
+
+// Соединение камеры: запрос собирается из буфера по мере поступления данных
+struct Connection {
+  int fd = -1;
+  std::string buffer;
+  Request req;
+  bool haveHeaders = false;  // Заголовок текущего запроса разобран, ждём тело
+  bool dropping = false;     // Оборвать посреди тела (--drop)
+  uint64_t length = 0;
+  long long lastData = 0;    // Когда пришли последние данные
+};
+
+// Принятый запрос выгрузки: смещение запроса и ответ на него
+struct Exchange {
+  uint64_t offset;  // X-Upload-Offset запроса
+  int status;       // 0 - ответ потерян (--lose)
+  long answered;    // X-Upload-Offset ответа (-1 - нет)
+};
+
+static double failRate = 0;
+static double dropRate = 0;
+static double loseRate = 0;
+static std::vector<Exchange> exchanges;  // По порядку запросов
+
+// Разобрать заголовок запроса из буфера. false - заголовок ещё не пришёл целиком
+static bool parseHeaders(std::string& buffer, Request& req, bool& bad) {
+  size_t end = buffer.find("\r\n\r\n");
+  if (end == std::string::npos) {
+    bad = buffer.size() > 8192;
+    return false;
+  }
+  std::istringstream head(buffer.substr(0, end));
+  buffer.erase(0, end + 4);
+  std::string line;
+  std::getline(head, line);
+  char method[16], path[256];
+  if (sscanf(line.c_str(), "%15s %255s", method, path) != 2) {
+    bad = true;
+    return false;
+  }
+  req = Request();
+  req.method = method;
+  req.path = path;
+
+  while (std::getline(head, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string name = line.substr(0, colon);
+    for (char& c : name) {
+      c = tolower(c);
+    }
+    size_t value = line.find_first_not_of(' ', colon + 1);
+    req.headers[name] = value == std::string::npos ? "" : line.substr(value);
+  }
+  return true;
+}
+
+static void respond(int fd, int status, const char* reason, long offset) {
+  char response[256];
+  int len;
+  if (offset >= 0) {
+    len = snprintf(response, sizeof(response),
+                   "HTTP/1.1 %d %s\r\nX-Upload-Offset: %ld\r\nContent-Length: 0\r\n\r\n", status, reason, offset);
+  } else {
+    len = snprintf(response, sizeof(response), "HTTP/1.1 %d %s\r\nContent-Length: 0\r\n\r\n", status, reason);
+  }
+  send(fd, response, len, MSG_NOSIGNAL);
+}
+
+// Только безопасные символы имени (без / и ..)
+static std::string sanitize(const std::string& value) {
+  std::string out;
+  for (char c : value) {
+    out += (isalnum((unsigned char)c) || c == '.' || c == '_' || c == '-') ? c : '-';
+  }
+  while (!out.empty() && out[0] == '.') {
+    out.erase(0, 1);
+  }
+  return out;
+}
+
+// Ответ на запрос выгрузки (с записью в журнал)
+static void answer(int fd, uint64_t offset, int status, const char* reason, long answered) {
+  respond(fd, status, reason, answered);
+  exchanges.push_back({offset, status, answered});
+}
+
+// false - ответ не отправлен, соединение нужно закрыть
+static bool handleUpload(int fd, const Request& req, const files::path& root) {
+  std::string device = sanitize(req.header("x-device-id"));
+  std::string name = sanitize(req.header("x-segment"));
+  std::string start = sanitize(req.header("x-segment-start"));
+  std::string offsetHeader = req.header("x-upload-offset");
+  std::string totalHeader = req.header("x-upload-total");
+  if (device.empty() || name.empty() || start.empty() || offsetHeader.empty() || totalHeader.empty()) {
+    respond(fd, 400, "Bad Request", -1);
+    return true;
+  }
+  uint64_t offset = strtoull(offsetHeader.c_str(), nullptr, 10);
+  uint64_t total = strtoull(totalHeader.c_str(), nullptr, 10);
+
+  files::path dir = root / device;
+  files::create_directories(dir);
+  files::path finalPath = dir / (start + "_" + name);
+  files::path partPath = dir / (start + "_" + name + ".part");
+
+  // Сегмент уже принят целиком (повтор после потерянного ответа)
+  if (files::exists(finalPath)) {
+    printf("%s %s: already complete\n", device.c_str(), name.c_str());
+    answer(fd, offset, 200, "OK", (long)files::file_size(finalPath));
+    return true;
+  }
+
+  uint64_t current = files::exists(partPath) ? files::file_size(partPath) : 0;
+  if (offset != current) {
+    printf("%s %s: offset %llu, have %llu -> 409\n", device.c_str(), name.c_str(),
+           (unsigned long long)offset, (unsigned long long)current);
+    answer(fd, offset, 409, "Conflict", (long)current);
+    return true;
+  }
+  if (current + req.body.size() > total) {
+    answer(fd, offset, 400, "Bad Request", (long)current);
+    return true;
+  }
+  if (chance(failRate)) {
+    printf("%s %s: injected failure\n", device.c_str(), name.c_str());
+    answer(fd, offset, 500, "Internal Server Error", -1);
+    return true;
+  }
+
+  FILE* f = fopen(partPath.c_str(), "ab");
+  if (!f || fwrite(req.body.data(), 1, req.body.size(), f) != req.body.size()) {
+    if (f) fclose(f);
+    answer(fd, offset, 500, "Internal Server Error", -1);
+    return true;
+  }
+  fclose(f);
+  current += req.body.size();
+
+  if (current == total) {
+    files::rename(partPath, finalPath);
+    printf("%s %s: complete, %llu bytes\n", device.c_str(), name.c_str(), (unsigned long long)total);
+  } else {
+    printf("%s %s: %llu / %llu\n", device.c_str(), name.c_str(), (unsigned long long)current,
+           (unsigned long long)total);
+  }
+
+  // Часть сохранена, но камера ответа не получит - повтор того же смещения получит 409
+  if (chance(loseRate)) {
+    printf("  lose response\n");
+    exchanges.push_back({offset, 0, -1});
+    return false;
+  }
+  answer(fd, offset, 200, "OK", (long)current);
+  return true;
+}
+
+static int listenOn(int port) {
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(server, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(server, 4) < 0) {
+    perror("bind");
+    close(server);
+    return -1;
+  }
+  return server;
+}
+
+static Connection connection;  // Одно соединение за раз (одна камера)
+
+static void closeConnection() {
+  close(connection.fd);
+  connection = Connection();
+}
+
+// Обработать запросы, уже пришедшие целиком. false - соединение закрыто
+static bool processBuffered(const files::path& root) {
+  Connection& conn = connection;
+  while (true) {
+    if (!conn.haveHeaders) {
+      bool bad = false;
+      if (!parseHeaders(conn.buffer, conn.req, bad)) {
+        return !bad;
+      }
+      conn.length = strtoull(conn.req.header("content-length").c_str(), nullptr, 10);
+      if (conn.length > MAX_CHUNK) {
+        return false;
+      }
+      conn.haveHeaders = true;
+      conn.dropping = chance(dropRate);
+    }
+
+    // Обрыв посреди тела: половина пришла - закрываем соединение, часть не сохраняется
+    if (conn.dropping && conn.buffer.size() >= conn.length / 2) {
+      printf("  drop connection\n");
+      return false;
+    }
+    if (conn.buffer.size() < conn.length) {
+      return true;
+    }
+    conn.req.body = conn.buffer.substr(0, conn.length);
+    conn.buffer.erase(0, conn.length);
+    conn.haveHeaders = false;
+
+    if (conn.req.method == "POST" && conn.req.path == UPLOAD_PATH) {
+      if (!handleUpload(conn.fd, conn.req, root)) {
+        return false;
+      }
+    } else {
+      respond(conn.fd, 404, "Not Found", -1);
+    }
+  }
+}
+
+// Один проход цикла сервера: новое соединение или данные текущего и ответы на запросы
+static void serveOnce(int server, const files::path& root, int timeoutMs) {
+  pollfd fd = {connection.fd >= 0 ? connection.fd : server, POLLIN, 0};
+  if (poll(&fd, 1, timeoutMs) <= 0) {
+    if (connection.fd >= 0 && nowMs() - connection.lastData > IDLE_TIMEOUT_MS) {
+      closeConnection();
+    }
+    return;
+  }
+
+  if (connection.fd < 0) {
+    connection.fd = accept(server, nullptr, nullptr);
+    connection.lastData = nowMs();
+    return;
+  }
+
+  char tmp[16384];
+  ssize_t n = recv(connection.fd, tmp, sizeof(tmp), 0);
+  if (n <= 0) {
+    closeConnection();
+    return;
+  }
+  connection.buffer.append(tmp, n);
+  connection.lastData = nowMs();
+  if (!processBuffered(root)) {
+    closeConnection();
+  }
+  fflush(stdout);
+}
+
+#ifndef UPLOAD_SERVER_NO_MAIN
+int main(int argc, char** argv) {
+  int port = 8081;
+  files::path root = "uploads";
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--port" && i + 1 < argc) {
+      port = atoi(argv[++i]);
+    } else if (arg == "--dir" && i + 1 < argc) {
+      root = argv[++i];
+    } else if (arg == "--fail" && i + 1 < argc) {
+      failRate = atof(argv[++i]);
+    } else if (arg == "--drop" && i + 1 < argc) {
+      dropRate = atof(argv[++i]);
+    } else if (arg == "--lose" && i + 1 < argc) {
+      loseRate = atof(argv[++i]);
+    } else {
+      fprintf(stderr, "Usage: %s [--port 8081] [--dir uploads] [--fail P] [--drop P] [--lose P]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  int server = listenOn(port);
+  if (server < 0) {
+    return 1;
+  }
+  printf("Listening on :%d, storing to %s\n", port, root.c_str());
+  fflush(stdout);
+
+  while (true) {
+    serveOnce(server, root, 1000);
+  }
+}
+#endif // UPLOAD_SERVER_NO_MAIN